@@ -3,6 +3,7 @@
 #Run a built object using the locally built library
 #Use --threads to run the thread tests
 #Use --maths to run the maths tests
+#Use --structures to run the internal data structure tests
 #Don't specify either of the above to run the graphical demo
 
 #Use --loop to repeatedly run a target (ignored for the default demo)
@@ -28,6 +29,9 @@ for arg in "$@"; do
     --maths)
       target="$buildDir/mathsTest"
       ;;
+    --structures)
+      target="$buildDir/structuresTest"
+      ;;
     --loop)
       loopRequested="true"
       ;;
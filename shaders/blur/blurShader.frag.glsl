@@ -0,0 +1,37 @@
+#version 430 core
+
+in vec2 texCoords;
+out vec4 colour;
+
+uniform sampler2D sourceSampler;
+uniform vec2 blurStep;
+
+//Largest circle of confusion to spread taps by, limits undersampling
+const float maxCircleOfConfusion = 4.0f;
+
+//Gaussian weights for the centre tap and each pair of taps away from it
+const float weights[5] = {
+  0.2270270270, 0.1945945946, 0.1216216216, 0.0540540541, 0.0162162162
+};
+
+void main() {
+  //Spread the taps by this pixel's blur, in focus pixels only sample themselves
+  vec4 centre = texture(sourceSampler, texCoords);
+  vec2 tapStep = blurStep * min(centre.a, maxCircleOfConfusion);
+
+  vec3 col = centre.rgb * weights[0];
+  float totalWeight = weights[0];
+  for (int i = 1; i < 5; i++) {
+    for (int side = -1; side <= 1; side += 2) {
+      vec4 tap = texture(sourceSampler, texCoords + (tapStep * float(i * side)));
+
+      //Sharper taps contribute less, so in focus objects don't leave halos
+      float weight = weights[i] * clamp(tap.a / max(centre.a, 0.001f), 0.0, 1.0);
+      col += tap.rgb * weight;
+      totalWeight += weight;
+    }
+  }
+
+  //Keep the circle of confusion for the next pass and the final composite
+  colour = vec4(col / totalWeight, centre.a);
+}
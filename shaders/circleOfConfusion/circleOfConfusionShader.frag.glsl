@@ -0,0 +1,52 @@
+#version 430 core
+
+in vec2 texCoords;
+out vec4 colour;
+
+uniform sampler2D screenSampler;
+uniform sampler2D depthSampler;
+
+uniform float focalDepth;
+uniform float blurStrength;
+uniform vec2 tapOffset;
+uniform vec2 renderScale;
+
+const float nearPlane = 0.1f;
+
+//Per-frame constants, shared by every shader
+#include "frameData"
+
+//Amount of blur for a depth sample, from its linear distance to the focal depth
+float getCircleOfConfusion(float depth) {
+  depth = 1 - nearPlane / (renderFarPlane + nearPlane - depth * (renderFarPlane - nearPlane));
+  return abs(depth - focalDepth) * blurStrength;
+}
+
+void main() {
+  vec2 offsets[4] = {
+    vec2(-tapOffset.x, -tapOffset.y),
+    vec2(tapOffset.x, -tapOffset.y),
+    vec2(-tapOffset.x, tapOffset.y),
+    vec2(tapOffset.x, tapOffset.y)
+  };
+
+  /*
+   - Downscale the frame by averaging 4 filtered taps, covering the full resolution
+     pixels under this pixel
+   - Keep the largest circle of confusion, so blurred edges aren't shrunk
+  */
+  //Only part of the scene textures may have been drawn to, stay half a texel inside it
+  vec2 maxCoords = renderScale - (0.5 / vec2(textureSize(screenSampler, 0)));
+
+  vec3 col = vec3(0.0);
+  float circleOfConfusion = 0.0;
+  for (int i = 0; i < 4; i++) {
+    vec2 tapCoords = min((texCoords * renderScale) + offsets[i], maxCoords);
+    col += texture(screenSampler, tapCoords).rgb;
+
+    float tapCircle = getCircleOfConfusion(texture(depthSampler, tapCoords).x);
+    circleOfConfusion = max(circleOfConfusion, tapCircle);
+  }
+
+  colour = vec4(col / 4.0, circleOfConfusion);
+}
@@ -4,6 +4,7 @@
 //specular.w is actually power
 struct LightSource {
   vec3 position;
+  float range;
   vec3 diffuse;
   vec4 specular;
 };
@@ -13,10 +14,12 @@ layout (std430, binding = 0) buffer LightPropertiesBuffer {
   LightSource lightSources[];
 };
 
+//Per-frame constants, shared by every shader
+#include "frameData"
+
 in vec4 fragPos;
 
 uniform uint shadowMapIndex;
-uniform float shadowFarPlane;
 
 void main() {
   float lightDistance = distance(fragPos.xyz, lightSources[shadowMapIndex].position);
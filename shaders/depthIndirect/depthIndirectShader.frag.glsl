@@ -0,0 +1,29 @@
+#version 430 core
+
+//Data structure to handle input from shader storage buffer object
+//specular.w is actually power
+struct LightSource {
+  vec3 position;
+  float range;
+  vec3 diffuse;
+  vec4 specular;
+};
+
+//Lighting inputs from shader storage buffer
+layout (std430, binding = 0) buffer LightPropertiesBuffer {
+  LightSource lightSources[];
+};
+
+//Per-frame constants, shared by every shader
+#include "frameData"
+
+in vec4 fragPos;
+
+uniform uint shadowMapIndex;
+
+void main() {
+  float lightDistance = distance(fragPos.xyz, lightSources[shadowMapIndex].position);
+
+  //Save distance, mapped distance to [0, 1]
+  gl_FragDepth = lightDistance / shadowFarPlane;
+}
@@ -0,0 +1,39 @@
+#version 430 core
+
+layout (triangles) in;
+layout (triangle_strip, max_vertices = 18) out;
+
+//Shadow transforms from shader storage buffer
+layout (std430, binding = 1) buffer ShadowMatricesBuffer {
+  mat4 shadowMatrices[][6];
+};
+
+uniform uint shadowMapIndex;
+
+//Bit mask of the cubemap faces the model can appear on
+flat in uint vertexFaceMask[];
+
+out vec4 fragPos;
+
+void main() {
+  //For every triangle vertex, output the position on the cubemap
+  for (int face = 0; face < 6; face++) {
+    //Skip faces the model was culled from
+    if ((vertexFaceMask[0] & (1u << face)) == 0u) {
+      continue;
+    }
+
+    //Cubemaps select the face by layer, shadow atlases select the face's tile by viewport
+    gl_Layer = (int(shadowMapIndex) * 6) + face;
+    gl_ViewportIndex = face;
+
+    for (int i = 0; i < 3; i++) {
+      fragPos = gl_in[i].gl_Position;
+      gl_Position = shadowMatrices[shadowMapIndex][face] * fragPos;
+
+      EmitVertex();
+    }
+
+    EndPrimitive();
+  }
+}
@@ -0,0 +1,28 @@
+#version 430 core
+#extension GL_ARB_shader_draw_parameters : require
+
+layout (location = 0) in vec3 inPosition;
+
+//Data structure to handle input from shader storage buffer object
+struct DrawData {
+  mat4 modelMatrix;
+  mat3 normalMatrix;
+  uint materialIndex;
+};
+
+//Per-draw inputs from shader storage buffer
+layout (std430, binding = 2) readonly buffer DrawDataBuffer {
+  DrawData drawData[];
+};
+
+uniform uint drawOffset;
+
+//Face mask for the current light, passed through the command's base instance
+flat out uint vertexFaceMask;
+
+void main() {
+  //Output position, in model space
+  uint drawIndex = drawOffset + uint(gl_DrawIDARB);
+  gl_Position = drawData[drawIndex].modelMatrix * vec4(inPosition, 1);
+  vertexFaceMask = uint(gl_BaseInstanceARB);
+}
@@ -0,0 +1,70 @@
+#version 430 core
+#extension GL_ARB_shader_draw_parameters : require
+#ifdef GL_ARB_shader_viewport_layer_array
+  #extension GL_ARB_shader_viewport_layer_array : require
+#else
+  #extension GL_AMD_vertex_shader_layer : require
+#endif
+
+layout (location = 0) in vec3 inPosition;
+
+//Data structure to handle input from shader storage buffer object
+struct DrawData {
+  mat4 modelMatrix;
+  mat3 normalMatrix;
+  uint materialIndex;
+};
+
+//Per-draw inputs from shader storage buffer
+layout (std430, binding = 2) readonly buffer DrawDataBuffer {
+  DrawData drawData[];
+};
+
+//Shadow transforms from shader storage buffer
+layout (std430, binding = 1) buffer ShadowMatricesBuffer {
+  mat4 shadowMatrices[][6];
+};
+
+//Shadow atlas tiles for each light's faces, in texture coordinates (offset in xy, size in zw)
+layout (std430, binding = 3) readonly buffer ShadowTilesBuffer {
+  vec4 shadowTiles[][6];
+};
+
+//Cubemap layer drawn by each instance, as (light index * 6) + face
+layout (std430, binding = 7) readonly buffer ShadowInstancesBuffer {
+  uint shadowInstanceLayers[];
+};
+
+//Per-frame constants, shared by every shader
+#include "frameData"
+
+uniform uint drawOffset;
+
+out vec4 fragPos;
+flat out uint lightIndex;
+
+void main() {
+  //The command's base instance is the model's first instance, gl_InstanceID doesn't include it
+  uint drawIndex = drawOffset + uint(gl_DrawIDARB);
+  uint layer = shadowInstanceLayers[uint(gl_BaseInstanceARB) + uint(gl_InstanceID)];
+  uint face = layer % 6u;
+  lightIndex = layer / 6u;
+
+  fragPos = drawData[drawIndex].modelMatrix * vec4(inPosition, 1);
+  vec4 position = shadowMatrices[lightIndex][face] * fragPos;
+
+  //Shadow atlases clip to the face's view, then move it into the face's tile
+  if (shadowAtlasEnabled) {
+    gl_ClipDistance[0] = position.w + position.x;
+    gl_ClipDistance[1] = position.w - position.x;
+    gl_ClipDistance[2] = position.w + position.y;
+    gl_ClipDistance[3] = position.w - position.y;
+
+    vec4 tile = shadowTiles[lightIndex][face];
+    position.xy = (position.xy * tile.zw) + (position.w * ((2.0f * tile.xy) + tile.zw - 1.0f));
+  }
+
+  //Cubemaps select the face by layer, writing it without a geometry shader
+  gl_Layer = int(layer);
+  gl_Position = position;
+}
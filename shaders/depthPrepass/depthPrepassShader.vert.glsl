@@ -0,0 +1,17 @@
+#version 430 core
+
+layout (location = 0) in vec3 inPosition;
+
+//Per-frame constants, shared by every shader
+#include "frameData"
+
+uniform mat4 modelMatrix;
+
+//Positions must match the model shaders exactly, for the main pass' equal depth test
+invariant gl_Position;
+
+void main() {
+  //Position of the vertex, calculated the same way as the model shaders
+  vec4 worldPos = modelMatrix * vec4(inPosition, 1);
+  gl_Position = viewProjection * worldPos;
+}
@@ -0,0 +1,25 @@
+#version 430 core
+
+layout (location = 0) in vec3 inPosition;
+layout (location = 2) in vec2 inTexCoord;
+
+//Per-frame constants, shared by every shader
+#include "frameData"
+
+//Texture coord and material, to test the material's alpha
+out vec2 texCoord;
+flat out uint vertexMaterialIndex;
+
+uniform mat4 modelMatrix;
+uniform uint materialIndex;
+
+//Positions must match the model shaders exactly, for the main pass' equal depth test
+invariant gl_Position;
+
+void main() {
+  //Position of the vertex, calculated the same way as the model shaders
+  vec4 worldPos = modelMatrix * vec4(inPosition, 1);
+  texCoord = inTexCoord;
+  vertexMaterialIndex = materialIndex;
+  gl_Position = viewProjection * worldPos;
+}
@@ -0,0 +1,42 @@
+#version 430 core
+#extension GL_ARB_bindless_texture : enable
+
+//Material of each mesh, bindless handles are only set when the textures aren't bound
+struct Material {
+  uvec2 diffuseHandle;
+  uvec2 specularHandle;
+  vec4 diffuseColour;
+  vec4 specularColour;
+  uint hasDiffuseTexture;
+  uint hasSpecularTexture;
+};
+
+//Materials from shader storage buffer
+layout (std430, binding = 6) readonly buffer MaterialBuffer {
+  Material materials[];
+};
+
+in vec2 texCoord;
+flat in uint vertexMaterialIndex;
+
+uniform sampler2D diffuseSampler;
+
+void main() {
+  //Sample the diffuse texture from its handle, or the bound texture
+  Material material = materials[vertexMaterialIndex];
+  vec4 materialColour;
+#ifdef GL_ARB_bindless_texture
+  if (material.diffuseHandle != uvec2(0u)) {
+    materialColour = texture(sampler2D(material.diffuseHandle), texCoord);
+  } else {
+    materialColour = texture(diffuseSampler, texCoord);
+  }
+#else
+  materialColour = texture(diffuseSampler, texCoord);
+#endif
+
+  //Leave transparent fragments out of the depth buffer, like the model shaders discard them
+  if (materialColour.a != 1.0f) {
+    discard;
+  }
+}
@@ -0,0 +1,5 @@
+#version 430 core
+
+//Only depth is written, so opaque materials need no fragment work
+void main() {
+}
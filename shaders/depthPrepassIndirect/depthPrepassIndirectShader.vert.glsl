@@ -0,0 +1,33 @@
+#version 430 core
+#extension GL_ARB_shader_draw_parameters : require
+
+layout (location = 0) in vec3 inPosition;
+
+//Data structure to handle input from shader storage buffer object
+struct DrawData {
+  mat4 modelMatrix;
+  mat3 normalMatrix;
+  uint materialIndex;
+};
+
+//Per-draw inputs from shader storage buffer
+layout (std430, binding = 2) readonly buffer DrawDataBuffer {
+  DrawData drawData[];
+};
+
+//Per-frame constants, shared by every shader
+#include "frameData"
+
+uniform uint drawOffset;
+
+//Positions must match the model shaders exactly, for the main pass' equal depth test
+invariant gl_Position;
+
+void main() {
+  //gl_DrawID restarts for every multi-draw, so offset it to the batch
+  uint drawIndex = drawOffset + uint(gl_DrawIDARB);
+
+  //Position of the vertex, calculated the same way as the model shaders
+  vec4 worldPos = drawData[drawIndex].modelMatrix * vec4(inPosition, 1);
+  gl_Position = viewProjection * worldPos;
+}
@@ -4,6 +4,7 @@
 //specular.w is actually power
 struct LightSource {
   vec3 position;
+  float range;
   vec3 diffuse;
   vec4 specular;
 };
@@ -1,9 +1,13 @@
 #version 430 core
 
 layout (location = 0) in vec3 inPosition;
-uniform mat4 MVP;
+
+//Per-frame constants, shared by every shader
+#include "frameData"
+
+uniform mat4 modelMatrix;
 
 void main() {
   //Output position of the vertex
-  gl_Position = MVP * vec4(inPosition, 1);
+  gl_Position = viewProjection * modelMatrix * vec4(inPosition, 1);
 }
@@ -1,9 +1,11 @@
 #version 430 core
+#extension GL_ARB_bindless_texture : enable
 
 //Data structure to handle input from shader storage buffer object
 //specular.w is actually power
 struct LightSource {
   vec3 position;
+  float range;
   vec3 diffuse;
   vec4 specular;
 };
@@ -13,11 +15,49 @@ layout (std430, binding = 0) readonly buffer LightPropertiesBuffer {
   LightSource lightSources[];
 };
 
+//Shadow transforms from shader storage buffer
+layout (std430, binding = 1) readonly buffer ShadowMatricesBuffer {
+  mat4 shadowMatrices[][6];
+};
+
+//Shadow atlas tile of each light's faces, as offset (xy) and size (zw) in texture coordinates
+layout (std430, binding = 3) readonly buffer ShadowTilesBuffer {
+  vec4 shadowTiles[][6];
+};
+
+//Lights affecting each cluster of the view, as an offset (x) and count (y) into clusterLightIndices
+layout (std430, binding = 4) readonly buffer LightClustersBuffer {
+  uvec2 lightClusters[];
+};
+
+layout (std430, binding = 5) readonly buffer ClusterLightIndicesBuffer {
+  uint clusterLightIndices[];
+};
+
+//Material of each mesh, bindless handles are only set when the textures aren't bound
+struct Material {
+  uvec2 diffuseHandle;
+  uvec2 specularHandle;
+  vec4 diffuseColour;
+  vec4 specularColour;
+  uint hasDiffuseTexture;
+  uint hasSpecularTexture;
+};
+
+//Materials from shader storage buffer
+layout (std430, binding = 6) readonly buffer MaterialBuffer {
+  Material materials[];
+};
+
+//Per-frame constants, shared by every shader
+#include "frameData"
+
 //Input fragment data, from vertex shader
 in FragmentDataOut {
   vec3 fragPos;
   vec3 normal;
   vec2 texCoord;
+  flat uint materialIndex;
 } fragData;
 
 //Ouput data
@@ -27,10 +67,71 @@ out vec3 outputColour;
 uniform sampler2D diffuseSampler;
 uniform sampler2D specularSampler;
 uniform samplerCubeArrayShadow shadowCubeMap;
-uniform vec3 ambientLight;
-uniform vec3 cameraPos;
-uniform float shadowFarPlane;
-uniform uint lightCount;
+uniform sampler2DShadow shadowAtlas;
+
+//Sample a material's diffuse component, from its handle, the bound texture or its colour
+vec4 sampleDiffuse(Material material) {
+  if (material.hasDiffuseTexture == 0u) {
+    return material.diffuseColour;
+  }
+
+#ifdef GL_ARB_bindless_texture
+  if (material.diffuseHandle != uvec2(0u)) {
+    return texture(sampler2D(material.diffuseHandle), fragData.texCoord);
+  }
+#endif
+
+  return texture(diffuseSampler, fragData.texCoord);
+}
+
+//Sample a material's specular component, the same way as the diffuse component
+vec3 sampleSpecular(Material material) {
+  if (material.hasSpecularTexture == 0u) {
+    return material.specularColour.rgb;
+  }
+
+#ifdef GL_ARB_bindless_texture
+  if (material.specularHandle != uvec2(0u)) {
+    return texture(sampler2D(material.specularHandle), fragData.texCoord).rgb;
+  }
+#endif
+
+  return texture(specularSampler, fragData.texCoord).rgb;
+}
+
+//Find the cubemap face a direction points to, ordered +X, -X, +Y, -Y, +Z, -Z
+uint findCubeFace(vec3 direction) {
+  vec3 absDirection = abs(direction);
+  if (absDirection.x >= absDirection.y && absDirection.x >= absDirection.z) {
+    return (direction.x >= 0.0f) ? 0u : 1u;
+  } else if (absDirection.y >= absDirection.z) {
+    return (direction.y >= 0.0f) ? 2u : 3u;
+  }
+
+  return (direction.z >= 0.0f) ? 4u : 5u;
+}
+
+//Sample the light's tile in the shadow atlas, for the face the fragment is on
+float calcAtlasShadow(uint layer, vec3 fragPos, vec3 lightToFrag, float depth) {
+  uint face = findCubeFace(lightToFrag);
+  vec4 tile = shadowTiles[layer][face];
+
+  //Lights without space in the atlas don't cast shadows
+  if (tile.z == 0.0f) {
+    return 0.0f;
+  }
+
+  //Project onto the face, then into its tile
+  vec4 clipPos = shadowMatrices[layer][face] * vec4(fragPos, 1.0f);
+  vec2 faceCoord = ((clipPos.xy / clipPos.w) * 0.5f) + 0.5f;
+  vec2 atlasCoord = tile.xy + (faceCoord * tile.zw);
+
+  //Keep filtering from reading neighbouring tiles
+  vec2 halfTexel = 0.5f / vec2(textureSize(shadowAtlas, 0));
+  atlasCoord = clamp(atlasCoord, tile.xy + halfTexel, tile.xy + tile.zw - halfTexel);
+
+  return 1.0f - texture(shadowAtlas, vec3(atlasCoord, depth));
+}
 
 float calcShadow(uint layer, vec3 fragPos, vec3 lightPos) {
   //Get depth of current fragment
@@ -38,10 +139,26 @@ float calcShadow(uint layer, vec3 fragPos, vec3 lightPos) {
   float currentDepth = length(lightToFrag) / shadowFarPlane;
 
   float bias = 0.01f;
+  if (shadowAtlasEnabled) {
+    return calcAtlasShadow(layer, fragPos, lightToFrag, currentDepth - bias);
+  }
+
   return 1.0f - texture(shadowCubeMap, vec4(lightToFrag, layer), currentDepth - bias).r;
 }
 
-vec3 calcLight(LightSource lightSource, vec3 normal, vec3 fragPos, vec3 lightDir) {
+//Find the cluster a fragment is in, from its screen tile and depth slice
+uint findCluster(vec3 fragPos) {
+  uvec2 tile = min(uvec2(gl_FragCoord.xy * clusterTileScale), clusterGrid.xy - 1u);
+
+  float depth = max(-(viewMatrix * vec4(fragPos, 1.0f)).z, 1e-6f);
+  float slice = (log(depth) * clusterDepthScale) + clusterDepthBias;
+  uint sliceIndex = uint(clamp(slice, 0.0f, float(clusterGrid.z - 1u)));
+
+  return (((sliceIndex * clusterGrid.y) + tile.y) * clusterGrid.x) + tile.x;
+}
+
+vec3 calcLight(LightSource lightSource, vec3 normal, vec3 fragPos, vec3 lightDir,
+               vec3 materialSpecular) {
   //Diffuse component
   float diff = clamp(dot(lightDir, normal), 0.0, 1.0);
   vec3 diffuse = diff * lightSource.diffuse;
@@ -53,7 +170,7 @@ vec3 calcLight(LightSource lightSource, vec3 normal, vec3 fragPos, vec3 lightDir
     vec3 halfwayDir = normalize(lightDir + viewDir);
     float spec = pow(dot(normal, halfwayDir), 2.0);
     specular = lightSource.specular.xyz * spec;
-    specular *= texture(specularSampler, fragData.texCoord).rgb;
+    specular *= materialSpecular;
   }
 
   //Attenuation of the source
@@ -65,21 +182,35 @@ vec3 calcLight(LightSource lightSource, vec3 normal, vec3 fragPos, vec3 lightDir
 
 void main() {
   //Base colour of the fragment
-  vec4 materialColour = texture(diffuseSampler, fragData.texCoord);
+  Material material = materials[fragData.materialIndex];
+  vec4 materialColour = sampleDiffuse(material);
   vec3 lightColour = vec3(0.0f);
 
-  //Discard transparent fragments
-  if (materialColour.a != 1.0f) {
+  //Discard transparent fragments, the depth pre-pass already leaves them out of the equal test
+  if (!depthPrepassEnabled && materialColour.a != 1.0f) {
     discard;
   }
 
+  //Only visit the lights affecting the fragment's cluster, when clustering is enabled
+  uint firstLight = 0u;
+  uint fragLightCount = lightCount;
+  if (clusteredLighting) {
+    uvec2 cluster = lightClusters[findCluster(fragData.fragPos)];
+    firstLight = cluster.x;
+    fragLightCount = cluster.y;
+  }
+
   //Calculate lighting influence from each light source
-  for (uint i = 0; i < lightCount; i++) {
-    vec3 lightDir = normalize(lightSources[i].position - fragData.fragPos);
+  vec3 materialSpecular = sampleSpecular(material);
+  for (uint i = 0; i < fragLightCount; i++) {
+    uint lightIndex = clusteredLighting ? clusterLightIndices[firstLight + i] : i;
+    LightSource lightSource = lightSources[lightIndex];
+    vec3 lightDir = normalize(lightSource.position - fragData.fragPos);
 
     //Final contribution from the current light source
-    float shadow = calcShadow(i, fragData.fragPos, lightSources[i].position);
-    vec3 light = calcLight(lightSources[i], fragData.normal, fragData.fragPos, lightDir);
+    float shadow = calcShadow(lightIndex, fragData.fragPos, lightSource.position);
+    vec3 light = calcLight(lightSource, fragData.normal, fragData.fragPos, lightDir,
+                           materialSpecular);
     lightColour += (1.0f - shadow) * light;
   }
 
@@ -4,20 +4,28 @@ layout (location = 0) in vec3 inPosition;
 layout (location = 1) in vec3 inNormal;
 layout (location = 2) in vec2 inTexCoord;
 
+//Per-frame constants, shared by every shader
+#include "frameData"
+
 //Output fragment data, sent to fragment shader
 out FragmentDataOut {
   vec3 fragPos;
   vec3 normal;
   vec2 texCoord;
+  flat uint materialIndex;
 } fragData;
 
-uniform mat4 MVP;
 uniform mat4 modelMatrix;
 uniform mat3 normalMatrix;
+uniform uint materialIndex;
+
+//Positions must match the depth pre-pass exactly, for the equal depth test
+invariant gl_Position;
 
 void main() {
   //Position of the vertex, in worldspace
-  fragData.fragPos = (modelMatrix * vec4(inPosition, 1)).xyz;
+  vec4 worldPos = modelMatrix * vec4(inPosition, 1);
+  fragData.fragPos = worldPos.xyz;
 
   //Vertex normal
   fragData.normal = normalize(normalMatrix * inNormal);
@@ -25,6 +33,9 @@ void main() {
   //Vertex texture coord
   fragData.texCoord = inTexCoord;
 
+  //Material of the mesh
+  fragData.materialIndex = materialIndex;
+
   //Output position of the vertex
-  gl_Position = MVP * vec4(inPosition, 1);
+  gl_Position = viewProjection * worldPos;
 }
@@ -0,0 +1,55 @@
+#version 430 core
+#extension GL_ARB_shader_draw_parameters : require
+
+layout (location = 0) in vec3 inPosition;
+layout (location = 1) in vec3 inNormal;
+layout (location = 2) in vec2 inTexCoord;
+
+//Data structure to handle input from shader storage buffer object
+struct DrawData {
+  mat4 modelMatrix;
+  mat3 normalMatrix;
+  uint materialIndex;
+};
+
+//Per-draw inputs from shader storage buffer
+layout (std430, binding = 2) readonly buffer DrawDataBuffer {
+  DrawData drawData[];
+};
+
+//Per-frame constants, shared by every shader
+#include "frameData"
+
+//Output fragment data, sent to fragment shader
+out FragmentDataOut {
+  vec3 fragPos;
+  vec3 normal;
+  vec2 texCoord;
+  flat uint materialIndex;
+} fragData;
+
+uniform uint drawOffset;
+
+//Positions must match the depth pre-pass exactly, for the equal depth test
+invariant gl_Position;
+
+void main() {
+  //gl_DrawID restarts for every multi-draw, so offset it to the batch
+  uint drawIndex = drawOffset + uint(gl_DrawIDARB);
+
+  //Position of the vertex, in worldspace
+  vec4 worldPos = drawData[drawIndex].modelMatrix * vec4(inPosition, 1);
+  fragData.fragPos = worldPos.xyz;
+
+  //Vertex normal
+  fragData.normal = normalize(drawData[drawIndex].normalMatrix * inNormal);
+
+  //Vertex texture coord
+  fragData.texCoord = inTexCoord;
+
+  //Material of the mesh
+  fragData.materialIndex = drawData[drawIndex].materialIndex;
+
+  //Output position of the vertex
+  gl_Position = viewProjection * worldPos;
+}
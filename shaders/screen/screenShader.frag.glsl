@@ -5,54 +5,42 @@ out vec4 colour;
 
 uniform sampler2D screenSampler;
 uniform sampler2D depthSampler;
+uniform sampler2D blurSampler;
 
 uniform bool focalDepthEnabled;
 uniform float focalDepth;
 uniform float blurStrength;
+uniform vec2 renderScale;
 
 const float nearPlane = 0.1f;
-uniform float farPlane;
+
+//Circle of confusion where the blurred frame fully replaces the sharp frame
+const float blendRange = 0.1f;
+
+//Per-frame constants, shared by every shader
+#include "frameData"
+
+//Amount of blur for a depth sample, from its linear distance to the focal depth
+float getCircleOfConfusion(float depth) {
+  depth = 1 - nearPlane / (renderFarPlane + nearPlane - depth * (renderFarPlane - nearPlane));
+  return abs(depth - focalDepth) * blurStrength;
+}
 
 void main() {
+  //Only part of the scene textures may have been drawn to, stay half a texel inside it
+  vec2 maxCoords = renderScale - (0.5 / vec2(textureSize(screenSampler, 0)));
+  vec2 sceneCoords = min(texCoords * renderScale, maxCoords);
+
   if (!focalDepthEnabled) {
-    colour = vec4(texture(screenSampler, texCoords));
+    colour = vec4(texture(screenSampler, sceneCoords));
     return;
   }
 
-  //Calculate the offset from the focal depth and strength
-  float offset = 1.0 / 75.0;
-  float depth = texture(depthSampler, texCoords).x;
-  depth = 1 - nearPlane / (farPlane + nearPlane - depth * (farPlane - nearPlane));
-  depth = abs(depth - focalDepth);
-  offset *= blurStrength * depth;
-
-  vec2 offsets[9] = {
-    vec2(-offset, offset),
-    vec2(0.0f, offset),
-    vec2(offset, offset),
-    vec2(-offset, 0.0f),
-    vec2(0.0f, 0.0f),
-    vec2(offset, 0.0f),
-    vec2(-offset, -offset),
-    vec2(0.0f, -offset),
-    vec2(offset, -offset)
-  };
-
-  float blurKernel[9] = {
-    1.0 / 16, 2.0 / 16, 1.0 / 16,
-    2.0 / 16, 4.0 / 16, 2.0 / 16,
-    1.0 / 16, 2.0 / 16, 1.0 / 16
-  };
-
-  vec3 sampleTex[9];
-  for (int i = 0; i < 9; i++) {
-    sampleTex[i] = vec3(texture(screenSampler, texCoords.st + offsets[i]));
-  }
-
-  vec3 col = vec3(0.0);
-  for (int i = 0; i < 9; i++) {
-    col += sampleTex[i] * blurKernel[i];
-  }
+  //Blend in the upscaled blurred frame, using the full resolution depth for sharp edges
+  float circleOfConfusion = getCircleOfConfusion(texture(depthSampler, sceneCoords).x);
+  vec3 sharpColour = texture(screenSampler, sceneCoords).rgb;
+  vec3 blurColour = texture(blurSampler, texCoords).rgb;
+  float blend = smoothstep(0.0, blendRange, circleOfConfusion);
 
-  colour = vec4(col, 1.0);
+  colour = vec4(mix(sharpColour, blurColour, blend), 1.0);
 }
@@ -4,10 +4,12 @@ layout (location = 0) in vec3 inPosition;
 
 out vec3 texCoords;
 
-uniform mat4 viewMatrix;
-uniform mat4 projectionMatrix;
+//Per-frame constants, shared by every shader
+#include "frameData"
 
 void main() {
   texCoords = inPosition;
-  gl_Position = (projectionMatrix * viewMatrix * vec4(inPosition, 1.0)).xyww;
+  //Remove the translation from the view, so the skybox stays centred on the camera
+  mat4 rotationMatrix = mat4(mat3(viewMatrix));
+  gl_Position = (projectionMatrix * rotationMatrix * vec4(inPosition, 1.0)).xyww;
 }
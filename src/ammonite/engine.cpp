@@ -7,6 +7,7 @@
 
 #include "camera/camera.hpp"
 #include "graphics/renderer.hpp"
+#include "models/models.hpp"
 #include "utils/debug.hpp"
 #include "utils/logging.hpp"
 #include "utils/thread.hpp"
@@ -143,6 +144,7 @@ namespace ammonite {
      - Update the frame time delta
      - Update the progress of camera paths using this
      - Optionally update the position of the active camera, if it's on a path
+     - Swap in asynchronously loaded textures that have finished
   */
   void beginFrame(bool updateActiveCameraPath) {
     updateFrameTime();
@@ -151,5 +153,7 @@ namespace ammonite {
     if (updateActiveCameraPath) {
       camera::path::updateActiveCameraOnPath();
     }
+
+    models::internal::updateAsyncMaterials();
   }
 }
@@ -1,4 +1,7 @@
+#include <algorithm>
 #include <cstddef>
+#include <iostream>
+#include <map>
 #include <vector>
 
 extern "C" {
@@ -7,7 +10,9 @@ extern "C" {
 
 #include "buffers.hpp"
 
+#include "rangeAllocator.hpp"
 #include "../models/models.hpp"
+#include "../utils/debug.hpp"
 
 namespace ammonite {
   namespace graphics {
@@ -20,37 +25,50 @@ namespace ammonite {
         unsigned int lastLightDataSize = 0;
       }
 
-      void createModelBuffers(models::internal::ModelData* modelData,
-                              std::vector<models::internal::RawMeshData>* rawMeshDataVec) {
-        //Generate buffers for every mesh
-        for (const models::internal::RawMeshData& rawMeshData : *rawMeshDataVec) {
-          models::internal::MeshInfoGroup& meshInfo = modelData->meshInfo.emplace_back();
+      namespace {
+        /*
+         - Shared vertex and index storage, suballocated between meshes
+         - Pools are tracked against their vertex array, so meshes only need to
+           store the vertex array ID to find their pool again
+        */
+        struct MeshBufferPool {
+          GLuint vertexBufferId;
+          GLuint elementBufferId;
+          RangeAllocator vertexRanges;
+          RangeAllocator indexRanges;
+        };
 
-          //Copy point count information
-          meshInfo.vertexCount = rawMeshData.vertexCount;
-          meshInfo.indexCount = rawMeshData.indexCount;
+        std::map<GLuint, MeshBufferPool> meshBufferPools;
 
-          //Create vertex and index buffers
-          glCreateBuffers(1, &meshInfo.vertexBufferId);
-          glCreateBuffers(1, &meshInfo.elementBufferId);
+        /*
+         - Pools start small and double in size up to the maximum, so small scenes
+           don't reserve storage they'll never use
+         - Larger meshes get a dedicated pool
+        */
+        constexpr unsigned int minPoolVertexCount = 1 << 14;
+        constexpr unsigned int minPoolIndexCount = 1 << 16;
+        constexpr unsigned int maxPoolVertexCount = 1 << 20;
+        constexpr unsigned int maxPoolIndexCount = 1 << 22;
 
-          //Fill interleaved vertex + normal + texture buffer and index buffer
-          glNamedBufferData(meshInfo.vertexBufferId,
-                            meshInfo.vertexCount * (long)sizeof(models::AmmoniteVertex),
-                            &rawMeshData.vertexData[0], GL_STATIC_DRAW);
-          glNamedBufferData(meshInfo.elementBufferId,
-                            meshInfo.indexCount * (long)sizeof(unsigned int),
-                            &rawMeshData.indices[0], GL_STATIC_DRAW);
+        unsigned int nextPoolVertexCount = minPoolVertexCount;
+        unsigned int nextPoolIndexCount = minPoolIndexCount;
 
-          //Destroy mesh data once uploaded
-          delete [] rawMeshData.vertexData;
-          delete [] rawMeshData.indices;
+        //Create a pool and its vertex array, return the vertex array ID
+        GLuint createBufferPool(unsigned int vertexCount, unsigned int indexCount) {
+          GLuint vboId = 0;
+          GLuint eboId = 0;
 
-          //Create the vertex attribute buffer
-          glCreateVertexArrays(1, &meshInfo.vertexArrayId);
+          //Create immutable vertex and index storage
+          glCreateBuffers(1, &vboId);
+          glCreateBuffers(1, &eboId);
+          glNamedBufferStorage(vboId, vertexCount * (GLsizeiptr)sizeof(models::AmmoniteVertex),
+                               nullptr, GL_DYNAMIC_STORAGE_BIT);
+          glNamedBufferStorage(eboId, indexCount * (GLsizeiptr)sizeof(unsigned int),
+                               nullptr, GL_DYNAMIC_STORAGE_BIT);
 
-          const GLuint vaoId = meshInfo.vertexArrayId;
-          const GLuint vboId = meshInfo.vertexBufferId;
+          //Create the vertex attribute buffer
+          GLuint vaoId = 0;
+          glCreateVertexArrays(1, &vaoId);
           const int stride = sizeof(models::AmmoniteVertex);
 
           //Vertex attribute
@@ -75,17 +93,148 @@ namespace ammonite {
           glVertexArrayAttribBinding(vaoId, 2, 2);
 
           //Element buffer
-          glVertexArrayElementBuffer(vaoId, meshInfo.elementBufferId);
+          glVertexArrayElementBuffer(vaoId, eboId);
+
+          meshBufferPools.emplace(vaoId, MeshBufferPool{
+            .vertexBufferId = vboId,
+            .elementBufferId = eboId,
+            .vertexRanges = RangeAllocator(vertexCount),
+            .indexRanges = RangeAllocator(indexCount)
+          });
+
+          ammoniteInternalDebug << "Created mesh buffer pool (" << vertexCount \
+                                << " vertices, " << indexCount << " indices)" << std::endl;
+          return vaoId;
+        }
+
+        void deleteBufferPool(GLuint vaoId) {
+          const MeshBufferPool& pool = meshBufferPools.at(vaoId);
+          glDeleteBuffers(1, &pool.vertexBufferId);
+          glDeleteBuffers(1, &pool.elementBufferId);
+          glDeleteVertexArrays(1, &vaoId);
+
+          meshBufferPools.erase(vaoId);
+        }
+
+        //Try to claim vertex and index ranges from a pool, as a pair
+        bool allocateFromPool(MeshBufferPool* pool,
+                              models::internal::MeshInfoGroup* meshInfo) {
+          unsigned int baseVertex = 0;
+          if (!pool->vertexRanges.allocate(meshInfo->vertexCount, &baseVertex)) {
+            return false;
+          }
+
+          if (!pool->indexRanges.allocate(meshInfo->indexCount, &meshInfo->firstIndex)) {
+            pool->vertexRanges.free(baseVertex, meshInfo->vertexCount);
+            return false;
+          }
+
+          meshInfo->baseVertex = (GLint)baseVertex;
+          return true;
+        }
+
+        /*
+         - Find space for a mesh, creating a new pool if every pool is full
+         - New pools are sized to fit the rest of the model when possible, using
+           remainingVertices and remainingIndices
+        */
+        void allocateMeshSpace(models::internal::MeshInfoGroup* meshInfo,
+                               unsigned int remainingVertices, unsigned int remainingIndices) {
+          for (auto& [vaoId, pool] : meshBufferPools) {
+            if (allocateFromPool(&pool, meshInfo)) {
+              meshInfo->vertexArrayId = vaoId;
+              return;
+            }
+          }
+
+          //New pools are always large enough for the mesh that needed them
+          const unsigned int vertexCount = std::max(meshInfo->vertexCount,
+            std::min(std::max(remainingVertices, nextPoolVertexCount), maxPoolVertexCount));
+          const unsigned int indexCount = std::max(meshInfo->indexCount,
+            std::min(std::max(remainingIndices, nextPoolIndexCount), maxPoolIndexCount));
+          nextPoolVertexCount = std::min(nextPoolVertexCount * 2, maxPoolVertexCount);
+          nextPoolIndexCount = std::min(nextPoolIndexCount * 2, maxPoolIndexCount);
+
+          const GLuint vaoId = createBufferPool(vertexCount, indexCount);
+          allocateFromPool(&meshBufferPools.at(vaoId), meshInfo);
+          meshInfo->vertexArrayId = vaoId;
         }
       }
 
+      void createModelBuffers(models::internal::ModelData* modelData,
+                              std::vector<models::internal::RawMeshData>* rawMeshDataVec) {
+        //Total the model's size, so a new pool can fit all of it
+        unsigned int remainingVertices = 0;
+        unsigned int remainingIndices = 0;
+        for (const models::internal::RawMeshData& rawMeshData : *rawMeshDataVec) {
+          remainingVertices += rawMeshData.vertexCount;
+          remainingIndices += rawMeshData.indexCount;
+        }
+
+        //Suballocate and upload every mesh
+        for (const models::internal::RawMeshData& rawMeshData : *rawMeshDataVec) {
+          models::internal::MeshInfoGroup& meshInfo = modelData->meshInfo.emplace_back();
+          remainingVertices -= rawMeshData.vertexCount;
+          remainingIndices -= rawMeshData.indexCount;
+
+          //Meshes without vertices or indices draw nothing, so they aren't given a pool
+          if (rawMeshData.vertexCount != 0 && rawMeshData.indexCount != 0) {
+            //Copy point count information
+            meshInfo.vertexCount = rawMeshData.vertexCount;
+            meshInfo.indexCount = rawMeshData.indexCount;
+
+            //Claim vertex and index ranges from a pool
+            allocateMeshSpace(&meshInfo, meshInfo.vertexCount + remainingVertices,
+                              meshInfo.indexCount + remainingIndices);
+            const MeshBufferPool& pool = meshBufferPools.at(meshInfo.vertexArrayId);
+
+            //Fill interleaved vertex + normal + texture data and index data
+            glNamedBufferSubData(pool.vertexBufferId,
+              meshInfo.baseVertex * (GLintptr)sizeof(models::AmmoniteVertex),
+              meshInfo.vertexCount * (GLsizeiptr)sizeof(models::AmmoniteVertex),
+              &rawMeshData.vertexData[0]);
+            glNamedBufferSubData(pool.elementBufferId,
+              meshInfo.firstIndex * (GLintptr)sizeof(unsigned int),
+              meshInfo.indexCount * (GLsizeiptr)sizeof(unsigned int),
+              &rawMeshData.indices[0]);
+          }
+
+          //Destroy mesh data once uploaded
+          delete [] rawMeshData.vertexData;
+          delete [] rawMeshData.indices;
+        }
+      }
+
+      /*
+       - Return the ranges used by a model's meshes to their pools
+       - Empty pools are freed, unless it's the last pool
+       - Empty meshes were never given a pool, so they're skipped
+      */
       void deleteModelBuffers(models::internal::ModelData* modelData) {
-        //Delete created buffers and the VAO
         for (const models::internal::MeshInfoGroup& meshInfo : modelData->meshInfo) {
-          glDeleteBuffers(1, &meshInfo.vertexBufferId);
-          glDeleteBuffers(1, &meshInfo.elementBufferId);
-          glDeleteVertexArrays(1, &meshInfo.vertexArrayId);
+          if (meshInfo.vertexArrayId == 0) {
+            continue;
+          }
+
+          MeshBufferPool& pool = meshBufferPools.at(meshInfo.vertexArrayId);
+          pool.vertexRanges.free((unsigned int)meshInfo.baseVertex, meshInfo.vertexCount);
+          pool.indexRanges.free(meshInfo.firstIndex, meshInfo.indexCount);
+
+          if (pool.vertexRanges.isEmpty() && pool.indexRanges.isEmpty() &&
+              meshBufferPools.size() > 1) {
+            deleteBufferPool(meshInfo.vertexArrayId);
+          }
+        }
+      }
+
+      //Delete any remaining mesh buffer pools
+      void deleteMeshBufferPools() {
+        while (!meshBufferPools.empty()) {
+          deleteBufferPool(meshBufferPools.begin()->first);
         }
+
+        nextPoolVertexCount = minPoolVertexCount;
+        nextPoolIndexCount = minPoolIndexCount;
       }
 
       //Unbind and delete the lighting data buffers
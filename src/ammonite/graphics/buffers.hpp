@@ -12,6 +12,7 @@ namespace AMMONITE_INTERNAL ammonite {
       void createModelBuffers(models::internal::ModelData* modelData,
                               std::vector<models::internal::RawMeshData>* rawMeshDataVec);
       void deleteModelBuffers(models::internal::ModelData* modelData);
+      void deleteMeshBufferPools();
 
       void deleteLightBuffers();
       void uploadLightBuffers(void* lightData, unsigned int lightDataSize,
@@ -0,0 +1,51 @@
+#include <cmath>
+
+#include "culling.hpp"
+
+#include "../maths/vector.hpp"
+#include "../models/models.hpp"
+
+/*
+ - Cull the faces of a cubemap view, without touching OpenGL or the tracked models
+ - Kept apart from the rest of culling so it can be tested on its own
+*/
+
+namespace ammonite {
+  namespace graphics {
+    namespace internal {
+      /*
+       - Find which faces of a cubemap centred on origin a box may appear on
+       - Each face sees a pyramid around one axis, bounded by the planes where
+         the other coordinates match its distance along that axis
+       - The test is conservative, boxes near an edge may be kept for both faces
+      */
+      unsigned char calculateFaceMask(const models::internal::BoundingBox& bounds,
+                                      const ammonite::Vec<float, 3>& origin) {
+        ammonite::Vec<float, 3> centre = {0};
+        ammonite::Vec<float, 3> extent = {0};
+        for (unsigned int axis = 0; axis < 3; axis++) {
+          centre[axis] = ((bounds.minimum[axis] + bounds.maximum[axis]) * 0.5f) - origin[axis];
+          extent[axis] = (bounds.maximum[axis] - bounds.minimum[axis]) * 0.5f;
+        }
+
+        //Faces are ordered +X, -X, +Y, -Y, +Z, -Z, to match the shadow transforms
+        unsigned char faceMask = 0;
+        for (unsigned int face = 0; face < 6; face++) {
+          const unsigned int axis = face / 2;
+          const float sign = ((face % 2) == 0) ? 1.0f : -1.0f;
+          const unsigned int otherA = (axis + 1) % 3;
+          const unsigned int otherB = (axis + 2) % 3;
+
+          //Furthest reach of the box along the face's axis, against each other axis
+          const float reachA = (sign * centre[axis]) + extent[axis] + extent[otherA];
+          const float reachB = (sign * centre[axis]) + extent[axis] + extent[otherB];
+          if (reachA >= std::abs(centre[otherA]) && reachB >= std::abs(centre[otherB])) {
+            faceMask |= (1u << face);
+          }
+        }
+
+        return faceMask;
+      }
+    }
+  }
+}
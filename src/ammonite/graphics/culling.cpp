@@ -0,0 +1,135 @@
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+#include "culling.hpp"
+
+#include "../maths/matrix.hpp"
+#include "../maths/vector.hpp"
+#include "../models/models.hpp"
+#include "../utils/id.hpp"
+
+/*
+ - Cull model instances against a view, before their draws are submitted
+ - Visible models are found with the bounding volume tree, then mapped to
+   their position in the renderer's list of regular models
+*/
+
+namespace ammonite {
+  namespace graphics {
+    namespace internal {
+      namespace {
+        //Cubemap faces a model may appear on, 0 when culled
+        constexpr unsigned char allFaces = (1u << 6) - 1;
+
+        //Position of each regular model in the list given to updateCullingModels()
+        std::unordered_map<AmmoniteId, unsigned int> modelIndices;
+        std::vector<models::internal::ModelInfo*> cullingModelPtrs;
+        std::vector<unsigned char> faceMasks;
+        std::vector<AmmoniteId> visibleModelIds;
+
+        //Mark the models found by the last tree query as visible, and everything else as culled
+        void applyVisibleModels(const ammonite::Vec<float, 3>* cubeOrigin) {
+          std::fill(faceMasks.begin(), faceMasks.end(), 0);
+          for (const AmmoniteId modelId : visibleModelIds) {
+            const auto indexIt = modelIndices.find(modelId);
+            if (indexIt == modelIndices.end()) {
+              continue;
+            }
+
+            //Only cubemap views need faces to be culled individually
+            const unsigned int modelIndex = indexIt->second;
+            if (cubeOrigin == nullptr) {
+              faceMasks[modelIndex] = allFaces;
+            } else {
+              faceMasks[modelIndex] = calculateFaceMask(
+                cullingModelPtrs[modelIndex]->worldBounds, *cubeOrigin);
+            }
+          }
+        }
+      }
+
+      /*
+       - Extract the 6 clipping planes from a view projection matrix
+       - Planes are left unnormalised, since culling only checks their sign
+      */
+      void calculateFrustumPlanes(const ammonite::Mat<float, 4>& viewProjection,
+                                  ammonite::Vec<float, 4> planes[6]) {
+        for (unsigned int i = 0; i < 4; i++) {
+          //Rows of the matrix, stored column-major
+          const float rowX = viewProjection[i][0];
+          const float rowY = viewProjection[i][1];
+          const float rowZ = viewProjection[i][2];
+          const float rowW = viewProjection[i][3];
+
+          planes[0][i] = rowW + rowX;
+          planes[1][i] = rowW - rowX;
+          planes[2][i] = rowW + rowY;
+          planes[3][i] = rowW - rowY;
+          planes[4][i] = rowW + rowZ;
+          planes[5][i] = rowW - rowZ;
+        }
+      }
+
+      /*
+       - Store the position of each model in modelPtrs, used to report visibility
+       - Must be called whenever models are added, removed or change type
+      */
+      void updateCullingModels(models::internal::ModelInfo** modelPtrs,
+                               unsigned int modelCount) {
+        modelIndices.clear();
+        for (unsigned int i = 0; i < modelCount; i++) {
+          modelIndices[modelPtrs[i]->modelId] = i;
+        }
+
+        cullingModelPtrs.assign(modelPtrs, modelPtrs + modelCount);
+        faceMasks.assign(modelCount, allFaces);
+      }
+
+      //Find the models that intersect a view frustum, from calculateFrustumPlanes()
+      void cullFrustum(const ammonite::Vec<float, 4> planes[6]) {
+        visibleModelIds.clear();
+        models::internal::getModelsInFrustum(planes, &visibleModelIds);
+        applyVisibleModels(nullptr);
+      }
+
+      /*
+       - Find the models in range of a point light, and the faces of its shadow
+         cubemap they can appear on
+      */
+      void cullPointLight(const ammonite::Vec<float, 3>& lightPosition, float range) {
+        visibleModelIds.clear();
+        models::internal::getModelsInSphere(lightPosition, range, &visibleModelIds);
+        applyVisibleModels(&lightPosition);
+      }
+
+      /*
+       - Cull either the static or dynamic models from the results of the last query
+       - Used to draw cached shadows of static models separately from moving models
+      */
+      void cullByMotion(bool keepDynamic) {
+        for (const AmmoniteId modelId : visibleModelIds) {
+          const auto indexIt = modelIndices.find(modelId);
+          if (indexIt == modelIndices.end()) {
+            continue;
+          }
+
+          const unsigned int modelIndex = indexIt->second;
+          if (cullingModelPtrs[modelIndex]->isDynamic != keepDynamic) {
+            faceMasks[modelIndex] = 0;
+          }
+        }
+      }
+
+      //Result of the last query for a model, using its index from updateCullingModels()
+      bool isModelVisible(unsigned int modelIndex) {
+        return faceMasks[modelIndex] != 0;
+      }
+
+      //Cubemap faces a model may appear on, every face is set for non-cubemap views
+      unsigned int getModelFaceMask(unsigned int modelIndex) {
+        return faceMasks[modelIndex];
+      }
+    }
+  }
+}
@@ -0,0 +1,28 @@
+#ifndef INTERNALCULLING
+#define INTERNALCULLING
+
+#include "../maths/matrix.hpp"
+#include "../maths/vector.hpp"
+#include "../models/models.hpp"
+#include "../visibility.hpp"
+
+namespace AMMONITE_INTERNAL ammonite {
+  namespace graphics {
+    namespace internal {
+      void calculateFrustumPlanes(const ammonite::Mat<float, 4>& viewProjection,
+                                  ammonite::Vec<float, 4> planes[6]);
+      unsigned char calculateFaceMask(const models::internal::BoundingBox& bounds,
+                                      const ammonite::Vec<float, 3>& origin);
+
+      void updateCullingModels(models::internal::ModelInfo** modelPtrs,
+                               unsigned int modelCount);
+      void cullFrustum(const ammonite::Vec<float, 4> planes[6]);
+      void cullPointLight(const ammonite::Vec<float, 3>& lightPosition, float range);
+      void cullByMotion(bool keepDynamic);
+      bool isModelVisible(unsigned int modelIndex);
+      unsigned int getModelFaceMask(unsigned int modelIndex);
+    }
+  }
+}
+
+#endif
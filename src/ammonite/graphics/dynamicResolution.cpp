@@ -0,0 +1,158 @@
+#include <algorithm>
+#include <cmath>
+
+extern "C" {
+  #include <epoxy/gl.h>
+}
+
+#include "dynamicResolution.hpp"
+
+/*
+ - Measure the GPU time of each frame, and pick a render scale to reach a target frame time
+ - Timer queries are kept in a ring and only read once available, so measuring
+   never waits for the GPU
+ - The scale is only changed every few frames, using the average of the
+   measurements since the last change
+*/
+
+namespace ammonite {
+  namespace graphics {
+    namespace internal {
+      namespace {
+        //Queries in flight, results are normally available a frame or two later
+        constexpr unsigned int timerQueryCount = 4;
+
+        //Frames to measure before each scale change
+        constexpr unsigned int scaleUpdateInterval = 8;
+
+        //Fraction of the target to aim for, leaving headroom for CPU work and spikes
+        constexpr float frameTimeHeadroom = 0.9f;
+
+        //Fraction of the change towards the ideal scale to apply, to avoid oscillating
+        constexpr float scaleDamping = 0.5f;
+
+        //Changes smaller than this are ignored, so the scale settles
+        constexpr float minScaleChange = 0.02f;
+
+        GLuint timerQueryIds[timerQueryCount] = {0};
+        bool isQueryPending[timerQueryCount] = {false};
+        unsigned int nextQueryIndex = 0;
+        bool isTimerActive = false;
+
+        float renderScale = 1.0f;
+        double measuredTime = 0.0;
+        unsigned int measuredFrames = 0;
+        unsigned int framesSinceUpdate = 0;
+
+        //Collect the results of finished queries, in seconds
+        void collectTimerResults() {
+          for (unsigned int i = 0; i < timerQueryCount; i++) {
+            if (!isQueryPending[i]) {
+              continue;
+            }
+
+            GLint isAvailable = GL_FALSE;
+            glGetQueryObjectiv(timerQueryIds[i], GL_QUERY_RESULT_AVAILABLE, &isAvailable);
+            if (isAvailable == GL_FALSE) {
+              continue;
+            }
+
+            GLuint64 elapsedTime = 0;
+            glGetQueryObjectui64v(timerQueryIds[i], GL_QUERY_RESULT, &elapsedTime);
+            measuredTime += (double)elapsedTime / 1e9;
+            measuredFrames++;
+            isQueryPending[i] = false;
+          }
+        }
+
+        /*
+         - Find the render scale that should bring the GPU frame time to the target
+         - The cost of a frame is assumed to grow with its pixel count, the square
+           of the scale
+         - Returns a scale between minRenderScale and 1
+        */
+        float calculateRenderScale(float currentScale, float gpuFrameTime, float targetFrameTime) {
+          if (gpuFrameTime <= 0.0f || targetFrameTime <= 0.0f) {
+            return currentScale;
+          }
+
+          const float idealScale = currentScale *
+            std::sqrt((targetFrameTime * frameTimeHeadroom) / gpuFrameTime);
+          float newScale = currentScale + ((idealScale - currentScale) * scaleDamping);
+          newScale = std::clamp(newScale, minRenderScale, 1.0f);
+
+          //Ignore small changes within the target so the scale settles, unless they reach a limit
+          if (std::abs(newScale - currentScale) < minScaleChange &&
+              gpuFrameTime <= targetFrameTime &&
+              newScale != minRenderScale && newScale != 1.0f) {
+            return currentScale;
+          }
+
+          return newScale;
+        }
+      }
+
+      //Start timing the GPU work of a frame, frames are skipped while every query is in flight
+      void beginGpuFrameTimer() {
+        if (timerQueryIds[0] == 0) {
+          glGenQueries(timerQueryCount, timerQueryIds);
+        }
+
+        collectTimerResults();
+        if (isQueryPending[nextQueryIndex]) {
+          return;
+        }
+
+        glBeginQuery(GL_TIME_ELAPSED, timerQueryIds[nextQueryIndex]);
+        isTimerActive = true;
+      }
+
+      void endGpuFrameTimer() {
+        if (!isTimerActive) {
+          return;
+        }
+
+        glEndQuery(GL_TIME_ELAPSED);
+        isTimerActive = false;
+        isQueryPending[nextQueryIndex] = true;
+        nextQueryIndex = (nextQueryIndex + 1) % timerQueryCount;
+      }
+
+      //Update and return the render scale, once enough frames have been measured
+      float updateRenderScale(float targetFrameTime) {
+        framesSinceUpdate++;
+        if (framesSinceUpdate < scaleUpdateInterval || measuredFrames == 0) {
+          return renderScale;
+        }
+
+        const float gpuFrameTime = (float)(measuredTime / (double)measuredFrames);
+        renderScale = calculateRenderScale(renderScale, gpuFrameTime, targetFrameTime);
+
+        measuredTime = 0.0;
+        measuredFrames = 0;
+        framesSinceUpdate = 0;
+
+        return renderScale;
+      }
+
+      //Return to the full render resolution, and forget previous measurements
+      void resetRenderScale() {
+        renderScale = 1.0f;
+        measuredTime = 0.0;
+        measuredFrames = 0;
+        framesSinceUpdate = 0;
+      }
+
+      void deleteGpuFrameTimers() {
+        if (timerQueryIds[0] != 0) {
+          glDeleteQueries(timerQueryCount, timerQueryIds);
+          std::fill(&timerQueryIds[0], &timerQueryIds[timerQueryCount], 0);
+          std::fill(&isQueryPending[0], &isQueryPending[timerQueryCount], false);
+        }
+
+        isTimerActive = false;
+        nextQueryIndex = 0;
+      }
+    }
+  }
+}
@@ -0,0 +1,21 @@
+#ifndef INTERNALDYNAMICRESOLUTION
+#define INTERNALDYNAMICRESOLUTION
+
+#include "../visibility.hpp"
+
+namespace AMMONITE_INTERNAL ammonite {
+  namespace graphics {
+    namespace internal {
+      //Smallest fraction of the allocated render resolution to draw at
+      constexpr float minRenderScale = 0.5f;
+
+      void beginGpuFrameTimer();
+      void endGpuFrameTimer();
+      float updateRenderScale(float targetFrameTime);
+      void resetRenderScale();
+      void deleteGpuFrameTimers();
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef INTERNALFRAMEDATA
+#define INTERNALFRAMEDATA
+
+extern "C" {
+  #include <epoxy/gl.h>
+}
+
+#include "../maths/matrix.hpp"
+#include "../maths/vector.hpp"
+#include "../visibility.hpp"
+
+namespace AMMONITE_INTERNAL ammonite {
+  namespace graphics {
+    namespace internal {
+      //Per-frame constants, matches the std140 layout of frameDataBlockSource
+      struct FrameData {
+        ammonite::Mat<float, 4> viewMatrix;
+        ammonite::Mat<float, 4> projectionMatrix;
+        ammonite::Mat<float, 4> viewProjection;
+        ammonite::Vec<float, 3> cameraPosition;
+        float shadowFarPlane;
+        ammonite::Vec<float, 3> ambientLight;
+        float renderFarPlane;
+        GLuint lightCount;
+        GLuint shadowAtlasEnabled;
+        ammonite::Vec<float, 2> clusterTileScale;
+        GLuint clusterGrid[3];
+        float clusterDepthScale;
+        float clusterDepthBias;
+        GLuint clusteredLighting;
+        GLuint depthPrepassEnabled;
+        GLuint padding;
+      };
+
+      //std140 rounds the block up to a multiple of a vec4
+      static_assert(sizeof(FrameData) == 272, "FrameData doesn't match FrameDataBuffer");
+
+      //Name used by shaders to include the block, as '#include "frameData"'
+      constexpr char frameDataIncludeName[] = "frameData";
+
+      //Shared definition of FrameDataBuffer, substituted for the include by the shader loader
+      constexpr char frameDataBlockSource[] = R"(
+layout (std140, binding = 0) uniform FrameDataBuffer {
+  mat4 viewMatrix;
+  mat4 projectionMatrix;
+  mat4 viewProjection;
+  vec3 cameraPos;
+  float shadowFarPlane;
+  vec3 ambientLight;
+  float renderFarPlane;
+  uint lightCount;
+  bool shadowAtlasEnabled;
+  vec2 clusterTileScale;
+  uvec3 clusterGrid;
+  float clusterDepthScale;
+  float clusterDepthBias;
+  bool clusteredLighting;
+  bool depthPrepassEnabled;
+};
+)";
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,175 @@
+#include <algorithm>
+#include <vector>
+
+extern "C" {
+  #include <epoxy/gl.h>
+}
+
+#include "frameGraph.hpp"
+
+#include "postTargets.hpp"
+#include "renderer.hpp"
+
+/*
+ - Build and run the post-processing passes for a frame
+ - The graph is rebuilt every frame, so passes can be added and removed freely
+   by the renderer's settings
+*/
+
+namespace ammonite {
+  namespace graphics {
+    namespace internal {
+      /*
+       - Walk back from the final texture, keeping passes that write a needed texture
+       - The inputs of a kept pass become needed, and record the last pass to read them
+      */
+      void FrameGraph::cullPasses(unsigned int outputId) {
+        std::vector<bool> isNeeded(this->resources.size(), false);
+        isNeeded[outputId] = true;
+        this->resources[outputId].isUsed = true;
+
+        for (unsigned int passIndex = this->passes.size(); passIndex-- > 0;) {
+          Pass& pass = this->passes[passIndex];
+          pass.isUsed = std::ranges::any_of(pass.outputs, [&isNeeded](unsigned int resourceId) {
+            return isNeeded[resourceId];
+          });
+
+          if (!pass.isUsed) {
+            continue;
+          }
+
+          //Outputs that aren't needed are still written, but are released straight away
+          for (const unsigned int resourceId : pass.outputs) {
+            Resource& resource = this->resources[resourceId];
+            resource.lastPass = std::max(resource.lastPass, passIndex);
+          }
+
+          for (const unsigned int resourceId : pass.inputs) {
+            Resource& resource = this->resources[resourceId];
+            resource.isUsed = true;
+            resource.lastPass = std::max(resource.lastPass, passIndex);
+            isNeeded[resourceId] = true;
+          }
+        }
+      }
+
+      void FrameGraph::fillContext(const Pass& pass) {
+        this->context.inputs.clear();
+        this->context.outputs.clear();
+
+        for (const unsigned int resourceId : pass.inputs) {
+          const Resource& resource = this->resources[resourceId];
+          this->context.inputs.push_back({
+            .textureId = resource.textureId,
+            .framebufferId = resource.framebufferId,
+            .width = resource.width,
+            .height = resource.height,
+            .isUsed = true
+          });
+        }
+
+        for (const unsigned int resourceId : pass.outputs) {
+          const Resource& resource = this->resources[resourceId];
+          this->context.outputs.push_back({
+            .textureId = resource.textureId,
+            .framebufferId = resource.framebufferId,
+            .width = resource.width,
+            .height = resource.height,
+            .isUsed = resource.isUsed
+          });
+        }
+      }
+
+      //Remove every pass and texture, ready to build the next frame's graph
+      void FrameGraph::reset() {
+        this->resources.clear();
+        this->passes.clear();
+      }
+
+      //Add a texture owned outside of the graph, such as the scene or the default framebuffer
+      unsigned int FrameGraph::importTexture(GLuint textureId, GLuint framebufferId,
+                                             unsigned int width, unsigned int height) {
+        this->resources.push_back({
+          .textureId = textureId,
+          .framebufferId = framebufferId,
+          .width = width,
+          .height = height,
+          .isImported = true
+        });
+
+        return (unsigned int)this->resources.size() - 1;
+      }
+
+      //Add a texture that only lives between the pass that writes it and its last reader
+      unsigned int FrameGraph::createTexture(unsigned int width, unsigned int height,
+                                             GLenum format) {
+        this->resources.push_back({
+          .width = std::max(width, 1u),
+          .height = std::max(height, 1u),
+          .format = format
+        });
+
+        return (unsigned int)this->resources.size() - 1;
+      }
+
+      /*
+       - Add a pass, the framebuffer of its first output is bound when it runs
+       - userPtr is passed to the callback unchanged, and must outlive execute()
+      */
+      void FrameGraph::addPass(FramePassCallback callback, void* userPtr,
+                               const std::vector<unsigned int>& inputs,
+                               const std::vector<unsigned int>& outputs) {
+        this->passes.push_back({
+          .callback = callback,
+          .userPtr = userPtr,
+          .inputs = inputs,
+          .outputs = outputs
+        });
+      }
+
+      //Run every pass that contributes to outputId
+      void FrameGraph::execute(unsigned int outputId) {
+        this->cullPasses(outputId);
+
+        for (unsigned int passIndex = 0; passIndex < this->passes.size(); passIndex++) {
+          const Pass& pass = this->passes[passIndex];
+          if (!pass.isUsed) {
+            continue;
+          }
+
+          //Take pooled targets for transient outputs, before any inputs are released
+          for (const unsigned int resourceId : pass.outputs) {
+            Resource& resource = this->resources[resourceId];
+            if (!resource.isImported) {
+              resource.targetIndex = acquirePostTarget(resource.width, resource.height,
+                                                       resource.format);
+              const PostTarget& target = getPostTarget(resource.targetIndex);
+              resource.textureId = target.textureId;
+              resource.framebufferId = target.framebufferId;
+            }
+          }
+
+          if (!pass.outputs.empty()) {
+            const Resource& target = this->resources[pass.outputs[0]];
+            renderer::internal::prepareScreen(target.framebufferId, target.width,
+                                              target.height, false);
+          }
+
+          this->fillContext(pass);
+          pass.callback(this->context, pass.userPtr);
+
+          //Return transient textures once their last reader has run
+          auto releaseFinished = [this, passIndex](unsigned int resourceId) {
+            const Resource& resource = this->resources[resourceId];
+            if (!resource.isImported && resource.lastPass == passIndex) {
+              releasePostTarget(resource.targetIndex);
+            }
+          };
+
+          std::ranges::for_each(pass.inputs, releaseFinished);
+          std::ranges::for_each(pass.outputs, releaseFinished);
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,84 @@
+#ifndef INTERNALFRAMEGRAPH
+#define INTERNALFRAMEGRAPH
+
+#include <vector>
+
+extern "C" {
+  #include <epoxy/gl.h>
+}
+
+#include "../visibility.hpp"
+
+namespace AMMONITE_INTERNAL ammonite {
+  namespace graphics {
+    namespace internal {
+      //Texture read or written by a pass, isUsed is false for outputs nothing reads
+      struct FrameTexture {
+        GLuint textureId = 0;
+        GLuint framebufferId = 0;
+        unsigned int width = 0;
+        unsigned int height = 0;
+        bool isUsed = false;
+      };
+
+      //Textures given to a pass, in the order they were declared
+      struct FramePassContext {
+        std::vector<FrameTexture> inputs;
+        std::vector<FrameTexture> outputs;
+      };
+
+      using FramePassCallback = void (*)(const FramePassContext& context, void* userPtr);
+
+      /*
+       - Order post-processing passes by the textures they read and write
+       - Passes are run in the order they're added, so writers must come before readers
+         - Each texture should only be written by a single pass
+       - Passes that don't contribute to the final texture are skipped
+       - Transient textures are taken from the post-processing target pool when first
+         written, and returned after their last read, so passes that don't overlap
+         share memory
+      */
+      class FrameGraph {
+      private:
+        struct Resource {
+          GLuint textureId = 0;
+          GLuint framebufferId = 0;
+          unsigned int width = 0;
+          unsigned int height = 0;
+          GLenum format = GL_NONE;
+          bool isImported = false;
+          bool isUsed = false;
+          unsigned int lastPass = 0;
+          unsigned int targetIndex = 0;
+        };
+
+        struct Pass {
+          FramePassCallback callback = nullptr;
+          void* userPtr = nullptr;
+          std::vector<unsigned int> inputs;
+          std::vector<unsigned int> outputs;
+          bool isUsed = false;
+        };
+
+        std::vector<Resource> resources;
+        std::vector<Pass> passes;
+        FramePassContext context;
+
+        void cullPasses(unsigned int outputId);
+        void fillContext(const Pass& pass);
+
+      public:
+        void reset();
+        unsigned int importTexture(GLuint textureId, GLuint framebufferId,
+                                   unsigned int width, unsigned int height);
+        unsigned int createTexture(unsigned int width, unsigned int height, GLenum format);
+        void addPass(FramePassCallback callback, void* userPtr,
+                     const std::vector<unsigned int>& inputs,
+                     const std::vector<unsigned int>& outputs);
+        void execute(unsigned int outputId);
+      };
+    }
+  }
+}
+
+#endif
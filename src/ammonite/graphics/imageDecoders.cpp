@@ -0,0 +1,273 @@
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#ifdef AMMONITE_LIBJPEG
+  #include <csetjmp>
+  #include <cstdio>
+#endif
+
+#ifdef AMMONITE_LIBPNG
+  #include <cstring>
+#endif
+
+extern "C" {
+  #define STB_IMAGE_IMPLEMENTATION
+  #include <stb/stb_image.h>
+
+  #ifdef AMMONITE_LIBJPEG
+    #include <jpeglib.h>
+  #endif
+
+  #ifdef AMMONITE_LIBPNG
+    #include <png.h>
+  #endif
+}
+
+#include "imageDecoders.hpp"
+
+#include "../utils/debug.hpp"
+#include "../utils/files.hpp"
+
+/*
+ - Decode image files for textures, picking a decoder from each file's signature
+ - Faster decoders for common formats can be enabled at build time, stb_image
+   handles everything else, and anything they fail to decode
+ - Images keep the channels stored in the file, and every decoder allocates the
+   pixels with malloc(), matching stb_image
+*/
+
+namespace ammonite {
+  namespace textures {
+    namespace internal {
+      namespace {
+        struct ImageDecoder {
+          const char* name;
+          bool (*checkSignature)(const unsigned char* fileData, std::size_t fileSize);
+          bool (*decode)(const unsigned char* fileData, std::size_t fileSize,
+                         bool flipImage, DecodedImage* image);
+        };
+
+#ifdef AMMONITE_LIBJPEG
+        //Rows to ask libjpeg for at once
+        constexpr unsigned int jpegRowBatch = 16;
+
+        struct JpegErrorManager {
+          jpeg_error_mgr manager;
+          std::jmp_buf jumpBuffer;
+        };
+
+        //Return to decodeJpeg() on fatal errors, instead of exiting
+        [[noreturn]] void jpegErrorExit(j_common_ptr info) {
+          JpegErrorManager* const errorManager = (JpegErrorManager*)info->err;
+          std::longjmp(errorManager->jumpBuffer, 1);
+        }
+
+        //Recoverable errors are quietly ignored, like stb_image does
+        void jpegOutputMessage(j_common_ptr) {}
+
+        bool checkJpegSignature(const unsigned char* fileData, std::size_t fileSize) {
+          return fileSize >= 3 && fileData[0] == 0xFF && fileData[1] == 0xD8 &&
+                 fileData[2] == 0xFF;
+        }
+
+        /*
+         - Decode a JPEG with libjpeg, which uses SIMD for the IDCT and colour conversion
+         - Nothing with a destructor may be created here, as errors jump back to setjmp()
+        */
+        bool decodeJpeg(const unsigned char* fileData, std::size_t fileSize, bool flipImage,
+                        DecodedImage* image) {
+          jpeg_decompress_struct info;
+          JpegErrorManager errorManager;
+          info.err = jpeg_std_error(&errorManager.manager);
+          errorManager.manager.error_exit = jpegErrorExit;
+          errorManager.manager.output_message = jpegOutputMessage;
+
+          //Written after setjmp(), so must be volatile to survive the jump
+          unsigned char* volatile data = nullptr;
+          if (setjmp(errorManager.jumpBuffer) != 0) {
+            jpeg_destroy_decompress(&info);
+            std::free(data);
+            return false;
+          }
+
+          jpeg_create_decompress(&info);
+          jpeg_mem_src(&info, fileData, (unsigned long)fileSize);
+          jpeg_read_header(&info, TRUE);
+
+          //Keep greyscale images as 1 channel, and convert everything else to RGB
+          info.out_color_space = (info.jpeg_color_space == JCS_GRAYSCALE) ?
+            JCS_GRAYSCALE : JCS_RGB;
+          jpeg_start_decompress(&info);
+
+          const std::size_t rowSize = (std::size_t)info.output_width *
+                                      (std::size_t)info.output_components;
+          data = (unsigned char*)std::malloc(rowSize * info.output_height);
+          if (data == nullptr) {
+            jpeg_destroy_decompress(&info);
+            return false;
+          }
+
+          //Decode batches of rows, placing them bottom-up when flipping
+          JSAMPROW rows[jpegRowBatch];
+          while (info.output_scanline < info.output_height) {
+            const JDIMENSION firstRow = info.output_scanline;
+            JDIMENSION rowCount = info.output_height - firstRow;
+            if (rowCount > jpegRowBatch) {
+              rowCount = jpegRowBatch;
+            }
+
+            for (JDIMENSION i = 0; i < rowCount; i++) {
+              const JDIMENSION row = flipImage ? (info.output_height - 1 - (firstRow + i)) :
+                                                 (firstRow + i);
+              rows[i] = data + ((std::size_t)row * rowSize);
+            }
+
+            jpeg_read_scanlines(&info, rows, rowCount);
+          }
+
+          image->data = data;
+          image->width = (int)info.output_width;
+          image->height = (int)info.output_height;
+          image->channels = info.output_components;
+
+          jpeg_finish_decompress(&info);
+          jpeg_destroy_decompress(&info);
+          return true;
+        }
+#endif
+
+#ifdef AMMONITE_LIBPNG
+        bool checkPngSignature(const unsigned char* fileData, std::size_t fileSize) {
+          return fileSize >= 8 && png_sig_cmp(fileData, 0, 8) == 0;
+        }
+
+        /*
+         - Decode a PNG with libpng, which uses SIMD to undo row filters
+         - Palettes and transparency chunks are expanded to grey or RGB, with alpha
+           if the image has any
+         - 16-bit images are left to stb_image, as libpng would treat them as linear
+        */
+        bool decodePng(const unsigned char* fileData, std::size_t fileSize, bool flipImage,
+                       DecodedImage* image) {
+          png_image pngImage;
+          std::memset(&pngImage, 0, sizeof(pngImage));
+          pngImage.version = PNG_IMAGE_VERSION;
+          if (png_image_begin_read_from_memory(&pngImage, fileData, fileSize) == 0) {
+            return false;
+          }
+
+          if ((pngImage.format & PNG_FORMAT_FLAG_LINEAR) != 0) {
+            png_image_free(&pngImage);
+            return false;
+          }
+
+          //Request the channels stored in the file, without a colour map
+          const bool hasColour = (pngImage.format & PNG_FORMAT_FLAG_COLOR) != 0;
+          const bool hasAlpha = (pngImage.format & PNG_FORMAT_FLAG_ALPHA) != 0;
+          if (hasColour) {
+            pngImage.format = hasAlpha ? PNG_FORMAT_RGBA : PNG_FORMAT_RGB;
+          } else {
+            pngImage.format = hasAlpha ? PNG_FORMAT_GA : PNG_FORMAT_GRAY;
+          }
+
+          unsigned char* const data = (unsigned char*)std::malloc(PNG_IMAGE_SIZE(pngImage));
+          if (data == nullptr) {
+            png_image_free(&pngImage);
+            return false;
+          }
+
+          //A negative stride stores the rows bottom-up
+          png_int_32 rowStride = (png_int_32)PNG_IMAGE_ROW_STRIDE(pngImage);
+          if (flipImage) {
+            rowStride = -rowStride;
+          }
+
+          if (png_image_finish_read(&pngImage, nullptr, data, rowStride, nullptr) == 0) {
+            std::free(data);
+            return false;
+          }
+
+          image->data = data;
+          image->width = (int)pngImage.width;
+          image->height = (int)pngImage.height;
+          image->channels = (int)PNG_IMAGE_SAMPLE_CHANNELS(pngImage.format);
+          return true;
+        }
+#endif
+
+        bool checkAnySignature(const unsigned char*, std::size_t) {
+          return true;
+        }
+
+        bool decodeStb(const unsigned char* fileData, std::size_t fileSize, bool flipImage,
+                       DecodedImage* image) {
+          if (flipImage) {
+            stbi_set_flip_vertically_on_load_thread(1);
+          }
+
+          image->data = stbi_load_from_memory(fileData, (int)fileSize, &image->width,
+                                              &image->height, &image->channels, 0);
+
+          //Disable flipping, to avoid interfering with future calls
+          if (flipImage) {
+            stbi_set_flip_vertically_on_load_thread(0);
+          }
+
+          return image->data != nullptr;
+        }
+
+        //Decoders to try in order, stb_image must stay last as it accepts any file
+        const ImageDecoder imageDecoders[] = {
+#ifdef AMMONITE_LIBJPEG
+          {.name = "libjpeg", .checkSignature = checkJpegSignature, .decode = decodeJpeg},
+#endif
+#ifdef AMMONITE_LIBPNG
+          {.name = "libpng", .checkSignature = checkPngSignature, .decode = decodePng},
+#endif
+          {.name = "stb_image", .checkSignature = checkAnySignature, .decode = decodeStb}
+        };
+      }
+
+      /*
+       - Read and decode an image, optionally flipping it vertically
+       - The pixels must be freed with freeDecodedImage()
+       - Guaranteed to be thread-safe
+       - Returns true on success, false on failure
+      */
+      bool decodeImage(const std::string& imagePath, bool flipImage, DecodedImage* image) {
+        std::size_t fileSize = 0;
+        unsigned char* const fileData = ammonite::utils::files::loadFile(imagePath,
+                                                                         &fileSize);
+        if (fileData == nullptr) {
+          return false;
+        }
+
+        //Try each decoder that accepts the file, until one succeeds
+        for (const ImageDecoder& decoder : imageDecoders) {
+          if (!decoder.checkSignature(fileData, fileSize)) {
+            continue;
+          }
+
+          *image = {};
+          if (decoder.decode(fileData, fileSize, flipImage, image)) {
+            delete [] fileData;
+            return true;
+          }
+
+          ammoniteInternalDebug << "Failed to decode '" << imagePath << "' with " \
+                                << decoder.name << std::endl;
+        }
+
+        delete [] fileData;
+        return false;
+      }
+
+      void freeDecodedImage(DecodedImage* image) {
+        std::free(image->data);
+        image->data = nullptr;
+      }
+    }
+  }
+}
@@ -0,0 +1,24 @@
+#ifndef INTERNALIMAGEDECODERS
+#define INTERNALIMAGEDECODERS
+
+#include <string>
+
+#include "../visibility.hpp"
+
+namespace AMMONITE_INTERNAL ammonite {
+  namespace textures {
+    namespace internal {
+      struct DecodedImage {
+        unsigned char* data = nullptr;
+        int width = 0;
+        int height = 0;
+        int channels = 0;
+      };
+
+      bool decodeImage(const std::string& imagePath, bool flipImage, DecodedImage* image);
+      void freeDecodedImage(DecodedImage* image);
+    }
+  }
+}
+
+#endif
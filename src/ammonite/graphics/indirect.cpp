@@ -0,0 +1,429 @@
+#include <algorithm>
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+extern "C" {
+  #include <epoxy/gl.h>
+}
+
+#include "indirect.hpp"
+
+#include "culling.hpp"
+#include "materials.hpp"
+#include "renderer.hpp"
+#include "shadowInstances.hpp"
+#include "textures.hpp"
+#include "../maths/matrix.hpp"
+#include "../models/models.hpp"
+
+/*
+ - Build and store the command and per-draw buffers for multi-draw indirect rendering
+ - Commands are only rebuilt when the set of drawn meshes changes, per-draw
+   data is refreshed every frame
+*/
+
+namespace ammonite {
+  namespace graphics {
+    namespace internal {
+      namespace {
+        //Command layout consumed by glMultiDrawElementsIndirect()
+        struct DrawElementsIndirectCommand {
+          GLuint count;
+          GLuint instanceCount;
+          GLuint firstIndex;
+          GLint baseVertex;
+          GLuint baseInstance;
+        };
+
+        //Per-draw data, matches the std430 layout of DrawDataBuffer in the shaders
+        struct IndirectDrawData {
+          ammonite::Mat<float, 4> modelMatrix;
+          ammonite::Mat<float, 3, 4> normalMatrix;
+          GLuint materialIndex;
+          GLuint padding[3];
+        };
+
+        //Mesh of a model instance to be drawn, used to sort draws into batches
+        struct DrawEntry {
+          const models::internal::ModelInfo* modelPtr;
+          unsigned int modelIndex;
+          const models::internal::MeshInfoGroup* meshInfoPtr;
+          unsigned int materialIndex;
+          bool isAlphaTested;
+          GLuint diffuseId;
+          GLuint specularId;
+        };
+
+        std::vector<DrawElementsIndirectCommand> commands;
+        std::vector<const models::internal::ModelInfo*> commandModelPtrs;
+        std::vector<unsigned int> commandModelIndices;
+        std::vector<IndirectDrawData> drawData;
+        std::vector<IndirectBatch> batches;
+        std::vector<IndirectBatch> depthBatches;
+
+        /*
+         - Commands of each model, so moved models only refresh their own draw data
+         - Model IDs map to positions in the model list, whose commands are
+           modelCommands[modelCommandStarts[i]] up to modelCommands[modelCommandStarts[i + 1]]
+        */
+        std::unordered_map<AmmoniteId, unsigned int> modelIdIndexMap;
+        std::vector<unsigned int> modelCommandStarts;
+        std::vector<unsigned int> modelCommands;
+        bool isDrawDataStale = true;
+
+        //Sorted indices of the commands or draw data changed since the last upload
+        std::vector<unsigned int> changedIndices;
+
+        GLuint commandBufferId = 0;
+        GLuint drawDataBufferId = 0;
+        unsigned int bufferCapacity = 0;
+
+        //Unchanged elements between changed ones are uploaded with them, up to this many
+        constexpr unsigned int maxUploadGap = 64;
+
+        //Upload a run of elements to the same place in a buffer
+        void uploadElements(GLuint bufferId, const void* elements, std::size_t elementSize,
+                            unsigned int firstElement, unsigned int elementCount) {
+          glNamedBufferSubData(bufferId, firstElement * (GLintptr)elementSize,
+                               elementCount * (GLsizeiptr)elementSize,
+                               (const unsigned char*)elements + (firstElement * elementSize));
+        }
+
+        /*
+         - Upload the elements listed in changedIndices, joining runs separated by small gaps
+         - changedIndices must be sorted, without duplicates
+        */
+        void uploadChangedElements(GLuint bufferId, const void* elements,
+                                   std::size_t elementSize) {
+          if (changedIndices.empty()) {
+            return;
+          }
+
+          unsigned int runStart = changedIndices[0];
+          unsigned int runEnd = runStart + 1;
+          for (std::size_t i = 1; i < changedIndices.size(); i++) {
+            const unsigned int index = changedIndices[i];
+            if (index - runEnd > maxUploadGap) {
+              uploadElements(bufferId, elements, elementSize, runStart, runEnd - runStart);
+              runStart = index;
+            }
+            runEnd = index + 1;
+          }
+
+          uploadElements(bufferId, elements, elementSize, runStart, runEnd - runStart);
+        }
+
+        //Copy the latest model and normal matrices of a command's model into its draw data
+        void copyDrawMatrices(unsigned int commandIndex) {
+          const models::internal::PositionData& positionData =
+            commandModelPtrs[commandIndex]->positionData;
+          ammonite::copy(positionData.modelMatrix, drawData[commandIndex].modelMatrix);
+
+          //Columns of the normal matrix are padded to match std430
+          ammonite::copy(positionData.normalMatrix, drawData[commandIndex].normalMatrix);
+        }
+
+        //Set the instances drawn by a command, recording it in changedIndices if they changed
+        void setCommandInstances(unsigned int commandIndex, GLuint instanceCount,
+                                 GLuint baseInstance) {
+          DrawElementsIndirectCommand& command = commands[commandIndex];
+          if (command.instanceCount != instanceCount || command.baseInstance != baseInstance) {
+            command.instanceCount = instanceCount;
+            command.baseInstance = baseInstance;
+            changedIndices.push_back(commandIndex);
+          }
+        }
+
+        //Create storage for at least commandCount commands and their draw data
+        void reserveIndirectBuffers(unsigned int commandCount) {
+          if (commandCount <= bufferCapacity) {
+            return;
+          }
+
+          deleteIndirectBuffers();
+
+          //Grow to the next power of 2, to avoid reallocating for every new model
+          bufferCapacity = 1;
+          while (bufferCapacity < commandCount) {
+            bufferCapacity *= 2;
+          }
+
+          glCreateBuffers(1, &commandBufferId);
+          glNamedBufferStorage(commandBufferId,
+                               bufferCapacity * (GLsizeiptr)sizeof(DrawElementsIndirectCommand),
+                               nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+          glCreateBuffers(1, &drawDataBufferId);
+          glNamedBufferStorage(drawDataBufferId,
+                               bufferCapacity * (GLsizeiptr)sizeof(IndirectDrawData),
+                               nullptr, GL_DYNAMIC_STORAGE_BIT);
+        }
+
+        //Order draws so batches share a vertex array, draw mode, alpha testing and textures
+        bool compareDrawEntries(const DrawEntry& a, const DrawEntry& b) {
+          if (a.meshInfoPtr->vertexArrayId != b.meshInfoPtr->vertexArrayId) {
+            return a.meshInfoPtr->vertexArrayId < b.meshInfoPtr->vertexArrayId;
+          }
+
+          if (a.modelPtr->drawMode != b.modelPtr->drawMode) {
+            return a.modelPtr->drawMode < b.modelPtr->drawMode;
+          }
+
+          if (a.isAlphaTested != b.isAlphaTested) {
+            return b.isAlphaTested;
+          }
+
+          if (a.diffuseId != b.diffuseId) {
+            return a.diffuseId < b.diffuseId;
+          }
+
+          return a.specularId < b.specularId;
+        }
+      }
+
+      /*
+       - Rebuild the indirect commands and batches from the active models
+       - Only needs to be called when models are added, removed, or have their
+         draw mode or textures changed
+       - Materials must be uploaded first, so bindless materials can share batches
+      */
+      void updateIndirectCommands(models::internal::ModelInfo** modelPtrs,
+                                  unsigned int modelCount) {
+        //Collect every mesh of every model
+        std::vector<DrawEntry> drawEntries;
+        for (unsigned int i = 0; i < modelCount; i++) {
+          const models::internal::ModelInfo* const modelPtr = modelPtrs[i];
+          const std::vector<models::internal::MeshInfoGroup>& meshInfo =
+            modelPtr->modelData->meshInfo;
+
+          for (unsigned int meshIndex = 0; meshIndex < meshInfo.size(); meshIndex++) {
+            //Empty meshes have no vertex array to draw from
+            if (meshInfo[meshIndex].vertexArrayId == 0) {
+              continue;
+            }
+
+            //Bindless materials don't bind textures, so don't split batches by them
+            const models::internal::TextureIdGroup& textureIds =
+              modelPtr->textureIds[meshIndex];
+            const bool isBindless = isMaterialBindless(textureIds.materialIndex);
+            drawEntries.push_back({
+              .modelPtr = modelPtr,
+              .modelIndex = i,
+              .meshInfoPtr = &meshInfo[meshIndex],
+              .materialIndex = textureIds.materialIndex,
+              .isAlphaTested = textures::internal::isTextureTransparent(textureIds.diffuseId),
+              .diffuseId = isBindless ? 0 : textureIds.diffuseId,
+              .specularId = isBindless ? 0 : textureIds.specularId
+            });
+          }
+        }
+
+        std::sort(drawEntries.begin(), drawEntries.end(), compareDrawEntries);
+
+        //Fill the commands, starting a new batch whenever the state changes
+        commands.clear();
+        commandModelPtrs.clear();
+        commandModelIndices.clear();
+        batches.clear();
+        depthBatches.clear();
+        for (unsigned int i = 0; i < drawEntries.size(); i++) {
+          const DrawEntry& entry = drawEntries[i];
+          commands.push_back({
+            .count = entry.meshInfoPtr->indexCount,
+            .instanceCount = 1,
+            .firstIndex = entry.meshInfoPtr->firstIndex,
+            .baseVertex = entry.meshInfoPtr->baseVertex,
+            .baseInstance = 0
+          });
+          commandModelPtrs.push_back(entry.modelPtr);
+          commandModelIndices.push_back(entry.modelIndex);
+
+          //Depth batches ignore textures
+          const bool isNewDepthBatch = depthBatches.empty() ||
+            depthBatches.back().vertexArrayId != entry.meshInfoPtr->vertexArrayId ||
+            depthBatches.back().drawMode != entry.modelPtr->drawMode;
+          const bool isNewBatch = isNewDepthBatch ||
+            batches.back().isAlphaTested != entry.isAlphaTested ||
+            batches.back().diffuseId != entry.diffuseId ||
+            batches.back().specularId != entry.specularId;
+
+          if (isNewBatch) {
+            batches.push_back({
+              .vertexArrayId = entry.meshInfoPtr->vertexArrayId,
+              .drawMode = entry.modelPtr->drawMode,
+              .isAlphaTested = entry.isAlphaTested,
+              .diffuseId = entry.diffuseId,
+              .specularId = entry.specularId,
+              .firstCommand = i,
+              .commandCount = 0
+            });
+          }
+          batches.back().commandCount++;
+
+          if (isNewDepthBatch) {
+            depthBatches.push_back(batches.back());
+            depthBatches.back().commandCount = 0;
+          }
+          depthBatches.back().commandCount++;
+        }
+
+        //Group the commands by model, counting each model's commands first
+        modelIdIndexMap.clear();
+        for (unsigned int i = 0; i < modelCount; i++) {
+          modelIdIndexMap[modelPtrs[i]->modelId] = i;
+        }
+
+        modelCommandStarts.assign(modelCount + 1, 0);
+        for (const unsigned int modelIndex : commandModelIndices) {
+          modelCommandStarts[modelIndex + 1]++;
+        }
+
+        for (unsigned int i = 0; i < modelCount; i++) {
+          modelCommandStarts[i + 1] += modelCommandStarts[i];
+        }
+
+        std::vector<unsigned int> nextModelCommand(modelCommandStarts.begin(),
+                                                   modelCommandStarts.end() - 1);
+        modelCommands.resize(commands.size());
+        for (unsigned int i = 0; i < commands.size(); i++) {
+          modelCommands[nextModelCommand[commandModelIndices[i]]++] = i;
+        }
+
+        //Upload the commands, the draw data's matrices are filled in separately
+        reserveIndirectBuffers(commands.size());
+        drawData.resize(commands.size());
+        for (unsigned int i = 0; i < drawEntries.size(); i++) {
+          drawData[i].materialIndex = drawEntries[i].materialIndex;
+        }
+        if (!commands.empty()) {
+          uploadElements(commandBufferId, commands.data(), sizeof(DrawElementsIndirectCommand),
+                         0, commands.size());
+        }
+        isDrawDataStale = true;
+      }
+
+      /*
+       - Copy the latest model and normal matrices into the per-draw buffer
+       - Only the draws of models in movedModelIds are refreshed, unless the commands
+         were rebuilt, the draw data was invalidated, or movedModelIds is nullptr
+      */
+      void updateIndirectDrawData(const std::vector<AmmoniteId>* movedModelIds) {
+        if (drawData.empty()) {
+          isDrawDataStale = false;
+          return;
+        }
+
+        //Refresh every draw, when individual changes can't be used
+        if (isDrawDataStale || movedModelIds == nullptr) {
+          for (unsigned int i = 0; i < drawData.size(); i++) {
+            copyDrawMatrices(i);
+          }
+
+          uploadElements(drawDataBufferId, drawData.data(), sizeof(IndirectDrawData),
+                         0, drawData.size());
+          isDrawDataStale = false;
+          return;
+        }
+
+        //Find the draws of each moved model, models may have moved more than once
+        changedIndices.clear();
+        for (const AmmoniteId modelId : *movedModelIds) {
+          const auto modelIt = modelIdIndexMap.find(modelId);
+          if (modelIt == modelIdIndexMap.end()) {
+            continue;
+          }
+
+          const unsigned int modelIndex = modelIt->second;
+          for (unsigned int i = modelCommandStarts[modelIndex];
+               i < modelCommandStarts[modelIndex + 1]; i++) {
+            changedIndices.push_back(modelCommands[i]);
+          }
+        }
+
+        std::sort(changedIndices.begin(), changedIndices.end());
+        changedIndices.erase(std::unique(changedIndices.begin(), changedIndices.end()),
+                             changedIndices.end());
+        for (const unsigned int commandIndex : changedIndices) {
+          copyDrawMatrices(commandIndex);
+        }
+
+        uploadChangedElements(drawDataBufferId, drawData.data(), sizeof(IndirectDrawData));
+      }
+
+      //Refresh every draw's data next time, for when model movements weren't passed on
+      void invalidateIndirectDrawData() {
+        isDrawDataStale = true;
+      }
+
+      /*
+       - Enable or disable each command using the results of the last culling query
+       - Culled commands are kept with an instance count of 0, so batches don't
+         need to be rebuilt for each view
+       - The base instance carries the cubemap face mask to the depth shaders,
+         no attributes are instanced so it has no other effect
+       - Only the runs of commands that changed since the last view are uploaded
+      */
+      void updateIndirectVisibility() {
+        changedIndices.clear();
+        for (unsigned int i = 0; i < commands.size(); i++) {
+          const GLuint faceMask = getModelFaceMask(commandModelIndices[i]);
+          setCommandInstances(i, (faceMask != 0) ? 1 : 0, faceMask);
+        }
+
+        //Nothing is uploaded when the visible set is unchanged from the last view
+        uploadChangedElements(commandBufferId, commands.data(),
+                              sizeof(DrawElementsIndirectCommand));
+      }
+
+      /*
+       - Draw each command once for every shadow instance of its model
+       - The base instance points the layered depth shaders at the model's first instance
+      */
+      void updateIndirectShadowInstances(const std::vector<ShadowInstanceRun>& instanceRuns) {
+        changedIndices.clear();
+        for (unsigned int i = 0; i < commands.size(); i++) {
+          const ShadowInstanceRun& instanceRun = instanceRuns[commandModelIndices[i]];
+          setCommandInstances(i, instanceRun.instanceCount, instanceRun.firstInstance);
+        }
+
+        uploadChangedElements(commandBufferId, commands.data(),
+                              sizeof(DrawElementsIndirectCommand));
+      }
+
+      void bindIndirectBuffers() {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBufferId);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, drawDataBufferId);
+      }
+
+      //Draw a batch, requires the buffers to be bound with bindIndirectBuffers()
+      void drawIndirectBatch(const IndirectBatch& batch, GLenum mode) {
+        const GLintptr commandOffset =
+          batch.firstCommand * (GLintptr)sizeof(DrawElementsIndirectCommand);
+
+        renderer::internal::bindVertexArray(batch.vertexArrayId);
+        //NOLINTNEXTLINE(performance-no-int-to-ptr)
+        glMultiDrawElementsIndirect(mode, GL_UNSIGNED_INT, (const void*)commandOffset,
+                                    (GLsizei)batch.commandCount, 0);
+      }
+
+      void deleteIndirectBuffers() {
+        if (commandBufferId != 0) {
+          glDeleteBuffers(1, &commandBufferId);
+          glDeleteBuffers(1, &drawDataBufferId);
+          commandBufferId = 0;
+          drawDataBufferId = 0;
+          bufferCapacity = 0;
+        }
+      }
+
+      const std::vector<IndirectBatch>& getIndirectBatches() {
+        return batches;
+      }
+
+      const std::vector<IndirectBatch>& getIndirectDepthBatches() {
+        return depthBatches;
+      }
+    }
+  }
+}
@@ -0,0 +1,47 @@
+#ifndef INTERNALINDIRECT
+#define INTERNALINDIRECT
+
+#include <vector>
+
+extern "C" {
+  #include <epoxy/gl.h>
+}
+
+#include "shadowInstances.hpp"
+#include "../models/models.hpp"
+#include "../visibility.hpp"
+
+namespace AMMONITE_INTERNAL ammonite {
+  namespace graphics {
+    namespace internal {
+      /*
+       - A run of indirect draw commands that can be issued with the same state
+       - Texture IDs are only set when the batch's materials need them bound
+      */
+      struct IndirectBatch {
+        GLuint vertexArrayId = 0;
+        AmmoniteDrawEnum drawMode = AMMONITE_DRAW_ACTIVE;
+        bool isAlphaTested = false;
+        GLuint diffuseId = 0;
+        GLuint specularId = 0;
+        unsigned int firstCommand = 0;
+        unsigned int commandCount = 0;
+      };
+
+      void updateIndirectCommands(models::internal::ModelInfo** modelPtrs,
+                                  unsigned int modelCount);
+      void updateIndirectDrawData(const std::vector<AmmoniteId>* movedModelIds);
+      void invalidateIndirectDrawData();
+      void updateIndirectVisibility();
+      void updateIndirectShadowInstances(const std::vector<ShadowInstanceRun>& instanceRuns);
+      void bindIndirectBuffers();
+      void drawIndirectBatch(const IndirectBatch& batch, GLenum mode);
+      void deleteIndirectBuffers();
+
+      const std::vector<IndirectBatch>& getIndirectBatches();
+      const std::vector<IndirectBatch>& getIndirectDepthBatches();
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,248 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "lightClusters.hpp"
+
+#include "../maths/matrix.hpp"
+#include "../maths/vector.hpp"
+#include "../utils/thread.hpp"
+
+/*
+ - Sort lights into a grid of clusters dividing the camera's view, for clustered
+   forward shading
+ - Clusters are screen-space tiles, split into slices that grow exponentially
+   with depth, so near clusters stay small
+ - Each depth slice is built by a separate job, split across the thread pool
+   once there are enough lights
+*/
+
+namespace ammonite {
+  namespace graphics {
+    namespace internal {
+      namespace {
+        constexpr unsigned int clustersPerSlice = clusterGridX * clusterGridY;
+
+        //Light and cluster pairs to test before using the thread pool
+        constexpr unsigned int minTestsForThreads = 65536;
+
+        //View-space bounding box of a cluster
+        struct ClusterBounds {
+          ammonite::Vec<float, 3> minimum;
+          ammonite::Vec<float, 3> maximum;
+        };
+
+        //Light moved into view space, with the depth slices it may reach
+        struct ViewLight {
+          ammonite::Vec<float, 3> position;
+          float range;
+          unsigned int firstSlice;
+          unsigned int lastSlice;
+        };
+
+        //Per-job state, lights are listed relative to the slice's own index list
+        struct SliceJobData {
+          unsigned int slice;
+          std::vector<unsigned int> lightIndices;
+        };
+
+        std::vector<ClusterBounds> clusterBounds;
+        std::vector<ViewLight> viewLights;
+        std::vector<SliceJobData> sliceJobData;
+        std::vector<LightCluster> lightClusters;
+        std::vector<unsigned int> clusterLightIndices;
+
+        //Projection the cluster bounds were built for
+        float lastNearPlane = 0.0f;
+        float lastFarPlane = 0.0f;
+        float lastScaleX = 0.0f;
+        float lastScaleY = 0.0f;
+
+        float depthScale = 0.0f;
+        float depthBias = 0.0f;
+
+        //Depth of the near side of a slice, slice clusterGridZ gives the far plane
+        float getSliceDepth(unsigned int slice, float nearPlane, float farPlane) {
+          return nearPlane * std::pow(farPlane / nearPlane, (float)slice / (float)clusterGridZ);
+        }
+
+        //Find the slice containing a depth, clamped to the grid
+        unsigned int getDepthSlice(float depth) {
+          const float slice = (std::log(std::max(depth, 1e-6f)) * depthScale) + depthBias;
+          return (unsigned int)std::clamp(slice, 0.0f, (float)(clusterGridZ - 1));
+        }
+
+        /*
+         - Calculate the view-space bounds of every cluster, for a symmetric perspective
+           projection with the given scales and planes
+         - Tiles are bounded at both ends of their slice, since the frustum widens with depth
+        */
+        void calculateClusterBounds(float nearPlane, float farPlane, float scaleX, float scaleY) {
+          clusterBounds.resize(clusterCount);
+          for (unsigned int slice = 0; slice < clusterGridZ; slice++) {
+            const float nearDepth = getSliceDepth(slice, nearPlane, farPlane);
+            const float farDepth = getSliceDepth(slice + 1, nearPlane, farPlane);
+
+            for (unsigned int y = 0; y < clusterGridY; y++) {
+              const float bottom = -1.0f + (2.0f * (float)y / (float)clusterGridY);
+              const float top = -1.0f + (2.0f * (float)(y + 1) / (float)clusterGridY);
+
+              for (unsigned int x = 0; x < clusterGridX; x++) {
+                const float left = -1.0f + (2.0f * (float)x / (float)clusterGridX);
+                const float right = -1.0f + (2.0f * (float)(x + 1) / (float)clusterGridX);
+
+                ClusterBounds& bounds = clusterBounds[(slice * clustersPerSlice) +
+                                                     (y * clusterGridX) + x];
+                bounds.minimum[0] = std::min(left * nearDepth, left * farDepth) / scaleX;
+                bounds.maximum[0] = std::max(right * nearDepth, right * farDepth) / scaleX;
+                bounds.minimum[1] = std::min(bottom * nearDepth, bottom * farDepth) / scaleY;
+                bounds.maximum[1] = std::max(top * nearDepth, top * farDepth) / scaleY;
+
+                //View space looks down -Z
+                bounds.minimum[2] = -farDepth;
+                bounds.maximum[2] = -nearDepth;
+              }
+            }
+          }
+        }
+
+        bool isSphereInBounds(const ClusterBounds& bounds,
+                              const ammonite::Vec<float, 3>& centre, float radius) {
+          float distanceSquared = 0.0f;
+          for (unsigned int axis = 0; axis < 3; axis++) {
+            const float closest = std::clamp(centre[axis], bounds.minimum[axis],
+                                             bounds.maximum[axis]);
+            distanceSquared += (closest - centre[axis]) * (closest - centre[axis]);
+          }
+
+          return distanceSquared <= radius * radius;
+        }
+
+        //Fill the clusters of a slice, with offsets relative to the slice's index list
+        void buildSliceJob(void* userPtr) {
+          SliceJobData* const data = (SliceJobData*)userPtr;
+          data->lightIndices.clear();
+
+          const unsigned int firstCluster = data->slice * clustersPerSlice;
+          for (unsigned int i = 0; i < clustersPerSlice; i++) {
+            const ClusterBounds& bounds = clusterBounds[firstCluster + i];
+            LightCluster& cluster = lightClusters[firstCluster + i];
+            cluster.firstLight = data->lightIndices.size();
+
+            for (unsigned int lightIndex = 0; lightIndex < viewLights.size(); lightIndex++) {
+              const ViewLight& viewLight = viewLights[lightIndex];
+              if (data->slice < viewLight.firstSlice || data->slice > viewLight.lastSlice) {
+                continue;
+              }
+
+              if (isSphereInBounds(bounds, viewLight.position, viewLight.range)) {
+                data->lightIndices.push_back(lightIndex);
+              }
+            }
+
+            cluster.lightCount = data->lightIndices.size() - cluster.firstLight;
+          }
+        }
+      }
+
+      /*
+       - Rebuild the light list of every cluster, for the camera's current view
+       - Lights behind the camera, or past the far plane, aren't added to any cluster
+      */
+      void buildLightClusters(const ammonite::Mat<float, 4>& viewMatrix,
+                              const ammonite::Mat<float, 4>& projectionMatrix,
+                              const std::vector<ClusterLight>& lights) {
+        //Recover the planes and scales from the projection
+        const float nearPlane = projectionMatrix[3][2] / (projectionMatrix[2][2] - 1.0f);
+        const float farPlane = projectionMatrix[3][2] / (projectionMatrix[2][2] + 1.0f);
+        const float scaleX = projectionMatrix[0][0];
+        const float scaleY = projectionMatrix[1][1];
+
+        //Only rebuild the cluster bounds when the projection changes
+        if (nearPlane != lastNearPlane || farPlane != lastFarPlane ||
+            scaleX != lastScaleX || scaleY != lastScaleY) {
+          lastNearPlane = nearPlane;
+          lastFarPlane = farPlane;
+          lastScaleX = scaleX;
+          lastScaleY = scaleY;
+
+          depthScale = (float)clusterGridZ / std::log(farPlane / nearPlane);
+          depthBias = -std::log(nearPlane) * depthScale;
+          calculateClusterBounds(nearPlane, farPlane, scaleX, scaleY);
+        }
+
+        //Move lights into view space, and find the slices they reach
+        viewLights.clear();
+        for (const ClusterLight& light : lights) {
+          ammonite::Vec<float, 4> worldPosition = {0};
+          ammonite::Vec<float, 4> viewPosition = {0};
+          ammonite::set(worldPosition, light.position, 1.0f);
+          ammonite::multiply(viewMatrix, worldPosition, viewPosition);
+
+          //Keep the light's index into the light buffer, even when skipped
+          ViewLight& viewLight = viewLights.emplace_back();
+          ammonite::copy(viewPosition, viewLight.position);
+          viewLight.range = light.range;
+          viewLight.firstSlice = 1;
+          viewLight.lastSlice = 0;
+
+          const float depth = -viewPosition[2];
+          if (depth + light.range < nearPlane || depth - light.range > farPlane) {
+            continue;
+          }
+
+          viewLight.firstSlice = getDepthSlice(depth - light.range);
+          viewLight.lastSlice = getDepthSlice(depth + light.range);
+        }
+
+        //Build each slice, using the thread pool for large light counts
+        lightClusters.resize(clusterCount);
+        sliceJobData.resize(clusterGridZ);
+        for (unsigned int slice = 0; slice < clusterGridZ; slice++) {
+          sliceJobData[slice].slice = slice;
+        }
+
+        if (lights.size() * clusterCount < minTestsForThreads ||
+            ammonite::utils::thread::getThreadPoolSize() <= 1) {
+          for (SliceJobData& data : sliceJobData) {
+            buildSliceJob(&data);
+          }
+        } else {
+          AmmoniteGroup group{0};
+          ammonite::utils::thread::submitMultipleSync(buildSliceJob, sliceJobData.data(),
+                                                      sizeof(SliceJobData), &group,
+                                                      clusterGridZ);
+          ammonite::utils::thread::waitGroupComplete(&group, clusterGridZ);
+        }
+
+        //Join the slice lists, offsetting each slice's clusters to match
+        clusterLightIndices.clear();
+        for (unsigned int slice = 0; slice < clusterGridZ; slice++) {
+          const unsigned int sliceOffset = clusterLightIndices.size();
+          const std::vector<unsigned int>& sliceIndices = sliceJobData[slice].lightIndices;
+          clusterLightIndices.insert(clusterLightIndices.end(), sliceIndices.begin(),
+                                     sliceIndices.end());
+
+          const unsigned int firstCluster = slice * clustersPerSlice;
+          for (unsigned int i = 0; i < clustersPerSlice; i++) {
+            lightClusters[firstCluster + i].firstLight += sliceOffset;
+          }
+        }
+      }
+
+      //Factors to find a fragment's slice, as log(depth) * scale + bias
+      void getClusterDepthFactors(float* scale, float* bias) {
+        *scale = depthScale;
+        *bias = depthBias;
+      }
+
+      const std::vector<LightCluster>& getLightClusters() {
+        return lightClusters;
+      }
+
+      const std::vector<unsigned int>& getClusterLightIndices() {
+        return clusterLightIndices;
+      }
+    }
+  }
+}
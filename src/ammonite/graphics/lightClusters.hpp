@@ -0,0 +1,42 @@
+#ifndef INTERNALLIGHTCLUSTERS
+#define INTERNALLIGHTCLUSTERS
+
+#include <vector>
+
+#include "../maths/matrix.hpp"
+#include "../maths/vector.hpp"
+#include "../visibility.hpp"
+
+namespace AMMONITE_INTERNAL ammonite {
+  namespace graphics {
+    namespace internal {
+      //Clusters across the screen, and depth slices between the near and far planes
+      constexpr unsigned int clusterGridX = 16;
+      constexpr unsigned int clusterGridY = 9;
+      constexpr unsigned int clusterGridZ = 24;
+      constexpr unsigned int clusterCount = clusterGridX * clusterGridY * clusterGridZ;
+
+      //Light to sort into clusters, as a sphere in world space
+      struct ClusterLight {
+        ammonite::Vec<float, 3> position;
+        float range;
+      };
+
+      //Run of the light index list used by a cluster, matches LightClustersBuffer in the shaders
+      struct LightCluster {
+        unsigned int firstLight;
+        unsigned int lightCount;
+      };
+
+      void buildLightClusters(const ammonite::Mat<float, 4>& viewMatrix,
+                              const ammonite::Mat<float, 4>& projectionMatrix,
+                              const std::vector<ClusterLight>& lights);
+      void getClusterDepthFactors(float* scale, float* bias);
+
+      const std::vector<LightCluster>& getLightClusters();
+      const std::vector<unsigned int>& getClusterLightIndices();
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,355 @@
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+extern "C" {
+  #include <epoxy/gl.h>
+}
+
+#include "materials.hpp"
+
+#include "extensions.hpp"
+#include "textures.hpp"
+#include "../maths/vector.hpp"
+#include "../utils/debug.hpp"
+#include "../utils/flatHashMap.hpp"
+#include "../utils/hash.hpp"
+#include "../utils/logging.hpp"
+
+/*
+ - Store every mesh's material in a shader storage buffer, so draws only need an index
+ - Identical materials are deduplicated and reference counted, and their indices reused
+ - With GL_ARB_bindless_texture, textures are sampled through handles in the buffer,
+   so draws no longer need textures bound
+   - Streamed textures and GPUs without support fall back to bound texture units
+ - Colour components are stored as constants, instead of 1x1 textures
+ - Textures without data yet are drawn as their component's colour, until their
+   materials are refreshed
+*/
+
+namespace ammonite {
+  namespace graphics {
+    namespace internal {
+      namespace {
+        //Material layout, matches the std430 layout of MaterialBuffer in the shaders
+        struct MaterialData {
+          GLuint64 diffuseHandle;
+          GLuint64 specularHandle;
+          ammonite::Vec<float, 4> diffuseColour;
+          ammonite::Vec<float, 4> specularColour;
+          GLuint hasDiffuseTexture;
+          GLuint hasSpecularTexture;
+          GLuint padding[2];
+        };
+
+        //Identifies a material's textures and colours
+        using MaterialKey = ammonite::utils::internal::Hash128;
+
+        //Textures and colours identifying a material, hashed to find matching materials
+        struct MaterialKeyData {
+          GLuint diffuseId;
+          GLuint specularId;
+          float diffuseColour[3];
+          float specularColour[3];
+        };
+
+        struct MaterialInfo {
+          GLuint diffuseId = 0;
+          GLuint specularId = 0;
+          MaterialKey materialKey = {};
+          unsigned int refCount = 0;
+          bool hasHandles = false;
+          bool isBindless = false;
+        };
+
+        //Bindless handles are shared by every material using the texture
+        struct TextureHandle {
+          GLuint64 handle = 0;
+          unsigned int refCount = 0;
+        };
+
+        std::vector<MaterialInfo> materialInfos;
+        std::vector<MaterialData> materialData;
+        std::vector<unsigned int> freeMaterialIndices;
+        ammonite::utils::internal::FlatHashMap<unsigned int> materialKeyIndexMap;
+        std::unordered_map<GLuint, TextureHandle> textureHandleMap;
+
+        GLuint materialBufferId = 0;
+        unsigned int bufferCapacity = 0;
+        bool isBindlessSupported = false;
+        bool haveMaterialsChanged = false;
+
+        /*
+         - Calculate the key identifying a material, from its textures and colours
+         - Colours of textured components are left out, so they don't split materials
+        */
+        MaterialKey calculateMaterialKey(GLuint diffuseId, GLuint specularId,
+                                         const ammonite::Vec<float, 3>& diffuseColour,
+                                         const ammonite::Vec<float, 3>& specularColour) {
+          MaterialKeyData keyData = {.diffuseId = diffuseId, .specularId = specularId,
+                                     .diffuseColour = {}, .specularColour = {}};
+          for (int i = 0; i < 3; i++) {
+            keyData.diffuseColour[i] = (diffuseId == 0) ? diffuseColour[i] : 0.0f;
+            keyData.specularColour[i] = (specularId == 0) ? specularColour[i] : 0.0f;
+          }
+
+          return ammonite::utils::internal::hashData(&keyData, sizeof(keyData), 0);
+        }
+
+        //Return a resident handle for a texture, increasing its reference counter
+        GLuint64 acquireTextureHandle(GLuint textureId) {
+          TextureHandle& textureHandle = textureHandleMap[textureId];
+          if (textureHandle.refCount++ == 0) {
+            textureHandle.handle = glGetTextureHandleARB(textureId);
+            glMakeTextureHandleResidentARB(textureHandle.handle);
+          }
+
+          return textureHandle.handle;
+        }
+
+        //Reduce the reference counter of a texture's handle, making it non-resident if unused
+        void releaseTextureHandle(GLuint textureId) {
+          const auto handleIt = textureHandleMap.find(textureId);
+          if (handleIt == textureHandleMap.end()) {
+            return;
+          }
+
+          if (--handleIt->second.refCount == 0) {
+            glMakeTextureHandleNonResidentARB(handleIt->second.handle);
+            textureHandleMap.erase(handleIt);
+          }
+        }
+
+        //Release the handles of a bindless material's textures
+        void releaseMaterialHandles(const MaterialInfo& materialInfo) {
+          if (!materialInfo.isBindless) {
+            return;
+          }
+
+          if (materialInfo.diffuseId != 0) {
+            releaseTextureHandle(materialInfo.diffuseId);
+          }
+
+          if (materialInfo.specularId != 0) {
+            releaseTextureHandle(materialInfo.specularId);
+          }
+        }
+
+        /*
+         - Decide whether a material can be drawn without binding its textures
+         - Handles can only be created once textures are uploaded, so this waits until
+           the material is first uploaded
+         - Textures without data yet are left out, so their colour is drawn instead
+        */
+        void resolveMaterialHandles(unsigned int materialIndex) {
+          MaterialInfo& materialInfo = materialInfos[materialIndex];
+          MaterialData& data = materialData[materialIndex];
+          materialInfo.hasHandles = true;
+          materialInfo.isBindless = isBindlessSupported;
+
+          data.hasDiffuseTexture = textures::internal::isTextureLoaded(
+            materialInfo.diffuseId) ? 1 : 0;
+          data.hasSpecularTexture = textures::internal::isTextureLoaded(
+            materialInfo.specularId) ? 1 : 0;
+
+          for (const GLuint textureId : {materialInfo.diffuseId, materialInfo.specularId}) {
+            if (textureId != 0 && !textures::internal::hasFixedTextureStorage(textureId)) {
+              materialInfo.isBindless = false;
+            }
+          }
+
+          if (!materialInfo.isBindless) {
+            return;
+          }
+
+          if (materialInfo.diffuseId != 0) {
+            data.diffuseHandle = acquireTextureHandle(materialInfo.diffuseId);
+          }
+
+          if (materialInfo.specularId != 0) {
+            data.specularHandle = acquireTextureHandle(materialInfo.specularId);
+          }
+        }
+      }
+
+      /*
+       - Return the index of a material with the given textures and colours
+       - Colours are only used for components without a texture
+         - Textured components share a material regardless of colour, so the colour
+           drawn before a texture is uploaded comes from the first of them
+       - Increases the reference counter, the material must be released with releaseMaterial()
+      */
+      unsigned int acquireMaterial(GLuint diffuseId, GLuint specularId,
+                                   const ammonite::Vec<float, 3>& diffuseColour,
+                                   const ammonite::Vec<float, 3>& specularColour) {
+        const MaterialKey materialKey = calculateMaterialKey(diffuseId, specularId,
+                                                             diffuseColour, specularColour);
+
+        //Use an existing material, if there's a match
+        const unsigned int* const materialIndexPtr = materialKeyIndexMap.find(materialKey);
+        if (materialIndexPtr != nullptr) {
+          materialInfos[*materialIndexPtr].refCount++;
+          return *materialIndexPtr;
+        }
+
+        //Reuse a free index, or add a new one
+        unsigned int materialIndex = 0;
+        if (!freeMaterialIndices.empty()) {
+          materialIndex = freeMaterialIndices.back();
+          freeMaterialIndices.pop_back();
+        } else {
+          materialIndex = materialInfos.size();
+          materialInfos.emplace_back();
+          materialData.emplace_back();
+        }
+
+        materialInfos[materialIndex] = {
+          .diffuseId = diffuseId,
+          .specularId = specularId,
+          .materialKey = materialKey,
+          .refCount = 1
+        };
+        materialKeyIndexMap[materialKey] = materialIndex;
+
+        //Fill the material's colours, textures are added when it's uploaded
+        MaterialData& data = materialData[materialIndex];
+        data = {};
+        ammonite::copy(diffuseColour, data.diffuseColour);
+        ammonite::copy(specularColour, data.specularColour);
+        data.diffuseColour[3] = 1.0f;
+        data.specularColour[3] = 1.0f;
+
+        haveMaterialsChanged = true;
+        return materialIndex;
+      }
+
+      //Increase the reference count of a material by its index
+      void copyMaterial(unsigned int materialIndex) {
+        if (materialIndex >= materialInfos.size() ||
+            materialInfos[materialIndex].refCount == 0) {
+          ammonite::utils::warning << "Material index (" << materialIndex \
+                                   << ") doesn't exist, not copying material" << std::endl;
+          return;
+        }
+
+        materialInfos[materialIndex].refCount++;
+      }
+
+      /*
+       - Reduce the reference count of a material, freeing its index if now unused
+       - Must be called before the material's textures are deleted
+      */
+      void releaseMaterial(unsigned int materialIndex) {
+        if (materialIndex >= materialInfos.size() ||
+            materialInfos[materialIndex].refCount == 0) {
+          ammonite::utils::warning << "Not releasing material (index " << materialIndex \
+                                   << "), it doesn't exist" << std::endl;
+          return;
+        }
+
+        MaterialInfo& materialInfo = materialInfos[materialIndex];
+        if (--materialInfo.refCount != 0) {
+          return;
+        }
+
+        //Release the texture handles, while the textures still exist
+        releaseMaterialHandles(materialInfo);
+
+        materialKeyIndexMap.erase(materialInfo.materialKey);
+        materialInfo = {};
+        freeMaterialIndices.push_back(materialIndex);
+        ammoniteInternalDebug << "Released material (index " << materialIndex << ")" \
+                              << std::endl;
+      }
+
+      /*
+       - Returns true if a material's textures are sampled through handles, instead of
+         being bound
+       - Only valid once the material has been uploaded, returns false for unknown materials
+      */
+      bool isMaterialBindless(unsigned int materialIndex) {
+        if (materialIndex >= materialInfos.size() ||
+            materialInfos[materialIndex].refCount == 0) {
+          return false;
+        }
+
+        return materialInfos[materialIndex].isBindless;
+      }
+
+      /*
+       - Resolve the materials using a texture again when they're next uploaded
+       - Call this once a texture's data has been uploaded after its materials were
+       - Draws must be rebuilt afterwards, as materials may become bindless
+      */
+      void refreshTextureMaterials(GLuint textureId) {
+        for (unsigned int i = 0; i < materialInfos.size(); i++) {
+          MaterialInfo& materialInfo = materialInfos[i];
+          if (materialInfo.refCount == 0 || !materialInfo.hasHandles ||
+              (materialInfo.diffuseId != textureId && materialInfo.specularId != textureId)) {
+            continue;
+          }
+
+          releaseMaterialHandles(materialInfo);
+          materialInfo.hasHandles = false;
+          materialInfo.isBindless = false;
+          materialData[i].diffuseHandle = 0;
+          materialData[i].specularHandle = 0;
+          haveMaterialsChanged = true;
+        }
+      }
+
+      //Check for bindless texture support, must be called before materials are uploaded
+      void updateBindlessSupport() {
+        isBindlessSupported = checkExtension("GL_ARB_bindless_texture");
+        if (isBindlessSupported) {
+          ammoniteInternalDebug << "Using bindless textures for materials" << std::endl;
+        }
+      }
+
+      /*
+       - Create handles for new materials, then upload the materials and bind the buffer
+       - Only uploads when materials have been added since the last call
+      */
+      void uploadMaterials() {
+        if (!haveMaterialsChanged) {
+          return;
+        }
+
+        for (unsigned int i = 0; i < materialInfos.size(); i++) {
+          if (materialInfos[i].refCount != 0 && !materialInfos[i].hasHandles) {
+            resolveMaterialHandles(i);
+          }
+        }
+
+        //Grow to the next power of 2, to avoid reallocating for every new material
+        if (materialData.size() > bufferCapacity) {
+          deleteMaterialBuffer();
+
+          bufferCapacity = 1;
+          while (bufferCapacity < materialData.size()) {
+            bufferCapacity *= 2;
+          }
+
+          glCreateBuffers(1, &materialBufferId);
+          glNamedBufferStorage(materialBufferId,
+                               bufferCapacity * (GLsizeiptr)sizeof(MaterialData),
+                               nullptr, GL_DYNAMIC_STORAGE_BIT);
+          glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, materialBufferId);
+        }
+
+        glNamedBufferSubData(materialBufferId, 0,
+                             materialData.size() * (GLsizeiptr)sizeof(MaterialData),
+                             materialData.data());
+        haveMaterialsChanged = false;
+      }
+
+      void deleteMaterialBuffer() {
+        if (materialBufferId != 0) {
+          glDeleteBuffers(1, &materialBufferId);
+          materialBufferId = 0;
+          bufferCapacity = 0;
+        }
+      }
+    }
+  }
+}
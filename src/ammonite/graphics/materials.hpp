@@ -0,0 +1,29 @@
+#ifndef INTERNALMATERIALS
+#define INTERNALMATERIALS
+
+extern "C" {
+  #include <epoxy/gl.h>
+}
+
+#include "../maths/vector.hpp"
+#include "../visibility.hpp"
+
+namespace AMMONITE_INTERNAL ammonite {
+  namespace graphics {
+    namespace internal {
+      unsigned int acquireMaterial(GLuint diffuseId, GLuint specularId,
+                                   const ammonite::Vec<float, 3>& diffuseColour,
+                                   const ammonite::Vec<float, 3>& specularColour);
+      void copyMaterial(unsigned int materialIndex);
+      void releaseMaterial(unsigned int materialIndex);
+      bool isMaterialBindless(unsigned int materialIndex);
+      void refreshTextureMaterials(GLuint textureId);
+
+      void updateBindlessSupport();
+      void uploadMaterials();
+      void deleteMaterialBuffer();
+    }
+  }
+}
+
+#endif
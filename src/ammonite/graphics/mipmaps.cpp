@@ -0,0 +1,185 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include "mipmaps.hpp"
+
+/*
+ - Create mipmaps on the CPU, so they can be built on worker threads and uploaded
+   or compressed with the texture
+ - Each level averages 2x2 squares of the level above it, in linear space for sRGB
+   colour, so dark and bright detail keep the same balance as the texture shrinks
+ - Alpha is never treated as sRGB
+ - Each step works on whole rows of floats, so the compiler can vectorise it
+*/
+
+namespace ammonite {
+  namespace textures {
+    namespace internal {
+      namespace {
+        float srgbToLinear(float value) {
+          if (value <= 0.04045f) {
+            return value / 12.92f;
+          }
+
+          return std::pow((value + 0.055f) / 1.055f, 2.4f);
+        }
+
+        //Linear value of every sRGB byte
+        const std::array<float, 256> srgbToLinearTable = []() {
+          std::array<float, 256> table = {0.0f};
+          for (unsigned int i = 0; i < table.size(); i++) {
+            table[i] = srgbToLinear((float)i / 255.0f);
+          }
+
+          return table;
+        }();
+
+        //Linear values halfway between each pair of sRGB bytes, used to round back to sRGB
+        const std::array<float, 255> srgbBoundaryTable = []() {
+          std::array<float, 255> table = {0.0f};
+          for (unsigned int i = 0; i < table.size(); i++) {
+            table[i] = srgbToLinear(((float)i + 0.5f) / 255.0f);
+          }
+
+          return table;
+        }();
+
+        unsigned char linearToSrgbByte(float value) {
+          return (unsigned char)(std::upper_bound(srgbBoundaryTable.begin(),
+                                                  srgbBoundaryTable.end(), value) -
+                                 srgbBoundaryTable.begin());
+        }
+
+        //Read a row of pixels as floats from 0 to 255, or linear values for sRGB colour
+        void readRow(const unsigned char* row, int width, int channels, bool srgbTexture,
+                     float* output) {
+          const std::size_t values = (std::size_t)width * (std::size_t)channels;
+          if (!srgbTexture) {
+            for (std::size_t i = 0; i < values; i++) {
+              output[i] = (float)row[i];
+            }
+
+            return;
+          }
+
+          for (std::size_t i = 0; i < values; i++) {
+            output[i] = srgbToLinearTable[row[i]];
+          }
+
+          //Restore alpha, the last component of 2 and 4 channel data, which isn't sRGB
+          if (channels == 2 || channels == 4) {
+            for (std::size_t i = (std::size_t)channels - 1; i < values;
+                 i += (std::size_t)channels) {
+              output[i] = (float)row[i];
+            }
+          }
+        }
+
+        //Write a row of values from readRow() back to bytes
+        void writeRow(const float* values, int width, int channels, bool srgbTexture,
+                      unsigned char* row) {
+          const std::size_t valueCount = (std::size_t)width * (std::size_t)channels;
+          if (!srgbTexture) {
+            for (std::size_t i = 0; i < valueCount; i++) {
+              row[i] = (unsigned char)std::clamp(values[i] + 0.5f, 0.0f, 255.0f);
+            }
+
+            return;
+          }
+
+          for (std::size_t i = 0; i < valueCount; i++) {
+            row[i] = linearToSrgbByte(values[i]);
+          }
+
+          if (channels == 2 || channels == 4) {
+            for (std::size_t i = (std::size_t)channels - 1; i < valueCount;
+                 i += (std::size_t)channels) {
+              row[i] = (unsigned char)std::clamp(values[i] + 0.5f, 0.0f, 255.0f);
+            }
+          }
+        }
+
+        /*
+         - Halve an image in each dimension, writing the result to output
+         - Odd rows and columns at the edges are averaged with themselves
+        */
+        void downsampleLevel(const unsigned char* data, int width, int height, int channels,
+                             bool srgbTexture, unsigned char* output) {
+          const int outputWidth = std::max(width / 2, 1);
+          const int outputHeight = std::max(height / 2, 1);
+          const std::size_t rowSize = (std::size_t)width * (std::size_t)channels;
+          const std::size_t outputRowSize = (std::size_t)outputWidth * (std::size_t)channels;
+
+          std::vector<float> topRow(rowSize);
+          std::vector<float> bottomRow(rowSize);
+          std::vector<float> outputRow(outputRowSize);
+          for (int y = 0; y < outputHeight; y++) {
+            const int topY = std::min(y * 2, height - 1);
+            const int bottomY = std::min((y * 2) + 1, height - 1);
+            readRow(data + ((std::size_t)topY * rowSize), width, channels, srgbTexture,
+                    topRow.data());
+            readRow(data + ((std::size_t)bottomY * rowSize), width, channels, srgbTexture,
+                    bottomRow.data());
+
+            //Sum each column of the pair of rows
+            for (std::size_t i = 0; i < rowSize; i++) {
+              topRow[i] += bottomRow[i];
+            }
+
+            //Average each pair of summed columns
+            const std::size_t pixelSize = (std::size_t)channels;
+            for (int x = 0; x < outputWidth; x++) {
+              const std::size_t left = (std::size_t)std::min(x * 2, width - 1) * pixelSize;
+              const std::size_t right = (std::size_t)std::min((x * 2) + 1, width - 1) *
+                                        pixelSize;
+              for (std::size_t c = 0; c < pixelSize; c++) {
+                outputRow[((std::size_t)x * pixelSize) + c] =
+                  (topRow[left + c] + topRow[right + c]) * 0.25f;
+              }
+            }
+
+            writeRow(outputRow.data(), outputWidth, channels, srgbTexture,
+                     output + ((std::size_t)y * outputRowSize));
+          }
+        }
+      }
+
+      //Return the size of an image and its first (levels - 1) mipmaps, without row padding
+      std::size_t calculateMipmapChainSize(int width, int height, int channels,
+                                           unsigned int levels) {
+        std::size_t size = 0;
+        for (unsigned int level = 0; level < levels; level++) {
+          size += (std::size_t)std::max(width >> level, 1) *
+                  (std::size_t)std::max(height >> level, 1) * (std::size_t)channels;
+        }
+
+        return size;
+      }
+
+      /*
+       - Fill in the mipmaps of an image, stored after the image from largest to smallest
+         - data must hold calculateMipmapChainSize() bytes, starting with the full image
+       - Guaranteed to be thread-safe
+      */
+      void generateMipmaps(unsigned char* data, int width, int height, int channels,
+                           bool srgbTexture, unsigned int levels) {
+        unsigned char* levelData = data;
+        int levelWidth = width;
+        int levelHeight = height;
+        for (unsigned int level = 1; level < levels; level++) {
+          unsigned char* const nextLevelData = levelData +
+            ((std::size_t)levelWidth * (std::size_t)levelHeight * (std::size_t)channels);
+          downsampleLevel(levelData, levelWidth, levelHeight, channels, srgbTexture,
+                          nextLevelData);
+
+          levelData = nextLevelData;
+          levelWidth = std::max(levelWidth / 2, 1);
+          levelHeight = std::max(levelHeight / 2, 1);
+        }
+      }
+    }
+  }
+}
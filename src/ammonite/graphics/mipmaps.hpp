@@ -0,0 +1,19 @@
+#ifndef INTERNALMIPMAPS
+#define INTERNALMIPMAPS
+
+#include <cstddef>
+
+#include "../visibility.hpp"
+
+namespace AMMONITE_INTERNAL ammonite {
+  namespace textures {
+    namespace internal {
+      std::size_t calculateMipmapChainSize(int width, int height, int channels,
+                                           unsigned int levels);
+      void generateMipmaps(unsigned char* data, int width, int height, int channels,
+                           bool srgbTexture, unsigned int levels);
+    }
+  }
+}
+
+#endif
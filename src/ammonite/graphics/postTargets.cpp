@@ -0,0 +1,120 @@
+#include <iostream>
+#include <vector>
+
+extern "C" {
+  #include <epoxy/gl.h>
+}
+
+#include "postTargets.hpp"
+
+#include "../utils/debug.hpp"
+#include "../utils/logging.hpp"
+
+/*
+ - Pool of transient render targets for post-processing
+ - Stages acquire targets by size and format, and hand them to later stages
+   instead of copying, released targets are reused by the next acquire
+ - Targets left unused for a while are deleted, so old sizes don't linger
+   after a resolution change
+*/
+
+namespace ammonite {
+  namespace graphics {
+    namespace internal {
+      namespace {
+        //Frames a target can go unused for before it's deleted
+        constexpr unsigned int maxIdleFrames = 60;
+
+        std::vector<PostTarget> postTargets;
+
+        void createPostTarget(PostTarget* target) {
+          glCreateTextures(GL_TEXTURE_2D, 1, &target->textureId);
+          glTextureStorage2D(target->textureId, 1, target->format,
+                             (GLsizei)target->width, (GLsizei)target->height);
+          glTextureParameteri(target->textureId, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+          glTextureParameteri(target->textureId, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+          glTextureParameteri(target->textureId, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+          glTextureParameteri(target->textureId, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+          glCreateFramebuffers(1, &target->framebufferId);
+          glNamedFramebufferTexture(target->framebufferId, GL_COLOR_ATTACHMENT0,
+                                    target->textureId, 0);
+
+          if (glCheckNamedFramebufferStatus(target->framebufferId, GL_FRAMEBUFFER) !=
+              GL_FRAMEBUFFER_COMPLETE) {
+            ammonite::utils::warning << "Incomplete post-processing framebuffer (" \
+                                     << target->width << " x " << target->height << ")" \
+                                     << std::endl;
+          } else {
+            ammoniteInternalDebug << "Created new post-processing target (" << target->width \
+                                  << " x " << target->height << ")" << std::endl;
+          }
+        }
+
+        void destroyPostTarget(PostTarget* target) {
+          glDeleteFramebuffers(1, &target->framebufferId);
+          glDeleteTextures(1, &target->textureId);
+          target->framebufferId = 0;
+          target->textureId = 0;
+        }
+      }
+
+      /*
+       - Find an unused target matching the size and format, or create one
+       - The target stays in use until it's released, so it can be passed between stages
+       - Indices are stable until finishPostTargetFrame() is called
+      */
+      unsigned int acquirePostTarget(unsigned int width, unsigned int height, GLenum format) {
+        for (unsigned int i = 0; i < postTargets.size(); i++) {
+          PostTarget& target = postTargets[i];
+          if (!target.isInUse && target.width == width && target.height == height &&
+              target.format == format) {
+            target.isInUse = true;
+            target.idleFrames = 0;
+            return i;
+          }
+        }
+
+        PostTarget& target = postTargets.emplace_back();
+        target.width = width;
+        target.height = height;
+        target.format = format;
+        target.isInUse = true;
+        createPostTarget(&target);
+
+        return (unsigned int)postTargets.size() - 1;
+      }
+
+      const PostTarget& getPostTarget(unsigned int targetIndex) {
+        return postTargets[targetIndex];
+      }
+
+      //Allow a target to be reused by a later acquire
+      void releasePostTarget(unsigned int targetIndex) {
+        postTargets[targetIndex].isInUse = false;
+      }
+
+      //Release every target, and delete targets that have been idle for too long
+      void finishPostTargetFrame() {
+        for (PostTarget& target : postTargets) {
+          target.isInUse = false;
+          if (target.idleFrames++ >= maxIdleFrames) {
+            destroyPostTarget(&target);
+          }
+        }
+
+        std::erase_if(postTargets, [](const PostTarget& target) {
+          return target.textureId == 0;
+        });
+      }
+
+      void deletePostTargets() {
+        for (PostTarget& target : postTargets) {
+          destroyPostTarget(&target);
+        }
+
+        postTargets.clear();
+      }
+    }
+  }
+}
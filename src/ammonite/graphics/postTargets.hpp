@@ -0,0 +1,33 @@
+#ifndef INTERNALPOSTTARGETS
+#define INTERNALPOSTTARGETS
+
+extern "C" {
+  #include <epoxy/gl.h>
+}
+
+#include "../visibility.hpp"
+
+namespace AMMONITE_INTERNAL ammonite {
+  namespace graphics {
+    namespace internal {
+      //Colour texture used between post-processing stages, with a framebuffer to draw into it
+      struct PostTarget {
+        GLuint textureId = 0;
+        GLuint framebufferId = 0;
+        unsigned int width = 0;
+        unsigned int height = 0;
+        GLenum format = GL_NONE;
+        bool isInUse = false;
+        unsigned int idleFrames = 0;
+      };
+
+      unsigned int acquirePostTarget(unsigned int width, unsigned int height, GLenum format);
+      const PostTarget& getPostTarget(unsigned int targetIndex);
+      void releasePostTarget(unsigned int targetIndex);
+      void finishPostTargetFrame();
+      void deletePostTargets();
+    }
+  }
+}
+
+#endif
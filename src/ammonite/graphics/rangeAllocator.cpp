@@ -0,0 +1,119 @@
+#include <algorithm>
+#include <iterator>
+#include <map>
+
+#include "rangeAllocator.hpp"
+
+/*
+ - Best-fit free-list allocator, used to suballocate shared buffers
+ - Freed ranges are merged with adjacent free ranges, so a fully freed
+   allocator always returns to a single free range
+*/
+
+namespace ammonite {
+  namespace graphics {
+    namespace internal {
+      //Creates an allocator with capacity free elements
+      RangeAllocator::RangeAllocator(unsigned int capacity) {
+        this->capacity = capacity;
+        if (capacity != 0) {
+          this->freeRanges[0] = capacity;
+        }
+      }
+
+      /*
+       - Reserve size contiguous elements, writing the start to offset
+       - Returns false if no free range is large enough
+       - Zero-sized ranges always succeed, and don't need to be freed
+      */
+      bool RangeAllocator::allocate(unsigned int size, unsigned int* offset) {
+        if (size == 0) {
+          *offset = 0;
+          return true;
+        }
+
+        //Find the smallest free range that fits, to limit fragmentation
+        auto bestIt = this->freeRanges.end();
+        for (auto it = this->freeRanges.begin(); it != this->freeRanges.end(); it++) {
+          if (it->second >= size) {
+            if (bestIt == this->freeRanges.end() || it->second < bestIt->second) {
+              bestIt = it;
+
+              //Exact fits can't be beaten
+              if (it->second == size) {
+                break;
+              }
+            }
+          }
+        }
+
+        if (bestIt == this->freeRanges.end()) {
+          return false;
+        }
+
+        //Claim the start of the range, keep any remainder free
+        *offset = bestIt->first;
+        const unsigned int remainingSize = bestIt->second - size;
+        this->freeRanges.erase(bestIt);
+        if (remainingSize != 0) {
+          this->freeRanges[*offset + size] = remainingSize;
+        }
+
+        this->usedSize += size;
+        return true;
+      }
+
+      //Return a range from allocate(), merging it with any free neighbours
+      void RangeAllocator::free(unsigned int offset, unsigned int size) {
+        if (size == 0) {
+          return;
+        }
+
+        this->usedSize -= size;
+        const auto it = this->freeRanges.emplace(offset, size).first;
+
+        //Merge with the following range
+        const auto nextIt = std::next(it);
+        if (nextIt != this->freeRanges.end() && offset + size == nextIt->first) {
+          it->second += nextIt->second;
+          this->freeRanges.erase(nextIt);
+        }
+
+        //Merge into the preceding range
+        if (it != this->freeRanges.begin()) {
+          const auto prevIt = std::prev(it);
+          if (prevIt->first + prevIt->second == offset) {
+            prevIt->second += it->second;
+            this->freeRanges.erase(it);
+          }
+        }
+      }
+
+      unsigned int RangeAllocator::getCapacity() const {
+        return this->capacity;
+      }
+
+      unsigned int RangeAllocator::getUsedSize() const {
+        return this->usedSize;
+      }
+
+      unsigned int RangeAllocator::getLargestFreeRange() const {
+        unsigned int largestRange = 0;
+        for (const auto& freeRange : this->freeRanges) {
+          largestRange = std::max(largestRange, freeRange.second);
+        }
+
+        return largestRange;
+      }
+
+      //Number of separate free ranges, useful to measure fragmentation
+      unsigned int RangeAllocator::getFreeRangeCount() const {
+        return this->freeRanges.size();
+      }
+
+      bool RangeAllocator::isEmpty() const {
+        return this->usedSize == 0;
+      }
+    }
+  }
+}
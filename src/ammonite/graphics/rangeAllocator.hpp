@@ -0,0 +1,38 @@
+#ifndef INTERNALRANGEALLOCATOR
+#define INTERNALRANGEALLOCATOR
+
+#include <map>
+
+#include "../visibility.hpp"
+
+namespace AMMONITE_INTERNAL ammonite {
+  namespace graphics {
+    namespace internal {
+      /*
+       - Track free and used ranges inside a fixed size block of storage
+         - Offsets and sizes are counted in elements, not bytes
+       - Only handles bookkeeping, the owner is responsible for the storage itself
+      */
+      class RangeAllocator {
+      private:
+        //Free ranges, sorted by offset to allow merging neighbours
+        std::map<unsigned int, unsigned int> freeRanges;
+        unsigned int capacity = 0;
+        unsigned int usedSize = 0;
+
+      public:
+        RangeAllocator(unsigned int capacity);
+        bool allocate(unsigned int size, unsigned int* offset);
+        void free(unsigned int offset, unsigned int size);
+
+        unsigned int getCapacity() const;
+        unsigned int getUsedSize() const;
+        unsigned int getLargestFreeRange() const;
+        unsigned int getFreeRangeCount() const;
+        bool isEmpty() const;
+      };
+    }
+  }
+}
+
+#endif
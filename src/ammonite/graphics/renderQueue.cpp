@@ -0,0 +1,176 @@
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "renderQueue.hpp"
+
+#include "../utils/thread.hpp"
+
+/*
+ - Build and sort queues of mesh draws, to group draws sharing GL state
+ - Sort keys pack the state most expensive to change into the highest bits
+ - Keys are sorted with an LSD radix sort, split across the thread pool for
+   large queues
+*/
+
+namespace ammonite {
+  namespace graphics {
+    namespace internal {
+      namespace {
+        //Bit widths of each sort key field, must add up to 64
+        constexpr unsigned int passBits = 2;
+        constexpr unsigned int drawModeBits = 2;
+        constexpr unsigned int shaderBits = 2;
+        constexpr unsigned int vertexArrayBits = 12;
+        constexpr unsigned int diffuseBits = 16;
+        constexpr unsigned int specularBits = 14;
+        constexpr unsigned int depthBits = 16;
+
+        //Radix sort digits, and the queue size needed to use the thread pool
+        constexpr unsigned int radixBits = 8;
+        constexpr unsigned int bucketCount = 1u << radixBits;
+        constexpr unsigned int digitCount = 64 / radixBits;
+        constexpr unsigned int minItemsPerJob = 16384;
+
+        //Keep the low bits of a field, then shift the key to make room for the next
+        void appendField(std::uint64_t* key, unsigned int value, unsigned int bits) {
+          const std::uint64_t mask = (std::uint64_t(1) << bits) - 1;
+          *key = (*key << bits) | (value & mask);
+        }
+
+        unsigned int getDigit(std::uint64_t key, unsigned int digit) {
+          return (unsigned int)(key >> (digit * radixBits)) & (bucketCount - 1);
+        }
+
+        //Per-job state for a single digit of the sort
+        struct SortJobData {
+          const RenderItem* source;
+          RenderItem* destination;
+          unsigned int firstItem;
+          unsigned int itemCount;
+          unsigned int digit;
+          unsigned int buckets[bucketCount];
+        };
+
+        void countDigitsJob(void* userPtr) {
+          SortJobData* const data = (SortJobData*)userPtr;
+          std::fill(&data->buckets[0], &data->buckets[bucketCount], 0);
+
+          const unsigned int endItem = data->firstItem + data->itemCount;
+          for (unsigned int i = data->firstItem; i < endItem; i++) {
+            data->buckets[getDigit(data->source[i].sortKey, data->digit)]++;
+          }
+        }
+
+        //Scatter items to their sorted positions, once buckets hold the write offsets
+        void scatterItemsJob(void* userPtr) {
+          SortJobData* const data = (SortJobData*)userPtr;
+
+          const unsigned int endItem = data->firstItem + data->itemCount;
+          for (unsigned int i = data->firstItem; i < endItem; i++) {
+            const unsigned int bucket = getDigit(data->source[i].sortKey, data->digit);
+            data->destination[data->buckets[bucket]++] = data->source[i];
+          }
+        }
+
+        //Run a job for every chunk, using the thread pool when there's more than one
+        void runSortJobs(AmmoniteWork work, std::vector<SortJobData>* jobData) {
+          const unsigned int jobCount = jobData->size();
+          if (jobCount == 1) {
+            work(jobData->data());
+            return;
+          }
+
+          AmmoniteGroup group{0};
+          ammonite::utils::thread::submitMultipleSync(work, jobData->data(),
+                                                      sizeof(SortJobData), &group, jobCount);
+          ammonite::utils::thread::waitGroupComplete(&group, jobCount);
+        }
+      }
+
+      std::uint64_t createSortKey(const SortKeyFields& fields) {
+        std::uint64_t key = 0;
+        appendField(&key, fields.pass, passBits);
+        appendField(&key, fields.drawMode, drawModeBits);
+        appendField(&key, fields.shader, shaderBits);
+        appendField(&key, fields.vertexArrayId, vertexArrayBits);
+        appendField(&key, fields.diffuseId, diffuseBits);
+        appendField(&key, fields.specularId, specularBits);
+
+        //Depth is expected in [0, 1], nearer draws sort first
+        const float maxDepth = (float)((1u << depthBits) - 1);
+        const float depth = std::clamp(fields.depth, 0.0f, 1.0f) * maxDepth;
+        appendField(&key, (unsigned int)depth, depthBits);
+
+        return key;
+      }
+
+      /*
+       - Stable sort of render items by their sort keys
+       - Digits shared by every key are skipped, which covers most of the key
+         for scenes with few distinct states
+      */
+      void sortRenderItems(std::vector<RenderItem>* renderItems) {
+        const unsigned int itemCount = renderItems->size();
+        if (itemCount < 2) {
+          return;
+        }
+
+        //Split the items into contiguous chunks, one per job
+        const unsigned int maxJobs = std::max(1u,
+          ammonite::utils::thread::getThreadPoolSize());
+        const unsigned int jobCount = std::clamp(itemCount / minItemsPerJob, 1u, maxJobs);
+        const unsigned int itemsPerJob = (itemCount + jobCount - 1) / jobCount;
+
+        static std::vector<RenderItem> scratchItems;
+        static std::vector<SortJobData> jobData;
+        scratchItems.resize(itemCount);
+        jobData.resize(jobCount);
+
+        RenderItem* source = renderItems->data();
+        RenderItem* destination = scratchItems.data();
+        for (unsigned int digit = 0; digit < digitCount; digit++) {
+          for (unsigned int job = 0; job < jobCount; job++) {
+            const unsigned int firstItem = std::min(job * itemsPerJob, itemCount);
+            jobData[job].source = source;
+            jobData[job].destination = destination;
+            jobData[job].firstItem = firstItem;
+            jobData[job].itemCount = std::min(itemsPerJob, itemCount - firstItem);
+            jobData[job].digit = digit;
+          }
+
+          runSortJobs(countDigitsJob, &jobData);
+
+          //Skip the digit if every item lands in the same bucket
+          const unsigned int firstBucket = getDigit(source[0].sortKey, digit);
+          unsigned int firstBucketSize = 0;
+          for (unsigned int job = 0; job < jobCount; job++) {
+            firstBucketSize += jobData[job].buckets[firstBucket];
+          }
+
+          if (firstBucketSize == itemCount) {
+            continue;
+          }
+
+          //Turn the counts into write offsets, ordered by bucket then by job
+          unsigned int offset = 0;
+          for (unsigned int bucket = 0; bucket < bucketCount; bucket++) {
+            for (unsigned int job = 0; job < jobCount; job++) {
+              const unsigned int count = jobData[job].buckets[bucket];
+              jobData[job].buckets[bucket] = offset;
+              offset += count;
+            }
+          }
+
+          runSortJobs(scatterItemsJob, &jobData);
+          std::swap(source, destination);
+        }
+
+        //Copy the result back if it finished in the scratch buffer
+        if (source != renderItems->data()) {
+          std::copy(source, source + itemCount, renderItems->data());
+        }
+      }
+    }
+  }
+}
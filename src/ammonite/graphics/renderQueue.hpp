@@ -0,0 +1,39 @@
+#ifndef INTERNALRENDERQUEUE
+#define INTERNALRENDERQUEUE
+
+#include <cstdint>
+#include <vector>
+
+#include "../visibility.hpp"
+
+namespace AMMONITE_INTERNAL ammonite {
+  namespace graphics {
+    namespace internal {
+      //Draw of a single mesh, ordered by its sort key
+      struct RenderItem {
+        std::uint64_t sortKey;
+        unsigned int modelIndex;
+        unsigned int meshIndex;
+      };
+
+      /*
+       - Fields of a sort key, from most to least significant
+       - Each field is truncated to fit its bits, which only affects the order
+      */
+      struct SortKeyFields {
+        unsigned int pass;
+        unsigned int drawMode;
+        unsigned int shader;
+        unsigned int vertexArrayId;
+        unsigned int diffuseId;
+        unsigned int specularId;
+        float depth;
+      };
+
+      std::uint64_t createSortKey(const SortKeyFields& fields);
+      void sortRenderItems(std::vector<RenderItem>* renderItems);
+    }
+  }
+}
+
+#endif
@@ -77,6 +77,11 @@ namespace ammonite {
       return frameTime;
     }
 
+    //Number of GL state changes made while drawing the last frame's models
+    unsigned int getFrameStateChanges() {
+      return internal::getLastFrameStateChanges();
+    }
+
     void drawFrame() {
       //Increase frame counters
       static int unsigned frameCount = 0;
@@ -33,6 +33,11 @@ namespace AMMONITE_INTERNAL ammonite {
       void prepareScreen(GLuint framebufferId, unsigned int width,
                          unsigned int height, bool depthTest);
       void setWireframe(bool enabled);
+      void bindVertexArray(GLuint vertexArrayId);
+      void bindTextureUnit(GLuint unit, GLuint textureId);
+      void resetStateCache();
+      void finishStateChangeFrame();
+      unsigned int getLastFrameStateChanges();
     }
   }
 }
@@ -1,4 +1,6 @@
 #include <algorithm>
+#include <bit>
+#include <cmath>
 #include <iostream>
 #include <string>
 #include <utility>
@@ -10,9 +12,25 @@ extern "C" {
 
 #include "renderer.hpp"
 
+#include "buffers.hpp"
+#include "culling.hpp"
+#include "dynamicResolution.hpp"
 #include "extensions.hpp"
+#include "frameData.hpp"
+#include "frameGraph.hpp"
+#include "indirect.hpp"
+#include "lightClusters.hpp"
+#include "materials.hpp"
+#include "postTargets.hpp"
+#include "renderQueue.hpp"
+#include "shadowAtlas.hpp"
+#include "shadowInstances.hpp"
 #include "shaderLoader.hpp"
 #include "shaders.hpp"
+#include "textureCompression.hpp"
+#include "textureStreaming.hpp"
+#include "textures.hpp"
+#include "uploadRing.hpp"
 #include "../camera/camera.hpp"
 #include "../lighting/lighting.hpp"
 #include "../maths/matrix.hpp"
@@ -34,10 +52,20 @@ namespace ammonite {
     namespace {
       //Structures to store uniform IDs for the shaders
       internal::ModelShader modelShader;
+      internal::IndirectModelShader indirectModelShader;
       internal::LightShader lightShader;
       internal::DepthShader depthShader;
+      internal::IndirectDepthShader indirectDepthShader;
+      internal::DepthShader layeredDepthShader;
+      internal::IndirectDepthShader layeredIndirectDepthShader;
+      internal::PrepassShader prepassShader;
+      internal::PrepassShader alphaPrepassShader;
+      internal::IndirectPrepassShader indirectPrepassShader;
+      internal::IndirectPrepassShader indirectAlphaPrepassShader;
       internal::SkyboxShader skyboxShader;
       internal::ScreenShader screenShader;
+      internal::CircleOfConfusionShader circleOfConfusionShader;
+      internal::BlurShader blurShader;
       internal::SplashShader splashShader;
 
       struct {
@@ -45,6 +73,11 @@ namespace ammonite {
         GLuint skyboxElement;
         GLuint screenQuad;
         GLuint screenQuadElement;
+        GLuint frameData;
+        GLuint shadowTiles;
+        GLuint shadowInstances;
+        GLuint lightClusters;
+        GLuint clusterLightIndices;
       } bufferIds;
 
       GLuint skyboxVertexArrayId;
@@ -53,6 +86,15 @@ namespace ammonite {
       GLuint depthCubeMapId = 0;
       GLuint depthMapFBO;
 
+      //Shadows of static models only, copied into the depth cubemap before dynamic models are drawn
+      GLuint staticDepthCubeMapId = 0;
+      GLuint staticDepthMapFBO;
+
+      //Shadow atlases, replacing the depth cubemaps when enabled, with a tile for each light's faces
+      GLuint shadowAtlasId = 0;
+      GLuint staticShadowAtlasId = 0;
+      graphics::internal::ShadowAtlasAllocator shadowAtlas(0, 0);
+
       GLuint screenQuadTextureId = 0;
       GLuint screenQuadDepthTextureId = 0;
       GLuint screenQuadFBO;
@@ -67,16 +109,72 @@ namespace ammonite {
       ammonite::models::internal::ModelInfo** modelPtrs = nullptr;
       ammonite::models::internal::ModelInfo** lightModelPtrs = nullptr;
 
+      /*
+       - Light positions the shadows were last drawn from
+       - In atlas mode, also the tile of each face and the tile size last asked for
+      */
+      struct ShadowState {
+        ammonite::Vec<float, 3> lightPosition = {0};
+        graphics::internal::ShadowTile faceTiles[6] = {};
+        unsigned int tileSize = 0;
+        unsigned int requestedTileSize = 0;
+      };
+      std::vector<ShadowState> shadowStates;
+
+      //Viewer position and range, used to order queued draws front to back
+      ammonite::Vec<float, 3> queueViewOrigin = {0};
+      float queueViewRange = 1.0f;
+
       unsigned int maxLightCount = 0;
       GLint maxSampleCount = 0;
+      bool isIndirectSupported = false;
+      bool isClearTextureSupported = false;
+      bool isLayeredShadowSupported = false;
+      bool isCopyImageSupported = false;
+      bool isDepthPrepassSupported = false;
+      bool isViewportArraySupported = false;
+      GLint maxTextureSize = 0;
+
+      //Shadow storage and shaders used by the current frame
+      bool useShadowAtlas = false;
+      bool useLayeredShadows = false;
+
+      //Depth shaders used by the current frame, layered instead of geometry shaders when supported
+      internal::DepthShader* activeDepthShader = &depthShader;
+      internal::IndirectDepthShader* activeIndirectDepthShader = &indirectDepthShader;
+
+      //Fraction of the render targets drawn to this frame, for post-processing to sample
+      ammonite::Vec<float, 2> renderScale = {1.0f, 1.0f};
+
+      //Distance between depth of field blur taps, for a circle of confusion of 1
+      constexpr float blurStepSize = 1.0f / 150.0f;
+      ammonite::Vec<float, 2> horizontalBlurStep = {blurStepSize, 0.0f};
+      ammonite::Vec<float, 2> verticalBlurStep = {0.0f, blurStepSize};
+
+      //Depth pre-pass shader in use, swapped for materials that need an alpha test
+      internal::PrepassShader* activePrepassShader = &prepassShader;
+
+      //Smallest shadow atlas tile, lights further away than this allows share its detail
+      constexpr unsigned int minShadowTileSize = 64;
+
+      //Distance multiplier used before shrinking tiles, so lights near a threshold don't flip sizes
+      constexpr float shadowTileHysteresis = 0.8f;
 
       //Render modes for drawModels()
       enum AmmoniteRenderMode : unsigned char {
         AMMONITE_RENDER_PASS,
         AMMONITE_DEPTH_PASS,
         AMMONITE_EMISSION_PASS,
+        AMMONITE_DEPTH_PREPASS,
         AMMONITE_DATA_REFRESH
       };
+
+      //How much of a light's shadow needs redrawing
+      enum AmmoniteShadowRedraw : unsigned char {
+        AMMONITE_SHADOW_CLEAN,
+        AMMONITE_SHADOW_DYNAMIC,
+        AMMONITE_SHADOW_ALL
+      };
     }
 
     namespace setup {
@@ -89,17 +187,68 @@ namespace ammonite {
           hasCreatedShaders &= depthShader.loadShader(shaderPath + "depth/");
           hasCreatedShaders &= skyboxShader.loadShader(shaderPath + "skybox/");
           hasCreatedShaders &= screenShader.loadShader(shaderPath + "screen/");
+          hasCreatedShaders &= circleOfConfusionShader.loadShader(shaderPath + "circleOfConfusion/");
+          hasCreatedShaders &= blurShader.loadShader(shaderPath + "blur/");
           hasCreatedShaders &= splashShader.loadShader(shaderPath + "splash/");
 
+          //Load multi-draw indirect shaders, fall back to regular drawing on failure
+          if (isIndirectSupported) {
+            isIndirectSupported = indirectModelShader.loadShader(shaderPath + "modelsIndirect/");
+            isIndirectSupported &= indirectDepthShader.loadShader(shaderPath + "depthIndirect/");
+            if (!isIndirectSupported) {
+              ammonite::utils::warning << "Failed to load indirect shaders, using regular drawing" \
+                                       << std::endl;
+            }
+          }
+
+          //Load shadow shaders that select the cubemap layer without a geometry shader
+          if (isLayeredShadowSupported) {
+            isLayeredShadowSupported = layeredDepthShader.loadShader(shaderPath + "depthLayered/");
+            if (isIndirectSupported) {
+              isLayeredShadowSupported &=
+                layeredIndirectDepthShader.loadShader(shaderPath + "depthLayeredIndirect/");
+            }
+
+            if (!isLayeredShadowSupported) {
+              ammonite::utils::warning << "Failed to load layered shadow shaders, using geometry shaders" \
+                                       << std::endl;
+            }
+          }
+
+          //Load depth pre-pass shaders, the pre-pass is disabled on failure
+          isDepthPrepassSupported = prepassShader.loadShader(shaderPath + "depthPrepass/");
+          isDepthPrepassSupported &= alphaPrepassShader.loadShader(shaderPath + "depthPrepassAlpha/");
+          if (isIndirectSupported) {
+            isDepthPrepassSupported &=
+              indirectPrepassShader.loadShader(shaderPath + "depthPrepassIndirect/");
+            isDepthPrepassSupported &=
+              indirectAlphaPrepassShader.loadShader(shaderPath + "depthPrepassAlphaIndirect/");
+          }
+
+          if (!isDepthPrepassSupported) {
+            ammonite::utils::warning << "Failed to load depth pre-pass shaders, disabling the pre-pass" \
+                                     << std::endl;
+          }
+
           return hasCreatedShaders;
         }
 
         void deleteShaders() {
           modelShader.destroyShader();
+          indirectModelShader.destroyShader();
           lightShader.destroyShader();
           depthShader.destroyShader();
+          indirectDepthShader.destroyShader();
+          layeredDepthShader.destroyShader();
+          layeredIndirectDepthShader.destroyShader();
+          prepassShader.destroyShader();
+          alphaPrepassShader.destroyShader();
+          indirectPrepassShader.destroyShader();
+          indirectAlphaPrepassShader.destroyShader();
           skyboxShader.destroyShader();
           screenShader.destroyShader();
+          circleOfConfusionShader.destroyShader();
+          blurShader.destroyShader();
           splashShader.destroyShader();
         }
 
@@ -137,9 +286,34 @@ namespace ammonite {
             (*failureCount)++;
           }
 
+          //Check for multi-draw indirect support, regular drawing is used otherwise
+          isIndirectSupported = graphics::internal::checkExtension("GL_ARB_multi_draw_indirect", 4, 3) &&
+            graphics::internal::checkExtension("GL_ARB_base_instance", 4, 2) &&
+            graphics::internal::checkExtension("GL_ARB_shader_draw_parameters");
+
+          //Check for partial texture clearing, used to only redraw changed shadows
+          isClearTextureSupported = graphics::internal::checkExtension("GL_ARB_clear_texture", 4, 4);
+
+          //Check for writing gl_Layer from vertex shaders, used to draw shadows without geometry shaders
+          isLayeredShadowSupported =
+            graphics::internal::checkExtension("GL_ARB_shader_viewport_layer_array") ||
+            graphics::internal::checkExtension("GL_AMD_vertex_shader_layer");
+
+          //Check for copying between textures, used to cache shadows of static models
+          isCopyImageSupported = graphics::internal::checkExtension("GL_ARB_copy_image", 4, 3);
+
+          //Check for multiple viewports, used to draw each cubemap face into a shadow atlas tile
+          isViewportArraySupported = graphics::internal::checkExtension("GL_ARB_viewport_array", 4, 1);
+
           //Check for shader caching support
           ammonite::shaders::internal::updateCacheSupport();
 
+          //Check for compressed texture formats, used to store textures loaded from files
+          ammonite::textures::internal::updateCompressionSupport();
+
+          //Check for bindless textures, used to sample materials without binding them
+          graphics::internal::updateBindlessSupport();
+
           return success;
         }
 
@@ -150,6 +324,25 @@ namespace ammonite {
           glUniform1i(modelShader.diffuseSamplerId, 0);
           glUniform1i(modelShader.specularSamplerId, 1);
           glUniform1i(modelShader.shadowCubeMapId, 2);
+          glUniform1i(modelShader.shadowAtlasSamplerId, 6);
+
+          if (isIndirectSupported) {
+            indirectModelShader.useShader();
+            glUniform1i(indirectModelShader.diffuseSamplerId, 0);
+            glUniform1i(indirectModelShader.specularSamplerId, 1);
+            glUniform1i(indirectModelShader.shadowCubeMapId, 2);
+            glUniform1i(indirectModelShader.shadowAtlasSamplerId, 6);
+          }
+
+          if (isDepthPrepassSupported) {
+            alphaPrepassShader.useShader();
+            glUniform1i(alphaPrepassShader.diffuseSamplerId, 0);
+
+            if (isIndirectSupported) {
+              indirectAlphaPrepassShader.useShader();
+              glUniform1i(indirectAlphaPrepassShader.diffuseSamplerId, 0);
+            }
+          }
 
           skyboxShader.useShader();
           glUniform1i(skyboxShader.skyboxSamplerId, 3);
@@ -157,12 +350,24 @@ namespace ammonite {
           screenShader.useShader();
           glUniform1i(screenShader.screenSamplerId, 4);
           glUniform1i(screenShader.depthSamplerId, 5);
+          glUniform1i(screenShader.blurSamplerId, 7);
+
+          circleOfConfusionShader.useShader();
+          glUniform1i(circleOfConfusionShader.screenSamplerId, 4);
+          glUniform1i(circleOfConfusionShader.depthSamplerId, 5);
+
+          blurShader.useShader();
+          glUniform1i(blurShader.sourceSamplerId, 7);
 
           //Setup depth map framebuffer
           glCreateFramebuffers(1, &depthMapFBO);
           glNamedFramebufferDrawBuffer(depthMapFBO, GL_NONE);
           glNamedFramebufferReadBuffer(depthMapFBO, GL_NONE);
 
+          glCreateFramebuffers(1, &staticDepthMapFBO);
+          glNamedFramebufferDrawBuffer(staticDepthMapFBO, GL_NONE);
+          glNamedFramebufferReadBuffer(staticDepthMapFBO, GL_NONE);
+
           //Create multisampled framebuffer and depthbuffer to draw to
           glCreateFramebuffers(1, &colourBufferMultisampleFBO);
           glCreateFramebuffers(1, &screenQuadFBO);
@@ -182,6 +387,9 @@ namespace ammonite {
           //Find multisampling limits
           glGetIntegerv(GL_MAX_SAMPLES, &maxSampleCount);
 
+          //Find the largest shadow atlas allowed
+          glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+
           //Get the max number of lights supported
           maxLightCount = ammonite::lighting::getMaxLightCount();
 
@@ -218,6 +426,27 @@ namespace ammonite {
             0, 2, 3
           };
 
+          //Create the per-frame constant buffer, shared by every shader
+          glCreateBuffers(1, &bufferIds.frameData);
+          glNamedBufferStorage(bufferIds.frameData, sizeof(graphics::internal::FrameData),
+                               nullptr, GL_DYNAMIC_STORAGE_BIT);
+          glBindBufferBase(GL_UNIFORM_BUFFER, 0, bufferIds.frameData);
+
+          //Create the shadow atlas tile buffer, filled when tiles are assigned
+          glCreateBuffers(1, &bufferIds.shadowTiles);
+
+          //Create the shadow instance buffer, filled before each layered shadow pass
+          glCreateBuffers(1, &bufferIds.shadowInstances);
+
+          //Create the light cluster buffers, the grid is fixed but the index list grows
+          glCreateBuffers(1, &bufferIds.lightClusters);
+          glNamedBufferStorage(bufferIds.lightClusters,
+                               graphics::internal::clusterCount *
+                               (GLsizeiptr)sizeof(graphics::internal::LightCluster),
+                               nullptr, GL_DYNAMIC_STORAGE_BIT);
+          glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, bufferIds.lightClusters);
+          glCreateBuffers(1, &bufferIds.clusterLightIndices);
+
           //Create vertex and element buffers for the skybox and screen quad
           glCreateBuffers(1, &bufferIds.skybox);
           glCreateBuffers(1, &bufferIds.skyboxElement);
@@ -252,6 +481,7 @@ namespace ammonite {
 
         void destroyOpenGLObjects() {
           glDeleteFramebuffers(1, &depthMapFBO);
+          glDeleteFramebuffers(1, &staticDepthMapFBO);
           glDeleteFramebuffers(1, &colourBufferMultisampleFBO);
           glDeleteFramebuffers(1, &screenQuadFBO);
           glDeleteRenderbuffers(1, &depthRenderBufferId);
@@ -260,10 +490,19 @@ namespace ammonite {
           glDeleteBuffers(1, &bufferIds.skyboxElement);
           glDeleteBuffers(1, &bufferIds.screenQuad);
           glDeleteBuffers(1, &bufferIds.screenQuadElement);
+          glDeleteBuffers(1, &bufferIds.frameData);
+          glDeleteBuffers(1, &bufferIds.shadowTiles);
+          glDeleteBuffers(1, &bufferIds.shadowInstances);
+          glDeleteBuffers(1, &bufferIds.lightClusters);
+          glDeleteBuffers(1, &bufferIds.clusterLightIndices);
 
           glDeleteVertexArrays(1, &skyboxVertexArrayId);
           glDeleteVertexArrays(1, &screenQuadVertexArrayId);
 
+          graphics::internal::deletePostTargets();
+          graphics::internal::deleteGpuFrameTimers();
+          graphics::internal::deleteUploadRing();
+
           if (screenQuadTextureId != 0) {
             glDeleteTextures(1, &screenQuadTextureId);
             glDeleteTextures(1, &screenQuadDepthTextureId);
@@ -276,6 +515,23 @@ namespace ammonite {
           if (depthCubeMapId != 0) {
             glDeleteTextures(1, &depthCubeMapId);
           }
+
+          if (staticDepthCubeMapId != 0) {
+            glDeleteTextures(1, &staticDepthCubeMapId);
+          }
+
+          if (shadowAtlasId != 0) {
+            glDeleteTextures(1, &shadowAtlasId);
+          }
+
+          if (staticShadowAtlasId != 0) {
+            glDeleteTextures(1, &staticShadowAtlasId);
+          }
+
+          graphics::internal::deleteIndirectBuffers();
+          graphics::internal::deleteMaterialBuffer();
+          textures::internal::deleteAsyncTextures();
+          graphics::internal::deleteMeshBufferPools();
         }
 
         void deleteModelCache() {
@@ -373,114 +629,229 @@ namespace ammonite {
         }
       }
 
-      //Create, configure and bind depth cubemap for shadows
-      void setupDepthMap(unsigned int lightCount, unsigned int shadowRes) {
-        //Delete the cubemap array if it already exists
-        if (depthCubeMapId != 0) {
-          glDeleteTextures(1, &depthCubeMapId);
+      //Delete a shadow texture, if it exists
+      void deleteShadowTexture(GLuint* textureId) {
+        if (*textureId != 0) {
+          glDeleteTextures(1, textureId);
+          *textureId = 0;
+        }
+      }
+
+      /*
+       - Create a depth texture for shadows, and attach it to a framebuffer
+       - Cubemap arrays use depthLayers layers, 2D textures ignore it
+      */
+      void createShadowTexture(GLuint* textureId, GLuint framebufferId, GLenum target,
+                               GLsizei depthLayers, unsigned int shadowRes) {
+        //Delete the texture if it already exists
+        deleteShadowTexture(textureId);
+
+        //Create the texture for shadows
+        glCreateTextures(target, 1, textureId);
+        if (target == GL_TEXTURE_CUBE_MAP_ARRAY) {
+          glTextureStorage3D(*textureId, 1, GL_DEPTH_COMPONENT32, (GLsizei)shadowRes,
+                             (GLsizei)shadowRes, depthLayers);
+        } else {
+          glTextureStorage2D(*textureId, 1, GL_DEPTH_COMPONENT32, (GLsizei)shadowRes,
+                             (GLsizei)shadowRes);
+        }
+
+        //Set depth texture parameters
+        glTextureParameteri(*textureId, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTextureParameteri(*textureId, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTextureParameteri(*textureId, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTextureParameteri(*textureId, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+        glTextureParameteri(*textureId, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTextureParameteri(*textureId, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTextureParameteri(*textureId, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+        //Attach the texture to the framebuffer
+        glNamedFramebufferTexture(framebufferId, GL_DEPTH_ATTACHMENT, *textureId, 0);
+      }
+
+      /*
+       - Create depth cubemaps for shadows, with 6 faces for each light source
+         - In atlas mode, create a single atlas instead, and reset its tiles
+       - The static model cache is only created when it'll be used
+      */
+      void setupDepthMap(unsigned int lightCount, unsigned int shadowRes, bool useStaticCache,
+                         unsigned int shadowAtlasRes) {
+        //Every light needs new tiles after any change
+        shadowAtlas = graphics::internal::ShadowAtlasAllocator(
+          useShadowAtlas ? shadowAtlasRes : 0, minShadowTileSize);
+        for (ShadowState& shadowState : shadowStates) {
+          shadowState.tileSize = 0;
+          shadowState.requestedTileSize = 0;
+        }
+
+        if (useShadowAtlas) {
+          deleteShadowTexture(&depthCubeMapId);
+          deleteShadowTexture(&staticDepthCubeMapId);
+
+          createShadowTexture(&shadowAtlasId, depthMapFBO, GL_TEXTURE_2D, 1, shadowAtlasRes);
+          if (useStaticCache) {
+            createShadowTexture(&staticShadowAtlasId, staticDepthMapFBO, GL_TEXTURE_2D, 1,
+                                shadowAtlasRes);
+          } else {
+            deleteShadowTexture(&staticShadowAtlasId);
+          }
+
+          return;
         }
 
-        //Create a cubemap for shadows
-        glCreateTextures(GL_TEXTURE_CUBE_MAP_ARRAY, 1, &depthCubeMapId);
+        deleteShadowTexture(&shadowAtlasId);
+        deleteShadowTexture(&staticShadowAtlasId);
 
         //Workaround for no lights causing a depth of 0
         if (lightCount == 0) {
           lightCount = 1;
         }
 
-        //Create 6 faces for each light source
         const GLsizei depthLayers = (GLsizei)std::min(maxLightCount, lightCount) * 6;
-        glTextureStorage3D(depthCubeMapId, 1, GL_DEPTH_COMPONENT32, (GLsizei)shadowRes,
-                           (GLsizei)shadowRes, depthLayers);
+        createShadowTexture(&depthCubeMapId, depthMapFBO, GL_TEXTURE_CUBE_MAP_ARRAY,
+                            depthLayers, shadowRes);
 
-        //Set depth texture parameters
-        glTextureParameteri(depthCubeMapId, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTextureParameteri(depthCubeMapId, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTextureParameteri(depthCubeMapId, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
-        glTextureParameteri(depthCubeMapId, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
-        glTextureParameteri(depthCubeMapId, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTextureParameteri(depthCubeMapId, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTextureParameteri(depthCubeMapId, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-        //Attach cubemap array to framebuffer
-        glNamedFramebufferTexture(depthMapFBO, GL_DEPTH_ATTACHMENT, depthCubeMapId, 0);
+        if (useStaticCache) {
+          createShadowTexture(&staticDepthCubeMapId, staticDepthMapFBO, GL_TEXTURE_CUBE_MAP_ARRAY,
+                              depthLayers, shadowRes);
+        } else {
+          deleteShadowTexture(&staticDepthCubeMapId);
+        }
       }
 
       /*
        - Helper functions to draw / wrap components
       */
-      void drawModel(ammonite::models::internal::ModelInfo* drawObjectInfo,
-                            AmmoniteRenderMode renderMode) {
-        //Get model draw data
-        ammonite::models::internal::ModelData* const drawObjectData = drawObjectInfo->modelData;
 
-        //Set the requested draw mode (normal, wireframe, points)
+      //Apply a model's draw mode, returning the primitive type to draw with
+      GLenum applyDrawMode(AmmoniteDrawEnum drawMode) {
         GLenum mode = GL_TRIANGLES;
-        if (drawObjectInfo->drawMode == AMMONITE_DRAW_WIREFRAME) {
+        if (drawMode == AMMONITE_DRAW_WIREFRAME) {
           //Use wireframe if requested
           internal::setWireframe(true);
         } else {
           //Draw points if requested
-          if (drawObjectInfo->drawMode == AMMONITE_DRAW_POINTS) {
+          if (drawMode == AMMONITE_DRAW_POINTS) {
             mode = GL_POINTS;
           }
           internal::setWireframe(false);
         }
 
-        //Handle pass-specific matrices and uniforms
-        ammonite::Mat<float, 4> mvp = {{0}};
-        ammonite::Mat<float, 4> vp = {{0}};
+        return mode;
+      }
+
+      //Set the per-model uniforms for a pass
+      void applyModelUniforms(const ammonite::models::internal::ModelInfo* drawObjectInfo,
+                              AmmoniteRenderMode renderMode) {
+        //Handle pass-specific matrices and uniforms, view and projection are per-frame
         switch (renderMode) {
         case AMMONITE_DEPTH_PASS:
-          glUniformMatrix4fv(depthShader.modelMatrixId, 1, GL_FALSE,
+          glUniformMatrix4fv(activeDepthShader->modelMatrixId, 1, GL_FALSE,
                              &drawObjectInfo->positionData.modelMatrix[0][0]);
           break;
         case AMMONITE_RENDER_PASS:
-          //Calculate model view projection matrix
-          ammonite::multiply(*projectionMatrixPtr, *viewMatrixPtr, vp);
-          ammonite::multiply(vp, drawObjectInfo->positionData.modelMatrix, mvp);
-
-          glUniformMatrix4fv(modelShader.matrixId, 1, GL_FALSE, &mvp[0][0]);
           glUniformMatrix4fv(modelShader.modelMatrixId, 1, GL_FALSE,
                              &drawObjectInfo->positionData.modelMatrix[0][0]);
           glUniformMatrix3fv(modelShader.normalMatrixId, 1, GL_FALSE,
                              &drawObjectInfo->positionData.normalMatrix[0][0]);
           break;
         case AMMONITE_EMISSION_PASS:
-          //Calculate model view projection matrix
-          ammonite::multiply(*projectionMatrixPtr, *viewMatrixPtr, vp);
-          ammonite::multiply(vp, drawObjectInfo->positionData.modelMatrix, mvp);
-
-          glUniformMatrix4fv(lightShader.lightMatrixId, 1, GL_FALSE, &mvp[0][0]);
+          glUniformMatrix4fv(lightShader.modelMatrixId, 1, GL_FALSE,
+                             &drawObjectInfo->positionData.modelMatrix[0][0]);
           glUniform1ui(lightShader.lightIndexId, drawObjectInfo->lightIndex);
           break;
+        case AMMONITE_DEPTH_PREPASS:
+          glUniformMatrix4fv(activePrepassShader->modelMatrixId, 1, GL_FALSE,
+                             &drawObjectInfo->positionData.modelMatrix[0][0]);
+          break;
         case AMMONITE_DATA_REFRESH:
           //How did we get here?
-          ammonite::utils::error << "drawModel() called with AMMONITE_DATA_REFRESH" << std::endl;
+          ammonite::utils::error << "applyModelUniforms() called with AMMONITE_DATA_REFRESH" << std::endl;
           std::unreachable();
           break;
         }
+      }
+
+      /*
+       - Draw the triangles of a mesh, from its section of the shared buffers
+       - Layered shadows draw an instance for each cubemap face of each light
+       - Empty meshes have no vertex array, so they're skipped
+      */
+      void drawMesh(const ammonite::models::internal::MeshInfoGroup& meshInfo, GLenum mode,
+                    unsigned int instanceCount) {
+        if (meshInfo.vertexArrayId == 0) {
+          return;
+        }
 
-        for (unsigned int i = 0; i < drawObjectData->meshInfo.size(); i++) {
-          //Set texture for regular shading pass
-          if (renderMode == AMMONITE_RENDER_PASS) {
-            if (drawObjectInfo->textureIds[i].diffuseId != 0) {
-              glBindTextureUnit(0, drawObjectInfo->textureIds[i].diffuseId);
+        internal::bindVertexArray(meshInfo.vertexArrayId);
+
+        const GLintptr indexOffset = meshInfo.firstIndex * (GLintptr)sizeof(unsigned int);
+        //NOLINTNEXTLINE(performance-no-int-to-ptr)
+        glDrawElementsInstancedBaseVertex(mode, (GLsizei)meshInfo.indexCount, GL_UNSIGNED_INT,
+                                          (const void*)indexOffset, (GLsizei)instanceCount,
+                                          meshInfo.baseVertex);
+      }
+
+      /*
+       - Draw every active regular model using multi-draw indirect
+       - Commands and per-draw data must already be up to date
+      */
+      void drawModelsIndirect(AmmoniteRenderMode renderMode) {
+        const bool isDepthPass = (renderMode == AMMONITE_DEPTH_PASS);
+        const std::vector<graphics::internal::IndirectBatch>& batches = isDepthPass ?
+          graphics::internal::getIndirectDepthBatches() :
+          graphics::internal::getIndirectBatches();
+        const GLint drawOffsetId = isDepthPass ? activeIndirectDepthShader->drawOffsetId :
+                                                 indirectModelShader.drawOffsetId;
+
+        internal::resetStateCache();
+        graphics::internal::bindIndirectBuffers();
+        for (const graphics::internal::IndirectBatch& batch : batches) {
+          const GLenum mode = applyDrawMode(batch.drawMode);
+
+          //Set textures for regular shading pass, unless the materials are bindless
+          if (!isDepthPass) {
+            if (batch.diffuseId != 0) {
+              internal::bindTextureUnit(0, batch.diffuseId);
             }
 
-            if (drawObjectInfo->textureIds[i].specularId != 0) {
-              glBindTextureUnit(1, drawObjectInfo->textureIds[i].specularId);
-            } else {
-              glBindTextureUnit(1, 0);
+            if (batch.specularId != 0) {
+              internal::bindTextureUnit(1, batch.specularId);
             }
           }
 
-          //Bind vertex attribute buffer
-          glBindVertexArray(drawObjectData->meshInfo[i].vertexArrayId);
+          glUniform1ui(drawOffsetId, batch.firstCommand);
+          graphics::internal::drawIndirectBatch(batch, mode);
+        }
+      }
+
+      /*
+       - Draw the depth of every indirect batch, opaque batches first
+       - Batches with transparent textures use the alpha tested shader, which needs the
+         texture bound, unless the materials are bindless
+      */
+      void drawPrepassIndirect() {
+        internal::resetStateCache();
+        graphics::internal::bindIndirectBuffers();
+        for (const bool isAlphaPass : {false, true}) {
+          const internal::IndirectPrepassShader& shader = isAlphaPass ?
+            indirectAlphaPrepassShader : indirectPrepassShader;
+          shader.useShader();
+
+          for (const graphics::internal::IndirectBatch& batch :
+               graphics::internal::getIndirectBatches()) {
+            if (batch.isAlphaTested != isAlphaPass) {
+              continue;
+            }
 
-          //Draw the triangles
-          glDrawElements(mode, (GLsizei)drawObjectData->meshInfo[i].indexCount,
-                         GL_UNSIGNED_INT, nullptr);
+            const GLenum mode = applyDrawMode(batch.drawMode);
+            if (isAlphaPass && batch.diffuseId != 0) {
+              internal::bindTextureUnit(0, batch.diffuseId);
+            }
+
+            glUniform1ui(shader.drawOffsetId, batch.firstCommand);
+            graphics::internal::drawIndirectBatch(batch, mode);
+          }
         }
       }
     }
@@ -489,6 +860,7 @@ namespace ammonite {
       /*
        - Draw models of a given type, from a cache
        - Update the cache when given AMMONITE_DATA_REFRESH or a pointer to a null pointer
+       - Draws are sorted by state, then front to back from queueViewOrigin
       */
       void drawModelsCached(ammonite::models::internal::ModelInfo*** modelPtrsPtr,
                             ModelTypeEnum modelType, AmmoniteRenderMode renderMode) {
@@ -509,25 +881,662 @@ namespace ammonite {
           }
         }
 
-        //Draw the model pointers
+        /*
+         - Queue every mesh of the models, skipping regular models culled by the last query
+         - Layered shadows skip models without shadow instances instead, since every
+           light is drawn at once
+        */
+        static std::vector<graphics::internal::RenderItem> renderItems;
+        renderItems.clear();
+        const bool isDepthPass = (renderMode == AMMONITE_DEPTH_PASS);
+        const bool useShadowInstances = isDepthPass && useLayeredShadows;
+        const std::vector<graphics::internal::ShadowInstanceRun>& instanceRuns =
+          graphics::internal::getShadowInstanceRuns();
         for (unsigned int i = 0; i < modelCount; i++) {
-          drawModel((*modelPtrsPtr)[i], renderMode);
+          if (modelType == AMMONITE_MODEL) {
+            const bool isVisible = useShadowInstances ? (instanceRuns[i].instanceCount != 0) :
+              graphics::internal::isModelVisible(i);
+            if (!isVisible) {
+              continue;
+            }
+          }
+
+          //Find the model's depth from the viewer, as a fraction of the view's range
+          const ammonite::models::internal::ModelInfo* const modelPtr = (*modelPtrsPtr)[i];
+          const ammonite::models::internal::BoundingBox& bounds = modelPtr->worldBounds;
+          ammonite::Vec<float, 3> centre = {0};
+          ammonite::add(bounds.minimum, bounds.maximum, centre);
+          ammonite::scale(centre, 0.5f);
+          const float depth = ammonite::distance(centre, queueViewOrigin) / queueViewRange;
+
+          const std::vector<ammonite::models::internal::MeshInfoGroup>& meshInfo =
+            modelPtr->modelData->meshInfo;
+          for (unsigned int meshIndex = 0; meshIndex < meshInfo.size(); meshIndex++) {
+            //The pre-pass groups alpha tested meshes separately, and binds their texture
+            const ammonite::models::internal::TextureIdGroup& textureIds =
+              modelPtr->textureIds[meshIndex];
+            unsigned int shader = modelType;
+            bool useTextures = (renderMode == AMMONITE_RENDER_PASS);
+            if (renderMode == AMMONITE_DEPTH_PREPASS) {
+              const bool isAlphaTested =
+                textures::internal::isTextureTransparent(textureIds.diffuseId);
+              shader = isAlphaTested ? 1 : 0;
+              useTextures = isAlphaTested;
+            }
+
+            //Bindless materials never bind textures, so they can skip sorting by them
+            if (modelType == AMMONITE_MODEL &&
+                graphics::internal::isMaterialBindless(textureIds.materialIndex)) {
+              useTextures = false;
+            }
+
+            //Textures are only bound for the regular shading pass and alpha tests
+            const graphics::internal::SortKeyFields keyFields = {
+              .pass = renderMode,
+              .drawMode = modelPtr->drawMode,
+              .shader = shader,
+              .vertexArrayId = meshInfo[meshIndex].vertexArrayId,
+              .diffuseId = useTextures ? textureIds.diffuseId : 0,
+              .specularId = useTextures ? textureIds.specularId : 0,
+              .depth = depth
+            };
+
+            renderItems.push_back({
+              .sortKey = graphics::internal::createSortKey(keyFields),
+              .modelIndex = i,
+              .meshIndex = meshIndex
+            });
+          }
+        }
+
+        graphics::internal::sortRenderItems(&renderItems);
+
+        //Draw the queue, only changing state when the next draw needs it
+        internal::resetStateCache();
+        const ammonite::models::internal::ModelInfo* lastModelPtr = nullptr;
+        GLenum mode = GL_TRIANGLES;
+        unsigned int instanceCount = 1;
+        for (const graphics::internal::RenderItem& renderItem : renderItems) {
+          const ammonite::models::internal::ModelInfo* const modelPtr =
+            (*modelPtrsPtr)[renderItem.modelIndex];
+
+          //Swap to the alpha tested pre-pass shader when the queue reaches transparent materials
+          const ammonite::models::internal::TextureIdGroup& textureIds =
+            modelPtr->textureIds[renderItem.meshIndex];
+          const bool isBindless = (modelType == AMMONITE_MODEL) &&
+            graphics::internal::isMaterialBindless(textureIds.materialIndex);
+          if (renderMode == AMMONITE_DEPTH_PREPASS) {
+            const bool isAlphaTested =
+              textures::internal::isTextureTransparent(textureIds.diffuseId);
+            internal::PrepassShader* const prepassShaderPtr = isAlphaTested ?
+              &alphaPrepassShader : &prepassShader;
+            if (prepassShaderPtr != activePrepassShader) {
+              activePrepassShader = prepassShaderPtr;
+              activePrepassShader->useShader();
+
+              //The new shader needs its uniforms set again
+              lastModelPtr = nullptr;
+            }
+
+            if (isAlphaTested) {
+              glUniform1ui(activePrepassShader->materialIndexId, textureIds.materialIndex);
+              if (!isBindless) {
+                internal::bindTextureUnit(0, textureIds.diffuseId);
+              }
+            }
+          }
+
+          //Set the model's uniforms and draw mode, unless they're already set
+          if (modelPtr != lastModelPtr) {
+            applyModelUniforms(modelPtr, renderMode);
+            mode = applyDrawMode(modelPtr->drawMode);
+
+            /*
+             - Limit depth passes to the cubemap faces the model may appear on
+             - Layered shadows draw each light's faces as instances, instead of in a
+               geometry shader
+            */
+            if (useShadowInstances) {
+              const graphics::internal::ShadowInstanceRun& instanceRun =
+                instanceRuns[renderItem.modelIndex];
+              glUniform1ui(activeDepthShader->instanceOffsetId, instanceRun.firstInstance);
+              instanceCount = instanceRun.instanceCount;
+            } else if (isDepthPass) {
+              glUniform1ui(activeDepthShader->faceMaskId,
+                           graphics::internal::getModelFaceMask(renderItem.modelIndex));
+            }
+
+            lastModelPtr = modelPtr;
+          }
+
+          //Set the material for regular shading pass, binding its textures unless bindless
+          if (renderMode == AMMONITE_RENDER_PASS) {
+            glUniform1ui(modelShader.materialIndexId, textureIds.materialIndex);
+            if (!isBindless) {
+              if (textureIds.diffuseId != 0) {
+                internal::bindTextureUnit(0, textureIds.diffuseId);
+              }
+
+              if (textureIds.specularId != 0) {
+                internal::bindTextureUnit(1, textureIds.specularId);
+              }
+            }
+          }
+
+          drawMesh(modelPtr->modelData->meshInfo[renderItem.meshIndex], mode, instanceCount);
         }
       }
 
-      void drawSkybox(AmmoniteId activeSkyboxId) {
-        //Swap to skybox shader and pass uniforms
-        skyboxShader.useShader();
+      //Check if any part of a box is within range of a point
+      bool isBoundsInRange(const models::internal::BoundingBox& bounds,
+                           const ammonite::Vec<float, 3>& point, float range) {
+        float distanceSquared = 0.0f;
+        for (unsigned int axis = 0; axis < 3; axis++) {
+          const float closest = std::clamp(point[axis], bounds.minimum[axis],
+                                           bounds.maximum[axis]);
+          distanceSquared += (closest - point[axis]) * (closest - point[axis]);
+        }
+
+        return distanceSquared <= range * range;
+      }
+
+      //Check if any of a set of boxes is within range of a point
+      bool isAnyBoundsInRange(const std::vector<models::internal::BoundingBox>& boundsVec,
+                              const ammonite::Vec<float, 3>& point, float range) {
+        for (const models::internal::BoundingBox& bounds : boundsVec) {
+          if (isBoundsInRange(bounds, point, range)) {
+            return true;
+          }
+        }
+
+        return false;
+      }
+
+      /*
+       - Decide which lights need their shadows redrawn, filling redrawLights
+       - Lights are redrawn when they move, or when a model enters or leaves their range
+         - With the static cache, changes to only dynamic models keep the cached
+           static shadow, and only redraw the dynamic models
+       - Returns true if every light needs redrawing, either because redrawAll was
+         set or because the changes can't be tracked
+      */
+      bool findChangedShadows(unsigned int activeLights, float shadowFarPlane, bool redrawAll,
+                              bool useStaticCache,
+                              std::vector<AmmoniteShadowRedraw>* redrawLights) {
+        //Models that stopped moving become static, and need adding to the static cache
+        models::internal::settleDynamicModels();
+
+        //Partial redraws need to clear individual cubemaps
+        const std::vector<models::internal::BoundingBox>* const changedBoundsPtr =
+          models::internal::getChangedBounds();
+        const std::vector<models::internal::BoundingBox>* const changedStaticBoundsPtr =
+          models::internal::getChangedStaticBounds();
+        if (changedBoundsPtr == nullptr || !isClearTextureSupported) {
+          redrawAll = true;
+        }
+
+        shadowStates.resize(activeLights);
+        redrawLights->assign(activeLights, redrawAll ? AMMONITE_SHADOW_ALL : AMMONITE_SHADOW_CLEAN);
+        for (unsigned int i = 0; i < activeLights; i++) {
+          ammonite::Vec<float, 3> lightPosition = {0};
+          lighting::internal::getPackedLightPosition(i, lightPosition);
+
+          //Redraw lights that moved
+          if (!ammonite::equal(lightPosition, shadowStates[i].lightPosition)) {
+            ammonite::copy(lightPosition, shadowStates[i].lightPosition);
+            (*redrawLights)[i] = AMMONITE_SHADOW_ALL;
+          }
+
+          //Redraw lights with models moving through their range
+          if ((*redrawLights)[i] != AMMONITE_SHADOW_CLEAN) {
+            continue;
+          }
+
+          if (isAnyBoundsInRange(*changedStaticBoundsPtr, lightPosition, shadowFarPlane)) {
+            (*redrawLights)[i] = AMMONITE_SHADOW_ALL;
+          } else if (isAnyBoundsInRange(*changedBoundsPtr, lightPosition, shadowFarPlane)) {
+            (*redrawLights)[i] = useStaticCache ? AMMONITE_SHADOW_DYNAMIC : AMMONITE_SHADOW_ALL;
+          }
+        }
+
+        models::internal::resetChangedBounds();
+        return redrawAll;
+      }
+
+      /*
+       - Pick a shadow atlas tile size for a light, from its distance to the camera
+       - Tiles halve in size each time the distance doubles past the shadow range
+       - Lights that can't cast shadows into the view get the smallest tiles
+      */
+      unsigned int calculateShadowTileSize(const ammonite::Vec<float, 3>& lightPosition,
+                                           const ammonite::Vec<float, 3>& cameraPosition,
+                                           const ammonite::Vec<float, 4> frustumPlanes[6],
+                                           float shadowFarPlane, float distanceScale,
+                                           unsigned int shadowRes) {
+        //Check the light's range against each frustum plane
+        for (unsigned int i = 0; i < 6; i++) {
+          const ammonite::Vec<float, 4>& plane = frustumPlanes[i];
+          const float planeLength = std::sqrt((plane[0] * plane[0]) + (plane[1] * plane[1]) +
+                                              (plane[2] * plane[2]));
+          const float planeDistance = (plane[0] * lightPosition[0]) +
+            (plane[1] * lightPosition[1]) + (plane[2] * lightPosition[2]) + plane[3];
+          if (planeDistance < -shadowFarPlane * planeLength) {
+            return minShadowTileSize;
+          }
+        }
+
+        const float lightDistance = ammonite::distance(lightPosition, cameraPosition) *
+          distanceScale;
+        unsigned int tileSize = shadowRes;
+        float tileRange = shadowFarPlane;
+        while (lightDistance > tileRange && tileSize > minShadowTileSize) {
+          tileSize /= 2;
+          tileRange *= 2.0f;
+        }
+
+        return std::max(tileSize, minShadowTileSize);
+      }
+
+      //Return a light's tiles to the shadow atlas
+      void releaseShadowTiles(ShadowState* shadowState) {
+        if (shadowState->tileSize == 0) {
+          return;
+        }
+
+        for (const graphics::internal::ShadowTile& tile : shadowState->faceTiles) {
+          shadowAtlas.free(tile);
+        }
+
+        shadowState->tileSize = 0;
+      }
+
+      //Reserve a tile of tileSize for each of a light's faces, or none if they don't all fit
+      bool allocateShadowTiles(ShadowState* shadowState, unsigned int tileSize) {
+        for (unsigned int face = 0; face < 6; face++) {
+          if (!shadowAtlas.allocate(tileSize, &shadowState->faceTiles[face])) {
+            for (unsigned int i = 0; i < face; i++) {
+              shadowAtlas.free(shadowState->faceTiles[i]);
+            }
+
+            return false;
+          }
+        }
+
+        shadowState->tileSize = shadowState->faceTiles[0].size;
+        return true;
+      }
+
+      /*
+       - Give each light a shadow atlas tile for each face, sized by its distance to the camera
+       - Lights keep their tiles until they ask for a different size, then the largest
+         requests are placed first, falling back to smaller tiles when space runs out
+         - Lights that received a smaller tile don't retry until their request changes
+       - Lights given new tiles are set in changedTiles, lights without space have no tiles
+       - Returns true if any light's tiles changed
+      */
+      bool updateShadowTiles(unsigned int activeLights, unsigned int shadowRes,
+                             float shadowFarPlane,
+                             const ammonite::Vec<float, 3>& cameraPosition,
+                             const ammonite::Vec<float, 4> frustumPlanes[6],
+                             std::vector<bool>* changedTiles) {
+        //Release the tiles of removed lights
+        for (unsigned int i = activeLights; i < shadowStates.size(); i++) {
+          releaseShadowTiles(&shadowStates[i]);
+        }
+        shadowStates.resize(activeLights);
+        changedTiles->assign(activeLights, false);
+
+        //6 tiles must fit, so limit tiles to a quarter of the atlas
+        const unsigned int maxTileSize = shadowAtlas.getAtlasSize() / 4;
+        if (maxTileSize < minShadowTileSize) {
+          return false;
+        }
+
+        //Find lights that want a different tile size, and free their old tiles
+        struct TileRequest {
+          unsigned int lightIndex;
+          unsigned int tileSize;
+        };
+        static std::vector<TileRequest> tileRequests;
+        tileRequests.clear();
+        for (unsigned int i = 0; i < activeLights; i++) {
+          ShadowState& shadowState = shadowStates[i];
+          ammonite::Vec<float, 3> lightPosition = {0};
+          lighting::internal::getPackedLightPosition(i, lightPosition);
+
+          //Grow as soon as the light is close enough, shrink with hysteresis
+          const unsigned int growSize = calculateShadowTileSize(lightPosition, cameraPosition,
+            frustumPlanes, shadowFarPlane, 1.0f, shadowRes);
+          const unsigned int shrinkSize = calculateShadowTileSize(lightPosition, cameraPosition,
+            frustumPlanes, shadowFarPlane, shadowTileHysteresis, shadowRes);
+          unsigned int tileSize = shadowState.requestedTileSize;
+          if (growSize > tileSize) {
+            tileSize = growSize;
+          } else if (shrinkSize < tileSize) {
+            tileSize = shrinkSize;
+          }
+          tileSize = std::min(std::bit_floor(tileSize), maxTileSize);
+
+          if (tileSize != shadowState.requestedTileSize) {
+            releaseShadowTiles(&shadowState);
+            shadowState.requestedTileSize = tileSize;
+            tileRequests.push_back({.lightIndex = i, .tileSize = tileSize});
+          }
+        }
+
+        //Place the largest tiles first, to limit fragmentation
+        std::ranges::sort(tileRequests, [](const TileRequest& a, const TileRequest& b) {
+          return a.tileSize > b.tileSize;
+        });
+
+        for (const TileRequest& tileRequest : tileRequests) {
+          ShadowState& shadowState = shadowStates[tileRequest.lightIndex];
+          for (unsigned int tileSize = tileRequest.tileSize; tileSize >= minShadowTileSize;
+               tileSize /= 2) {
+            if (allocateShadowTiles(&shadowState, tileSize)) {
+              break;
+            }
+          }
+
+          (*changedTiles)[tileRequest.lightIndex] = true;
+        }
+
+        return !tileRequests.empty();
+      }
+
+      //Upload each light's tiles to the shaders, in texture coordinates
+      void uploadShadowTiles() {
+        static std::vector<float> tileData;
+        tileData.resize(shadowStates.size() * 6 * 4);
+        if (tileData.empty()) {
+          return;
+        }
+
+        const float texelSize = 1.0f / (float)shadowAtlas.getAtlasSize();
+        for (unsigned int i = 0; i < shadowStates.size(); i++) {
+          for (unsigned int face = 0; face < 6; face++) {
+            const graphics::internal::ShadowTile& tile = shadowStates[i].faceTiles[face];
+            const float tileSize = (shadowStates[i].tileSize == 0) ?
+              0.0f : (float)tile.size * texelSize;
+            float* const tileVec = &tileData[((i * 6) + face) * 4];
+            tileVec[0] = (float)tile.x * texelSize;
+            tileVec[1] = (float)tile.y * texelSize;
+            tileVec[2] = tileSize;
+            tileVec[3] = tileSize;
+          }
+        }
+
+        glNamedBufferData(bufferIds.shadowTiles,
+                          tileData.size() * (GLsizeiptr)sizeof(float),
+                          tileData.data(), GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, bufferIds.shadowTiles);
+      }
+
+      /*
+       - Sort the active lights into clusters of the camera's view, and upload the results
+       - The index list buffer only grows, to avoid reallocating as lights move
+      */
+      void updateLightClusters(const graphics::internal::FrameData& frameData,
+                               unsigned int activeLights) {
+        static std::vector<graphics::internal::ClusterLight> clusterLights;
+        clusterLights.resize(activeLights);
+        for (unsigned int i = 0; i < activeLights; i++) {
+          lighting::internal::getPackedLightPosition(i, clusterLights[i].position);
+          clusterLights[i].range = lighting::internal::getPackedLightRange(i);
+        }
+
+        graphics::internal::buildLightClusters(frameData.viewMatrix, frameData.projectionMatrix,
+                                               clusterLights);
+
+        const std::vector<graphics::internal::LightCluster>& lightClusters =
+          graphics::internal::getLightClusters();
+        glNamedBufferSubData(bufferIds.lightClusters, 0,
+                             lightClusters.size() *
+                             (GLsizeiptr)sizeof(graphics::internal::LightCluster),
+                             lightClusters.data());
+
+        //Keep at least 1 index, so the buffer always has storage to bind
+        const std::vector<unsigned int>& lightIndices =
+          graphics::internal::getClusterLightIndices();
+        const GLsizeiptr indexDataSize =
+          std::max<GLsizeiptr>(lightIndices.size(), 1) * (GLsizeiptr)sizeof(GLuint);
+        static GLsizeiptr indexBufferSize = 0;
+        if (indexDataSize > indexBufferSize) {
+          indexBufferSize = std::max(indexDataSize, indexBufferSize * 2);
+          glNamedBufferData(bufferIds.clusterLightIndices, indexBufferSize, nullptr,
+                            GL_DYNAMIC_DRAW);
+          glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, bufferIds.clusterLightIndices);
+        }
+
+        if (!lightIndices.empty()) {
+          glNamedBufferSubData(bufferIds.clusterLightIndices, 0,
+                               lightIndices.size() * (GLsizeiptr)sizeof(GLuint),
+                               lightIndices.data());
+        }
+      }
+
+      //Point the viewport of each face at its tile in the shadow atlas
+      void setShadowTileViewports(const ShadowState& shadowState) {
+        for (unsigned int face = 0; face < 6; face++) {
+          const graphics::internal::ShadowTile& tile = shadowState.faceTiles[face];
+          glViewportIndexedf(face, (float)tile.x, (float)tile.y, (float)tile.size,
+                             (float)tile.size);
+        }
+      }
+
+      //Clear the 6 faces of a light's shadow, either cubemap layers or atlas tiles
+      void clearShadowLayers(GLuint textureId, unsigned int lightIndex, unsigned int shadowRes) {
+        const float clearDepth = 1.0f;
+        if (useShadowAtlas) {
+          for (const graphics::internal::ShadowTile& tile : shadowStates[lightIndex].faceTiles) {
+            glClearTexSubImage(textureId, 0, (GLint)tile.x, (GLint)tile.y, 0,
+                               (GLsizei)tile.size, (GLsizei)tile.size, 1,
+                               GL_DEPTH_COMPONENT, GL_FLOAT, &clearDepth);
+          }
+
+          return;
+        }
+
+        glClearTexSubImage(textureId, 0, 0, 0, (GLint)lightIndex * 6,
+                           (GLsizei)shadowRes, (GLsizei)shadowRes, 6,
+                           GL_DEPTH_COMPONENT, GL_FLOAT, &clearDepth);
+      }
+
+      //Copy the 6 faces of a light's shadow between textures, either cubemap layers or atlas tiles
+      void copyShadowLayers(GLuint sourceId, GLuint destId, unsigned int lightIndex,
+                            unsigned int shadowRes) {
+        if (useShadowAtlas) {
+          for (const graphics::internal::ShadowTile& tile : shadowStates[lightIndex].faceTiles) {
+            glCopyImageSubData(sourceId, GL_TEXTURE_2D, 0, (GLint)tile.x, (GLint)tile.y, 0,
+                               destId, GL_TEXTURE_2D, 0, (GLint)tile.x, (GLint)tile.y, 0,
+                               (GLsizei)tile.size, (GLsizei)tile.size, 1);
+          }
+
+          return;
+        }
 
-        ammonite::Mat<float, 3> viewMatrixSmall = {{0}};
-        ammonite::Mat<float, 4> viewMatrixCut = {{0}};
-        ammonite::copy(*viewMatrixPtr, viewMatrixSmall);
-        ammonite::copy(viewMatrixSmall, viewMatrixCut);
+        glCopyImageSubData(sourceId, GL_TEXTURE_CUBE_MAP_ARRAY, 0,
+                           0, 0, (GLint)lightIndex * 6,
+                           destId, GL_TEXTURE_CUBE_MAP_ARRAY, 0,
+                           0, 0, (GLint)lightIndex * 6,
+                           (GLsizei)shadowRes, (GLsizei)shadowRes, 6);
+      }
 
-        glUniformMatrix4fv(skyboxShader.viewMatrixId, 1, GL_FALSE,
-                           &viewMatrixCut[0][0]);
-        glUniformMatrix4fv(skyboxShader.projectionMatrixId, 1, GL_FALSE,
-                           &(*projectionMatrixPtr)[0][0]);
+      /*
+       - Draw the regular models left by the last culling query into the bound depth cubemap
+       - Layered shadows draw the instances from queueShadowInstances() instead
+      */
+      void drawShadowCasters(bool useIndirect) {
+        if (useIndirect) {
+          if (useLayeredShadows) {
+            graphics::internal::updateIndirectShadowInstances(
+              graphics::internal::getShadowInstanceRuns());
+          } else {
+            graphics::internal::updateIndirectVisibility();
+          }
+
+          drawModelsIndirect(AMMONITE_DEPTH_PASS);
+        } else {
+          drawModelsCached(&modelPtrs, AMMONITE_MODEL, AMMONITE_DEPTH_PASS);
+        }
+      }
+
+      /*
+       - Find the shadow instances of every model for a set of lights, and upload them
+       - Each light is culled separately, and the faces each model may appear on become
+         instances of that model
+       - When useStaticCache is set, only static or dynamic models are kept, from keepDynamic
+       - Returns false if nothing needs drawing
+      */
+      bool queueShadowInstances(const std::vector<unsigned int>& lightIndices,
+                                float shadowFarPlane, bool useStaticCache, bool keepDynamic) {
+        const unsigned int modelCount =
+          ammonite::models::internal::getModelCount(AMMONITE_MODEL);
+        graphics::internal::resetShadowInstances(modelCount);
+        for (const unsigned int lightIndex : lightIndices) {
+          graphics::internal::cullPointLight(shadowStates[lightIndex].lightPosition,
+                                             shadowFarPlane);
+          if (useStaticCache) {
+            graphics::internal::cullByMotion(keepDynamic);
+          }
+
+          for (unsigned int i = 0; i < modelCount; i++) {
+            graphics::internal::addShadowInstances(i, lightIndex,
+              graphics::internal::getModelFaceMask(i));
+          }
+        }
+
+        graphics::internal::groupShadowInstances();
+        const std::vector<unsigned int>& instanceLayers =
+          graphics::internal::getShadowInstanceLayers();
+        if (instanceLayers.empty()) {
+          return false;
+        }
+
+        glNamedBufferData(bufferIds.shadowInstances,
+                          instanceLayers.size() * (GLsizeiptr)sizeof(unsigned int),
+                          instanceLayers.data(), GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, bufferIds.shadowInstances);
+        return true;
+      }
+
+      /*
+       - Draw every out of date shadow with layered shaders, in a single instanced pass
+         - Each instance draws a model onto one face of one light, chosen by the shaders
+           from the shadow instance buffer
+         - Static shadow caching adds a pass for the static models of lights that need them
+       - Shadow atlases draw to the whole atlas, and the shaders move each face into its tile
+      */
+      void drawLayeredShadows(const std::vector<AmmoniteShadowRedraw>& redrawLights,
+                              float shadowFarPlane, bool useIndirect, bool useStaticCache,
+                              GLuint shadowMapId, GLuint staticShadowMapId,
+                              unsigned int shadowRes) {
+        //Find the lights with out of date shadows, and those with out of date static shadows
+        static std::vector<unsigned int> redrawIndices;
+        static std::vector<unsigned int> staticRedrawIndices;
+        redrawIndices.clear();
+        staticRedrawIndices.clear();
+        for (unsigned int i = 0; i < redrawLights.size(); i++) {
+          if (redrawLights[i] != AMMONITE_SHADOW_CLEAN) {
+            redrawIndices.push_back(i);
+          }
+
+          if (redrawLights[i] == AMMONITE_SHADOW_ALL) {
+            staticRedrawIndices.push_back(i);
+          }
+        }
+
+        if (redrawIndices.empty()) {
+          return;
+        }
+
+        //Check framebuffer status
+        if (glCheckNamedFramebufferStatus(depthMapFBO, GL_FRAMEBUFFER) !=
+            GL_FRAMEBUFFER_COMPLETE) {
+          ammonite::utils::warning << "Incomplete depth framebuffer" << std::endl;
+        }
+
+        //Clip each face to its own tile of the atlas
+        if (useShadowAtlas) {
+          const GLsizei atlasSize = (GLsizei)shadowAtlas.getAtlasSize();
+          glViewport(0, 0, atlasSize, atlasSize);
+          for (unsigned int i = 0; i < 4; i++) {
+            glEnable(GL_CLIP_DISTANCE0 + i);
+          }
+        }
+
+        //Draws are shared by every light, so they're ordered from the first light
+        ammonite::copy(shadowStates[redrawIndices[0]].lightPosition, queueViewOrigin);
+        queueViewRange = shadowFarPlane;
+
+        if (!useStaticCache) {
+          if (queueShadowInstances(redrawIndices, shadowFarPlane, false, false)) {
+            drawShadowCasters(useIndirect);
+          }
+        } else {
+          //Redraw the static models into the cache, only for lights where they've changed
+          if (!staticRedrawIndices.empty()) {
+            for (const unsigned int lightIndex : staticRedrawIndices) {
+              clearShadowLayers(staticShadowMapId, lightIndex, shadowRes);
+            }
+
+            if (queueShadowInstances(staticRedrawIndices, shadowFarPlane, true, false)) {
+              glBindFramebuffer(GL_FRAMEBUFFER, staticDepthMapFBO);
+              drawShadowCasters(useIndirect);
+              glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
+            }
+          }
+
+          //Start from the cached static shadows, then draw the dynamic models over them
+          for (const unsigned int lightIndex : redrawIndices) {
+            copyShadowLayers(staticShadowMapId, shadowMapId, lightIndex, shadowRes);
+          }
+
+          if (queueShadowInstances(redrawIndices, shadowFarPlane, true, true)) {
+            drawShadowCasters(useIndirect);
+          }
+        }
+
+        if (useShadowAtlas) {
+          for (unsigned int i = 0; i < 4; i++) {
+            glDisable(GL_CLIP_DISTANCE0 + i);
+          }
+        }
+      }
+
+      /*
+       - Request texture resolutions for the regular models left by the last culling query
+       - Each model's textures are assumed to cover its bounds' height on the screen
+      */
+      void requestModelTextures(unsigned int scaledHeight) {
+        const float pixelScale = (*projectionMatrixPtr)[1][1] * (float)scaledHeight;
+        const unsigned int modelCount =
+          ammonite::models::internal::getModelCount(AMMONITE_MODEL);
+        for (unsigned int i = 0; i < modelCount; i++) {
+          if (!graphics::internal::isModelVisible(i)) {
+            continue;
+          }
+
+          const ammonite::models::internal::ModelInfo* const modelPtr = modelPtrs[i];
+          const ammonite::models::internal::BoundingBox& bounds = modelPtr->worldBounds;
+          ammonite::Vec<float, 3> centre = {0};
+          ammonite::add(bounds.minimum, bounds.maximum, centre);
+          ammonite::scale(centre, 0.5f);
+          const float radius = ammonite::distance(bounds.minimum, bounds.maximum) * 0.5f;
+          const float distance = std::max(ammonite::distance(centre, queueViewOrigin), radius);
+          const float pixels = (radius / distance) * pixelScale;
+
+          for (const ammonite::models::internal::TextureIdGroup& textureIds :
+               modelPtr->textureIds) {
+            textures::internal::requestTextureResolution(textureIds.diffuseId, pixels);
+            textures::internal::requestTextureResolution(textureIds.specularId, pixels);
+          }
+        }
+      }
+
+      void drawSkybox(AmmoniteId activeSkyboxId) {
+        //Swap to skybox shader, the view and projection come from the frame data
+        skyboxShader.useShader();
 
         //Prepare and draw the skybox
         glBindVertexArray(skyboxVertexArrayId);
@@ -535,6 +1544,115 @@ namespace ammonite {
         glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_BYTE, nullptr);
       }
 
+      //Copy the multisampled scene into the resolved textures that later passes read
+      void resolveScenePass(const graphics::internal::FramePassContext& context, void*) {
+        const graphics::internal::FrameTexture& source = context.inputs[0];
+        GLbitfield blitBits = 0;
+        if (context.outputs[0].isUsed) {
+          blitBits |= GL_COLOR_BUFFER_BIT;
+        }
+
+        if (context.outputs[1].isUsed) {
+          blitBits |= GL_DEPTH_BUFFER_BIT;
+        }
+
+        glBlitNamedFramebuffer(source.framebufferId, context.outputs[0].framebufferId, 0, 0,
+                               (GLint)source.width, (GLint)source.height, 0, 0,
+                               (GLint)source.width, (GLint)source.height,
+                               blitBits, GL_NEAREST);
+      }
+
+      //Resolve the multisampled scene directly into the output, when nothing else is needed
+      void blitScenePass(const graphics::internal::FramePassContext& context, void*) {
+        const graphics::internal::FrameTexture& source = context.inputs[0];
+        const graphics::internal::FrameTexture& target = context.outputs[0];
+        glBlitNamedFramebuffer(source.framebufferId, target.framebufferId, 0, 0,
+                               (GLint)source.width, (GLint)source.height, 0, 0,
+                               (GLint)target.width, (GLint)target.height,
+                               GL_COLOR_BUFFER_BIT, GL_NEAREST);
+      }
+
+      //Downscale the frame into the output, storing the circle of confusion in alpha
+      void circleOfConfusionPass(const graphics::internal::FramePassContext& context, void*) {
+        const graphics::internal::FrameTexture& target = context.outputs[0];
+        circleOfConfusionShader.useShader();
+        glUniform1f(circleOfConfusionShader.focalDepthId, settings::post::getFocalDepth());
+        glUniform1f(circleOfConfusionShader.blurStrengthId, settings::post::getBlurStrength());
+
+        //Spread the taps to cover the full resolution pixels under each output pixel
+        glUniform2fv(circleOfConfusionShader.renderScaleId, 1, &renderScale[0]);
+        glUniform2f(circleOfConfusionShader.tapOffsetId,
+                    renderScale[0] / (4.0f * (float)target.width),
+                    renderScale[1] / (4.0f * (float)target.height));
+
+        glBindTextureUnit(4, context.inputs[0].textureId);
+        glBindTextureUnit(5, context.inputs[1].textureId);
+        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_BYTE, nullptr);
+      }
+
+      //Blur the input along the direction given by userPtr, as 2 floats
+      void blurPass(const graphics::internal::FramePassContext& context, void* userPtr) {
+        blurShader.useShader();
+        glUniform2fv(blurShader.blurStepId, 1, (float*)userPtr);
+        glBindTextureUnit(7, context.inputs[0].textureId);
+        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_BYTE, nullptr);
+      }
+
+      /*
+       - Draw the scene to the output, blending in the blurred frame when depth of field
+         is enabled
+       - Depth of field is enabled by passing the scene's depth and the blurred frame
+         as extra inputs
+      */
+      void compositePass(const graphics::internal::FramePassContext& context, void*) {
+        const bool focalDepthEnabled = (context.inputs.size() == 3);
+        screenShader.useShader();
+        glUniform2fv(screenShader.renderScaleId, 1, &renderScale[0]);
+
+        glUniform1i(screenShader.focalDepthEnabledId, (GLint)focalDepthEnabled);
+        if (focalDepthEnabled) {
+          const float focalDepth = settings::post::getFocalDepth();
+          const float blurStrength = settings::post::getBlurStrength();
+
+          glUniform1f(screenShader.focalDepthId, focalDepth);
+          glUniform1f(screenShader.blurStrengthId, blurStrength);
+          glBindTextureUnit(5, context.inputs[1].textureId);
+          glBindTextureUnit(7, context.inputs[2].textureId);
+        }
+
+        //Display the rendered frame
+        glBindTextureUnit(4, context.inputs[0].textureId);
+        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_BYTE, nullptr);
+      }
+
+      /*
+       - Add passes to blur the scene by its distance from the focal depth, at a reduced resolution
+       - The frame is downscaled with its circle of confusion stored in the alpha channel,
+         then blurred horizontally and vertically in separate passes
+       - Returns the texture holding the blurred frame, for the composite to upscale
+      */
+      unsigned int addDepthOfFieldPasses(graphics::internal::FrameGraph* frameGraph,
+                                         unsigned int sceneColourId, unsigned int sceneDepthId,
+                                         unsigned int renderWidth, unsigned int renderHeight) {
+        const unsigned int downscale = settings::post::getBlurDownscale();
+        const unsigned int blurWidth = renderWidth / downscale;
+        const unsigned int blurHeight = renderHeight / downscale;
+
+        //The vertical blur can reuse the circle of confusion's target, once it's been read
+        const unsigned int cocId = frameGraph->createTexture(blurWidth, blurHeight, GL_RGBA16F);
+        const unsigned int horizontalId = frameGraph->createTexture(blurWidth, blurHeight,
+                                                                    GL_RGBA16F);
+        const unsigned int verticalId = frameGraph->createTexture(blurWidth, blurHeight,
+                                                                  GL_RGBA16F);
+
+        frameGraph->addPass(circleOfConfusionPass, nullptr, {sceneColourId, sceneDepthId},
+                            {cocId});
+        frameGraph->addPass(blurPass, &horizontalBlurStep[0], {cocId}, {horizontalId});
+        frameGraph->addPass(blurPass, &verticalBlurStep[0], {horizontalId}, {verticalId});
+
+        return verticalId;
+      }
+
       void drawSplashScreen(AmmoniteId splashScreenId, unsigned int width,
                             unsigned int height) {
         //Swap to splash screen shader
@@ -582,6 +1700,9 @@ namespace ammonite {
       }
 
       void internalDrawFrame() {
+        //Record state changes from the last frame, before counting this frame's
+        internal::finishStateChangeFrame();
+
         const unsigned int width = ammonite::window::internal::getGraphicsWidth();
         const unsigned int height = ammonite::window::internal::getGraphicsHeight();
         static unsigned int lastWidth = 0;
@@ -629,40 +1750,128 @@ namespace ammonite {
           ammoniteInternalDebug << "Output resolution: " << width << " x " << height << std::endl;
         }
 
+        /*
+         - Pick how much of the render targets to draw to, from the GPU time of recent frames
+         - Only the viewport changes, so the render targets are never reallocated
+        */
+        const bool useDynamicResolution = settings::getDynamicResolution();
+        static bool lastDynamicResolution = false;
+        if (useDynamicResolution != lastDynamicResolution) {
+          lastDynamicResolution = useDynamicResolution;
+          graphics::internal::resetRenderScale();
+        }
+
+        float dynamicScale = 1.0f;
+        if (useDynamicResolution) {
+          dynamicScale = graphics::internal::updateRenderScale(settings::getTargetFrameTime());
+          graphics::internal::beginGpuFrameTimer();
+        }
+
+        const unsigned int scaledWidth =
+          std::max((unsigned int)((float)renderWidth * dynamicScale), 1u);
+        const unsigned int scaledHeight =
+          std::max((unsigned int)((float)renderHeight * dynamicScale), 1u);
+        renderScale[0] = (float)scaledWidth / (float)renderWidth;
+        renderScale[1] = (float)scaledHeight / (float)renderHeight;
+
         //Get shadow resolution and light count, save for next time to avoid cubemap recreation
         const unsigned int shadowRes = settings::getShadowRes();
         const unsigned int lightCount = lighting::getLightCount();
         static unsigned int lastShadowRes = 0;
         static unsigned int lastLightCount = -1;
+        bool redrawAllShadows = false;
+
+        //Cache shadows of static models separately, when enabled and supported
+        const bool useStaticCache = settings::getStaticShadowCaching() &&
+          isCopyImageSupported && isClearTextureSupported;
+        static bool lastUseStaticCache = false;
+
+        //Store shadows in an atlas instead of cubemaps, when enabled and supported
+        useShadowAtlas = settings::getShadowAtlasEnabled() && isViewportArraySupported;
+        const unsigned int shadowAtlasRes = std::min(settings::getShadowAtlasRes(),
+                                                     (unsigned int)maxTextureSize);
+        static bool lastUseShadowAtlas = false;
+        static unsigned int lastShadowAtlasRes = 0;
+
+        //Atlases don't depend on the light count or shadow resolution, only their own size
+        bool isDepthMapOutdated = (useStaticCache != lastUseStaticCache) ||
+          (useShadowAtlas != lastUseShadowAtlas);
+        if (useShadowAtlas) {
+          isDepthMapOutdated |= (shadowAtlasRes != lastShadowAtlasRes);
+        } else {
+          isDepthMapOutdated |= (shadowRes != lastShadowRes) || (lightCount != lastLightCount);
+        }
 
-        //If number of lights or shadow resolution changes, recreate cubemap
-        if ((shadowRes != lastShadowRes) || (lightCount != lastLightCount)) {
-          setupDepthMap(lightCount, shadowRes);
+        //If number of lights, shadow resolution or caching changes, recreate cubemap
+        if (isDepthMapOutdated) {
+          setupDepthMap(lightCount, shadowRes, useStaticCache, shadowAtlasRes);
+          redrawAllShadows = true;
 
           //Save for next time to avoid cubemap recreation
           lastShadowRes = shadowRes;
           lastLightCount = lightCount;
+          lastUseStaticCache = useStaticCache;
+          lastUseShadowAtlas = useShadowAtlas;
+          lastShadowAtlasRes = shadowAtlasRes;
         }
 
+        //Use multi-draw indirect for regular models when supported and enabled
+        const bool useIndirect = isIndirectSupported && settings::getIndirectDrawing();
+        internal::ModelShader* const activeModelShader = useIndirect ?
+          &indirectModelShader : &modelShader;
+
+        //Select the depth shaders, preferring layered shaders over geometry shaders
+        useLayeredShadows = isLayeredShadowSupported;
+        activeDepthShader = useLayeredShadows ? &layeredDepthShader : &depthShader;
+        activeIndirectDepthShader = useLayeredShadows ?
+          &layeredIndirectDepthShader : &indirectDepthShader;
+        internal::DepthShader* const frameDepthShader = useIndirect ?
+          activeIndirectDepthShader : activeDepthShader;
+
         //Swap to depth shader and enable depth testing
-        depthShader.useShader();
+        frameDepthShader->useShader();
         internal::prepareScreen(depthMapFBO, shadowRes, shadowRes, true);
 
-        //Pass uniforms that don't change between light sources
+        //Every shadow depends on the far plane
         const float shadowFarPlane = settings::getShadowFarPlane();
-        glUniform1f(depthShader.shadowFarPlaneId, shadowFarPlane);
+        static float lastShadowFarPlane = 0.0f;
+        if (shadowFarPlane != lastShadowFarPlane) {
+          lastShadowFarPlane = shadowFarPlane;
+          redrawAllShadows = true;
+        }
 
-        //Clear existing depth values
-        glClear(GL_DEPTH_BUFFER_BIT);
+        //Upload new materials, before draws are built from them
+        graphics::internal::uploadMaterials();
 
         //Update cached model pointers, if the models have changed trackers
         static bool* const modelsMovedPtr = ammonite::models::internal::getModelsMovedPtr();
         if (*modelsMovedPtr) {
           drawModelsCached(&modelPtrs, AMMONITE_MODEL, AMMONITE_DATA_REFRESH);
           drawModelsCached(&lightModelPtrs, AMMONITE_LIGHT_EMITTER, AMMONITE_DATA_REFRESH);
+
+          //Rebuild indirect commands, so they're ready if indirect drawing is enabled later
+          if (isIndirectSupported) {
+            graphics::internal::updateIndirectCommands(modelPtrs,
+              ammonite::models::internal::getModelCount(AMMONITE_MODEL));
+          }
+
+          //Culling results are reported by position in the cached model pointers
+          graphics::internal::updateCullingModels(modelPtrs,
+            ammonite::models::internal::getModelCount(AMMONITE_MODEL));
+
+          //Draw modes may have changed, which can't be tracked by bounds
+          redrawAllShadows = true;
           *modelsMovedPtr = false;
         }
 
+        //Refresh the draw data of models that moved, or all of it if indirect drawing was off
+        if (useIndirect) {
+          graphics::internal::updateIndirectDrawData(models::internal::getMovedModels());
+        } else {
+          graphics::internal::invalidateIndirectDrawData();
+        }
+        models::internal::resetMovedModels();
+
         //Use gamma correction if enabled
         if (settings::getGammaCorrection()) {
           glEnable(GL_FRAMEBUFFER_SRGB);
@@ -670,24 +1879,153 @@ namespace ammonite {
           glDisable(GL_FRAMEBUFFER_SRGB);
         }
 
-        //Depth mapping render passes
         lighting::internal::updateLightSources();
         const unsigned int activeLights = std::min(lightCount, maxLightCount);
-        for (unsigned int shadowCount = 0; shadowCount < activeLights; shadowCount++) {
-          //Check framebuffer status
-          if (glCheckNamedFramebufferStatus(depthMapFBO, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-            ammonite::utils::warning << "Incomplete depth framebuffer" << std::endl;
+
+        //Upload constants shared by every shader, instead of setting them per-draw
+        graphics::internal::FrameData frameData = {};
+        ammonite::copy(*viewMatrixPtr, frameData.viewMatrix);
+        ammonite::copy(*projectionMatrixPtr, frameData.projectionMatrix);
+        ammonite::multiply(*projectionMatrixPtr, *viewMatrixPtr, frameData.viewProjection);
+        ammonite::camera::getPosition(ammonite::camera::getActiveCamera(),
+                                      frameData.cameraPosition);
+        ammonite::lighting::properties::getAmbientLight(frameData.ambientLight);
+        frameData.shadowFarPlane = shadowFarPlane;
+        frameData.renderFarPlane = settings::getRenderFarPlane();
+        frameData.lightCount = activeLights;
+        frameData.shadowAtlasEnabled = useShadowAtlas ? 1 : 0;
+
+        //Main pass fragments only pass when they match the pre-pass depth, when enabled
+        const bool useDepthPrepass = settings::getDepthPrepass() && isDepthPrepassSupported;
+        frameData.depthPrepassEnabled = useDepthPrepass ? 1 : 0;
+
+        //Sort lights into clusters of the view, so fragments only visit nearby lights
+        const bool useClusteredLighting = settings::getClusteredLighting();
+        frameData.clusteredLighting = useClusteredLighting ? 1 : 0;
+        if (useClusteredLighting) {
+          updateLightClusters(frameData, activeLights);
+
+          frameData.clusterTileScale[0] = (float)graphics::internal::clusterGridX /
+            (float)scaledWidth;
+          frameData.clusterTileScale[1] = (float)graphics::internal::clusterGridY /
+            (float)scaledHeight;
+          frameData.clusterGrid[0] = graphics::internal::clusterGridX;
+          frameData.clusterGrid[1] = graphics::internal::clusterGridY;
+          frameData.clusterGrid[2] = graphics::internal::clusterGridZ;
+          graphics::internal::getClusterDepthFactors(&frameData.clusterDepthScale,
+                                                     &frameData.clusterDepthBias);
+        }
+
+        glNamedBufferSubData(bufferIds.frameData, 0, sizeof(graphics::internal::FrameData),
+                             &frameData);
+
+        //Planes of the camera's view, used to size shadow atlas tiles and to cull models
+        ammonite::Vec<float, 4> frustumPlanes[6] = {{0}};
+        graphics::internal::calculateFrustumPlanes(frameData.viewProjection, frustumPlanes);
+
+        //Resize shadow atlas tiles, before finding changes so shadowStates matches the lights
+        static std::vector<bool> changedTiles;
+        static unsigned int lastTileLightCount = 0;
+        if (useShadowAtlas) {
+          const bool tilesChanged = updateShadowTiles(activeLights, shadowRes, shadowFarPlane,
+                                                      frameData.cameraPosition, frustumPlanes,
+                                                      &changedTiles);
+          if (tilesChanged || activeLights != lastTileLightCount) {
+            uploadShadowTiles();
+            lastTileLightCount = activeLights;
+          }
+        }
+
+        //Find which shadows are out of date
+        static std::vector<AmmoniteShadowRedraw> redrawLights;
+        const bool isFullRedraw = findChangedShadows(activeLights, shadowFarPlane,
+                                                     redrawAllShadows, useStaticCache,
+                                                     &redrawLights);
+
+        //Lights with new tiles need a full redraw, lights without tiles can't be drawn
+        if (useShadowAtlas) {
+          for (unsigned int shadowCount = 0; shadowCount < activeLights; shadowCount++) {
+            if (shadowStates[shadowCount].tileSize == 0) {
+              redrawLights[shadowCount] = AMMONITE_SHADOW_CLEAN;
+            } else if (changedTiles[shadowCount]) {
+              redrawLights[shadowCount] = AMMONITE_SHADOW_ALL;
+            }
           }
+        }
 
-          //Pass light source specific uniforms
-          glUniform1ui(depthShader.depthShadowIndexId, shadowCount);
+        //Select the textures shadows are drawn into
+        const GLuint shadowMapId = useShadowAtlas ? shadowAtlasId : depthCubeMapId;
+        const GLuint staticShadowMapId = useShadowAtlas ? staticShadowAtlasId : staticDepthCubeMapId;
 
-          //Render to depth buffer and move to the next light source
-          drawModelsCached(&modelPtrs, AMMONITE_MODEL, AMMONITE_DEPTH_PASS);
+        //Clear out of date depth values, cached shadows are overwritten by the static cache instead
+        if (!useStaticCache) {
+          if (isFullRedraw) {
+            glClear(GL_DEPTH_BUFFER_BIT);
+          } else {
+            for (unsigned int shadowCount = 0; shadowCount < activeLights; shadowCount++) {
+              if (redrawLights[shadowCount] != AMMONITE_SHADOW_CLEAN) {
+                clearShadowLayers(shadowMapId, shadowCount, shadowRes);
+              }
+            }
+          }
+        }
+
+        //Depth mapping render passes, skipping lights with unchanged shadows
+        if (useLayeredShadows) {
+          drawLayeredShadows(redrawLights, shadowFarPlane, useIndirect, useStaticCache,
+                             shadowMapId, staticShadowMapId, shadowRes);
+        } else {
+          for (unsigned int shadowCount = 0; shadowCount < activeLights; shadowCount++) {
+            if (redrawLights[shadowCount] == AMMONITE_SHADOW_CLEAN) {
+              continue;
+            }
+
+            //Check framebuffer status
+            if (glCheckNamedFramebufferStatus(depthMapFBO, GL_FRAMEBUFFER) !=
+                GL_FRAMEBUFFER_COMPLETE) {
+              ammonite::utils::warning << "Incomplete depth framebuffer" << std::endl;
+            }
+
+            //Pass light source specific uniforms
+            glUniform1ui(frameDepthShader->depthShadowIndexId, shadowCount);
+            if (useShadowAtlas) {
+              setShadowTileViewports(shadowStates[shadowCount]);
+            }
+
+            //Skip models outside of the light's shadow range, and the faces they can't appear on
+            const ammonite::Vec<float, 3>& lightPosition =
+              shadowStates[shadowCount].lightPosition;
+            ammonite::copy(lightPosition, queueViewOrigin);
+            queueViewRange = shadowFarPlane;
+            if (!useStaticCache) {
+              graphics::internal::cullPointLight(lightPosition, shadowFarPlane);
+              drawShadowCasters(useIndirect);
+              continue;
+            }
+
+            //Redraw the static models into the cache, only when they've changed
+            if (redrawLights[shadowCount] == AMMONITE_SHADOW_ALL) {
+              clearShadowLayers(staticShadowMapId, shadowCount, shadowRes);
+              glBindFramebuffer(GL_FRAMEBUFFER, staticDepthMapFBO);
+
+              graphics::internal::cullPointLight(lightPosition, shadowFarPlane);
+              graphics::internal::cullByMotion(false);
+              drawShadowCasters(useIndirect);
+
+              glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
+            }
+
+            //Start from the cached static shadow, then draw the dynamic models over it
+            copyShadowLayers(staticShadowMapId, shadowMapId, shadowCount, shadowRes);
+
+            graphics::internal::cullPointLight(lightPosition, shadowFarPlane);
+            graphics::internal::cullByMotion(true);
+            drawShadowCasters(useIndirect);
+          }
         }
 
         //Reset the framebuffer and viewport
-        internal::prepareScreen(targetBufferId, renderWidth, renderHeight, true);
+        internal::prepareScreen(targetBufferId, scaledWidth, scaledHeight, true);
 
         //Clear depth and colour (if no skybox is used)
         const AmmoniteId activeSkybox = ammonite::skybox::getActiveSkybox();
@@ -697,22 +2035,53 @@ namespace ammonite {
           glClear(GL_DEPTH_BUFFER_BIT);
         }
 
-        //Prepare model shader and depth cube map
-        modelShader.useShader();
-        glBindTextureUnit(2, depthCubeMapId);
+        //Skip models outside of the camera's view
+        graphics::internal::cullFrustum(frustumPlanes);
+        ammonite::copy(frameData.cameraPosition, queueViewOrigin);
+        queueViewRange = frameData.renderFarPlane;
+        if (useIndirect) {
+          graphics::internal::updateIndirectVisibility();
+        }
+
+        //Report how large visible models appear, so their textures can stream to match
+        if (textures::internal::isTextureStreamingActive()) {
+          requestModelTextures(scaledHeight);
+        }
 
-        //Get ambient light and camera position
-        ammonite::Vec<float, 3> ambientLight = {0};
-        ammonite::Vec<float, 3> cameraPosition = {0};
-        ammonite::lighting::properties::getAmbientLight(ambientLight);
-        ammonite::camera::getPosition(ammonite::camera::getActiveCamera(), cameraPosition);
+        //Draw depth first, then only shade fragments that match it
+        if (useDepthPrepass) {
+          if (useIndirect) {
+            drawPrepassIndirect();
+          } else {
+            activePrepassShader = &prepassShader;
+            activePrepassShader->useShader();
+            drawModelsCached(&modelPtrs, AMMONITE_MODEL, AMMONITE_DEPTH_PREPASS);
+          }
 
-        //Pass uniforms and render regular models
-        glUniform3fv(modelShader.ambientLightId, 1, &ambientLight[0]);
-        glUniform3fv(modelShader.cameraPosId, 1, &cameraPosition[0]);
-        glUniform1f(modelShader.shadowFarPlaneId, shadowFarPlane);
-        glUniform1ui(modelShader.lightCountId, activeLights);
-        drawModelsCached(&modelPtrs, AMMONITE_MODEL, AMMONITE_RENDER_PASS);
+          glDepthFunc(GL_EQUAL);
+          glDepthMask(GL_FALSE);
+        }
+
+        //Prepare model shader and depth cube map or shadow atlas
+        activeModelShader->useShader();
+        if (useShadowAtlas) {
+          glBindTextureUnit(6, shadowAtlasId);
+        } else {
+          glBindTextureUnit(2, depthCubeMapId);
+        }
+
+        //Render regular models
+        if (useIndirect) {
+          drawModelsIndirect(AMMONITE_RENDER_PASS);
+        } else {
+          drawModelsCached(&modelPtrs, AMMONITE_MODEL, AMMONITE_RENDER_PASS);
+        }
+
+        //Restore depth testing and writes for the remaining draws
+        if (useDepthPrepass) {
+          glDepthFunc(GL_LEQUAL);
+          glDepthMask(GL_TRUE);
+        }
 
         //Render light emitting models
         const unsigned int lightModelCount =
@@ -736,61 +2105,72 @@ namespace ammonite {
 
         //Enable post-processor when required, or blit would fail
         bool isPostRequired = focalDepthEnabled;
-        if (sampleCount == 0 || renderResMultiplier != 1.0f) {
+        const bool isScaled = (renderResMultiplier != 1.0f) || (scaledWidth != renderWidth) ||
+                              (scaledHeight != renderHeight);
+        if (sampleCount == 0 || isScaled) {
           /*
            - Workaround until non-multisampled rendering is done to an offscreen framebuffer
              - sampleCount == 0
            - Workaround INVALID_OPERATION when scaling a multisampled buffer with a blit
-             - sampleCount != 0 && renderResMultiplier != 1.0f
+             - sampleCount != 0 && isScaled
           */
           isPostRequired = true;
         }
 
         /*
-          If post-processing is required, blit offscreen framebuffer to texture
-          Use a post-processing fragment shader with this texture to blur and scale
-
-          If post-processing isn't required or can be avoided, render directly to screen
+         - Build the passes from the rendered scene to the screen
+           - If post-processing is required, the scene is resolved into textures for
+             the post-processing passes, then composited and scaled to the screen
+           - If post-processing isn't required or can be avoided, the scene is
+             resolved directly to the screen
+         - Passes that nothing reads are skipped, and transient textures are shared
+           between passes that don't overlap
         */
-        internal::prepareScreen(0, width, height, false);
+        static graphics::internal::FrameGraph frameGraph;
+        frameGraph.reset();
+        const unsigned int screenId = frameGraph.importTexture(0, 0, width, height);
+        const unsigned int multisampleId = frameGraph.importTexture(
+          0, colourBufferMultisampleFBO, scaledWidth, scaledHeight);
+
         if (isPostRequired) {
-          //Resolve multisampling into regular texture
+          const unsigned int sceneColourId = frameGraph.importTexture(
+            screenQuadTextureId, screenQuadFBO, scaledWidth, scaledHeight);
+          const unsigned int sceneDepthId = frameGraph.importTexture(
+            screenQuadDepthTextureId, screenQuadFBO, scaledWidth, scaledHeight);
+
+          //Resolve multisampling into regular textures
           if (sampleCount != 0) {
-            const GLbitfield blitBits = GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT;
-            glBlitNamedFramebuffer(colourBufferMultisampleFBO, screenQuadFBO, 0, 0,
-                                   (GLint)renderWidth, (GLint)renderHeight, 0, 0,
-                                   (GLint)renderWidth, (GLint)renderHeight,
-                                   blitBits, GL_NEAREST);
+            frameGraph.addPass(resolveScenePass, nullptr, {multisampleId},
+                               {sceneColourId, sceneDepthId});
           }
 
-          //Swap to correct shaders
-          screenShader.useShader();
-
-          //Conditionally send data for blur
-          glUniform1i(screenShader.focalDepthEnabledId, (GLint)focalDepthEnabled);
+          std::vector<unsigned int> compositeInputs = {sceneColourId};
           if (focalDepthEnabled) {
-            const float focalDepth = settings::post::getFocalDepth();
-            const float blurStrength = settings::post::getBlurStrength();
-            const float farPlane = settings::getRenderFarPlane();
-
-            glUniform1f(screenShader.focalDepthId, focalDepth);
-            glUniform1f(screenShader.blurStrengthId, blurStrength);
-            glUniform1f(screenShader.farPlaneId, farPlane);
-            glBindTextureUnit(5, screenQuadDepthTextureId);
+            const unsigned int blurId = addDepthOfFieldPasses(&frameGraph, sceneColourId,
+                                                              sceneDepthId, renderWidth,
+                                                              renderHeight);
+            compositeInputs = {sceneColourId, sceneDepthId, blurId};
           }
 
-          //Display the rendered frame
-          glBindVertexArray(screenQuadVertexArrayId);
-          glBindTextureUnit(4, screenQuadTextureId);
-          glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_BYTE, nullptr);
+          frameGraph.addPass(compositePass, nullptr, compositeInputs, {screenId});
         } else {
-          //Resolve multisampling into default framebuffer
-          if (sampleCount != 0) {
-            const GLbitfield blitBits = GL_COLOR_BUFFER_BIT;
-            glBlitNamedFramebuffer(colourBufferMultisampleFBO, 0, 0, 0,
-                                   (GLint)renderWidth, (GLint)renderHeight, 0, 0,
-                                   (GLint)width, (GLint)height, blitBits, GL_NEAREST);
-          }
+          frameGraph.addPass(blitScenePass, nullptr, {multisampleId}, {screenId});
+        }
+
+        //Every drawing pass uses the screen quad
+        glBindVertexArray(screenQuadVertexArrayId);
+        frameGraph.execute(screenId);
+
+        //Return post-processing targets to the pool for the next frame
+        graphics::internal::finishPostTargetFrame();
+
+        if (useDynamicResolution) {
+          graphics::internal::endGpuFrameTimer();
+        }
+
+        //Move streamed textures towards the resolutions requested this frame
+        if (textures::internal::isTextureStreamingActive()) {
+          textures::internal::updateTextureStreaming();
         }
 
         //Display frame and handle any sleeping required
@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <limits>
+
 extern "C" {
   #include <epoxy/gl.h>
 }
@@ -6,10 +9,26 @@ extern "C" {
 
 /*
  - Generic helpers for the render core
+ - Binding helpers track the bound state, to filter out redundant state changes
 */
 
 namespace ammonite {
   namespace renderer {
+    namespace {
+      //Binding that never matches a real object, used when the state is unknown
+      constexpr GLuint unknownId = std::numeric_limits<GLuint>::max();
+      constexpr unsigned int trackedTextureUnits = 4;
+
+      GLuint boundVertexArrayId = unknownId;
+      GLuint boundTextureIds[trackedTextureUnits] = {
+        unknownId, unknownId, unknownId, unknownId
+      };
+
+      //GL state changes made through the helpers
+      unsigned int stateChangeCount = 0;
+      unsigned int lastFrameStateChanges = 0;
+    }
+
     namespace internal {
       void prepareScreen(GLuint framebufferId, unsigned int width,
                          unsigned int height, bool depthTest) {
@@ -32,6 +51,51 @@ namespace ammonite {
         //Change the draw mode
         glPolygonMode(GL_FRONT_AND_BACK, enabled ? GL_LINE : GL_FILL);
         oldEnabled = enabled;
+        stateChangeCount++;
+      }
+
+      //Bind a vertex array, unless it's already bound
+      void bindVertexArray(GLuint vertexArrayId) {
+        if (boundVertexArrayId == vertexArrayId) {
+          return;
+        }
+
+        glBindVertexArray(vertexArrayId);
+        boundVertexArrayId = vertexArrayId;
+        stateChangeCount++;
+      }
+
+      //Bind a texture to a unit, unless it's already bound there
+      void bindTextureUnit(GLuint unit, GLuint textureId) {
+        if (unit < trackedTextureUnits) {
+          if (boundTextureIds[unit] == textureId) {
+            return;
+          }
+
+          boundTextureIds[unit] = textureId;
+        }
+
+        glBindTextureUnit(unit, textureId);
+        stateChangeCount++;
+      }
+
+      /*
+       - Forget the tracked bindings, forcing the next binds to happen
+       - Call this before using the cache, if anything may have been bound directly
+      */
+      void resetStateCache() {
+        boundVertexArrayId = unknownId;
+        std::fill(&boundTextureIds[0], &boundTextureIds[trackedTextureUnits], unknownId);
+      }
+
+      //Save the state changes made this frame, and start counting the next frame
+      void finishStateChangeFrame() {
+        lastFrameStateChanges = stateChangeCount;
+        stateChangeCount = 0;
+      }
+
+      unsigned int getLastFrameStateChanges() {
+        return lastFrameStateChanges;
       }
     }
   }
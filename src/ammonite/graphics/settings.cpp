@@ -8,6 +8,7 @@ namespace ammonite {
           bool focalDepthEnabled = false;
           float focalDepth = 0.0f;
           float blurStrength = 1.0f;
+          unsigned int blurDownscale = 2;
         } postSettings;
 
         struct GraphicsSettings {
@@ -19,6 +20,18 @@ namespace ammonite {
           float renderFarPlane = 100.0f;
           float shadowFarPlane = 25.0f;
           bool gammaCorrection = false;
+          bool indirectDrawing = true;
+          bool staticShadowCaching = true;
+          bool shadowAtlasEnabled = false;
+          unsigned int shadowAtlasRes = 8192;
+          bool clusteredLighting = true;
+          bool depthPrepass = false;
+          bool dynamicResolution = false;
+          float targetFrameTime = 1.0f / 60.0f;
+          bool textureCompression = false;
+          bool textureStreaming = false;
+          unsigned int textureMemoryBudget = 0;
+          bool textureAtlasing = false;
         } graphicsSettings;
       }
 
@@ -46,6 +59,15 @@ namespace ammonite {
         float getBlurStrength() {
           return postSettings.blurStrength;
         }
+
+        //Factor to reduce the depth of field blur resolution by, 0 is treated as 1
+        void setBlurDownscale(unsigned int downscale) {
+          postSettings.blurDownscale = (downscale > 0) ? downscale : 1;
+        }
+
+        unsigned int getBlurDownscale() {
+          return postSettings.blurDownscale;
+        }
       }
 
       void setVsync(bool enabled) {
@@ -112,6 +134,157 @@ namespace ammonite {
       bool getGammaCorrection() {
         return graphicsSettings.gammaCorrection;
       }
+
+      /*
+       - Draw regular models with multi-draw indirect, when supported
+       - Has no effect if the driver lacks support, regular drawing is used instead
+      */
+      void setIndirectDrawing(bool enabled) {
+        graphicsSettings.indirectDrawing = enabled;
+      }
+
+      bool getIndirectDrawing() {
+        return graphicsSettings.indirectDrawing;
+      }
+
+      /*
+       - Keep a second copy of each shadow with only static models, so moving models
+         don't cause static models to be redrawn
+       - Uses twice the video memory for shadows, and has no effect without
+         support for copying and clearing textures
+      */
+      void setStaticShadowCaching(bool enabled) {
+        graphicsSettings.staticShadowCaching = enabled;
+      }
+
+      bool getStaticShadowCaching() {
+        return graphicsSettings.staticShadowCaching;
+      }
+
+      /*
+       - Store shadows in a fixed size atlas, instead of a cubemap for every light
+       - Each light's resolution is picked from its distance to the camera, up to the
+         shadow resolution, so lights can be added and removed without reallocating
+       - Has no effect without support for viewport arrays
+      */
+      void setShadowAtlasEnabled(bool enabled) {
+        graphicsSettings.shadowAtlasEnabled = enabled;
+      }
+
+      //Width and height of the shadow atlas, rounded down to a power of 2
+      void setShadowAtlasRes(unsigned int shadowAtlasRes) {
+        graphicsSettings.shadowAtlasRes = shadowAtlasRes;
+      }
+
+      bool getShadowAtlasEnabled() {
+        return graphicsSettings.shadowAtlasEnabled;
+      }
+
+      unsigned int getShadowAtlasRes() {
+        return graphicsSettings.shadowAtlasRes;
+      }
+
+      /*
+       - Only light fragments with the lights that can reach them, found per cluster of the view
+       - Lights are ignored past the range where they'd contribute under 1/256
+      */
+      void setClusteredLighting(bool enabled) {
+        graphicsSettings.clusteredLighting = enabled;
+      }
+
+      bool getClusteredLighting() {
+        return graphicsSettings.clusteredLighting;
+      }
+
+      /*
+       - Draw the depth of regular models before shading them, so each pixel is only shaded once
+       - Helps scenes with lots of overdraw, at the cost of transforming every vertex twice
+      */
+      void setDepthPrepass(bool enabled) {
+        graphicsSettings.depthPrepass = enabled;
+      }
+
+      bool getDepthPrepass() {
+        return graphicsSettings.depthPrepass;
+      }
+
+      /*
+       - Lower the render resolution while the GPU can't reach the target frame time,
+         and raise it again once it can
+       - The render resolution multiplier sets the highest resolution, and the render
+         targets are only allocated at that size
+      */
+      void setDynamicResolution(bool enabled) {
+        graphicsSettings.dynamicResolution = enabled;
+      }
+
+      //GPU time per frame for dynamic resolution to aim for, in seconds
+      void setTargetFrameTime(float targetFrameTime) {
+        graphicsSettings.targetFrameTime = targetFrameTime;
+      }
+
+      bool getDynamicResolution() {
+        return graphicsSettings.dynamicResolution;
+      }
+
+      float getTargetFrameTime() {
+        return graphicsSettings.targetFrameTime;
+      }
+
+      /*
+       - Store textures loaded from files block compressed, with their mipmaps created
+         on the CPU, using a quarter to an eighth of the video memory
+       - The compressed textures are saved to the data cache, if it's enabled
+       - Only affects textures loaded after it's changed
+      */
+      void setTextureCompression(bool enabled) {
+        graphicsSettings.textureCompression = enabled;
+      }
+
+      bool getTextureCompression() {
+        return graphicsSettings.textureCompression;
+      }
+
+      /*
+       - Upload only the smallest mipmaps of file textures when they're loaded, then
+         stream in larger mipmaps as they cover more of the screen
+       - Only affects textures loaded after it's changed
+      */
+      void setTextureStreaming(bool enabled) {
+        graphicsSettings.textureStreaming = enabled;
+      }
+
+      /*
+       - Video memory for streamed textures to stay within, in megabytes
+         - 0 means no limit
+       - The smallest mipmaps of each texture are always kept, even over the budget
+      */
+      void setTextureMemoryBudget(unsigned int megabytes) {
+        graphicsSettings.textureMemoryBudget = megabytes;
+      }
+
+      bool getTextureStreaming() {
+        return graphicsSettings.textureStreaming;
+      }
+
+      unsigned int getTextureMemoryBudget() {
+        return graphicsSettings.textureMemoryBudget;
+      }
+
+      /*
+       - Pack small, uncompressed diffuse textures of each model loaded from a file or
+         memory into shared atlases, remapping the texture coordinates of its meshes
+       - Meshes with texture coordinates outside of 0 to 1 keep their own textures, as
+         atlases can't repeat their images
+       - Only affects models loaded after it's changed
+      */
+      void setTextureAtlasing(bool enabled) {
+        graphicsSettings.textureAtlasing = enabled;
+      }
+
+      bool getTextureAtlasing() {
+        return graphicsSettings.textureAtlasing;
+      }
     }
   }
 }
@@ -6,6 +6,7 @@
 #include <filesystem>
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <vector>
 
 extern "C" {
@@ -15,8 +16,10 @@ extern "C" {
 #include "shaderLoader.hpp"
 
 #include "extensions.hpp"
+#include "frameData.hpp"
 #include "../utils/debug.hpp"
 #include "../utils/files.hpp"
+#include "../utils/hash.hpp"
 #include "../utils/logging.hpp"
 #include "../utils/thread.hpp"
 
@@ -59,12 +62,23 @@ namespace ammonite {
       char* binaryData;
     };
 
+    /*
+     - Hash of the sources that shaders can include, stored with cached programs
+       - Programs cached against a different version of the includes get rebuilt
+    */
+    const std::string& getIncludeHash() {
+      static const std::string includeSource = graphics::internal::frameDataBlockSource;
+      static const std::string includeHash = utils::internal::hashStrings(&includeSource, 1);
+      return includeHash;
+    }
+
     //Thread pool work to cache a program
     void doCacheWork(void* userPtr) {
       const CacheWorkerData* const data = (CacheWorkerData*)userPtr;
 
       //Prepare user data required to load the cache again
-      const std::string userData = std::to_string(data->binaryFormat) + "\n";
+      const std::string userData = std::to_string(data->binaryFormat) + "\n" + \
+                                   getIncludeHash() + "\n";
       const std::size_t userDataSize = userData.length();
       unsigned char* const userBuffer = new unsigned char[userDataSize];
       userData.copy((char*)userBuffer, userDataSize, 0);
@@ -186,6 +200,58 @@ namespace ammonite {
 
   //Shader compilation and cache functions, local to this file
   namespace {
+    /*
+     - Replace each '#include "frameData"' line of shaderCode with the shared FrameDataBuffer
+       - A '#line' directive follows the block, so compiler logs match the file's line numbers
+     - Write the resolved source to resolvedCode
+     - Returns false if an unknown or malformed include is found
+    */
+    bool resolveIncludes(std::string_view shaderCode, const std::string& shaderPath,
+                         std::string* resolvedCode) {
+      resolvedCode->clear();
+      resolvedCode->reserve(shaderCode.size() + sizeof(graphics::internal::frameDataBlockSource));
+
+      unsigned int lineNumber = 1;
+      std::size_t lineStart = 0;
+      while (lineStart < shaderCode.size()) {
+        std::size_t lineEnd = shaderCode.find('\n', lineStart);
+        lineEnd = (lineEnd == std::string_view::npos) ? shaderCode.size() : lineEnd + 1;
+        const std::string_view line = shaderCode.substr(lineStart, lineEnd - lineStart);
+        lineStart = lineEnd;
+        lineNumber++;
+
+        //Pass through anything other than an include
+        const std::size_t directiveStart = line.find_first_not_of(" \t");
+        if (directiveStart == std::string_view::npos ||
+            !line.substr(directiveStart).starts_with("#include")) {
+          resolvedCode->append(line);
+          continue;
+        }
+
+        //Find the quoted name
+        const std::size_t nameStart = line.find('"');
+        const std::size_t nameEnd = (nameStart == std::string_view::npos) ?
+          std::string_view::npos : line.find('"', nameStart + 1);
+        if (nameEnd == std::string_view::npos) {
+          ammonite::utils::warning << "Malformed include in '" << shaderPath << "'" \
+                                   << std::endl;
+          return false;
+        }
+
+        const std::string_view name = line.substr(nameStart + 1, nameEnd - nameStart - 1);
+        if (name != graphics::internal::frameDataIncludeName) {
+          ammonite::utils::warning << "Unknown include '" << name << "' in '" \
+                                   << shaderPath << "'" << std::endl;
+          return false;
+        }
+
+        resolvedCode->append(graphics::internal::frameDataBlockSource);
+        resolvedCode->append("#line " + std::to_string(lineNumber) + "\n");
+      }
+
+      return true;
+    }
+
     //Take shader source code, compile it and load it
     GLuint loadShader(const std::string& shaderPath, const GLenum shaderType) {
       //Create the shader
@@ -200,10 +266,21 @@ namespace ammonite {
         return 0;
       }
 
+      //Substitute shared definitions into the source
+      std::string resolvedCode;
+      const bool hasResolved = resolveIncludes(std::string_view(shaderCodePtr, shaderCodeSize),
+                                               shaderPath, &resolvedCode);
+      delete [] shaderCodePtr;
+      if (!hasResolved) {
+        glDeleteShader(shaderId);
+        return 0;
+      }
+
       ammoniteInternalDebug << "Compiling '" << shaderPath << "'" << std::endl;
-      glShaderSource(shaderId, 1, &shaderCodePtr, (int*)&shaderCodeSize);
+      const char* const resolvedCodePtr = resolvedCode.c_str();
+      const GLint resolvedCodeSize = (GLint)resolvedCode.size();
+      glShaderSource(shaderId, 1, &resolvedCodePtr, &resolvedCodeSize);
       glCompileShader(shaderId);
-      delete [] shaderCodePtr;
 
       //Check whether the shader compiled, log if relevant
       if (!checkShader(shaderId, shaderPath)) {
@@ -310,6 +387,20 @@ namespace ammonite {
           }
         }
 
+        //Rebuild programs cached against different shared definitions
+        if (cacheState == AMMONITE_CACHE_HIT) {
+          const std::string_view userText((char*)userData, userDataSize);
+          const std::size_t hashStart = userText.find('\n') + 1;
+          const std::size_t hashEnd = userText.find('\n', hashStart);
+          if (hashStart == 0 || hashEnd == std::string_view::npos ||
+              userText.substr(hashStart, hashEnd - hashStart) != getIncludeHash()) {
+            ammonite::utils::status << "Shared shader definitions changed, rebuilding '" \
+                                    << cacheFilePath << "'" << std::endl;
+            cacheState = AMMONITE_CACHE_INVALID;
+            delete [] cacheData;
+          }
+        }
+
         if (cacheState == AMMONITE_CACHE_HIT) {
           //Load the cached binary data into a program
           programId = glCreateProgram();
@@ -33,33 +33,50 @@ namespace ammonite {
       }
 
       void ModelShader::setUniformLocations() {
-        this->matrixId = glGetUniformLocation(this->shaderId, "MVP");
         this->modelMatrixId = glGetUniformLocation(this->shaderId, "modelMatrix");
         this->normalMatrixId = glGetUniformLocation(this->shaderId, "normalMatrix");
-        this->ambientLightId = glGetUniformLocation(this->shaderId, "ambientLight");
-        this->cameraPosId = glGetUniformLocation(this->shaderId, "cameraPos");
-        this->shadowFarPlaneId = glGetUniformLocation(this->shaderId, "shadowFarPlane");
-        this->lightCountId = glGetUniformLocation(this->shaderId, "lightCount");
         this->diffuseSamplerId = glGetUniformLocation(this->shaderId, "diffuseSampler");
         this->specularSamplerId = glGetUniformLocation(this->shaderId, "specularSampler");
+        this->materialIndexId = glGetUniformLocation(this->shaderId, "materialIndex");
         this->shadowCubeMapId = glGetUniformLocation(this->shaderId, "shadowCubeMap");
+        this->shadowAtlasSamplerId = glGetUniformLocation(this->shaderId, "shadowAtlas");
+      }
+
+      void IndirectModelShader::setUniformLocations() {
+        ModelShader::setUniformLocations();
+        this->drawOffsetId = glGetUniformLocation(this->shaderId, "drawOffset");
       }
 
       void LightShader::setUniformLocations() {
-        this->lightMatrixId = glGetUniformLocation(this->shaderId, "MVP");
+        this->modelMatrixId = glGetUniformLocation(this->shaderId, "modelMatrix");
         this->lightIndexId = glGetUniformLocation(this->shaderId, "lightIndex");
       }
 
       void DepthShader::setUniformLocations() {
         this->modelMatrixId = glGetUniformLocation(this->shaderId, "modelMatrix");
-        this->shadowFarPlaneId = glGetUniformLocation(this->shaderId, "shadowFarPlane");
         this->shadowMatrixId = glGetUniformLocation(this->shaderId, "shadowMatrices");
         this->depthShadowIndexId = glGetUniformLocation(this->shaderId, "shadowMapIndex");
+        this->faceMaskId = glGetUniformLocation(this->shaderId, "faceMask");
+        this->instanceOffsetId = glGetUniformLocation(this->shaderId, "instanceOffset");
+      }
+
+      void IndirectDepthShader::setUniformLocations() {
+        DepthShader::setUniformLocations();
+        this->drawOffsetId = glGetUniformLocation(this->shaderId, "drawOffset");
+      }
+
+      void PrepassShader::setUniformLocations() {
+        this->modelMatrixId = glGetUniformLocation(this->shaderId, "modelMatrix");
+        this->diffuseSamplerId = glGetUniformLocation(this->shaderId, "diffuseSampler");
+        this->materialIndexId = glGetUniformLocation(this->shaderId, "materialIndex");
+      }
+
+      void IndirectPrepassShader::setUniformLocations() {
+        PrepassShader::setUniformLocations();
+        this->drawOffsetId = glGetUniformLocation(this->shaderId, "drawOffset");
       }
 
       void SkyboxShader::setUniformLocations() {
-        this->viewMatrixId = glGetUniformLocation(this->shaderId, "viewMatrix");
-        this->projectionMatrixId = glGetUniformLocation(this->shaderId, "projectionMatrix");
         this->skyboxSamplerId = glGetUniformLocation(this->shaderId, "skyboxSampler");
       }
 
@@ -69,7 +86,22 @@ namespace ammonite {
         this->focalDepthId = glGetUniformLocation(this->shaderId, "focalDepth");
         this->focalDepthEnabledId = glGetUniformLocation(this->shaderId, "focalDepthEnabled");
         this->blurStrengthId = glGetUniformLocation(this->shaderId, "blurStrength");
-        this->farPlaneId = glGetUniformLocation(this->shaderId, "farPlane");
+        this->blurSamplerId = glGetUniformLocation(this->shaderId, "blurSampler");
+        this->renderScaleId = glGetUniformLocation(this->shaderId, "renderScale");
+      }
+
+      void CircleOfConfusionShader::setUniformLocations() {
+        this->screenSamplerId = glGetUniformLocation(this->shaderId, "screenSampler");
+        this->depthSamplerId = glGetUniformLocation(this->shaderId, "depthSampler");
+        this->focalDepthId = glGetUniformLocation(this->shaderId, "focalDepth");
+        this->blurStrengthId = glGetUniformLocation(this->shaderId, "blurStrength");
+        this->tapOffsetId = glGetUniformLocation(this->shaderId, "tapOffset");
+        this->renderScaleId = glGetUniformLocation(this->shaderId, "renderScale");
+      }
+
+      void BlurShader::setUniformLocations() {
+        this->sourceSamplerId = glGetUniformLocation(this->shaderId, "sourceSampler");
+        this->blurStepId = glGetUniformLocation(this->shaderId, "blurStep");
       }
 
       void SplashShader::setUniformLocations() {
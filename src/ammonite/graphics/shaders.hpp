@@ -28,23 +28,27 @@ namespace AMMONITE_INTERNAL ammonite {
       protected:
         void setUniformLocations() override;
       public:
-        GLint matrixId;
         GLint modelMatrixId;
         GLint normalMatrixId;
-        GLint ambientLightId;
-        GLint cameraPosId;
-        GLint shadowFarPlaneId;
-        GLint lightCountId;
         GLint diffuseSamplerId;
         GLint specularSamplerId;
+        GLint materialIndexId;
         GLint shadowCubeMapId;
+        GLint shadowAtlasSamplerId;
+      };
+
+      class IndirectModelShader : public ModelShader {
+      protected:
+        void setUniformLocations() override;
+      public:
+        GLint drawOffsetId;
       };
 
       class LightShader : public Shader {
       protected:
         void setUniformLocations() override;
       public:
-        GLint lightMatrixId;
+        GLint modelMatrixId;
         GLint lightIndexId;
       };
 
@@ -53,17 +57,39 @@ namespace AMMONITE_INTERNAL ammonite {
         void setUniformLocations() override;
       public:
         GLint modelMatrixId;
-        GLint shadowFarPlaneId;
         GLint shadowMatrixId;
         GLint depthShadowIndexId;
+        GLint faceMaskId;
+        GLint instanceOffsetId;
+      };
+
+      class IndirectDepthShader : public DepthShader {
+      protected:
+        void setUniformLocations() override;
+      public:
+        GLint drawOffsetId;
+      };
+
+      class PrepassShader : public Shader {
+      protected:
+        void setUniformLocations() override;
+      public:
+        GLint modelMatrixId;
+        GLint diffuseSamplerId;
+        GLint materialIndexId;
+      };
+
+      class IndirectPrepassShader : public PrepassShader {
+      protected:
+        void setUniformLocations() override;
+      public:
+        GLint drawOffsetId;
       };
 
       class SkyboxShader : public Shader {
       protected:
         void setUniformLocations() override;
       public:
-        GLint viewMatrixId;
-        GLint projectionMatrixId;
         GLint skyboxSamplerId;
       };
 
@@ -76,7 +102,28 @@ namespace AMMONITE_INTERNAL ammonite {
         GLint focalDepthId;
         GLint focalDepthEnabledId;
         GLint blurStrengthId;
-        GLint farPlaneId;
+        GLint blurSamplerId;
+        GLint renderScaleId;
+      };
+
+      class CircleOfConfusionShader : public Shader {
+      protected:
+        void setUniformLocations() override;
+      public:
+        GLint screenSamplerId;
+        GLint depthSamplerId;
+        GLint focalDepthId;
+        GLint blurStrengthId;
+        GLint tapOffsetId;
+        GLint renderScaleId;
+      };
+
+      class BlurShader : public Shader {
+      protected:
+        void setUniformLocations() override;
+      public:
+        GLint sourceSamplerId;
+        GLint blurStepId;
       };
 
       class SplashShader : public Shader {
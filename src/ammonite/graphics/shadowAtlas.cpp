@@ -0,0 +1,156 @@
+#include <algorithm>
+#include <bit>
+#include <set>
+
+#include "shadowAtlas.hpp"
+
+/*
+ - Quadtree allocator for the shadow atlas, each light face is given a square tile
+ - Tiles are power of 2 sized, so any freed tile can be reused by a tile of the
+   same size, or split into smaller tiles
+*/
+
+namespace ammonite {
+  namespace graphics {
+    namespace internal {
+      //Creates an allocator with a single free tile, sizes are rounded down to a power of 2
+      ShadowAtlasAllocator::ShadowAtlasAllocator(unsigned int atlasSize, unsigned int minTileSize) {
+        this->atlasSize = std::bit_floor(atlasSize);
+        if (this->atlasSize == 0) {
+          return;
+        }
+
+        minTileSize = std::clamp(std::bit_floor(minTileSize), 1u, this->atlasSize);
+
+        //Each level halves the tile size, down to the smallest tile
+        const unsigned int levelCount = std::countr_zero(this->atlasSize) -
+          std::countr_zero(minTileSize) + 1;
+        this->freeTiles.resize(levelCount);
+        this->freeTiles[0].insert(0);
+      }
+
+      //Find the level of the quadtree for a power of 2 tile size
+      unsigned int ShadowAtlasAllocator::getLevel(unsigned int tileSize) const {
+        return std::countr_zero(this->atlasSize) - std::countr_zero(tileSize);
+      }
+
+      //Take a free tile at a level, splitting a larger tile if required
+      bool ShadowAtlasAllocator::allocateLevel(unsigned int level, unsigned int* tileIndex) {
+        std::set<unsigned int>& levelTiles = this->freeTiles[level];
+        if (!levelTiles.empty()) {
+          *tileIndex = *levelTiles.begin();
+          levelTiles.erase(levelTiles.begin());
+          return true;
+        }
+
+        //Split a tile from the level above into 4, keeping the first
+        unsigned int parentIndex = 0;
+        if (level == 0 || !this->allocateLevel(level - 1, &parentIndex)) {
+          return false;
+        }
+
+        const unsigned int parentWidth = 1u << (level - 1);
+        const unsigned int width = parentWidth * 2;
+        const unsigned int x = (parentIndex % parentWidth) * 2;
+        const unsigned int y = (parentIndex / parentWidth) * 2;
+        *tileIndex = (y * width) + x;
+        levelTiles.insert((y * width) + x + 1);
+        levelTiles.insert(((y + 1) * width) + x);
+        levelTiles.insert(((y + 1) * width) + x + 1);
+
+        return true;
+      }
+
+      /*
+       - Reserve a square tile, writing its position and size to tile
+       - The size is rounded down to a power of 2, and clamped to the allocator's limits
+       - Returns false if there's no space for a tile of that size
+      */
+      bool ShadowAtlasAllocator::allocate(unsigned int tileSize, ShadowTile* tile) {
+        if (this->freeTiles.empty()) {
+          return false;
+        }
+
+        tileSize = std::clamp(std::bit_floor(tileSize), this->getMinTileSize(), this->atlasSize);
+        const unsigned int level = this->getLevel(tileSize);
+        unsigned int tileIndex = 0;
+        if (!this->allocateLevel(level, &tileIndex)) {
+          return false;
+        }
+
+        const unsigned int width = 1u << level;
+        tile->x = (tileIndex % width) * tileSize;
+        tile->y = (tileIndex / width) * tileSize;
+        tile->size = tileSize;
+
+        this->usedArea += tileSize * tileSize;
+        return true;
+      }
+
+      //Return a tile from allocate(), merging it with its siblings when they're all free
+      void ShadowAtlasAllocator::free(const ShadowTile& tile) {
+        if (tile.size == 0) {
+          return;
+        }
+
+        this->usedArea -= tile.size * tile.size;
+
+        unsigned int level = this->getLevel(tile.size);
+        unsigned int x = tile.x / tile.size;
+        unsigned int y = tile.y / tile.size;
+        while (level > 0) {
+          //Find the other 3 tiles that share a parent
+          const unsigned int width = 1u << level;
+          const unsigned int firstX = x & ~1u;
+          const unsigned int firstY = y & ~1u;
+          unsigned int siblingIndices[3] = {0};
+          unsigned int siblingCount = 0;
+          for (unsigned int offsetY = 0; offsetY < 2; offsetY++) {
+            for (unsigned int offsetX = 0; offsetX < 2; offsetX++) {
+              const unsigned int siblingX = firstX + offsetX;
+              const unsigned int siblingY = firstY + offsetY;
+              if (siblingX != x || siblingY != y) {
+                siblingIndices[siblingCount++] = (siblingY * width) + siblingX;
+              }
+            }
+          }
+
+          //Stop merging once a sibling is still in use
+          std::set<unsigned int>& levelTiles = this->freeTiles[level];
+          if (!std::ranges::all_of(siblingIndices, [&levelTiles](unsigned int index) {
+            return levelTiles.contains(index);
+          })) {
+            break;
+          }
+
+          for (const unsigned int siblingIndex : siblingIndices) {
+            levelTiles.erase(siblingIndex);
+          }
+
+          x /= 2;
+          y /= 2;
+          level--;
+        }
+
+        this->freeTiles[level].insert((y * (1u << level)) + x);
+      }
+
+      unsigned int ShadowAtlasAllocator::getAtlasSize() const {
+        return this->atlasSize;
+      }
+
+      unsigned int ShadowAtlasAllocator::getMinTileSize() const {
+        if (this->freeTiles.empty()) {
+          return 0;
+        }
+
+        return this->atlasSize >> (this->freeTiles.size() - 1);
+      }
+
+      //Texels covered by allocated tiles, useful to measure how full the atlas is
+      unsigned int ShadowAtlasAllocator::getUsedArea() const {
+        return this->usedArea;
+      }
+    }
+  }
+}
@@ -0,0 +1,48 @@
+#ifndef INTERNALSHADOWATLAS
+#define INTERNALSHADOWATLAS
+
+#include <set>
+#include <vector>
+
+#include "../visibility.hpp"
+
+namespace AMMONITE_INTERNAL ammonite {
+  namespace graphics {
+    namespace internal {
+      //Square region of the shadow atlas, in texels
+      struct ShadowTile {
+        unsigned int x = 0;
+        unsigned int y = 0;
+        unsigned int size = 0;
+      };
+
+      /*
+       - Split a square atlas into power of 2 sized square tiles, as a quadtree
+       - Freed tiles are merged with their siblings, so a fully freed allocator
+         always returns to a single tile
+       - Only handles bookkeeping, the owner is responsible for the texture itself
+      */
+      class ShadowAtlasAllocator {
+      private:
+        //Free tiles at each level, identified by their position in units of the level's size
+        std::vector<std::set<unsigned int>> freeTiles;
+        unsigned int atlasSize = 0;
+        unsigned int usedArea = 0;
+
+        unsigned int getLevel(unsigned int tileSize) const;
+        bool allocateLevel(unsigned int level, unsigned int* tileIndex);
+
+      public:
+        ShadowAtlasAllocator(unsigned int atlasSize, unsigned int minTileSize);
+        bool allocate(unsigned int tileSize, ShadowTile* tile);
+        void free(const ShadowTile& tile);
+
+        unsigned int getAtlasSize() const;
+        unsigned int getMinTileSize() const;
+        unsigned int getUsedArea() const;
+      };
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,83 @@
+#include <vector>
+
+#include "shadowInstances.hpp"
+
+/*
+ - Map the instances of a shadow pass to the lights and cubemap faces they draw
+ - Every light being redrawn is drawn by the same pass, with an instance of a model
+   for each face of each light it may appear on
+ - Instances of a model are contiguous, and store the cubemap layer they draw to,
+   as (light index * 6) + face
+*/
+
+namespace ammonite {
+  namespace graphics {
+    namespace internal {
+      namespace {
+        //Instance added for a model, before they're grouped by model
+        struct PendingInstance {
+          unsigned int modelIndex;
+          unsigned int layer;
+        };
+
+        std::vector<PendingInstance> pendingInstances;
+        std::vector<ShadowInstanceRun> instanceRuns;
+        std::vector<unsigned int> instanceLayers;
+      }
+
+      //Remove every instance, and prepare for models up to modelCount
+      void resetShadowInstances(unsigned int modelCount) {
+        pendingInstances.clear();
+        instanceRuns.assign(modelCount, {.firstInstance = 0, .instanceCount = 0});
+        instanceLayers.clear();
+      }
+
+      //Add an instance of a model for each cubemap face of a light in faceMask
+      void addShadowInstances(unsigned int modelIndex, unsigned int lightIndex,
+                              unsigned int faceMask) {
+        for (unsigned int face = 0; face < 6; face++) {
+          if ((faceMask & (1u << face)) != 0) {
+            pendingInstances.push_back({
+              .modelIndex = modelIndex,
+              .layer = (lightIndex * 6) + face
+            });
+            instanceRuns[modelIndex].instanceCount++;
+          }
+        }
+      }
+
+      /*
+       - Group the added instances by model, filling the runs and layers
+       - Instances of a model keep the order they were added in
+      */
+      void groupShadowInstances() {
+        unsigned int nextInstance = 0;
+        for (ShadowInstanceRun& instanceRun : instanceRuns) {
+          instanceRun.firstInstance = nextInstance;
+          nextInstance += instanceRun.instanceCount;
+        }
+
+        //Place each instance after the model's earlier ones
+        std::vector<unsigned int> modelInstanceCounts(instanceRuns.size(), 0);
+        instanceLayers.resize(pendingInstances.size());
+        for (const PendingInstance& instance : pendingInstances) {
+          const unsigned int instanceIndex = instanceRuns[instance.modelIndex].firstInstance +
+            modelInstanceCounts[instance.modelIndex]++;
+          instanceLayers[instanceIndex] = instance.layer;
+        }
+
+        pendingInstances.clear();
+      }
+
+      //Instances of each model, using its index from resetShadowInstances()
+      const std::vector<ShadowInstanceRun>& getShadowInstanceRuns() {
+        return instanceRuns;
+      }
+
+      //Cubemap layer drawn by each instance, for the shaders
+      const std::vector<unsigned int>& getShadowInstanceLayers() {
+        return instanceLayers;
+      }
+    }
+  }
+}
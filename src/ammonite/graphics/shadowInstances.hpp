@@ -0,0 +1,28 @@
+#ifndef INTERNALSHADOWINSTANCES
+#define INTERNALSHADOWINSTANCES
+
+#include <vector>
+
+#include "../visibility.hpp"
+
+namespace AMMONITE_INTERNAL ammonite {
+  namespace graphics {
+    namespace internal {
+      //Run of instances drawn for a model, each drawing one cubemap face of one light
+      struct ShadowInstanceRun {
+        unsigned int firstInstance;
+        unsigned int instanceCount;
+      };
+
+      void resetShadowInstances(unsigned int modelCount);
+      void addShadowInstances(unsigned int modelIndex, unsigned int lightIndex,
+                              unsigned int faceMask);
+      void groupShadowInstances();
+
+      const std::vector<ShadowInstanceRun>& getShadowInstanceRuns();
+      const std::vector<unsigned int>& getShadowInstanceLayers();
+    }
+  }
+}
+
+#endif
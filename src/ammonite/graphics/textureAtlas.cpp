@@ -0,0 +1,291 @@
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <numeric>
+#include <vector>
+
+extern "C" {
+  #include <epoxy/gl.h>
+}
+
+#include "textureAtlas.hpp"
+
+#include "mipmaps.hpp"
+#include "textures.hpp"
+
+/*
+ - Pack small textures into shared atlases, so meshes using them can share a
+   material and be drawn without switching textures
+ - Each image is surrounded by a gutter of its repeated edge texels, and images
+   are aligned to the gutter size, so every mipmap level keeps at least 1 texel
+   of gutter and filtering never samples a neighbouring image
+ - Nothing here touches OpenGL, the atlas is uploaded like any other texture
+*/
+
+namespace ammonite {
+  namespace textures {
+    namespace internal {
+      namespace {
+        //Largest image dimension to pack, and the largest atlas to pack into
+        constexpr int maxAtlasImageSize = 128;
+        constexpr unsigned int maxAtlasSize = 2048;
+
+        //Gutter around each image, a level's gutter is half the previous level's
+        constexpr unsigned int atlasGutter = 8;
+        constexpr unsigned int atlasMipLevels = 4;
+
+        //Round a size up to the gutter size, keeping rectangles on whole texels in every level
+        unsigned int alignAtlasSize(unsigned int size) {
+          return (size + atlasGutter - 1) & ~(atlasGutter - 1);
+        }
+
+        /*
+         - Copy an image into the atlas, filling its gutter and alignment padding with
+           the nearest edge texel
+         - rect is the image's region, excluding the gutter
+        */
+        void copyPaddedImage(const TextureData& image, const AtlasRect& rect,
+                             unsigned char* atlas, unsigned int atlasWidth) {
+          const std::size_t channels = image.numChannels;
+          const std::size_t width = image.width;
+          const std::size_t height = image.height;
+          const std::size_t paddedX = rect.x - atlasGutter;
+          const std::size_t paddedY = rect.y - atlasGutter;
+          const std::size_t paddedWidth = alignAtlasSize(rect.width + (atlasGutter * 2));
+          const std::size_t paddedHeight = alignAtlasSize(rect.height + (atlasGutter * 2));
+
+          for (std::size_t row = 0; row < paddedHeight; row++) {
+            const std::size_t sourceY = std::min(
+              (row > atlasGutter) ? row - atlasGutter : 0, height - 1);
+            const unsigned char* const sourceRow = image.data + (sourceY * width * channels);
+            unsigned char* const targetRow = atlas +
+              (((paddedY + row) * atlasWidth) + paddedX) * channels;
+
+            //Repeat the first texel over the left gutter, then copy the row
+            for (std::size_t column = 0; column < atlasGutter; column++) {
+              std::memcpy(targetRow + (column * channels), sourceRow, channels);
+            }
+            std::memcpy(targetRow + (atlasGutter * channels), sourceRow, width * channels);
+
+            //Repeat the last texel over the right gutter and padding
+            const unsigned char* const lastTexel = sourceRow + ((width - 1) * channels);
+            for (std::size_t column = atlasGutter + width; column < paddedWidth; column++) {
+              std::memcpy(targetRow + (column * channels), lastTexel, channels);
+            }
+          }
+        }
+      }
+
+      //Creates a packer with an empty skyline along the bottom of the area
+      SkylinePacker::SkylinePacker(unsigned int atlasWidth, unsigned int atlasHeight) {
+        this->atlasWidth = atlasWidth;
+        this->atlasHeight = atlasHeight;
+        if (atlasWidth != 0 && atlasHeight != 0) {
+          this->skyline.push_back({.x = 0, .y = 0, .width = atlasWidth});
+        }
+      }
+
+      /*
+       - Check if a rectangle fits with its left edge at a segment
+       - Writes the lowest position it can rest at to y
+      */
+      bool SkylinePacker::fitSegment(unsigned int segmentIndex, unsigned int width,
+                                     unsigned int height, unsigned int* y) const {
+        if (this->skyline[segmentIndex].x + width > this->atlasWidth) {
+          return false;
+        }
+
+        //Rest the rectangle on the highest segment it covers
+        unsigned int top = 0;
+        unsigned int remainingWidth = width;
+        for (unsigned int i = segmentIndex; remainingWidth > 0; i++) {
+          top = std::max(top, this->skyline[i].y);
+          if (top + height > this->atlasHeight) {
+            return false;
+          }
+
+          remainingWidth -= std::min(remainingWidth, this->skyline[i].width);
+        }
+
+        *y = top;
+        return true;
+      }
+
+      //Raise the skyline over a placed rectangle, starting at a segment
+      void SkylinePacker::addRect(unsigned int segmentIndex, const AtlasRect& rect) {
+        this->skyline.insert(this->skyline.begin() + segmentIndex,
+                             {.x = rect.x, .y = rect.y + rect.height, .width = rect.width});
+
+        //Shrink or remove the segments now under the rectangle
+        const unsigned int rectEnd = rect.x + rect.width;
+        unsigned int i = segmentIndex + 1;
+        while (i < this->skyline.size() && this->skyline[i].x < rectEnd) {
+          SkylineSegment& segment = this->skyline[i];
+          const unsigned int overlap = rectEnd - segment.x;
+          if (segment.width > overlap) {
+            segment.x += overlap;
+            segment.width -= overlap;
+            break;
+          }
+
+          this->skyline.erase(this->skyline.begin() + i);
+        }
+
+        //Merge neighbouring segments at the same height
+        i = 0;
+        while (i + 1 < this->skyline.size()) {
+          if (this->skyline[i].y == this->skyline[i + 1].y) {
+            this->skyline[i].width += this->skyline[i + 1].width;
+            this->skyline.erase(this->skyline.begin() + i + 1);
+          } else {
+            i++;
+          }
+        }
+
+        this->usedWidth = std::max(this->usedWidth, rectEnd);
+        this->usedHeight = std::max(this->usedHeight, rect.y + rect.height);
+      }
+
+      /*
+       - Place a rectangle, writing its position and size to rect
+       - Returns false if there's no space left for it
+      */
+      bool SkylinePacker::pack(unsigned int width, unsigned int height, AtlasRect* rect) {
+        if (width == 0 || height == 0) {
+          return false;
+        }
+
+        //Find the placement with the lowest top edge, preferring the leftmost
+        bool found = false;
+        unsigned int bestSegment = 0;
+        unsigned int bestY = 0;
+        for (unsigned int i = 0; i < this->skyline.size(); i++) {
+          unsigned int y = 0;
+          if (this->fitSegment(i, width, height, &y) && (!found || y < bestY)) {
+            found = true;
+            bestSegment = i;
+            bestY = y;
+          }
+        }
+
+        if (!found) {
+          return false;
+        }
+
+        *rect = {.x = this->skyline[bestSegment].x, .y = bestY,
+                 .width = width, .height = height};
+        this->addRect(bestSegment, *rect);
+        return true;
+      }
+
+      //Width of the area covered by packed rectangles
+      unsigned int SkylinePacker::getUsedWidth() const {
+        return this->usedWidth;
+      }
+
+      //Height of the area covered by packed rectangles
+      unsigned int SkylinePacker::getUsedHeight() const {
+        return this->usedHeight;
+      }
+
+      //Returns true if texture data is small and uncompressed, so it can be packed
+      bool canAtlasTexture(const TextureData& textureData) {
+        return textureData.compressedFormat == GL_NONE &&
+               textureData.width <= maxAtlasImageSize &&
+               textureData.height <= maxAtlasImageSize;
+      }
+
+      /*
+       - Pack images into a single atlas, and create its mipmaps
+         - Images must pass canAtlasTexture(), and share a channel count and colour space
+         - Only the first level of each image is used
+       - Writes the region of each image to imageRects, images that didn't fit are
+         given an empty region
+       - The atlas data is allocated like prepareTextureData(), ready for upload
+       - Returns false if no images could be packed
+      */
+      bool buildTextureAtlas(const TextureData* const* images, unsigned int imageCount,
+                             AtlasRect* imageRects, TextureData* atlasData) {
+        //Pack the tallest images first, leaving fewer gaps under the skyline
+        std::vector<unsigned int> packOrder(imageCount);
+        std::iota(packOrder.begin(), packOrder.end(), 0);
+        std::stable_sort(packOrder.begin(), packOrder.end(),
+                         [images](unsigned int left, unsigned int right) {
+          return images[left]->height > images[right]->height;
+        });
+
+        //Keep the atlas roughly square, by limiting its width to fit the total area
+        std::size_t totalArea = 0;
+        unsigned int minWidth = 0;
+        for (unsigned int i = 0; i < imageCount; i++) {
+          const unsigned int paddedWidth = alignAtlasSize(images[i]->width + (atlasGutter * 2));
+          totalArea += (std::size_t)paddedWidth *
+                       alignAtlasSize(images[i]->height + (atlasGutter * 2));
+          minWidth = std::max(minWidth, paddedWidth);
+        }
+
+        const unsigned int atlasWidth = std::clamp(
+          std::bit_ceil((unsigned int)std::ceil(std::sqrt((double)totalArea))),
+          minWidth, maxAtlasSize);
+        SkylinePacker packer(atlasWidth, maxAtlasSize);
+        unsigned int packedCount = 0;
+        for (const unsigned int imageIndex : packOrder) {
+          const TextureData& image = *images[imageIndex];
+          AtlasRect paddedRect;
+          imageRects[imageIndex] = {};
+          if (!packer.pack(alignAtlasSize(image.width + (atlasGutter * 2)),
+                           alignAtlasSize(image.height + (atlasGutter * 2)), &paddedRect)) {
+            continue;
+          }
+
+          imageRects[imageIndex] = {
+            .x = paddedRect.x + atlasGutter,
+            .y = paddedRect.y + atlasGutter,
+            .width = (unsigned int)image.width,
+            .height = (unsigned int)image.height
+          };
+          packedCount++;
+        }
+
+        if (packedCount == 0) {
+          return false;
+        }
+
+        //Clear the first level, then copy in the packed images
+        const int width = (int)packer.getUsedWidth();
+        const int height = (int)packer.getUsedHeight();
+        const int channels = images[0]->numChannels;
+        const bool srgbTexture = images[0]->srgbTexture;
+        unsigned char* const data = new unsigned char[
+          calculateMipmapChainSize(width, height, channels, atlasMipLevels)];
+        std::memset(data, 0, calculateMipmapChainSize(width, height, channels, 1));
+
+        bool hasTransparency = false;
+        for (unsigned int i = 0; i < imageCount; i++) {
+          if (imageRects[i].width != 0) {
+            copyPaddedImage(*images[i], imageRects[i], data, width);
+            hasTransparency |= images[i]->hasTransparency;
+          }
+        }
+
+        //Sizes are multiples of the gutter, so every level halves exactly
+        generateMipmaps(data, width, height, channels, srgbTexture, atlasMipLevels);
+
+        *atlasData = {
+          .width = width,
+          .height = height,
+          .numChannels = channels,
+          .srgbTexture = srgbTexture,
+          .hasTransparency = hasTransparency,
+          .data = data,
+          .compressedFormat = GL_NONE,
+          .levels = atlasMipLevels
+        };
+
+        return true;
+      }
+    }
+  }
+}
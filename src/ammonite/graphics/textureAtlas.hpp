@@ -0,0 +1,60 @@
+#ifndef INTERNALTEXTUREATLAS
+#define INTERNALTEXTUREATLAS
+
+#include <vector>
+
+#include "textures.hpp"
+#include "../visibility.hpp"
+
+namespace AMMONITE_INTERNAL ammonite {
+  namespace textures {
+    namespace internal {
+      //Rectangular region of a texture atlas, in texels
+      struct AtlasRect {
+        unsigned int x = 0;
+        unsigned int y = 0;
+        unsigned int width = 0;
+        unsigned int height = 0;
+      };
+
+      /*
+       - Pack rectangles into a fixed size area, tracking the top edge of the packed
+         rectangles as a skyline
+       - Each rectangle is placed where its top edge ends lowest, then furthest left
+       - Only handles bookkeeping, the owner is responsible for the texture itself
+      */
+      class SkylinePacker {
+      private:
+        //Horizontal segment of the skyline, ordered from left to right
+        struct SkylineSegment {
+          unsigned int x;
+          unsigned int y;
+          unsigned int width;
+        };
+
+        std::vector<SkylineSegment> skyline;
+        unsigned int atlasWidth = 0;
+        unsigned int atlasHeight = 0;
+        unsigned int usedWidth = 0;
+        unsigned int usedHeight = 0;
+
+        bool fitSegment(unsigned int segmentIndex, unsigned int width,
+                        unsigned int height, unsigned int* y) const;
+        void addRect(unsigned int segmentIndex, const AtlasRect& rect);
+
+      public:
+        SkylinePacker(unsigned int atlasWidth, unsigned int atlasHeight);
+        bool pack(unsigned int width, unsigned int height, AtlasRect* rect);
+
+        unsigned int getUsedWidth() const;
+        unsigned int getUsedHeight() const;
+      };
+
+      bool canAtlasTexture(const TextureData& textureData);
+      bool buildTextureAtlas(const TextureData* const* images, unsigned int imageCount,
+                             AtlasRect* imageRects, TextureData* atlasData);
+    }
+  }
+}
+
+#endif
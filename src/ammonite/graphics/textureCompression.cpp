@@ -0,0 +1,505 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+extern "C" {
+  #include <epoxy/gl.h>
+}
+
+#include "textureCompression.hpp"
+
+#include "extensions.hpp"
+
+/*
+ - Encode images into block compressed formats on the CPU
+ - Every format stores 4x4 blocks of pixels, blocks at the edges of images that
+   aren't a multiple of 4 repeat their closest pixels
+ - Endpoints come from the block's principal axis, then each pixel picks the
+   closest value between them
+*/
+
+namespace ammonite {
+  namespace textures {
+    namespace internal {
+      namespace {
+        //Set by updateCompressionSupport(), when the renderer is set up
+        bool isS3tcSupported = false;
+        bool isBptcSupported = false;
+
+        constexpr int blockSize = 4;
+        constexpr unsigned int blockPixels = blockSize * blockSize;
+
+        //Interpolation weights for 4-bit BC7 indices, out of 64
+        constexpr int bptcWeights[16] = {
+          0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64
+        };
+
+        //RGBA pixels of a block, in row order
+        struct PixelBlock {
+          unsigned char pixels[blockPixels][4];
+          bool isOpaque;
+        };
+
+        void readBlock(const unsigned char* data, int width, int height, int channels,
+                       int blockX, int blockY, PixelBlock* block) {
+          block->isOpaque = true;
+          for (int y = 0; y < blockSize; y++) {
+            const int pixelY = std::min((blockY * blockSize) + y, height - 1);
+            for (int x = 0; x < blockSize; x++) {
+              const int pixelX = std::min((blockX * blockSize) + x, width - 1);
+              const unsigned char* const source = data +
+                ((((std::size_t)pixelY * (std::size_t)width) + (std::size_t)pixelX) *
+                 (std::size_t)channels);
+              unsigned char* const pixel = block->pixels[(y * blockSize) + x];
+
+              //2 channel data is written to the first 2 components, for BC5
+              if (channels >= 3) {
+                pixel[0] = source[0];
+                pixel[1] = source[1];
+                pixel[2] = source[2];
+                pixel[3] = (channels == 4) ? source[3] : 255;
+              } else if (channels == 2) {
+                pixel[0] = source[0];
+                pixel[1] = source[1];
+                pixel[2] = 0;
+                pixel[3] = 255;
+              } else {
+                pixel[0] = source[0];
+                pixel[1] = source[0];
+                pixel[2] = source[0];
+                pixel[3] = 255;
+              }
+
+              block->isOpaque = block->isOpaque && (pixel[3] == 255);
+            }
+          }
+        }
+
+        /*
+         - Find a line through the first components of the block's pixels, and write
+           the points where the pixels start and end along it
+         - The ends are pulled in slightly, as the extremes are usually rare
+        */
+        void findEndpoints(const PixelBlock& block, unsigned int components,
+                           float start[4], float end[4]) {
+          float mean[4] = {0.0f};
+          for (const auto& pixel : block.pixels) {
+            for (unsigned int c = 0; c < components; c++) {
+              mean[c] += (float)pixel[c] / (float)blockPixels;
+            }
+          }
+
+          float covariance[4][4] = {{0.0f}};
+          for (const auto& pixel : block.pixels) {
+            for (unsigned int i = 0; i < components; i++) {
+              for (unsigned int j = 0; j < components; j++) {
+                covariance[i][j] += ((float)pixel[i] - mean[i]) * ((float)pixel[j] - mean[j]);
+              }
+            }
+          }
+
+          //Start from the row of the most varied component, so it can't be orthogonal
+          unsigned int largestComponent = 0;
+          for (unsigned int c = 1; c < components; c++) {
+            if (covariance[c][c] > covariance[largestComponent][largestComponent]) {
+              largestComponent = c;
+            }
+          }
+
+          //Approach the principal axis with power iteration
+          float axis[4] = {0.0f};
+          std::memcpy(axis, covariance[largestComponent], sizeof(axis));
+          for (unsigned int iteration = 0; iteration < 8; iteration++) {
+            float nextAxis[4] = {0.0f};
+            float length = 0.0f;
+            for (unsigned int i = 0; i < components; i++) {
+              for (unsigned int j = 0; j < components; j++) {
+                nextAxis[i] += covariance[i][j] * axis[j];
+              }
+              length += nextAxis[i] * nextAxis[i];
+            }
+
+            if (length <= 0.0f) {
+              break;
+            }
+
+            length = std::sqrt(length);
+            for (unsigned int c = 0; c < components; c++) {
+              axis[c] = nextAxis[c] / length;
+            }
+          }
+
+          //Find the range of the pixels along the axis
+          float minDistance = 0.0f;
+          float maxDistance = 0.0f;
+          for (const auto& pixel : block.pixels) {
+            float distance = 0.0f;
+            for (unsigned int c = 0; c < components; c++) {
+              distance += ((float)pixel[c] - mean[c]) * axis[c];
+            }
+
+            minDistance = std::min(minDistance, distance);
+            maxDistance = std::max(maxDistance, distance);
+          }
+
+          const float inset = (maxDistance - minDistance) / 16.0f;
+          minDistance += inset;
+          maxDistance -= inset;
+
+          for (unsigned int c = 0; c < components; c++) {
+            start[c] = std::clamp(mean[c] + (axis[c] * minDistance), 0.0f, 255.0f);
+            end[c] = std::clamp(mean[c] + (axis[c] * maxDistance), 0.0f, 255.0f);
+          }
+        }
+
+        void writeLittleEndian(std::uint64_t value, unsigned int bytes,
+                               unsigned char* output) {
+          for (unsigned int i = 0; i < bytes; i++) {
+            output[i] = (unsigned char)((value >> (i * 8)) & 0xFFu);
+          }
+        }
+
+        std::uint16_t packColour565(const float colour[3]) {
+          const long red = std::clamp(std::lround(colour[0] * 31.0f / 255.0f), 0l, 31l);
+          const long green = std::clamp(std::lround(colour[1] * 63.0f / 255.0f), 0l, 63l);
+          const long blue = std::clamp(std::lround(colour[2] * 31.0f / 255.0f), 0l, 31l);
+
+          return (std::uint16_t)((red << 11) | (green << 5) | blue);
+        }
+
+        void unpackColour565(std::uint16_t packed, int colour[3]) {
+          const int red = (packed >> 11) & 0x1F;
+          const int green = (packed >> 5) & 0x3F;
+          const int blue = packed & 0x1F;
+
+          colour[0] = (red << 3) | (red >> 2);
+          colour[1] = (green << 2) | (green >> 4);
+          colour[2] = (blue << 3) | (blue >> 2);
+        }
+
+        /*
+         - Write an 8 byte BC1 colour block, always using the 4 colour mode
+         - The same block is used by BC3, which doesn't support any other mode
+        */
+        void encodeColourBlock(const PixelBlock& block, unsigned char* output) {
+          float start[4] = {0.0f};
+          float end[4] = {0.0f};
+          findEndpoints(block, 3, start, end);
+
+          //The 4 colour mode is selected by storing the larger endpoint first
+          std::uint16_t colour0 = packColour565(end);
+          std::uint16_t colour1 = packColour565(start);
+          if (colour0 < colour1) {
+            std::swap(colour0, colour1);
+          }
+
+          int palette[4][3];
+          unpackColour565(colour0, palette[0]);
+          unpackColour565(colour1, palette[1]);
+          for (unsigned int c = 0; c < 3; c++) {
+            palette[2][c] = ((2 * palette[0][c]) + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + (2 * palette[1][c])) / 3;
+          }
+
+          //Matching endpoints leave every index as 0
+          std::uint32_t indices = 0;
+          if (colour0 != colour1) {
+            for (unsigned int i = 0; i < blockPixels; i++) {
+              unsigned int bestIndex = 0;
+              int bestError = 0;
+              for (unsigned int index = 0; index < 4; index++) {
+                int error = 0;
+                for (unsigned int c = 0; c < 3; c++) {
+                  const int difference = (int)block.pixels[i][c] - palette[index][c];
+                  error += difference * difference;
+                }
+
+                if (index == 0 || error < bestError) {
+                  bestIndex = index;
+                  bestError = error;
+                }
+              }
+
+              indices |= (std::uint32_t)bestIndex << (i * 2);
+            }
+          }
+
+          writeLittleEndian(colour0, 2, output);
+          writeLittleEndian(colour1, 2, output + 2);
+          writeLittleEndian(indices, 4, output + 4);
+        }
+
+        //Write an 8 byte BC4 block for one component, using the 8 value mode
+        void encodeChannelBlock(const PixelBlock& block, unsigned int component,
+                                unsigned char* output) {
+          int minValue = 255;
+          int maxValue = 0;
+          for (const auto& pixel : block.pixels) {
+            minValue = std::min(minValue, (int)pixel[component]);
+            maxValue = std::max(maxValue, (int)pixel[component]);
+          }
+
+          int palette[8] = {maxValue, minValue};
+          for (int index = 2; index < 8; index++) {
+            palette[index] = (((8 - index) * maxValue) + ((index - 1) * minValue)) / 7;
+          }
+
+          //Matching endpoints leave every index as 0
+          std::uint64_t indices = 0;
+          if (minValue != maxValue) {
+            for (unsigned int i = 0; i < blockPixels; i++) {
+              unsigned int bestIndex = 0;
+              int bestError = 256;
+              for (unsigned int index = 0; index < 8; index++) {
+                const int error = std::abs((int)block.pixels[i][component] - palette[index]);
+                if (error < bestError) {
+                  bestIndex = index;
+                  bestError = error;
+                }
+              }
+
+              indices |= (std::uint64_t)bestIndex << (i * 3);
+            }
+          }
+
+          output[0] = (unsigned char)maxValue;
+          output[1] = (unsigned char)minValue;
+          writeLittleEndian(indices, 6, output + 2);
+        }
+
+        //Append bits to a 16 byte block, starting from the lowest bit
+        struct BlockWriter {
+          unsigned char* output;
+          unsigned int bitOffset = 0;
+
+          void write(unsigned int value, unsigned int bits) {
+            for (unsigned int i = 0; i < bits; i++) {
+              if (((value >> i) & 1u) != 0) {
+                this->output[this->bitOffset / 8] |= (unsigned char)(1u << (this->bitOffset % 8));
+              }
+              this->bitOffset++;
+            }
+          }
+        };
+
+        /*
+         - Quantise an RGBA endpoint to 7 bits per component and a shared low bit
+         - Opaque blocks always set the low bit, so their alpha stays at 255
+        */
+        void quantiseBptcEndpoint(const float endpoint[4], bool isOpaque,
+                                  unsigned int quantised[4], unsigned int* pBit,
+                                  int expanded[4]) {
+          float bestError = 0.0f;
+          for (unsigned int bit = isOpaque ? 1 : 0; bit < 2; bit++) {
+            unsigned int values[4];
+            float error = 0.0f;
+            for (unsigned int c = 0; c < 4; c++) {
+              values[c] = (unsigned int)std::clamp(
+                std::lround((endpoint[c] - (float)bit) / 2.0f), 0l, 127l);
+              const float difference = (float)((values[c] << 1) | bit) - endpoint[c];
+              error += difference * difference;
+            }
+
+            if (bit == (isOpaque ? 1u : 0u) || error < bestError) {
+              bestError = error;
+              *pBit = bit;
+              for (unsigned int c = 0; c < 4; c++) {
+                quantised[c] = values[c];
+                expanded[c] = (int)((values[c] << 1) | bit);
+              }
+            }
+          }
+        }
+
+        //Write a 16 byte BC7 block, using mode 6 (a single RGBA subset with 4-bit indices)
+        void encodeBptcBlock(const PixelBlock& block, unsigned char* output) {
+          float endpoints[2][4] = {{0.0f}};
+          findEndpoints(block, 4, endpoints[0], endpoints[1]);
+
+          unsigned int quantised[2][4];
+          unsigned int pBits[2];
+          int expanded[2][4];
+          for (unsigned int e = 0; e < 2; e++) {
+            quantiseBptcEndpoint(endpoints[e], block.isOpaque, quantised[e], &pBits[e],
+                                 expanded[e]);
+          }
+
+          unsigned int indices[blockPixels];
+          for (unsigned int i = 0; i < blockPixels; i++) {
+            int bestError = 0;
+            for (unsigned int index = 0; index < 16; index++) {
+              const int weight = bptcWeights[index];
+              int error = 0;
+              for (unsigned int c = 0; c < 4; c++) {
+                const int value = (((64 - weight) * expanded[0][c]) +
+                                   (weight * expanded[1][c]) + 32) >> 6;
+                const int difference = (int)block.pixels[i][c] - value;
+                error += difference * difference;
+              }
+
+              if (index == 0 || error < bestError) {
+                indices[i] = index;
+                bestError = error;
+              }
+            }
+          }
+
+          //The first index has an implicit top bit of 0, so flip the line if it's set
+          if (indices[0] >= 8) {
+            std::swap(quantised[0], quantised[1]);
+            std::swap(pBits[0], pBits[1]);
+            for (unsigned int& index : indices) {
+              index = 15 - index;
+            }
+          }
+
+          std::memset(output, 0, 16);
+          BlockWriter writer = {.output = output};
+          writer.write(1u << 6, 7);
+          for (unsigned int c = 0; c < 4; c++) {
+            writer.write(quantised[0][c], 7);
+            writer.write(quantised[1][c], 7);
+          }
+
+          writer.write(pBits[0], 1);
+          writer.write(pBits[1], 1);
+          writer.write(indices[0], 3);
+          for (unsigned int i = 1; i < blockPixels; i++) {
+            writer.write(indices[i], 4);
+          }
+        }
+
+        //Return the bytes used by each 4x4 block of a format, or 0 if it's unknown
+        std::size_t getBlockBytes(GLenum format) {
+          switch (format) {
+          case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+          case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+            return 8;
+          case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+          case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+          case GL_COMPRESSED_RG_RGTC2:
+          case GL_COMPRESSED_RGBA_BPTC_UNORM:
+          case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+            return 16;
+          default:
+            return 0;
+          }
+        }
+      }
+
+      //Set supported compressed formats according to OpenGL support
+      void updateCompressionSupport() {
+        isS3tcSupported = graphics::internal::checkExtension("GL_EXT_texture_compression_s3tc") &&
+          (graphics::internal::checkExtension("GL_EXT_texture_sRGB") ||
+           graphics::internal::checkExtension("GL_EXT_texture_compression_s3tc_srgb"));
+        isBptcSupported = graphics::internal::checkExtension("GL_ARB_texture_compression_bptc",
+                                                             4, 2);
+      }
+
+      /*
+       - Return the compressed format to store a texture in, or GL_NONE if there isn't one
+         - Opaque colour uses BC1, falling back to BC7
+         - Transparent colour uses BC7, falling back to BC3
+         - 2 channel data uses BC5, which has no sRGB variant
+      */
+      GLenum decideCompressedFormat(int channels, bool srgbTexture, bool hasTransparency) {
+        if (channels == 2) {
+          return srgbTexture ? GL_NONE : GL_COMPRESSED_RG_RGTC2;
+        }
+
+        if (channels != 3 && channels != 4) {
+          return GL_NONE;
+        }
+
+        const GLenum bc1Format = srgbTexture ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT :
+                                               GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        const GLenum bc3Format = srgbTexture ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT :
+                                               GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        const GLenum bc7Format = srgbTexture ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM :
+                                               GL_COMPRESSED_RGBA_BPTC_UNORM;
+
+        if (!hasTransparency) {
+          if (isS3tcSupported) {
+            return bc1Format;
+          }
+
+          return isBptcSupported ? bc7Format : GL_NONE;
+        }
+
+        if (isBptcSupported) {
+          return bc7Format;
+        }
+
+        return isS3tcSupported ? bc3Format : GL_NONE;
+      }
+
+      //Return the size of a compressed image, or 0 if the format is unknown
+      std::size_t calculateCompressedSize(GLenum format, int width, int height) {
+        const std::size_t blocksX = ((std::size_t)width + blockSize - 1) / blockSize;
+        const std::size_t blocksY = ((std::size_t)height + blockSize - 1) / blockSize;
+
+        return blocksX * blocksY * getBlockBytes(format);
+      }
+
+      //Return the size of a compressed image and its first (levels - 1) mipmaps
+      std::size_t calculateCompressedSize(GLenum format, int width, int height,
+                                          unsigned int levels) {
+        std::size_t size = 0;
+        for (unsigned int level = 0; level < levels; level++) {
+          size += calculateCompressedSize(format, std::max(width >> level, 1),
+                                          std::max(height >> level, 1));
+        }
+
+        return size;
+      }
+
+      /*
+       - Compress an image into format, writing calculateCompressedSize() bytes to output
+       - Guaranteed to be thread-safe
+       - Returns true on success, false if the format isn't supported
+      */
+      bool compressImage(GLenum format, const unsigned char* data, int width, int height,
+                         int channels, unsigned char* output) {
+        const std::size_t blockBytes = getBlockBytes(format);
+        if (blockBytes == 0) {
+          return false;
+        }
+
+        const int blocksX = (width + blockSize - 1) / blockSize;
+        const int blocksY = (height + blockSize - 1) / blockSize;
+        PixelBlock block;
+        for (int blockY = 0; blockY < blocksY; blockY++) {
+          for (int blockX = 0; blockX < blocksX; blockX++) {
+            readBlock(data, width, height, channels, blockX, blockY, &block);
+            unsigned char* const blockOutput = output +
+              ((((std::size_t)blockY * (std::size_t)blocksX) + (std::size_t)blockX) * blockBytes);
+
+            switch (format) {
+            case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+            case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+              encodeColourBlock(block, blockOutput);
+              break;
+            case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+            case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+              encodeChannelBlock(block, 3, blockOutput);
+              encodeColourBlock(block, blockOutput + 8);
+              break;
+            case GL_COMPRESSED_RG_RGTC2:
+              encodeChannelBlock(block, 0, blockOutput);
+              encodeChannelBlock(block, 1, blockOutput + 8);
+              break;
+            default:
+              encodeBptcBlock(block, blockOutput);
+              break;
+            }
+          }
+        }
+
+        return true;
+      }
+    }
+  }
+}
@@ -0,0 +1,27 @@
+#ifndef INTERNALTEXTURECOMPRESSION
+#define INTERNALTEXTURECOMPRESSION
+
+#include <cstddef>
+
+extern "C" {
+  #include <epoxy/gl.h>
+}
+
+#include "../visibility.hpp"
+
+namespace AMMONITE_INTERNAL ammonite {
+  namespace textures {
+    namespace internal {
+      void updateCompressionSupport();
+
+      GLenum decideCompressedFormat(int channels, bool srgbTexture, bool hasTransparency);
+      std::size_t calculateCompressedSize(GLenum format, int width, int height);
+      std::size_t calculateCompressedSize(GLenum format, int width, int height,
+                                          unsigned int levels);
+      bool compressImage(GLenum format, const unsigned char* data, int width, int height,
+                         int channels, unsigned char* output);
+    }
+  }
+}
+
+#endif
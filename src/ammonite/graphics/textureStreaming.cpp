@@ -0,0 +1,389 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+extern "C" {
+  #include <epoxy/gl.h>
+}
+
+#include "textureStreaming.hpp"
+
+#include "mipmaps.hpp"
+#include "renderer.hpp"
+#include "textureCompression.hpp"
+#include "textures.hpp"
+#include "uploadRing.hpp"
+
+/*
+ - Stream the mipmaps of file textures in and out of video memory
+ - Textures start with only their smallest mipmaps resident, so they can be drawn
+   straight away, then the renderer reports how large each texture appears on the
+   screen, and larger mipmaps are uploaded a few at a time until they're sharp
+ - Mipmaps larger than a texture needs are dropped, and when the memory budget is
+   exceeded, the largest mipmaps of the textures seen least recently are dropped too
+ - The full mipmap chain is kept in system memory, so dropped mipmaps can return
+ - Streamed textures use mutable storage, as immutable storage can't release levels
+   - The base level is raised past any level that isn't resident
+*/
+
+namespace ammonite {
+  namespace textures {
+    namespace internal {
+      namespace {
+        //Mipmaps no larger than this are always resident
+        constexpr int tailSize = 64;
+
+        //Data to upload each frame, a larger mipmap is still uploaded alone
+        constexpr std::size_t maxFrameUploadSize = (std::size_t)16 * 1024 * 1024;
+
+        //Frames without a request before a texture falls back to its smallest mipmaps
+        constexpr std::uintmax_t forgetFrames = 120;
+
+        //Texture unit that streamed textures are bound to while their levels change
+        constexpr GLenum streamingTextureUnit = GL_TEXTURE15;
+
+        struct StreamedTexture {
+          TextureData textureData;
+          GLenum textureFormat;
+          GLenum dataFormat;
+          std::vector<std::size_t> levelOffsets;
+          unsigned int tailLevel;
+          unsigned int residentLevel;
+          unsigned int wantedLevel;
+          unsigned int frameLevel;
+          std::uintmax_t lastRequestedFrame = 0;
+        };
+
+        std::unordered_map<GLuint, StreamedTexture> streamedTextureMap;
+        std::size_t residentSize = 0;
+        std::uintmax_t streamingFrame = 0;
+
+        int getLevelWidth(const StreamedTexture& texture, unsigned int level) {
+          return std::max(texture.textureData.width >> level, 1);
+        }
+
+        int getLevelHeight(const StreamedTexture& texture, unsigned int level) {
+          return std::max(texture.textureData.height >> level, 1);
+        }
+
+        /*
+         - Return the video memory used by a level of a texture
+         - Drivers store 3 channel texels as 4 bytes, so count them that way
+        */
+        std::size_t calculateLevelSize(const StreamedTexture& texture, unsigned int level) {
+          if (texture.textureData.compressedFormat != GL_NONE) {
+            return texture.levelOffsets[level + 1] - texture.levelOffsets[level];
+          }
+
+          const int channels = (texture.textureData.numChannels == 3) ?
+            4 : texture.textureData.numChannels;
+          return calculateMipmapChainSize(getLevelWidth(texture, level),
+                                          getLevelHeight(texture, level), channels, 1);
+        }
+
+        void bindStreamedTexture(GLuint textureId) {
+          glActiveTexture(streamingTextureUnit);
+          glBindTexture(GL_TEXTURE_2D, textureId);
+        }
+
+        void unbindStreamedTexture() {
+          glBindTexture(GL_TEXTURE_2D, 0);
+          glActiveTexture(GL_TEXTURE0);
+        }
+
+        //Define a level of the bound texture from its data, staged through the upload ring
+        void uploadLevel(const StreamedTexture& texture, unsigned int level) {
+          const std::size_t dataSize = texture.levelOffsets[level + 1] -
+                                       texture.levelOffsets[level];
+          const unsigned char* const source = graphics::internal::stageUploadData(
+            texture.textureData.data + texture.levelOffsets[level], dataSize);
+
+          const int levelWidth = getLevelWidth(texture, level);
+          const int levelHeight = getLevelHeight(texture, level);
+          if (texture.textureData.compressedFormat != GL_NONE) {
+            glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)level, texture.textureFormat,
+                                   levelWidth, levelHeight, 0, (GLsizei)dataSize, source);
+          } else {
+            glTexImage2D(GL_TEXTURE_2D, (GLint)level, (GLint)texture.textureFormat,
+                         levelWidth, levelHeight, 0, texture.dataFormat, GL_UNSIGNED_BYTE,
+                         source);
+          }
+
+          graphics::internal::finishStagedUploads();
+        }
+
+        //Make the next largest level of a texture resident
+        void upgradeTexture(GLuint textureId, StreamedTexture* texture) {
+          const unsigned int level = texture->residentLevel - 1;
+          bindStreamedTexture(textureId);
+          glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+          uploadLevel(*texture, level);
+          glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+          unbindStreamedTexture();
+
+          glTextureParameteri(textureId, GL_TEXTURE_BASE_LEVEL, (GLint)level);
+          texture->residentLevel = level;
+          residentSize += calculateLevelSize(*texture, level);
+        }
+
+        //Release the largest resident level of a texture
+        void downgradeTexture(GLuint textureId, StreamedTexture* texture) {
+          const unsigned int level = texture->residentLevel;
+          glTextureParameteri(textureId, GL_TEXTURE_BASE_LEVEL, (GLint)level + 1);
+
+          //Redefining the level as empty frees its storage
+          const GLenum dataFormat = (texture->dataFormat != 0) ? texture->dataFormat : GL_RGBA;
+          bindStreamedTexture(textureId);
+          glTexImage2D(GL_TEXTURE_2D, (GLint)level, (GLint)texture->textureFormat, 0, 0, 0,
+                       dataFormat, GL_UNSIGNED_BYTE, nullptr);
+          unbindStreamedTexture();
+
+          texture->residentLevel = level + 1;
+          residentSize -= calculateLevelSize(*texture, level);
+        }
+
+        //Return the memory that findEvictionTarget() could release with requestedBefore
+        std::size_t calculateEvictableSize(std::uintmax_t requestedBefore) {
+          std::size_t evictableSize = 0;
+          for (const auto& [textureId, texture] : streamedTextureMap) {
+            if (texture.lastRequestedFrame >= requestedBefore) {
+              continue;
+            }
+
+            for (unsigned int level = texture.residentLevel; level < texture.tailLevel;
+                 level++) {
+              evictableSize += calculateLevelSize(texture, level);
+            }
+          }
+
+          return evictableSize;
+        }
+
+        /*
+         - Pick a texture to release a level from, returning its ID, or 0 if none can be
+         - Only textures last requested before requestedBefore are considered, preferring
+           the textures requested least recently, then the largest levels
+        */
+        GLuint findEvictionTarget(std::uintmax_t requestedBefore) {
+          GLuint targetId = 0;
+          const StreamedTexture* target = nullptr;
+          for (const auto& [textureId, texture] : streamedTextureMap) {
+            if (texture.residentLevel >= texture.tailLevel ||
+                texture.lastRequestedFrame >= requestedBefore) {
+              continue;
+            }
+
+            bool isBetter = (target == nullptr);
+            if (!isBetter && texture.lastRequestedFrame != target->lastRequestedFrame) {
+              isBetter = (texture.lastRequestedFrame < target->lastRequestedFrame);
+            } else if (!isBetter) {
+              isBetter = (calculateLevelSize(texture, texture.residentLevel) >
+                          calculateLevelSize(*target, target->residentLevel));
+            }
+
+            if (isBetter) {
+              targetId = textureId;
+              target = &texture;
+            }
+          }
+
+          return targetId;
+        }
+      }
+
+      /*
+       - Take ownership of a texture's data, and upload its smallest mipmaps
+       - The texture must not have storage yet
+       - The data is freed by releaseStreamedTexture()
+      */
+      void registerStreamedTexture(GLuint textureId, const TextureData& textureData,
+                                   GLenum textureFormat, GLenum dataFormat) {
+        StreamedTexture texture = {
+          .textureData = textureData,
+          .textureFormat = textureFormat,
+          .dataFormat = dataFormat,
+          .levelOffsets = std::vector<std::size_t>(textureData.levels + 1, 0),
+          .tailLevel = textureData.levels - 1,
+          .residentLevel = textureData.levels,
+          .wantedLevel = textureData.levels - 1,
+          .frameLevel = textureData.levels - 1,
+          .lastRequestedFrame = streamingFrame
+        };
+
+        //Find where each level starts, and the first level small enough to keep resident
+        for (unsigned int level = 0; level < textureData.levels; level++) {
+          const int levelWidth = getLevelWidth(texture, level);
+          const int levelHeight = getLevelHeight(texture, level);
+          const std::size_t levelDataSize = (textureData.compressedFormat != GL_NONE) ?
+            calculateCompressedSize(textureData.compressedFormat, levelWidth, levelHeight) :
+            calculateMipmapChainSize(levelWidth, levelHeight, textureData.numChannels, 1);
+          texture.levelOffsets[level + 1] = texture.levelOffsets[level] + levelDataSize;
+
+          if (level < texture.tailLevel && std::max(levelWidth, levelHeight) <= tailSize) {
+            texture.tailLevel = level;
+          }
+        }
+
+        texture.wantedLevel = texture.tailLevel;
+        texture.frameLevel = texture.tailLevel;
+
+        //Upload the tail, then only sample from the levels that exist
+        glTextureParameteri(textureId, GL_TEXTURE_MAX_LEVEL, (GLint)textureData.levels - 1);
+        glTextureParameteri(textureId, GL_TEXTURE_BASE_LEVEL, (GLint)textureData.levels - 1);
+        while (texture.residentLevel > texture.tailLevel) {
+          upgradeTexture(textureId, &texture);
+        }
+
+        streamedTextureMap[textureId] = texture;
+      }
+
+      //Forget a streamed texture and free its data, before the texture is deleted
+      void releaseStreamedTexture(GLuint textureId) {
+        const auto textureIt = streamedTextureMap.find(textureId);
+        if (textureIt == streamedTextureMap.end()) {
+          return;
+        }
+
+        StreamedTexture& texture = textureIt->second;
+        for (unsigned int level = texture.residentLevel; level < texture.textureData.levels;
+             level++) {
+          residentSize -= calculateLevelSize(texture, level);
+        }
+
+        delete [] texture.textureData.data;
+        streamedTextureMap.erase(textureIt);
+      }
+
+      bool isTextureStreamingActive() {
+        return !streamedTextureMap.empty();
+      }
+
+      /*
+       - Report that a texture covers around pixels pixels of the screen this frame
+       - Requests are combined until updateTextureStreaming(), keeping the largest
+      */
+      void requestTextureResolution(GLuint textureId, float pixels) {
+        const auto textureIt = streamedTextureMap.find(textureId);
+        if (textureIt == streamedTextureMap.end()) {
+          return;
+        }
+
+        //Find the level with a texel for each pixel
+        StreamedTexture& texture = textureIt->second;
+        const float size = (float)std::max(texture.textureData.width,
+                                           texture.textureData.height);
+        unsigned int level = 0;
+        if (pixels < size) {
+          level = (unsigned int)std::log2(size / std::max(pixels, 1.0f));
+        }
+
+        texture.frameLevel = std::min({texture.frameLevel, level, texture.tailLevel});
+        texture.lastRequestedFrame = streamingFrame;
+      }
+
+      /*
+       - Move streamed textures towards the levels requested this frame
+       - Levels are released until the budget is met, then larger levels are uploaded,
+         up to a limit each frame
+      */
+      void updateTextureStreaming() {
+        //Collect this frame's requests, forgetting textures that haven't been seen
+        for (auto& [textureId, texture] : streamedTextureMap) {
+          if (texture.lastRequestedFrame == streamingFrame) {
+            texture.wantedLevel = texture.frameLevel;
+          } else if (streamingFrame - texture.lastRequestedFrame >= forgetFrames) {
+            texture.wantedLevel = texture.tailLevel;
+          }
+
+          texture.frameLevel = texture.tailLevel;
+        }
+
+        const std::size_t budget = (std::size_t)renderer::settings::getTextureMemoryBudget() *
+                                   1024 * 1024;
+        const bool hasBudget = (budget != 0);
+
+        //Release levels nothing wants anymore, even without a budget
+        for (auto& [textureId, texture] : streamedTextureMap) {
+          while (texture.residentLevel < texture.wantedLevel) {
+            downgradeTexture(textureId, &texture);
+          }
+        }
+
+        //Release wanted levels until the budget is met, or only the tails remain
+        while (hasBudget && residentSize > budget) {
+          const GLuint targetId = findEvictionTarget(
+            std::numeric_limits<std::uintmax_t>::max());
+          if (targetId == 0) {
+            break;
+          }
+
+          downgradeTexture(targetId, &streamedTextureMap[targetId]);
+        }
+
+        //Find textures that want larger levels, furthest from their target first
+        std::vector<GLuint> upgradeIds;
+        for (const auto& [textureId, texture] : streamedTextureMap) {
+          if (texture.residentLevel > texture.wantedLevel) {
+            upgradeIds.push_back(textureId);
+          }
+        }
+
+        std::sort(upgradeIds.begin(), upgradeIds.end(), [](GLuint a, GLuint b) {
+          const StreamedTexture& textureA = streamedTextureMap[a];
+          const StreamedTexture& textureB = streamedTextureMap[b];
+          const unsigned int deficitA = textureA.residentLevel - textureA.wantedLevel;
+          const unsigned int deficitB = textureB.residentLevel - textureB.wantedLevel;
+          if (deficitA != deficitB) {
+            return deficitA > deficitB;
+          }
+
+          return a < b;
+        });
+
+        //Upload a level at a time, round-robin between textures, until the frame's limit
+        std::size_t frameUploadSize = 0;
+        bool uploadedLevel = true;
+        while (uploadedLevel && frameUploadSize < maxFrameUploadSize) {
+          uploadedLevel = false;
+          for (const GLuint textureId : upgradeIds) {
+            StreamedTexture& texture = streamedTextureMap[textureId];
+            if (texture.residentLevel <= texture.wantedLevel) {
+              continue;
+            }
+
+            //Stop at the frame's limit, unless nothing has been uploaded yet
+            const unsigned int level = texture.residentLevel - 1;
+            const std::size_t levelSize = calculateLevelSize(texture, level);
+            if (frameUploadSize != 0 && frameUploadSize + levelSize > maxFrameUploadSize) {
+              continue;
+            }
+
+            //Only make room by releasing levels of textures seen less recently
+            if (hasBudget) {
+              const std::uintmax_t requestedBefore = texture.lastRequestedFrame;
+              if (residentSize + levelSize >
+                  budget + calculateEvictableSize(requestedBefore)) {
+                continue;
+              }
+
+              while (residentSize + levelSize > budget) {
+                const GLuint targetId = findEvictionTarget(requestedBefore);
+                downgradeTexture(targetId, &streamedTextureMap[targetId]);
+              }
+            }
+
+            upgradeTexture(textureId, &texture);
+            frameUploadSize += levelSize;
+            uploadedLevel = true;
+          }
+        }
+
+        streamingFrame++;
+      }
+    }
+  }
+}
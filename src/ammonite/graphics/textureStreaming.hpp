@@ -0,0 +1,26 @@
+#ifndef INTERNALTEXTURESTREAMING
+#define INTERNALTEXTURESTREAMING
+
+extern "C" {
+  #include <epoxy/gl.h>
+}
+
+#include "textures.hpp"
+
+#include "../visibility.hpp"
+
+namespace AMMONITE_INTERNAL ammonite {
+  namespace textures {
+    namespace internal {
+      void registerStreamedTexture(GLuint textureId, const TextureData& textureData,
+                                   GLenum textureFormat, GLenum dataFormat);
+      void releaseStreamedTexture(GLuint textureId);
+      bool isTextureStreamingActive();
+
+      void requestTextureResolution(GLuint textureId, float pixels);
+      void updateTextureStreaming();
+    }
+  }
+}
+
+#endif
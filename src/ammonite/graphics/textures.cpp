@@ -1,22 +1,33 @@
 #include <algorithm>
 #include <cmath>
+#include <cstddef>
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
-#include <map>
+#include <list>
+#include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 extern "C" {
   #include <epoxy/gl.h>
-  #define STB_IMAGE_IMPLEMENTATION
-  #include <stb/stb_image.h>
 }
 
 #include "textures.hpp"
 
-#include "../maths/vector.hpp"
+#include "imageDecoders.hpp"
+#include "mipmaps.hpp"
+#include "renderer.hpp"
+#include "textureCompression.hpp"
+#include "textureStreaming.hpp"
+#include "uploadRing.hpp"
 #include "../utils/debug.hpp"
+#include "../utils/files.hpp"
+#include "../utils/flatHashMap.hpp"
+#include "../utils/hash.hpp"
 #include "../utils/logging.hpp"
+#include "../utils/thread.hpp"
 
 namespace ammonite {
   namespace textures {
@@ -25,12 +36,39 @@ namespace ammonite {
         struct TextureInfo {
           GLuint id;
           unsigned int refCount = 0;
-          std::string textureKey;
+          const std::string* texturePath = nullptr;
+          TextureKey textureKey = {};
+          bool hasTransparency = false;
+          bool hasFixedStorage = false;
+          bool isLoaded = false;
+          bool isPending = false;
         };
 
-        const unsigned int maxColourKeySize = sizeof(float) * 4;
-        std::map<GLuint, TextureInfo> idTextureMap;
-        std::unordered_map<std::string, TextureInfo*> textureKeyInfoPtrMap;
+        //Each path is only stored once, however many textures are loaded from it
+        struct InternedPath {
+          std::unique_ptr<std::string> path;
+          unsigned int refCount = 0;
+        };
+
+        //Texture decoded on the thread pool, uploaded once it's found to be finished
+        struct AsyncTextureLoad {
+          std::string texturePath;
+          bool flipTexture;
+          bool srgbTexture;
+          TextureData textureData;
+          bool loadedTexture = false;
+          bool isCancelled = false;
+          GLuint textureId;
+          AmmoniteGroup sync{0};
+        };
+
+        std::unordered_map<GLuint, TextureInfo> idTextureMap;
+        ammonite::utils::internal::FlatHashMap<TextureInfo*> textureKeyInfoPtrMap;
+        ammonite::utils::internal::FlatHashMap<InternedPath> internedPathMap;
+        std::list<AsyncTextureLoad> asyncTextureLoads;
+
+        //Asynchronous loads finished early by a synchronous load, still to be reported
+        std::vector<GLuint> earlyTextureIds;
       }
 
       namespace {
@@ -41,7 +79,15 @@ namespace ammonite {
         */
         bool decideTextureFormat(int channels, bool srgbTexture,
                                  GLenum* textureFormat, GLenum* dataFormat) {
-          if (channels == 3) {
+          if (channels == 2) {
+            //There's no sRGB format for 2 channels
+            if (srgbTexture) {
+              return false;
+            }
+
+            *dataFormat = GL_RG;
+            *textureFormat = GL_RG8;
+          } else if (channels == 3) {
             *dataFormat = GL_RGB;
             if (srgbTexture) {
               *textureFormat = GL_SRGB8;
@@ -62,94 +108,185 @@ namespace ammonite {
           return true;
         }
 
-        void enableFilteringMipmap(GLuint textureId) {
+        //Check for any pixels that aren't fully opaque, only 2 and 4 channel data has alpha
+        bool checkTransparency(const unsigned char* data, int width, int height,
+                               int channels) {
+          if (channels != 2 && channels != 4) {
+            return false;
+          }
+
+          const std::size_t pixelCount = (std::size_t)width * (std::size_t)height;
+          const std::size_t alphaOffset = (std::size_t)channels - 1;
+          for (std::size_t i = 0; i < pixelCount; i++) {
+            if (data[(i * (std::size_t)channels) + alphaOffset] != 255) {
+              return true;
+            }
+          }
+
+          return false;
+        }
+
+        //Sample 2 channel textures as grey and alpha, matching how they're loaded
+        void setChannelSwizzle(GLuint textureId, int channels) {
+          if (channels == 2) {
+            const GLint swizzle[4] = {GL_RED, GL_RED, GL_RED, GL_GREEN};
+            glTextureParameteriv(textureId, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+          }
+        }
+
+        void enableFiltering(GLuint textureId) {
           //When magnifying the image, use linear filtering
           glTextureParameteri(textureId, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
           //When minifying the image, use a linear blend of two mipmaps
           glTextureParameteri(textureId, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        }
+
+        //Return the stored copy of a path, storing it if it's new
+        const std::string* internPath(const std::string& texturePath) {
+          const ammonite::utils::internal::Hash128 pathHash =
+            ammonite::utils::internal::hashData(texturePath.data(), texturePath.size(), 0);
+          InternedPath& internedPath = internedPathMap[pathHash];
+          if (internedPath.refCount++ == 0) {
+            internedPath.path = std::make_unique<std::string>(texturePath);
+          }
 
-          //Generate mipmaps
-          glGenerateTextureMipmap(textureId);
+          return internedPath.path.get();
         }
 
-        void connectTextureCache(GLuint textureId, const std::string& textureKey) {
-          //Set the key on the texture's entry
+        //Reduce the reference counter of an interned path, freeing it if unused
+        void releasePath(const std::string* texturePath) {
+          const ammonite::utils::internal::Hash128 pathHash =
+            ammonite::utils::internal::hashData(texturePath->data(), texturePath->size(), 0);
+          InternedPath* const internedPathPtr = internedPathMap.find(pathHash);
+          if (internedPathPtr != nullptr && --internedPathPtr->refCount == 0) {
+            internedPathMap.erase(pathHash);
+          }
+        }
+
+        void connectTextureCache(GLuint textureId, const TextureKey& textureKey,
+                                 const std::string& texturePath) {
+          //Set the key and path on the texture's entry
           TextureInfo* const textureInfoPtr = &idTextureMap[textureId];
           textureInfoPtr->textureKey = textureKey;
+          textureInfoPtr->texturePath = internPath(texturePath);
 
           //Add the texture cache entry
           textureKeyInfoPtrMap[textureKey] = textureInfoPtr;
         }
 
+        //Remove a texture's cache entry, so later loads of its file don't return it
+        void disconnectTextureCache(TextureInfo* textureInfoPtr) {
+          if (textureInfoPtr->texturePath != nullptr) {
+            textureKeyInfoPtrMap.erase(textureInfoPtr->textureKey);
+            releasePath(textureInfoPtr->texturePath);
+            textureInfoPtr->texturePath = nullptr;
+          }
+        }
+
         //Return the texture ID for a key, increasing the reference counter
-        GLuint acquireTextureId (const std::string& textureKey) {
-          TextureInfo* const textureInfo = textureKeyInfoPtrMap[textureKey];
-          textureInfo->refCount++;
+        GLuint acquireTextureId(TextureInfo* textureInfoPtr) {
+          textureInfoPtr->refCount++;
+          return textureInfoPtr->id;
+        }
 
-          return textureInfo->id;
+        //Stop an asynchronous load from uploading, its data is freed once it finishes
+        void cancelAsyncTexture(GLuint textureId) {
+          for (AsyncTextureLoad& asyncLoad : asyncTextureLoads) {
+            if (asyncLoad.textureId == textureId && !asyncLoad.isCancelled) {
+              asyncLoad.isCancelled = true;
+              return;
+            }
+          }
         }
-      }
 
-      //Calculate the cache key to use for a texture and load settings
-      void calculateTextureKey(const std::string& texturePath,
-                               bool flipTexture, bool srgbTexture,
-                               std::string* textureKey) {
-        //Prepare the key's storage
-        const unsigned int colourLength = maxColourKeySize;
-        const unsigned int texturePathLength = texturePath.size();
-        const unsigned int keyLength = colourLength + texturePathLength + 1;
-        textureKey->resize(keyLength);
-
-        //Set the colour component with zeros to avoid collisions
-        std::memset(textureKey->data(), 0, colourLength);
-
-        //Set the string and load data components
-        std::memcpy(textureKey->data() + colourLength, texturePath.data(), texturePathLength);
-        const unsigned char extraData = ((int)flipTexture << 0) | ((int)srgbTexture << 1);
-        *(textureKey->data() + colourLength + texturePathLength) = std::to_string(extraData)[0];
-      }
+        /*
+         - Upload the data of a finished asynchronous load
+         - Failed loads are removed from the cache, so the file can be loaded again
+         - Returns true if the texture was uploaded
+        */
+        bool finishAsyncTexture(AsyncTextureLoad& asyncLoad) {
+          TextureInfo* const textureInfoPtr = &idTextureMap[asyncLoad.textureId];
+          textureInfoPtr->isPending = false;
+          if (asyncLoad.loadedTexture &&
+              uploadTextureData(asyncLoad.textureId, asyncLoad.textureData)) {
+            return true;
+          }
 
-      namespace {
-        template <unsigned int components>
-        void calculateTextureKeyTemplate(const ammonite::Vec<float, components>& colour,
-                                         std::string* stringPtr) {
-          //Only set the colour component
-          const unsigned int colourLength = sizeof(float) * components;
-          stringPtr->resize(colourLength);
-          std::memcpy(stringPtr->data(), &colour[0], colourLength);
+          disconnectTextureCache(textureInfoPtr);
+          return false;
         }
-      }
 
-      //Calculate the cache key to use for a 3-component colour
-      void calculateTextureKey(const ammonite::Vec<float, 3>& colour,
-                               std::string* textureKey) {
-        calculateTextureKeyTemplate(colour, textureKey);
+        /*
+         - Wait for the asynchronous load of a texture, and upload it
+         - The texture is still reported by the next updateAsyncTextures()
+         - Returns true if the texture was uploaded
+        */
+        bool waitAsyncTexture(GLuint textureId) {
+          for (auto asyncLoadIt = asyncTextureLoads.begin();
+               asyncLoadIt != asyncTextureLoads.end(); asyncLoadIt++) {
+            if (asyncLoadIt->textureId != textureId || asyncLoadIt->isCancelled) {
+              continue;
+            }
+
+            ammonite::utils::thread::waitGroupComplete(&asyncLoadIt->sync, 1);
+            const bool uploaded = finishAsyncTexture(*asyncLoadIt);
+            asyncTextureLoads.erase(asyncLoadIt);
+            earlyTextureIds.push_back(textureId);
+            return uploaded;
+          }
+
+          return false;
+        }
+
+        /*
+         - Return the texture ID for a cache entry, increasing the reference counter
+         - Waits for a pending asynchronous load, as synchronous loads return uploaded
+           textures
+         - Returns 0 if the pending load failed
+        */
+        GLuint acquireLoadedTextureId(TextureInfo* textureInfoPtr) {
+          if (textureInfoPtr->isPending && !waitAsyncTexture(textureInfoPtr->id)) {
+            return 0;
+          }
+
+          return acquireTextureId(textureInfoPtr);
+        }
       }
 
-      //Calculate the cache key to use for a 4-component colour
-      void calculateTextureKey(const ammonite::Vec<float, 4>& colour,
-                               std::string* textureKey) {
-        calculateTextureKeyTemplate(colour, textureKey);
+      /*
+       - Calculate the cache key to use for a texture and load settings
+       - Keys are 128-bit hashes, so lookups never need to compare or copy paths
+      */
+      void calculateTextureKey(const std::string& texturePath,
+                               bool flipTexture, bool srgbTexture,
+                               TextureKey* textureKey) {
+        //Use the load settings as the seed, so each combination gets its own key
+        const unsigned char extraData = ((int)flipTexture << 0) | ((int)srgbTexture << 1);
+        *textureKey = ammonite::utils::internal::hashData(texturePath.data(),
+                                                          texturePath.size(), extraData);
       }
 
       //Check if a cache key has been registered
-      bool checkTextureKey(const std::string& textureKey) {
+      bool checkTextureKey(const TextureKey& textureKey) {
         return textureKeyInfoPtrMap.contains(textureKey);
       }
 
       /*
        - Return the ID for a reserved texture key
        - Increases the reference counter
-       - Internally exposed, safer wrapper for acquireTextureId()
+       - Waits for and uploads the texture if it's still loading asynchronously
+       - Internally exposed, safer wrapper for acquireLoadedTextureId()
+       - Returns 0 on failure
       */
-      GLuint acquireTextureKeyId(const std::string& textureKey) {
-        if (!textureKeyInfoPtrMap.contains(textureKey)) {
+      GLuint acquireTextureKeyId(const TextureKey& textureKey) {
+        TextureInfo** const textureInfoPtrPtr = textureKeyInfoPtrMap.find(textureKey);
+        if (textureInfoPtrPtr == nullptr) {
           ammonite::utils::warning << "Requested ID for unreserved texture" << std::endl;
           return 0;
         }
 
-        return acquireTextureId(textureKey);
+        return acquireLoadedTextureId(*textureInfoPtrPtr);
       }
 
       /*
@@ -158,12 +295,14 @@ namespace ammonite {
          - calculateTextureKey() -> reserveTextureKey() ->
            prepareTextureData() -> uploadTextureData()
          - prepareTextureData() is thread-safe, allowing parallelised texture loads
+       - The path is only kept for debugging, the key identifies the texture
        - Returns the texture ID on success, 0 on failure
       */
-      GLuint reserveTextureKey(const std::string& textureKey) {
+      GLuint reserveTextureKey(const TextureKey& textureKey, const std::string& texturePath) {
         //Check the cache for the texture
-        if (textureKeyInfoPtrMap.contains(textureKey)) {
-          const GLuint textureId = textureKeyInfoPtrMap[textureKey]->id;
+        TextureInfo** const textureInfoPtrPtr = textureKeyInfoPtrMap.find(textureKey);
+        if (textureInfoPtrPtr != nullptr) {
+          const GLuint textureId = (*textureInfoPtrPtr)->id;
           ammonite::utils::warning << "Attempted to reserve an existing texture (ID " \
                                    << textureId << ")" << std::endl;
           return 0;
@@ -183,14 +322,270 @@ namespace ammonite {
                                    << ") already exists, not reserving texture" << std::endl;
           return 0;
         }
-        idTextureMap[textureId] = {.id = textureId, .refCount = 1, .textureKey = ""};
+        idTextureMap[textureId] = {.id = textureId, .refCount = 1};
 
-        //Connect the texture string to the ID and info
-        connectTextureCache(textureId, textureKey);
+        //Connect the texture key to the ID and info
+        connectTextureCache(textureId, textureKey, texturePath);
 
         return textureId;
       }
 
+      /*
+       - Reserve a texture outside of the cache, for data that doesn't come from a file
+       - Upload its data with uploadTextureData(), and release it with deleteTexture()
+       - Returns the texture ID on success, 0 on failure
+      */
+      GLuint reserveUncachedTexture() {
+        GLuint textureId = 0;
+        glCreateTextures(GL_TEXTURE_2D, 1, &textureId);
+        if (textureId == 0) {
+          ammonite::utils::warning << "Failed to create texture" << std::endl;
+          return 0;
+        }
+
+        idTextureMap[textureId] = {.id = textureId, .refCount = 1};
+        return textureId;
+      }
+
+      namespace {
+        /*
+         - Fill every level of a texture, from data ordered from largest to smallest
+         - The data is staged in the upload ring when it fits, so the driver can copy
+           it later instead of blocking, otherwise it's uploaded from client memory
+         - dataFormat is ignored for compressed data
+         - cubemapFace selects the face to fill for cubemaps, and must be -1 otherwise
+        */
+        void uploadTextureLevels(GLuint textureId, const TextureData& textureData,
+                                 GLenum dataFormat, GLint cubemapFace) {
+          const GLenum compressedFormat = textureData.compressedFormat;
+          const std::size_t dataSize = (compressedFormat != GL_NONE) ?
+            calculateCompressedSize(compressedFormat, textureData.width, textureData.height,
+                                    textureData.levels) :
+            calculateMipmapChainSize(textureData.width, textureData.height,
+                                     textureData.numChannels, textureData.levels);
+
+          //Copy the data to the upload ring, and read from there instead
+          const unsigned char* const source = graphics::internal::stageUploadData(
+            textureData.data, dataSize);
+
+          //Rows of each level are tightly packed, which may not fit the default alignment
+          glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+          std::size_t offset = 0;
+          for (unsigned int level = 0; level < textureData.levels; level++) {
+            const int levelWidth = std::max(textureData.width >> level, 1);
+            const int levelHeight = std::max(textureData.height >> level, 1);
+            if (compressedFormat != GL_NONE) {
+              const std::size_t levelSize = calculateCompressedSize(compressedFormat,
+                                                                    levelWidth, levelHeight);
+              if (cubemapFace < 0) {
+                glCompressedTextureSubImage2D(textureId, (GLint)level, 0, 0, levelWidth,
+                                              levelHeight, compressedFormat,
+                                              (GLsizei)levelSize, source + offset);
+              } else {
+                glCompressedTextureSubImage3D(textureId, (GLint)level, 0, 0, cubemapFace,
+                                              levelWidth, levelHeight, 1, compressedFormat,
+                                              (GLsizei)levelSize, source + offset);
+              }
+              offset += levelSize;
+            } else {
+              if (cubemapFace < 0) {
+                glTextureSubImage2D(textureId, (GLint)level, 0, 0, levelWidth, levelHeight,
+                                    dataFormat, GL_UNSIGNED_BYTE, source + offset);
+              } else {
+                glTextureSubImage3D(textureId, (GLint)level, 0, 0, cubemapFace, levelWidth,
+                                    levelHeight, 1, dataFormat, GL_UNSIGNED_BYTE,
+                                    source + offset);
+              }
+              offset += calculateMipmapChainSize(levelWidth, levelHeight,
+                                                 textureData.numChannels, 1);
+            }
+          }
+
+          glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+          graphics::internal::finishStagedUploads();
+        }
+
+        /*
+         - Replace texture data and its mipmaps with a copy compressed to format
+         - Returns true if the texture was compressed, false if it's left uncompressed
+        */
+        bool compressTextureData(TextureData* textureData, GLenum format) {
+          if (format == GL_NONE) {
+            return false;
+          }
+
+          unsigned char* const compressedData = new unsigned char[
+            calculateCompressedSize(format, textureData->width, textureData->height,
+                                    textureData->levels)];
+
+          //Compress each level of the existing mipmap chain
+          std::size_t offset = 0;
+          std::size_t compressedOffset = 0;
+          for (unsigned int level = 0; level < textureData->levels; level++) {
+            const int levelWidth = std::max(textureData->width >> level, 1);
+            const int levelHeight = std::max(textureData->height >> level, 1);
+            compressImage(format, textureData->data + offset, levelWidth, levelHeight,
+                          textureData->numChannels, compressedData + compressedOffset);
+
+            offset += calculateMipmapChainSize(levelWidth, levelHeight,
+                                               textureData->numChannels, 1);
+            compressedOffset += calculateCompressedSize(format, levelWidth, levelHeight);
+          }
+
+          delete [] textureData->data;
+          textureData->data = compressedData;
+          textureData->compressedFormat = format;
+
+          return true;
+        }
+
+        //Read the next number from the cached texture information
+        bool parseCacheValue(const char** cursor, long long* value) {
+          char* end = nullptr;
+          *value = std::strtoll(*cursor, &end, 10);
+          if (end == *cursor || (*end != ';' && *end != '\n')) {
+            return false;
+          }
+
+          *cursor = end + 1;
+          return true;
+        }
+
+        //Settings that change a texture's compressed data, so each gets its own cache file
+        std::string getCompressedCacheKey(bool flipTexture, bool srgbTexture,
+                                          bool isCubemapFace) {
+          return std::string("texture;flip=") + (flipTexture ? "1" : "0") +
+            ";srgb=" + (srgbTexture ? "1" : "0") + ";cubemap=" + (isCubemapFace ? "1" : "0");
+        }
+
+        /*
+         - Load a compressed texture and its mipmaps from the cache
+         - Flipped and sRGB loads of a file are cached separately, the stored information
+           is still checked in case the compressed format changed
+         - Cubemap faces are cached separately too, since they may use the format of a
+           face with transparency
+         - Writes the path to cache the texture to into cacheFilePath
+         - Returns true on a cache hit, false otherwise
+        */
+        bool loadCompressedCache(const std::string& texturePath, bool flipTexture,
+                                 bool srgbTexture, bool isCubemapFace,
+                                 std::string* cacheFilePath, TextureData* textureData) {
+          std::string filePaths[1] = {texturePath};
+          unsigned char* userData = nullptr;
+          std::size_t cacheDataSize = 0;
+          std::size_t userDataSize = 0;
+          AmmoniteCacheEnum cacheState = AMMONITE_CACHE_INVALID;
+          unsigned char* const cacheData = ammonite::utils::files::internal::getCachedFile(
+            cacheFilePath, filePaths, 1,
+            getCompressedCacheKey(flipTexture, srgbTexture, isCubemapFace), &cacheDataSize,
+            &userData, &userDataSize, &cacheState);
+          if (cacheState != AMMONITE_CACHE_HIT) {
+            return false;
+          }
+
+          //Format, width, height, channels, levels, transparency and flip
+          const std::string textureInfo((char*)userData, userDataSize);
+          const char* cursor = textureInfo.c_str();
+          long long values[7] = {0};
+          bool isValid = true;
+          for (long long& value : values) {
+            isValid = isValid && parseCacheValue(&cursor, &value);
+          }
+
+          const GLenum format = (GLenum)values[0];
+          const int width = (int)values[1];
+          const int height = (int)values[2];
+          const int channels = (int)values[3];
+          const unsigned int levels = (unsigned int)values[4];
+          const bool hasTransparency = (values[5] != 0);
+          const bool isFormatValid =
+            (format == decideCompressedFormat(channels, srgbTexture, hasTransparency)) ||
+            (isCubemapFace && format == decideCompressedFormat(channels, srgbTexture, true));
+          isValid = isValid && width > 0 && height > 0 && format != GL_NONE &&
+            (values[6] != 0) == flipTexture && isFormatValid &&
+            levels == calculateMipmapLevels(width, height) &&
+            cacheDataSize == calculateCompressedSize(format, width, height, levels);
+
+          if (!isValid) {
+            ammoniteInternalDebug << "Ignoring cached texture '" << *cacheFilePath \
+                                  << "'" << std::endl;
+            delete [] cacheData;
+            return false;
+          }
+
+          //The compressed levels are at the start of the cache data
+          textureData->width = width;
+          textureData->height = height;
+          textureData->numChannels = channels;
+          textureData->srgbTexture = srgbTexture;
+          textureData->hasTransparency = hasTransparency;
+          textureData->data = cacheData;
+          textureData->compressedFormat = format;
+          textureData->levels = levels;
+
+          return true;
+        }
+
+        //Write a compressed texture to the cache, with the information to validate it
+        void cacheCompressedTexture(const std::string& texturePath, bool flipTexture,
+                                    const std::string& cacheFilePath,
+                                    const TextureData& textureData) {
+          std::string filePaths[1] = {texturePath};
+          std::string textureInfo = std::to_string(textureData.compressedFormat) + ";" +
+            std::to_string(textureData.width) + ";" + std::to_string(textureData.height) +
+            ";" + std::to_string(textureData.numChannels) + ";" +
+            std::to_string(textureData.levels) + ";" +
+            std::to_string((int)textureData.hasTransparency) + ";" +
+            std::to_string((int)flipTexture) + "\n";
+
+          ammonite::utils::status << "Caching '" << cacheFilePath << "'" << std::endl;
+          const std::size_t dataSize = calculateCompressedSize(
+            textureData.compressedFormat, textureData.width, textureData.height,
+            textureData.levels);
+
+          //Write the cache file, failure messages are also handled by it
+          ammonite::utils::files::writeCacheFile(cacheFilePath, filePaths, 1, textureData.data,
+            dataSize, (unsigned char*)textureInfo.data(), textureInfo.size());
+        }
+
+        //Decode a texture and create its mipmaps, leaving them uncompressed
+        bool decodeTextureData(const std::string& texturePath, bool flipTexture,
+                               bool srgbTexture, TextureData* textureData) {
+          //Read image data
+          DecodedImage image;
+          if (!decodeImage(texturePath, flipTexture, &image)) {
+            ammonite::utils::warning << "Failed to load texture '" << texturePath \
+                                     << "'" << std::endl;
+            return false;
+          }
+
+          textureData->width = image.width;
+          textureData->height = image.height;
+          textureData->numChannels = image.channels;
+          textureData->srgbTexture = srgbTexture;
+          textureData->hasTransparency = checkTransparency(image.data, textureData->width,
+                                                           textureData->height,
+                                                           textureData->numChannels);
+
+          //Copy the image into storage for its mipmaps, then create them
+          const int width = textureData->width;
+          const int height = textureData->height;
+          const int channels = textureData->numChannels;
+          textureData->levels = calculateMipmapLevels(width, height);
+          textureData->data = new unsigned char[
+            calculateMipmapChainSize(width, height, channels, textureData->levels)];
+          std::memcpy(textureData->data, image.data,
+                      calculateMipmapChainSize(width, height, channels, 1));
+          freeDecodedImage(&image);
+          generateMipmaps(textureData->data, width, height, channels, srgbTexture,
+                          textureData->levels);
+
+          return true;
+        }
+      }
+
       /*
        - Upload data for the texture of a reserved key
          - Data should come from prepareTextureData();
@@ -207,33 +602,44 @@ namespace ammonite {
           ammonite::utils::warning << "Attempted to create a texture of unsupported size (" \
                                    << textureData.width << " x " << textureData.height \
                                    << ")" << std::endl;
+          delete [] textureData.data;
           return false;
         }
 
-        //Decide the format of the texture and data
-        GLenum textureFormat = 0;
+        //Decide the format of the texture and data, compressed data has its own format
+        GLenum textureFormat = textureData.compressedFormat;
         GLenum dataFormat = 0;
-        if (!decideTextureFormat(textureData.numChannels, textureData.srgbTexture,
+        if (textureFormat == GL_NONE &&
+            !decideTextureFormat(textureData.numChannels, textureData.srgbTexture,
                                  &textureFormat, &dataFormat)) {
           ammonite::utils::warning << "Failed to upload texture (ID " \
                                    << textureId << ")" << std::endl;
-          stbi_image_free(textureData.data);
+          delete [] textureData.data;
           return false;
         }
 
-        //Create and fill texture storage
-        const unsigned int textureLevels = calculateMipmapLevels(textureData.width,
-                                                                 textureData.height);
-        glTextureStorage2D(textureId, (GLint)textureLevels, textureFormat,
-                           textureData.width, textureData.height);
-        glTextureSubImage2D(textureId, 0, 0, 0, textureData.width, textureData.height,
-                            dataFormat, GL_UNSIGNED_BYTE, textureData.data);
-
-        //Free the texture data's storage
-        stbi_image_free(textureData.data);
+        /*
+         - Hand the texture to the streamer, which uploads its smallest mipmaps and
+           keeps the data for the rest
+         - Otherwise, create texture storage, then fill it and its mipmaps
+        */
+        if (renderer::settings::getTextureStreaming()) {
+          registerStreamedTexture(textureId, textureData, textureFormat, dataFormat);
+        } else {
+          glTextureStorage2D(textureId, (GLint)textureData.levels, textureFormat,
+                             textureData.width, textureData.height);
+          uploadTextureLevels(textureId, textureData, dataFormat, -1);
+
+          //Free the texture data's storage
+          delete [] textureData.data;
+        }
+        idTextureMap[textureId].hasTransparency = textureData.hasTransparency;
+        idTextureMap[textureId].hasFixedStorage = !renderer::settings::getTextureStreaming();
+        idTextureMap[textureId].isLoaded = true;
 
-        //Handle filtering and mipmaps
-        enableFilteringMipmap(textureId);
+        //Handle filtering, the mipmaps came with the data
+        setChannelSwizzle(textureId, textureData.numChannels);
+        enableFiltering(textureId);
 
         return true;
       }
@@ -243,31 +649,38 @@ namespace ammonite {
        - Load texture data for future upload
          - flipTextures controls whether the textures are flipped or not
          - srgbTextures controls whether the textures are treated as sRGB
+       - Mipmaps are created here, gamma-correctly for sRGB textures
+       - When texture compression is enabled, the texture and its mipmaps are compressed
+         here, and cached when the data cache is enabled
        - Guaranteed to be thread-safe
        - Returns true on success, false on failure
       */
       bool prepareTextureData(const std::string& texturePath, bool flipTexture,
                               bool srgbTexture, TextureData* textureData) {
-
-        //Handle texture flips
-        if (flipTexture) {
-          stbi_set_flip_vertically_on_load_thread(1);
-        }
-
-        //Read image data
-        textureData->data = stbi_load(texturePath.c_str(), &textureData->width,
-                                      &textureData->height, &textureData->numChannels, 0);
-        if (flipTexture) {
-          stbi_set_flip_vertically_on_load_thread(0);
+        textureData->compressedFormat = GL_NONE;
+        textureData->levels = 0;
+
+        //Use the cached compressed texture, if it matches the load settings
+        const bool useCompression = renderer::settings::getTextureCompression();
+        const bool useCache = useCompression && ammonite::utils::files::getCacheEnabled();
+        std::string cacheFilePath;
+        if (useCache && loadCompressedCache(texturePath, flipTexture, srgbTexture, false,
+                                            &cacheFilePath, textureData)) {
+          return true;
         }
 
-        if (textureData->data == nullptr) {
-          ammonite::utils::warning << "Failed to load texture '" << texturePath \
-                                   << "'" << std::endl;
+        if (!decodeTextureData(texturePath, flipTexture, srgbTexture, textureData)) {
           return false;
         }
 
-        textureData->srgbTexture = srgbTexture;
+        //Compress the texture and its mipmaps, then cache the result for future loads
+        if (useCompression) {
+          const GLenum format = decideCompressedFormat(textureData->numChannels, srgbTexture,
+                                                       textureData->hasTransparency);
+          if (compressTextureData(textureData, format) && useCache) {
+            cacheCompressedTexture(texturePath, flipTexture, cacheFilePath, *textureData);
+          }
+        }
 
         return true;
       }
@@ -277,7 +690,10 @@ namespace ammonite {
         return (unsigned int)std::log2(std::max(width, height)) + 1;
       }
 
-      //Deletes a texture created with createTexture() or load*Texture()
+      /*
+       - Deletes a texture created with loadTexture(), reserveTextureKey() or
+         reserveUncachedTexture()
+      */
       void deleteTexture(GLuint textureId) {
         //Fetch the texture info, if it exists
         if (!idTextureMap.contains(textureId)) {
@@ -289,25 +705,26 @@ namespace ammonite {
 
         //Decrease the reference counter, delete the texture if now unused
         if (--textureInfoPtr->refCount == 0) {
+          //Discard the data of an unfinished asynchronous load
+          if (textureInfoPtr->isPending) {
+            cancelAsyncTexture(textureId);
+          }
+
           //Remove the cache entry
-          if (!textureInfoPtr->textureKey.empty()) {
+          if (textureInfoPtr->texturePath != nullptr) {
             textureKeyInfoPtrMap.erase(textureInfoPtr->textureKey);
           }
 
-          //Delete the texture
+          //Delete the texture, and its streaming data
+          releaseStreamedTexture(textureInfoPtr->id);
           glDeleteTextures(1, &textureInfoPtr->id);
 
-          //Delete the tracker entry
-          if (!textureInfoPtr->textureKey.empty()) {
-            if (textureInfoPtr->textureKey.size() <= maxColourKeySize) {
-              ammoniteInternalDebug << "Deleted storage for colour texture (ID " \
-                                    << textureId << ")" << std::endl;
-            } else {
-              ammoniteInternalDebug << "Deleted storage for file texture (ID " \
-                                    << textureId << ", '" \
-                                    << textureInfoPtr->textureKey.substr(maxColourKeySize) \
-                                    << "')" << std::endl;
-            }
+          //Delete the tracker entry, and release its path
+          if (textureInfoPtr->texturePath != nullptr) {
+            ammoniteInternalDebug << "Deleted storage for file texture (ID " \
+                                  << textureId << ", '" << *textureInfoPtr->texturePath \
+                                  << "')" << std::endl;
+            releasePath(textureInfoPtr->texturePath);
           }
           idTextureMap.erase(textureId);
         }
@@ -325,102 +742,53 @@ namespace ammonite {
       }
 
       /*
-       - Create a texture from the data given, return its ID
-       - This doesn't generate the mipmaps, but allocates space for them (textureLevels)
-       - Makes no attempt at caching / deduplicating it
-       - Returns 0 on failure
+       - Returns true if a texture's data has been uploaded
+       - Textures that failed to load, or are still loading asynchronously, return false
       */
-      GLuint createTexture(int width, int height, unsigned char* data,
-                           GLenum dataFormat, GLenum textureFormat, GLint textureLevels) {
-        //Check texture size is within limits
-        GLint maxTextureSize = 0;
-        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
-        if (width > maxTextureSize || height > maxTextureSize) {
-          ammonite::utils::warning << "Attempted to create a texture of unsupported size (" \
-                                   << width << " x " << height << ")" << std::endl;
-          return 0;
+      bool isTextureLoaded(GLuint textureId) {
+        const auto textureIt = idTextureMap.find(textureId);
+        if (textureIt == idTextureMap.end()) {
+          return false;
         }
 
-        //Create a texture, its storage, and then fill it
-        GLuint textureId = 0;
-        glCreateTextures(GL_TEXTURE_2D, 1, &textureId);
-        glTextureStorage2D(textureId, textureLevels, textureFormat, width, height);
-        glTextureSubImage2D(textureId, 0, 0, 0, width, height, dataFormat,
-                            GL_UNSIGNED_BYTE, data);
+        return textureIt->second.isLoaded;
+      }
 
-        //Add the texture to the tracker
-        if (idTextureMap.contains(textureId)) {
-          ammonite::utils::warning << "Texture ID (" << textureId \
-                                   << ") already exists, not creating texture" << std::endl;
-          return 0;
+      //Returns true if a texture is still being loaded by loadTextureAsync()
+      bool isTexturePending(GLuint textureId) {
+        const auto textureIt = idTextureMap.find(textureId);
+        if (textureIt == idTextureMap.end()) {
+          return false;
         }
-        idTextureMap[textureId] = {.id = textureId, .refCount = 1, .textureKey = ""};
 
-        return textureId;
+        return textureIt->second.isPending;
       }
 
       /*
-       - Load a texture from a colour and return its ID
-       - Caches / deduplicates identical solid colour textures
-       - Returns 0 on failure
+       - Returns true if any pixel of a texture isn't fully opaque
+       - Textures that don't exist are treated as opaque
       */
-      namespace {
-        template <unsigned int components> requires (components == 3 || components == 4)
-        GLuint loadSolidTextureTemplate(const ammonite::Vec<float, components>& colour) {
-          //Calculate the texture's cache key
-          std::string textureKey;
-          calculateTextureKey(colour, &textureKey);
-
-          //Check the cache for the texture
-          if (textureKeyInfoPtrMap.contains(textureKey)) {
-            return acquireTextureId(textureKey);
-          }
-
-          //Decide the format of the texture and data
-          GLenum textureFormat = 0;
-          GLenum dataFormat = 0;
-          if (!decideTextureFormat(components, false, &textureFormat, &dataFormat)) {
-            ammonite::utils::warning << "Failed to load texture from colour" << std::endl;
-            return 0;
-          }
-
-          //Convert the colour into the required format
-          ammonite::Vec<float, components> scaledColour = {0};
-          ammonite::scale(colour, 255.0f, scaledColour);
-          unsigned char data[components] = {
-            (unsigned char)scaledColour[0],
-            (unsigned char)scaledColour[1],
-            (unsigned char)scaledColour[2]
-          };
-          if constexpr (components == 4) {
-            data[3] = (unsigned char)scaledColour[3];
-          }
-
-          //Create the texture and free the image data
-          const unsigned int mipmapLevels = calculateMipmapLevels(1, 1);
-          const GLuint textureId = createTexture(1, 1, data, dataFormat, textureFormat,
-                                                 (GLint)mipmapLevels);
-          if (textureId == 0) {
-            ammonite::utils::warning << "Failed to load texture from colour" << std::endl;
-            return 0;
-          }
-
-          //Connect the texture string to the ID and info
-          connectTextureCache(textureId, textureKey);
-
-          //Handle filtering and mipmaps
-          enableFilteringMipmap(textureId);
-
-          return textureId;
+      bool isTextureTransparent(GLuint textureId) {
+        const auto textureIt = idTextureMap.find(textureId);
+        if (textureIt == idTextureMap.end()) {
+          return false;
         }
-      }
 
-      GLuint loadSolidTexture(const ammonite::Vec<float, 3>& colour) {
-        return loadSolidTextureTemplate(colour);
+        return textureIt->second.hasTransparency;
       }
 
-      GLuint loadSolidTexture(const ammonite::Vec<float, 4>& colour) {
-        return loadSolidTextureTemplate(colour);
+      /*
+       - Returns true if a texture is uploaded and its levels won't change, so it can be
+         sampled through a bindless handle
+       - Streamed textures move their base level, which a handle would freeze
+      */
+      bool hasFixedTextureStorage(GLuint textureId) {
+        const auto textureIt = idTextureMap.find(textureId);
+        if (textureIt == idTextureMap.end()) {
+          return false;
+        }
+
+        return textureIt->second.hasFixedStorage;
       }
 
       /*
@@ -433,16 +801,18 @@ namespace ammonite {
       GLuint loadTexture(const std::string& texturePath, bool flipTexture,
                          bool srgbTexture) {
         //Calculate the texture's cache key
-        std::string textureKey;
+        TextureKey textureKey;
         calculateTextureKey(texturePath, flipTexture, srgbTexture, &textureKey);
 
         //Use texture cache, if already loaded / reserved
-        if (checkTextureKey(textureKey)) {
-          return acquireTextureId(textureKey);
+        TextureInfo** const textureInfoPtrPtr = textureKeyInfoPtrMap.find(textureKey);
+        if (textureInfoPtrPtr != nullptr) {
+          return acquireLoadedTextureId(*textureInfoPtrPtr);
         }
 
         //Reserve the texture key before loading
-        const GLuint textureId = textures::internal::reserveTextureKey(textureKey);
+        const GLuint textureId = textures::internal::reserveTextureKey(textureKey,
+                                                                       texturePath);
         if (textureId == 0) {
           ammonite::utils::warning << "Failed to reserve texture ID" << std::endl;
           return 0;
@@ -465,79 +835,316 @@ namespace ammonite {
         return textureId;
       }
 
+      namespace {
+        void asyncTextureWorker(void* userPtr) {
+          AsyncTextureLoad* const asyncLoad = (AsyncTextureLoad*)userPtr;
+          asyncLoad->loadedTexture = prepareTextureData(asyncLoad->texturePath,
+                                                        asyncLoad->flipTexture,
+                                                        asyncLoad->srgbTexture,
+                                                        &asyncLoad->textureData);
+        }
+      }
+
+      /*
+       - Start loading a texture from a file on the thread pool, and return its ID
+         - flipTexture controls whether the texture is flipped or not
+         - srgbTexture controls whether the texture is treated as sRGB
+       - The texture has no data until updateAsyncTextures() uploads it, and
+         isTexturePending() returns true until then
+       - Caches / deduplicates same-file textures, a cached texture may be returned
+         before or after it's loaded
+       - Returns 0 on failure
+      */
+      GLuint loadTextureAsync(const std::string& texturePath, bool flipTexture,
+                              bool srgbTexture) {
+        //Use texture cache, if already loaded / reserved
+        TextureKey textureKey;
+        calculateTextureKey(texturePath, flipTexture, srgbTexture, &textureKey);
+        TextureInfo** const textureInfoPtrPtr = textureKeyInfoPtrMap.find(textureKey);
+        if (textureInfoPtrPtr != nullptr) {
+          return acquireTextureId(*textureInfoPtrPtr);
+        }
+
+        const GLuint textureId = reserveTextureKey(textureKey, texturePath);
+        if (textureId == 0) {
+          ammonite::utils::warning << "Failed to reserve texture ID" << std::endl;
+          return 0;
+        }
+        idTextureMap[textureId].isPending = true;
+
+        //Decode the texture on the thread pool
+        AsyncTextureLoad& asyncLoad = asyncTextureLoads.emplace_back();
+        asyncLoad.texturePath = texturePath;
+        asyncLoad.flipTexture = flipTexture;
+        asyncLoad.srgbTexture = srgbTexture;
+        asyncLoad.textureId = textureId;
+        ammonite::utils::thread::submitWork(asyncTextureWorker, &asyncLoad, &asyncLoad.sync);
+
+        return textureId;
+      }
+
+      /*
+       - Upload the asynchronous texture loads that have finished, without waiting for
+         the rest
+       - Writes the IDs of the textures that finished to finishedTextureIds, including
+         those that failed to load, or were finished early by a synchronous load
+       - Failed loads are removed from the cache
+      */
+      void updateAsyncTextures(std::vector<GLuint>* finishedTextureIds) {
+        finishedTextureIds->insert(finishedTextureIds->end(), earlyTextureIds.begin(),
+                                   earlyTextureIds.end());
+        earlyTextureIds.clear();
+
+        auto asyncLoadIt = asyncTextureLoads.begin();
+        while (asyncLoadIt != asyncTextureLoads.end()) {
+          AsyncTextureLoad& asyncLoad = *asyncLoadIt;
+          if (!ammonite::utils::thread::isSingleWorkComplete(&asyncLoad.sync)) {
+            asyncLoadIt++;
+            continue;
+          }
+
+          //Cancelled loads only need their data freeing, the texture is already gone
+          if (asyncLoad.isCancelled) {
+            if (asyncLoad.loadedTexture) {
+              delete [] asyncLoad.textureData.data;
+            }
+          } else {
+            finishAsyncTexture(asyncLoad);
+            finishedTextureIds->push_back(asyncLoad.textureId);
+          }
+
+          asyncLoadIt = asyncTextureLoads.erase(asyncLoadIt);
+        }
+      }
+
+      //Wait for outstanding asynchronous texture loads, then discard them
+      void deleteAsyncTextures() {
+        for (AsyncTextureLoad& asyncLoad : asyncTextureLoads) {
+          ammonite::utils::thread::waitGroupComplete(&asyncLoad.sync, 1);
+          if (asyncLoad.loadedTexture) {
+            delete [] asyncLoad.textureData.data;
+          }
+
+          if (!asyncLoad.isCancelled) {
+            idTextureMap[asyncLoad.textureId].isPending = false;
+          }
+        }
+
+        asyncTextureLoads.clear();
+        earlyTextureIds.clear();
+      }
+
+      namespace {
+        struct CubemapFaceJob {
+          const std::string* texturePath;
+          bool flipTexture;
+          bool srgbTexture;
+          bool useCache;
+          std::string cacheFilePath;
+          GLenum compressedFormat;
+          TextureData textureData;
+          bool loadedTexture;
+        };
+
+        //Load a face from the cache, or decode it and leave compression until later
+        void cubemapFaceWorker(void* userPtr) {
+          CubemapFaceJob* const job = (CubemapFaceJob*)userPtr;
+          job->textureData.compressedFormat = GL_NONE;
+          job->textureData.levels = 0;
+          if (job->useCache && loadCompressedCache(*job->texturePath, job->flipTexture,
+                                                   job->srgbTexture, true, &job->cacheFilePath,
+                                                   &job->textureData)) {
+            job->loadedTexture = true;
+            return;
+          }
+
+          job->loadedTexture = decodeTextureData(*job->texturePath, job->flipTexture,
+                                                 job->srgbTexture, &job->textureData);
+        }
+
+        /*
+         - Convert a face to the format shared by the cubemap, then cache it
+         - Cached faces in a different format are decoded again, since they can't be
+           converted
+        */
+        void cubemapFormatWorker(void* userPtr) {
+          CubemapFaceJob* const job = (CubemapFaceJob*)userPtr;
+          TextureData* const textureData = &job->textureData;
+          if (textureData->compressedFormat == job->compressedFormat) {
+            return;
+          }
+
+          if (textureData->compressedFormat != GL_NONE) {
+            delete [] textureData->data;
+            textureData->compressedFormat = GL_NONE;
+            job->loadedTexture = decodeTextureData(*job->texturePath, job->flipTexture,
+                                                   job->srgbTexture, textureData);
+            if (!job->loadedTexture) {
+              return;
+            }
+          }
+
+          if (compressTextureData(textureData, job->compressedFormat) && job->useCache) {
+            cacheCompressedTexture(*job->texturePath, job->flipTexture, job->cacheFilePath,
+                                   *textureData);
+          }
+        }
+
+        /*
+         - Decide one compressed format for every face, from the union of their transparency
+         - Faces with different numbers of channels can't share a compressed format, so
+           they're left uncompressed
+        */
+        GLenum decideCubemapFormat(const CubemapFaceJob faceJobs[6], bool srgbTextures) {
+          if (!renderer::settings::getTextureCompression()) {
+            return GL_NONE;
+          }
+
+          const int channels = faceJobs[0].textureData.numChannels;
+          bool hasTransparency = false;
+          for (int i = 0; i < 6; i++) {
+            const TextureData& face = faceJobs[i].textureData;
+            if (face.numChannels != channels) {
+              return GL_NONE;
+            }
+
+            hasTransparency = hasTransparency || face.hasTransparency;
+          }
+
+          return decideCompressedFormat(channels, srgbTextures, hasTransparency);
+        }
+
+        //Check every face loaded, and is square and matching in size
+        bool checkCubemapFaces(const CubemapFaceJob faceJobs[6]) {
+          //Faces that failed to load have already been reported
+          for (int i = 0; i < 6; i++) {
+            if (!faceJobs[i].loadedTexture) {
+              return false;
+            }
+          }
+
+          const TextureData& firstFace = faceJobs[0].textureData;
+          for (int i = 0; i < 6; i++) {
+            const TextureData& face = faceJobs[i].textureData;
+            if (face.width != face.height || face.width != firstFace.width ||
+                face.height != firstFace.height) {
+              ammonite::utils::warning << "Cubemap face '" << *faceJobs[i].texturePath \
+                                       << "' must be square and match the other faces (" \
+                                       << face.width << " x " << face.height << ")" \
+                                       << std::endl;
+              return false;
+            }
+          }
+
+          return true;
+        }
+
+        void deleteCubemapFaces(const CubemapFaceJob faceJobs[6]) {
+          for (int i = 0; i < 6; i++) {
+            if (faceJobs[i].loadedTexture) {
+              delete [] faceJobs[i].textureData.data;
+            }
+          }
+        }
+      }
+
       /*
        - Load 6 textures as a cubemap and return its ID
          - flipTextures controls whether the textures are flipped or not
          - srgbTextures controls whether the textures are treated as sRGB
+       - The faces are decoded together on the thread pool, and prepared like other
+         file textures, including compression and caching
+       - Every face uses the same compressed format, decided once all faces are loaded
        - Returns 0 on failure
       */
       GLuint loadCubemap(std::string texturePaths[6], bool flipTextures,
                          bool srgbTextures) {
-        GLuint textureId = 0;
-        glCreateTextures(GL_TEXTURE_CUBE_MAP, 1, &textureId);
-
-        //Load each face into a cubemap
-        bool hasCreatedStorage = false;
+        //Decode and mipmap every face at once, or load them from the cache
+        const bool useCache = renderer::settings::getTextureCompression() &&
+          ammonite::utils::files::getCacheEnabled();
+        CubemapFaceJob faceJobs[6];
         for (int i = 0; i < 6; i++) {
-          if (flipTextures) {
-            stbi_set_flip_vertically_on_load_thread(1);
-          }
+          faceJobs[i] = {
+            .texturePath = &texturePaths[i],
+            .flipTexture = flipTextures,
+            .srgbTexture = srgbTextures,
+            .useCache = useCache,
+            .cacheFilePath = {},
+            .compressedFormat = GL_NONE,
+            .textureData = {},
+            .loadedTexture = false
+          };
+        }
 
-          //Read the image data
-          int width = 0;
-          int height = 0;
-          int nChannels = 0;
-          unsigned char* const imageData = stbi_load(texturePaths[i].c_str(), &width,
-                                                     &height, &nChannels, 0);
+        AmmoniteGroup group{0};
+        ammonite::utils::thread::submitMultipleSync(cubemapFaceWorker, faceJobs,
+                                                    sizeof(CubemapFaceJob), &group, 6);
+        ammonite::utils::thread::waitGroupComplete(&group, 6);
 
-          //Disable texture flipping, to avoid interfering with future calls
-          if (flipTextures) {
-            stbi_set_flip_vertically_on_load_thread(0);
+        //Convert every face to a shared format at once, then check the faces match
+        bool isValid = true;
+        for (const CubemapFaceJob& faceJob : faceJobs) {
+          isValid = isValid && faceJob.loadedTexture;
+        }
+
+        GLenum internalFormat = GL_NONE;
+        if (isValid) {
+          internalFormat = decideCubemapFormat(faceJobs, srgbTextures);
+          for (CubemapFaceJob& faceJob : faceJobs) {
+            faceJob.compressedFormat = internalFormat;
           }
 
-          //Decide the format of the texture and data
-          GLenum internalFormat = 0;
-          GLenum dataFormat = 0;
-          if (!decideTextureFormat(nChannels, srgbTextures,
-              &internalFormat, &dataFormat)) {
-            //Free image data, destroy texture and return
-            ammonite::utils::warning << "Failed to load '" << texturePaths[i] \
-                                     << "'" << std::endl;
-            stbi_image_free(imageData);
-            glDeleteTextures(1, &textureId);
+          ammonite::utils::thread::submitMultipleSync(cubemapFormatWorker, faceJobs,
+                                                      sizeof(CubemapFaceJob), &group, 6);
+          ammonite::utils::thread::waitGroupComplete(&group, 6);
+          isValid = checkCubemapFaces(faceJobs);
+        }
 
-            return 0;
+        //Uncompressed faces use the most channels of any face, the rest are converted
+        const TextureData* textureData = &faceJobs[0].textureData;
+        for (const CubemapFaceJob& faceJob : faceJobs) {
+          if (faceJob.textureData.numChannels > textureData->numChannels) {
+            textureData = &faceJob.textureData;
           }
+        }
 
-          //Only create texture storage once
-          if (!hasCreatedStorage) {
-            glTextureStorage2D(textureId,
-              (GLint)ammonite::textures::internal::calculateMipmapLevels(width, height),
-              internalFormat, width, height);
-            hasCreatedStorage = true;
-          }
+        GLenum dataFormat = 0;
+        if (isValid && internalFormat == GL_NONE) {
+          isValid = decideTextureFormat(textureData->numChannels, srgbTextures,
+                                        &internalFormat, &dataFormat);
+        }
 
-          //Fill the texture with each face
-          if (imageData != nullptr) {
-            glTextureSubImage3D(textureId, 0, 0, 0, i, width, height, 1, dataFormat,
-                                GL_UNSIGNED_BYTE, imageData);
-            stbi_image_free(imageData);
-          } else {
-            //Free image data, destroy texture and return
-            ammonite::utils::warning << "Failed to load '" << texturePaths[i] \
-                                     << "'" << std::endl;
-            stbi_image_free(imageData);
-            glDeleteTextures(1, &textureId);
+        if (!isValid) {
+          ammonite::utils::warning << "Failed to load cubemap" << std::endl;
+          deleteCubemapFaces(faceJobs);
+          return 0;
+        }
 
-            return 0;
+        //Create storage for every face, then fill each face and its mipmaps
+        GLuint textureId = 0;
+        glCreateTextures(GL_TEXTURE_CUBE_MAP, 1, &textureId);
+        glTextureStorage2D(textureId, (GLint)textureData->levels, internalFormat,
+                           textureData->width, textureData->height);
+        setChannelSwizzle(textureId, textureData->numChannels);
+        for (int i = 0; i < 6; i++) {
+          //Faces with a different number of channels are converted by the upload
+          const TextureData& face = faceJobs[i].textureData;
+          GLenum faceDataFormat = dataFormat;
+          if (face.compressedFormat == GL_NONE) {
+            GLenum faceInternalFormat = 0;
+            decideTextureFormat(face.numChannels, srgbTextures, &faceInternalFormat,
+                                &faceDataFormat);
           }
+
+          uploadTextureLevels(textureId, face, faceDataFormat, i);
+          delete [] face.data;
         }
 
-        //Handle filtering and mipmaps
+        //Handle filtering, the mipmaps came with the data
         glTextureParameteri(textureId, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
         glTextureParameteri(textureId, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
         glTextureParameteri(textureId, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-        enableFilteringMipmap(textureId);
+        enableFiltering(textureId);
 
         return textureId;
       }
@@ -2,42 +2,51 @@
 #define INTERNALTEXTURES
 
 #include <string>
+#include <vector>
 
 extern "C" {
   #include <epoxy/gl.h>
 }
 
+#include "../utils/hash.hpp"
 #include "../visibility.hpp"
-#include "../maths/vector.hpp"
 
 namespace AMMONITE_INTERNAL ammonite {
   namespace textures {
     namespace internal {
-      GLuint createTexture(int width, int height, unsigned char* data, GLenum dataFormat,
-                           GLenum textureFormat, GLint textureLevels);
       GLuint loadTexture(const std::string& texturePath, bool flipTexture, bool srgbTexture);
-
-      GLuint loadSolidTexture(const ammonite::Vec<float, 3>& colour);
-      GLuint loadSolidTexture(const ammonite::Vec<float, 4>& colour);
+      GLuint loadTextureAsync(const std::string& texturePath, bool flipTexture,
+                              bool srgbTexture);
+      void updateAsyncTextures(std::vector<GLuint>* finishedTextureIds);
+      void deleteAsyncTextures();
 
       void copyTexture(GLuint textureId);
       void deleteTexture(GLuint textureId);
+      bool isTextureTransparent(GLuint textureId);
+      bool hasFixedTextureStorage(GLuint textureId);
+      bool isTextureLoaded(GLuint textureId);
+      bool isTexturePending(GLuint textureId);
 
       struct TextureData {
         int width;
         int height;
         int numChannels;
         bool srgbTexture;
+        bool hasTransparency;
         unsigned char* data;
+        GLenum compressedFormat = GL_NONE;
+        unsigned int levels = 0;
       };
 
+      //Identifies a texture file and its load settings
+      using TextureKey = ammonite::utils::internal::Hash128;
+
       void calculateTextureKey(const std::string& texturePath, bool flipTexture,
-                               bool srgbTexture, std::string* textureKey);
-      void calculateTextureKey(const ammonite::Vec<float, 3>& colour, std::string* textureKey);
-      void calculateTextureKey(const ammonite::Vec<float, 4>& colour, std::string* textureKey);
-      bool checkTextureKey(const std::string& textureKey);
-      GLuint acquireTextureKeyId(const std::string& textureKey);
-      GLuint reserveTextureKey(const std::string& textureKey);
+                               bool srgbTexture, TextureKey* textureKey);
+      bool checkTextureKey(const TextureKey& textureKey);
+      GLuint acquireTextureKeyId(const TextureKey& textureKey);
+      GLuint reserveTextureKey(const TextureKey& textureKey, const std::string& texturePath);
+      GLuint reserveUncachedTexture();
       bool prepareTextureData(const std::string& texturePath, bool flipTexture,
                               bool srgbTexture, TextureData* textureData);
       bool uploadTextureData(GLuint textureId, const TextureData& textureData);
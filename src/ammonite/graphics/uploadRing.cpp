@@ -0,0 +1,153 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+
+extern "C" {
+  #include <epoxy/gl.h>
+}
+
+#include "uploadRing.hpp"
+
+/*
+ - Persistently mapped staging buffer for texture uploads
+ - Data is copied into the ring and uploaded from a buffer offset, so the driver
+   can copy it to the texture later instead of blocking until it's consumed
+ - Space is handed out in order, and each batch of uploads is covered by a fence
+   that must signal before the space can be reused
+ - Positions are tracked as offsets that only grow, the position in the buffer is
+   the offset modulo the ring's size
+*/
+
+namespace ammonite {
+  namespace graphics {
+    namespace internal {
+      namespace {
+        constexpr std::size_t uploadRingSize = (std::size_t)64 * 1024 * 1024;
+
+        //Keep each reservation aligned for any pixel or block format
+        constexpr std::size_t uploadAlignment = 64;
+
+        //Time to wait for a fence before trying again, in nanoseconds
+        constexpr GLuint64 fenceTimeout = 1000000;
+
+        struct UploadRegion {
+          GLsync fence;
+          std::uint64_t start;
+        };
+
+        GLuint uploadBufferId = 0;
+        unsigned char* mappedData = nullptr;
+        std::uint64_t writeOffset = 0;
+        std::uint64_t fencedOffset = 0;
+        std::deque<UploadRegion> pendingRegions;
+
+        void createUploadRing() {
+          const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+          glCreateBuffers(1, &uploadBufferId);
+          glNamedBufferStorage(uploadBufferId, (GLsizeiptr)uploadRingSize, nullptr, flags);
+          mappedData = (unsigned char*)glMapNamedBufferRange(uploadBufferId, 0,
+                                                             (GLsizeiptr)uploadRingSize, flags);
+        }
+
+        void waitForRegion(const UploadRegion& region) {
+          while (glClientWaitSync(region.fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                  fenceTimeout) == GL_TIMEOUT_EXPIRED) {}
+          glDeleteSync(region.fence);
+        }
+
+        /*
+         - Reserve size bytes of the upload ring, and return where to write them
+           - bufferOffset is set to the matching offset in the ring's buffer
+         - Waits for earlier uploads if they still use the space
+         - Returns nullptr if the data doesn't fit in the ring, or mapping failed
+        */
+        unsigned char* reserveUploadSpace(std::size_t size, std::size_t* bufferOffset) {
+          if (size == 0 || size > uploadRingSize) {
+            return nullptr;
+          }
+
+          if (uploadBufferId == 0) {
+            createUploadRing();
+          }
+
+          if (mappedData == nullptr) {
+            return nullptr;
+          }
+
+          //Align the start, and skip to the next lap if the space would run past the end
+          std::uint64_t start = ((writeOffset + uploadAlignment - 1) / uploadAlignment) *
+                                uploadAlignment;
+          if ((start % uploadRingSize) + size > uploadRingSize) {
+            start = ((start / uploadRingSize) + 1) * uploadRingSize;
+          }
+
+          //Wait for uploads that used the space on the previous lap
+          const std::uint64_t end = start + size;
+          while (!pendingRegions.empty() && pendingRegions.front().start + uploadRingSize < end) {
+            waitForRegion(pendingRegions.front());
+            pendingRegions.pop_front();
+          }
+
+          writeOffset = end;
+          *bufferOffset = (std::size_t)(start % uploadRingSize);
+          return mappedData + *bufferOffset;
+        }
+
+        //Fence the space reserved since the last call, once its uploads have been issued
+        void fenceUploadSpace() {
+          if (writeOffset == fencedOffset) {
+            return;
+          }
+
+          pendingRegions.push_back({
+            .fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0),
+            .start = fencedOffset
+          });
+          fencedOffset = writeOffset;
+        }
+      }
+
+      /*
+       - Copy data into the upload ring and bind the ring for unpacking
+       - Returns the pointer to give to the upload, as an offset into the ring, or
+         data unchanged if it doesn't fit and has to be read from client memory
+      */
+      const unsigned char* stageUploadData(const unsigned char* data, std::size_t size) {
+        std::size_t bufferOffset = 0;
+        unsigned char* const stagingData = reserveUploadSpace(size, &bufferOffset);
+        if (stagingData == nullptr) {
+          glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+          return data;
+        }
+
+        std::memcpy(stagingData, data, size);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploadBufferId);
+        return (const unsigned char*)bufferOffset;
+      }
+
+      //Stop unpacking from the ring, and protect staged data until its uploads complete
+      void finishStagedUploads() {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        fenceUploadSpace();
+      }
+
+      void deleteUploadRing() {
+        for (const UploadRegion& region : pendingRegions) {
+          glDeleteSync(region.fence);
+        }
+        pendingRegions.clear();
+
+        if (uploadBufferId != 0) {
+          glUnmapNamedBuffer(uploadBufferId);
+          glDeleteBuffers(1, &uploadBufferId);
+          uploadBufferId = 0;
+        }
+
+        mappedData = nullptr;
+        writeOffset = 0;
+        fencedOffset = 0;
+      }
+    }
+  }
+}
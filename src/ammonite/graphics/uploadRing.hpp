@@ -0,0 +1,18 @@
+#ifndef INTERNALUPLOADRING
+#define INTERNALUPLOADRING
+
+#include <cstddef>
+
+#include "../visibility.hpp"
+
+namespace AMMONITE_INTERNAL ammonite {
+  namespace graphics {
+    namespace internal {
+      const unsigned char* stageUploadData(const unsigned char* data, std::size_t size);
+      void finishStagedUploads();
+      void deleteUploadRing();
+    }
+  }
+}
+
+#endif
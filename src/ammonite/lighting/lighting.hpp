@@ -33,6 +33,9 @@ namespace AMMONITE_INTERNAL ammonite {
       void destroyLightSystem();
 
       LightSource* getLightSourcePtr(AmmoniteId lightId);
+      void getPackedLightPosition(unsigned int lightIndex,
+                                  ammonite::Vec<float, 3>& position);
+      float getPackedLightRange(unsigned int lightIndex);
     }
   }
 }
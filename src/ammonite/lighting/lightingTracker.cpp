@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <iterator>
 #include <unordered_map>
@@ -32,6 +34,9 @@ namespace ammonite {
       using ShaderShadowTransform = ammonite::Mat<float, 4>[6];
       ShaderLightSource* shaderLightData = nullptr;
       ShaderShadowTransform* shaderShadowData = nullptr;
+
+      //Contribution below which a light is treated as out of range, under 1 step of 8-bit colour
+      constexpr float lightCutoff = 1.0f / 256.0f;
     }
 
     namespace {
@@ -52,8 +57,16 @@ namespace ammonite {
           modelPtr->lightIndex = lightSource->lightIndex;
         }
 
-        //Repack lighting information
-        ammonite::set(shaderLightData[index][0], lightSource->position, 0.0f);
+        //Find where the brightest channel's attenuated contribution falls below the cutoff
+        const float peakColour = std::max({lightSource->diffuse[0], lightSource->diffuse[1],
+                                           lightSource->diffuse[2]}) +
+                                 std::max({lightSource->specular[0], lightSource->specular[1],
+                                           lightSource->specular[2]});
+        const float range = std::sqrt(std::max(lightSource->power * peakColour, 0.0f) /
+                                      lightCutoff);
+
+        //Repack lighting information, position.w is the light's range
+        ammonite::set(shaderLightData[index][0], lightSource->position, range);
         ammonite::set(shaderLightData[index][1], lightSource->diffuse, 0.0f);
         ammonite::set(shaderLightData[index][2], lightSource->specular, lightSource->power);
 
@@ -103,6 +116,20 @@ namespace ammonite {
         return nullptr;
       }
 
+      /*
+       - Write the position of the light at lightIndex, as last packed for rendering
+       - Only valid after updateLightSources(), for indices below the light count
+      */
+      void getPackedLightPosition(unsigned int lightIndex,
+                                  ammonite::Vec<float, 3>& position) {
+        ammonite::copy(shaderLightData[lightIndex][0], position);
+      }
+
+      //Distance past which the light at lightIndex is ignored, valid under the same conditions
+      float getPackedLightRange(unsigned int lightIndex) {
+        return shaderLightData[lightIndex][0][3];
+      }
+
       void destroyLightSystem() {
         //Destroy the GPU buffers
         graphics::internal::deleteLightBuffers();
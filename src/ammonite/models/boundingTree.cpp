@@ -0,0 +1,505 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "boundingTree.hpp"
+
+#include "../maths/vector.hpp"
+#include "../utils/id.hpp"
+
+/*
+ - Incrementally maintained bounding volume hierarchy, based on the dynamic
+   AABB tree used by Box2D
+ - New leaves are placed next to the sibling that grows the surface area of
+   the tree the least, then ancestors are refitted and rebalanced
+*/
+
+namespace ammonite {
+  namespace models {
+    namespace internal {
+      namespace {
+        //Fraction of a box's largest side added to each side of a leaf, and the minimum margin
+        constexpr float marginFactor = 0.1f;
+        constexpr float minimumMargin = 0.01f;
+
+        void combineBounds(const BoundingBox& a, const BoundingBox& b, BoundingBox& dest) {
+          for (unsigned int axis = 0; axis < 3; axis++) {
+            dest.minimum[axis] = std::min(a.minimum[axis], b.minimum[axis]);
+            dest.maximum[axis] = std::max(a.maximum[axis], b.maximum[axis]);
+          }
+        }
+
+        float surfaceArea(const BoundingBox& bounds) {
+          const float width = bounds.maximum[0] - bounds.minimum[0];
+          const float height = bounds.maximum[1] - bounds.minimum[1];
+          const float depth = bounds.maximum[2] - bounds.minimum[2];
+          return 2.0f * ((width * height) + (width * depth) + (height * depth));
+        }
+
+        float combinedSurfaceArea(const BoundingBox& a, const BoundingBox& b) {
+          BoundingBox combined;
+          combineBounds(a, b, combined);
+          return surfaceArea(combined);
+        }
+
+        bool containsBounds(const BoundingBox& outer, const BoundingBox& inner) {
+          for (unsigned int axis = 0; axis < 3; axis++) {
+            if (inner.minimum[axis] < outer.minimum[axis] ||
+                inner.maximum[axis] > outer.maximum[axis]) {
+              return false;
+            }
+          }
+
+          return true;
+        }
+
+        //Enlarge bounds on every side, scaled by the size of the box
+        void fattenBounds(const BoundingBox& bounds, BoundingBox& dest) {
+          float largestSide = 0.0f;
+          for (unsigned int axis = 0; axis < 3; axis++) {
+            largestSide = std::max(largestSide, bounds.maximum[axis] - bounds.minimum[axis]);
+          }
+
+          const float margin = std::max(largestSide * marginFactor, minimumMargin);
+          ammonite::sub(bounds.minimum, margin, dest.minimum);
+          ammonite::add(bounds.maximum, margin, dest.maximum);
+        }
+
+        //Squared distance from a point to the closest point of a box
+        float distanceSquared(const BoundingBox& bounds, const ammonite::Vec<float, 3>& point) {
+          float distance = 0.0f;
+          for (unsigned int axis = 0; axis < 3; axis++) {
+            const float closest = std::clamp(point[axis], bounds.minimum[axis],
+                                             bounds.maximum[axis]);
+            distance += (closest - point[axis]) * (closest - point[axis]);
+          }
+
+          return distance;
+        }
+
+        /*
+         - Find where a ray enters a box, using the slab method
+         - Returns false if the box is missed, or only hit beyond maxDistance
+        */
+        bool intersectRay(const BoundingBox& bounds, const ammonite::Vec<float, 3>& origin,
+                          const ammonite::Vec<float, 3>& inverseDirection,
+                          float maxDistance, float* distance) {
+          float nearDistance = 0.0f;
+          float farDistance = maxDistance;
+          for (unsigned int axis = 0; axis < 3; axis++) {
+            float nearSlab = (bounds.minimum[axis] - origin[axis]) * inverseDirection[axis];
+            float farSlab = (bounds.maximum[axis] - origin[axis]) * inverseDirection[axis];
+            if (nearSlab > farSlab) {
+              std::swap(nearSlab, farSlab);
+            }
+
+            nearDistance = std::max(nearDistance, nearSlab);
+            farDistance = std::min(farDistance, farSlab);
+            if (nearDistance > farDistance) {
+              return false;
+            }
+          }
+
+          *distance = nearDistance;
+          return true;
+        }
+
+        /*
+         - Test a box against the planes selected by planeMask
+         - Returns false if the box is fully outside any plane, otherwise clears
+           the bits of planes the box is fully inside of
+        */
+        bool testFrustumPlanes(const BoundingBox& bounds, const ammonite::Vec<float, 4> planes[6],
+                               unsigned int* planeMask) {
+          for (unsigned int i = 0; i < 6; i++) {
+            if ((*planeMask & (1u << i)) == 0) {
+              continue;
+            }
+
+            //Distance of the centre, and the box's projected radius onto the plane's normal
+            float centreDistance = planes[i][3];
+            float radius = 0.0f;
+            for (unsigned int axis = 0; axis < 3; axis++) {
+              const float centre = (bounds.minimum[axis] + bounds.maximum[axis]) * 0.5f;
+              const float extent = (bounds.maximum[axis] - bounds.minimum[axis]) * 0.5f;
+              centreDistance += planes[i][axis] * centre;
+              radius += std::abs(planes[i][axis]) * extent;
+            }
+
+            if (centreDistance + radius < 0.0f) {
+              return false;
+            }
+
+            if (centreDistance - radius >= 0.0f) {
+              *planeMask &= ~(1u << i);
+            }
+          }
+
+          return true;
+        }
+      }
+
+      //Take a node from the free list, or add a new one
+      unsigned int BoundingTree::allocateNode() {
+        if (this->freeNode == nullNode) {
+          this->nodes.emplace_back();
+          return this->nodes.size() - 1;
+        }
+
+        //Free nodes are linked through their parent
+        const unsigned int nodeIndex = this->freeNode;
+        this->freeNode = this->nodes[nodeIndex].parent;
+        this->nodes[nodeIndex] = TreeNode();
+        return nodeIndex;
+      }
+
+      void BoundingTree::releaseNode(unsigned int nodeIndex) {
+        this->nodes[nodeIndex].parent = this->freeNode;
+        this->nodes[nodeIndex].height = -1;
+        this->freeNode = nodeIndex;
+      }
+
+      bool BoundingTree::isLeaf(unsigned int nodeIndex) const {
+        return this->nodes[nodeIndex].children[0] == nullNode;
+      }
+
+      void BoundingTree::insertLeaf(unsigned int leafIndex) {
+        if (this->rootNode == nullNode) {
+          this->rootNode = leafIndex;
+          this->nodes[leafIndex].parent = nullNode;
+          return;
+        }
+
+        //Find the cheapest sibling for the new leaf
+        const BoundingBox leafBounds = this->nodes[leafIndex].bounds;
+        unsigned int siblingIndex = this->rootNode;
+        while (!this->isLeaf(siblingIndex)) {
+          const TreeNode& node = this->nodes[siblingIndex];
+          const float area = surfaceArea(node.bounds);
+          const float combinedArea = combinedSurfaceArea(node.bounds, leafBounds);
+
+          //Cost of pairing with this node, and the cost pushed down to its children
+          const float pairCost = 2.0f * combinedArea;
+          const float inheritedCost = 2.0f * (combinedArea - area);
+
+          float childCosts[2] = {0.0f, 0.0f};
+          for (unsigned int i = 0; i < 2; i++) {
+            const TreeNode& child = this->nodes[node.children[i]];
+            childCosts[i] = combinedSurfaceArea(child.bounds, leafBounds) + inheritedCost;
+            if (!this->isLeaf(node.children[i])) {
+              childCosts[i] -= surfaceArea(child.bounds);
+            }
+          }
+
+          if (pairCost < childCosts[0] && pairCost < childCosts[1]) {
+            break;
+          }
+
+          siblingIndex = (childCosts[0] < childCosts[1]) ? node.children[0] : node.children[1];
+        }
+
+        //Create a new parent for the sibling and the leaf
+        const unsigned int oldParentIndex = this->nodes[siblingIndex].parent;
+        const unsigned int newParentIndex = this->allocateNode();
+        TreeNode& newParent = this->nodes[newParentIndex];
+        newParent.parent = oldParentIndex;
+        newParent.children[0] = siblingIndex;
+        newParent.children[1] = leafIndex;
+        newParent.height = this->nodes[siblingIndex].height + 1;
+        combineBounds(this->nodes[siblingIndex].bounds, leafBounds, newParent.bounds);
+
+        if (oldParentIndex == nullNode) {
+          this->rootNode = newParentIndex;
+        } else {
+          TreeNode& oldParent = this->nodes[oldParentIndex];
+          const unsigned int childSlot = (oldParent.children[0] == siblingIndex) ? 0 : 1;
+          oldParent.children[childSlot] = newParentIndex;
+        }
+
+        this->nodes[siblingIndex].parent = newParentIndex;
+        this->nodes[leafIndex].parent = newParentIndex;
+
+        this->refitAncestors(this->nodes[leafIndex].parent);
+      }
+
+      void BoundingTree::removeLeaf(unsigned int leafIndex) {
+        if (leafIndex == this->rootNode) {
+          this->rootNode = nullNode;
+          return;
+        }
+
+        //Replace the leaf's parent with its sibling
+        const unsigned int parentIndex = this->nodes[leafIndex].parent;
+        const TreeNode& parent = this->nodes[parentIndex];
+        const unsigned int grandparentIndex = parent.parent;
+        const unsigned int siblingIndex = (parent.children[0] == leafIndex) ?
+          parent.children[1] : parent.children[0];
+
+        this->nodes[siblingIndex].parent = grandparentIndex;
+        this->releaseNode(parentIndex);
+        if (grandparentIndex == nullNode) {
+          this->rootNode = siblingIndex;
+          return;
+        }
+
+        TreeNode& grandparent = this->nodes[grandparentIndex];
+        const unsigned int childSlot = (grandparent.children[0] == parentIndex) ? 0 : 1;
+        grandparent.children[childSlot] = siblingIndex;
+
+        this->refitAncestors(grandparentIndex);
+      }
+
+      //Rebalance, then recalculate the bounds and height of a node and its ancestors
+      void BoundingTree::refitAncestors(unsigned int nodeIndex) {
+        while (nodeIndex != nullNode) {
+          nodeIndex = this->balance(nodeIndex);
+
+          TreeNode& node = this->nodes[nodeIndex];
+          const TreeNode& childA = this->nodes[node.children[0]];
+          const TreeNode& childB = this->nodes[node.children[1]];
+          node.height = 1 + std::max(childA.height, childB.height);
+          combineBounds(childA.bounds, childB.bounds, node.bounds);
+
+          nodeIndex = node.parent;
+        }
+      }
+
+      /*
+       - Rotate the taller child of a node above it, if the children's heights
+         differ by more than 1
+       - Returns the index of the node now in the original node's position
+      */
+      unsigned int BoundingTree::balance(unsigned int nodeIndex) {
+        if (this->isLeaf(nodeIndex) || this->nodes[nodeIndex].height < 2) {
+          return nodeIndex;
+        }
+
+        const int heightDifference = this->nodes[this->nodes[nodeIndex].children[1]].height -
+                                     this->nodes[this->nodes[nodeIndex].children[0]].height;
+        if (heightDifference >= -1 && heightDifference <= 1) {
+          return nodeIndex;
+        }
+
+        //Promote the taller child, keeping the shorter child in place
+        const unsigned int tallSlot = (heightDifference > 1) ? 1 : 0;
+        const unsigned int shortSlot = 1 - tallSlot;
+        const unsigned int tallIndex = this->nodes[nodeIndex].children[tallSlot];
+        const unsigned int shortIndex = this->nodes[nodeIndex].children[shortSlot];
+
+        TreeNode& node = this->nodes[nodeIndex];
+        TreeNode& tall = this->nodes[tallIndex];
+
+        //Move the promoted child into the node's position
+        tall.parent = node.parent;
+        node.parent = tallIndex;
+        if (tall.parent == nullNode) {
+          this->rootNode = tallIndex;
+        } else {
+          TreeNode& parent = this->nodes[tall.parent];
+          const unsigned int childSlot = (parent.children[0] == nodeIndex) ? 0 : 1;
+          parent.children[childSlot] = tallIndex;
+        }
+
+        //The promoted child keeps its taller child, and gives the other to the node
+        const unsigned int grandchildA = tall.children[0];
+        const unsigned int grandchildB = tall.children[1];
+        const bool keepFirst = this->nodes[grandchildA].height > this->nodes[grandchildB].height;
+        const unsigned int keptIndex = keepFirst ? grandchildA : grandchildB;
+        const unsigned int movedIndex = keepFirst ? grandchildB : grandchildA;
+
+        tall.children[0] = nodeIndex;
+        tall.children[1] = keptIndex;
+        node.children[tallSlot] = movedIndex;
+        this->nodes[movedIndex].parent = nodeIndex;
+
+        //Refit the demoted node, then the promoted child
+        const TreeNode& shortNode = this->nodes[shortIndex];
+        const TreeNode& movedNode = this->nodes[movedIndex];
+        const TreeNode& keptNode = this->nodes[keptIndex];
+        combineBounds(shortNode.bounds, movedNode.bounds, node.bounds);
+        node.height = 1 + std::max(shortNode.height, movedNode.height);
+        combineBounds(node.bounds, keptNode.bounds, tall.bounds);
+        tall.height = 1 + std::max(node.height, keptNode.height);
+
+        return tallIndex;
+      }
+
+      //Add a model's bounds to the tree, returning the node to use for future updates
+      unsigned int BoundingTree::insert(const BoundingBox& bounds, AmmoniteId modelId) {
+        const unsigned int leafIndex = this->allocateNode();
+        TreeNode& leaf = this->nodes[leafIndex];
+        leaf.leafBounds = bounds;
+        leaf.modelId = modelId;
+        fattenBounds(bounds, leaf.bounds);
+
+        this->insertLeaf(leafIndex);
+        this->leafCount++;
+        return leafIndex;
+      }
+
+      void BoundingTree::remove(unsigned int nodeIndex) {
+        this->removeLeaf(nodeIndex);
+        this->releaseNode(nodeIndex);
+        this->leafCount--;
+      }
+
+      /*
+       - Replace the bounds of a leaf
+       - The leaf is only moved if the new bounds escape its enlarged bounds,
+         returns true when this happens
+      */
+      bool BoundingTree::update(unsigned int nodeIndex, const BoundingBox& bounds) {
+        TreeNode& leaf = this->nodes[nodeIndex];
+        leaf.leafBounds = bounds;
+        if (containsBounds(leaf.bounds, bounds)) {
+          return false;
+        }
+
+        this->removeLeaf(nodeIndex);
+        fattenBounds(bounds, this->nodes[nodeIndex].bounds);
+        this->insertLeaf(nodeIndex);
+        return true;
+      }
+
+      /*
+       - Append the IDs of models intersecting the frustum to modelIds
+       - Subtrees fully inside a plane skip testing against it
+      */
+      void BoundingTree::queryFrustum(const ammonite::Vec<float, 4> planes[6],
+                                      std::vector<AmmoniteId>* modelIds) {
+        if (this->rootNode == nullNode) {
+          return;
+        }
+
+        //Stack holds pairs of node indices and the planes left to test
+        const unsigned int allPlanes = (1u << 6) - 1;
+        this->stack.clear();
+        this->stack.push_back(this->rootNode);
+        this->stack.push_back(allPlanes);
+        while (!this->stack.empty()) {
+          unsigned int planeMask = this->stack.back();
+          this->stack.pop_back();
+          const unsigned int nodeIndex = this->stack.back();
+          this->stack.pop_back();
+
+          const TreeNode& node = this->nodes[nodeIndex];
+          if (planeMask != 0 && !testFrustumPlanes(node.bounds, planes, &planeMask)) {
+            continue;
+          }
+
+          if (this->isLeaf(nodeIndex)) {
+            //Enlarged bounds fully inside means the exact bounds are too
+            if (planeMask == 0 || testFrustumPlanes(node.leafBounds, planes, &planeMask)) {
+              modelIds->push_back(node.modelId);
+            }
+            continue;
+          }
+
+          for (const unsigned int childIndex : node.children) {
+            this->stack.push_back(childIndex);
+            this->stack.push_back(planeMask);
+          }
+        }
+      }
+
+      //Append the IDs of models intersecting the sphere to modelIds
+      void BoundingTree::querySphere(const ammonite::Vec<float, 3>& centre, float radius,
+                                     std::vector<AmmoniteId>* modelIds) {
+        if (this->rootNode == nullNode) {
+          return;
+        }
+
+        const float radiusSquared = radius * radius;
+        this->stack.clear();
+        this->stack.push_back(this->rootNode);
+        while (!this->stack.empty()) {
+          const unsigned int nodeIndex = this->stack.back();
+          this->stack.pop_back();
+
+          const TreeNode& node = this->nodes[nodeIndex];
+          if (distanceSquared(node.bounds, centre) > radiusSquared) {
+            continue;
+          }
+
+          if (this->isLeaf(nodeIndex)) {
+            if (distanceSquared(node.leafBounds, centre) <= radiusSquared) {
+              modelIds->push_back(node.modelId);
+            }
+            continue;
+          }
+
+          this->stack.push_back(node.children[0]);
+          this->stack.push_back(node.children[1]);
+        }
+      }
+
+      /*
+       - Find the closest model whose bounds are hit by a ray, ignoring ignoredModelId
+       - Writes the distance along the ray to distance, in multiples of direction
+       - Returns 0 if nothing was hit
+      */
+      AmmoniteId BoundingTree::queryRay(const ammonite::Vec<float, 3>& origin,
+                                        const ammonite::Vec<float, 3>& direction,
+                                        AmmoniteId ignoredModelId, float* distance) {
+        if (this->rootNode == nullNode) {
+          return 0;
+        }
+
+        ammonite::Vec<float, 3> inverseDirection = {0};
+        for (unsigned int axis = 0; axis < 3; axis++) {
+          inverseDirection[axis] = 1.0f / direction[axis];
+        }
+
+        AmmoniteId closestModelId = 0;
+        float closestDistance = std::numeric_limits<float>::infinity();
+        this->stack.clear();
+        this->stack.push_back(this->rootNode);
+        while (!this->stack.empty()) {
+          const unsigned int nodeIndex = this->stack.back();
+          this->stack.pop_back();
+
+          //Skip nodes that can't beat the closest hit
+          const TreeNode& node = this->nodes[nodeIndex];
+          float hitDistance = 0.0f;
+          if (!intersectRay(node.bounds, origin, inverseDirection,
+                            closestDistance, &hitDistance)) {
+            continue;
+          }
+
+          if (this->isLeaf(nodeIndex)) {
+            if (node.modelId != ignoredModelId &&
+                intersectRay(node.leafBounds, origin, inverseDirection,
+                             closestDistance, &hitDistance)) {
+              closestModelId = node.modelId;
+              closestDistance = hitDistance;
+            }
+            continue;
+          }
+
+          this->stack.push_back(node.children[0]);
+          this->stack.push_back(node.children[1]);
+        }
+
+        if (closestModelId != 0) {
+          *distance = closestDistance;
+        }
+
+        return closestModelId;
+      }
+
+      unsigned int BoundingTree::getLeafCount() const {
+        return this->leafCount;
+      }
+
+      //Height of the tree, a single leaf has a height of 0
+      int BoundingTree::getHeight() const {
+        if (this->rootNode == nullNode) {
+          return -1;
+        }
+
+        return this->nodes[this->rootNode].height;
+      }
+    }
+  }
+}
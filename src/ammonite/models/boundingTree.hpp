@@ -0,0 +1,70 @@
+#ifndef INTERNALBOUNDINGTREE
+#define INTERNALBOUNDINGTREE
+
+#include <limits>
+#include <vector>
+
+#include "modelTypes.hpp"
+
+#include "../maths/vector.hpp"
+#include "../utils/id.hpp"
+#include "../visibility.hpp"
+
+namespace AMMONITE_INTERNAL ammonite {
+  namespace models {
+    namespace internal {
+      /*
+       - Dynamic bounding volume hierarchy over model instance bounds
+       - Leaves store enlarged bounds, so small movements don't restructure the tree
+         - Queries still test the exact bounds of each leaf
+       - The tree is kept height-balanced with rotations, as leaves are added and removed
+      */
+      class BoundingTree {
+      public:
+        static constexpr unsigned int nullNode = std::numeric_limits<unsigned int>::max();
+
+      private:
+        struct TreeNode {
+          BoundingBox bounds;
+          BoundingBox leafBounds;
+          unsigned int parent = nullNode;
+          unsigned int children[2] = {nullNode, nullNode};
+          int height = 0;
+          AmmoniteId modelId = 0;
+        };
+
+        std::vector<TreeNode> nodes;
+        std::vector<unsigned int> stack;
+        unsigned int rootNode = nullNode;
+        unsigned int freeNode = nullNode;
+        unsigned int leafCount = 0;
+
+        unsigned int allocateNode();
+        void releaseNode(unsigned int nodeIndex);
+        bool isLeaf(unsigned int nodeIndex) const;
+        void insertLeaf(unsigned int leafIndex);
+        void removeLeaf(unsigned int leafIndex);
+        void refitAncestors(unsigned int nodeIndex);
+        unsigned int balance(unsigned int nodeIndex);
+
+      public:
+        unsigned int insert(const BoundingBox& bounds, AmmoniteId modelId);
+        void remove(unsigned int nodeIndex);
+        bool update(unsigned int nodeIndex, const BoundingBox& bounds);
+
+        void queryFrustum(const ammonite::Vec<float, 4> planes[6],
+                          std::vector<AmmoniteId>* modelIds);
+        void querySphere(const ammonite::Vec<float, 3>& centre, float radius,
+                         std::vector<AmmoniteId>* modelIds);
+        AmmoniteId queryRay(const ammonite::Vec<float, 3>& origin,
+                            const ammonite::Vec<float, 3>& direction,
+                            AmmoniteId ignoredModelId, float* distance);
+
+        unsigned int getLeafCount() const;
+        int getHeight() const;
+      };
+    }
+  }
+}
+
+#endif
@@ -13,7 +13,7 @@
 
 #include "../models.hpp"
 
-#include "../../graphics/textures.hpp"
+#include "../../graphics/materials.hpp"
 #include "../../maths/vector.hpp"
 #include "../../utils/debug.hpp"
 #include "../../utils/logging.hpp"
@@ -67,28 +67,22 @@ namespace ammonite {
           return (materialPtr->Get(colourKey.key, colourKey.type, colourKey.index, aiColour) == AI_SUCCESS);
         }
 
-        GLuint processColour(const aiMaterial* materialPtr,
-                             const MatKey& colourKey, const std::string& modelKey) {
-          //Bail if we don't have any of this type
-          if (!materialHasColour(materialPtr, colourKey)) {
-            ammoniteInternalDebug << "Attempted to load colour on '" << modelKey \
-                                  << "', but none of this type exist" << std::endl;
-            return 0;
-          }
-
+        void processColour(const aiMaterial* materialPtr, const MatKey& colourKey,
+                           ammonite::Vec<float, 3>& colour) {
           //Fetch the colour
           aiColor3D aiColour(0.0f, 0.0f, 0.0f);
           materialPtr->Get(colourKey.key, colourKey.type, colourKey.index, aiColour);
-
-          const ammonite::Vec<float, 3> colour = {aiColour.r, aiColour.g, aiColour.b};
-          return ammonite::textures::internal::loadSolidTexture(colour);
+          ammonite::set(colour, aiColour.r, aiColour.g, aiColour.b);
         }
 
-        //Load all components of a material into a TextureIdGroup
+        /*
+         - Load all components of a material into a TextureIdGroup
+         - Colours are kept as material constants, missing components keep the defaults
+        */
         TextureIdGroup processMaterial(const aiMaterial* materialPtr,
                                        const ModelLoadInfo& modelLoadInfo,
                                        const std::string& modelKey) {
-          TextureIdGroup textureGroup = {.diffuseId = 0, .specularId = 0};
+          TextureIdGroup textureGroup;
 
           //Array of info required to fill the texture group by texture type
           //NOLINTBEGIN(modernize-use-designated-initializers)
@@ -97,10 +91,13 @@ namespace ammonite {
             aiTextureType textureType;
             MatKey colourKey;
             GLuint* textureIdPtr;
+            ammonite::Vec<float, 3>* colourPtr;
             bool isRequired;
           } textureLoadInfo[textureTypeCount] = {
-            {aiTextureType_DIFFUSE, {AI_MATKEY_COLOR_DIFFUSE}, &textureGroup.diffuseId, true},
-            {aiTextureType_SPECULAR, {AI_MATKEY_COLOR_SPECULAR}, &textureGroup.specularId, false}
+            {aiTextureType_DIFFUSE, {AI_MATKEY_COLOR_DIFFUSE}, &textureGroup.diffuseId,
+             &textureGroup.diffuseColour, true},
+            {aiTextureType_SPECULAR, {AI_MATKEY_COLOR_SPECULAR}, &textureGroup.specularId,
+             &textureGroup.specularColour, false}
           };
           //NOLINTEND(modernize-use-designated-initializers)
 
@@ -113,9 +110,8 @@ namespace ammonite {
               *loadInfo.textureIdPtr = processTexture(materialPtr,
                 loadInfo.textureType, modelLoadInfo, modelKey);
             } else if (materialHasColour(materialPtr, loadInfo.colourKey)) {
-              //Attempt to load the material as a colour
-              *loadInfo.textureIdPtr = processColour(materialPtr,
-                                                     loadInfo.colourKey, modelKey);
+              //Store the colour in the material
+              processColour(materialPtr, loadInfo.colourKey, *loadInfo.colourPtr);
             } else {
               missing = true;
             }
@@ -123,7 +119,7 @@ namespace ammonite {
             //Debug warning for unspecified required material components
             if (loadInfo.isRequired && missing) {
               ammoniteInternalDebug << "Mandatory texture / colour not supplied for model '" \
-                                    << modelKey << "', skipping" << std::endl;
+                                    << modelKey << "', using default colour" << std::endl;
             }
 
             //Debug warning for ignored textures
@@ -133,6 +129,9 @@ namespace ammonite {
             }
           }
 
+          textureGroup.materialIndex = graphics::internal::acquireMaterial(
+            textureGroup.diffuseId, textureGroup.specularId,
+            textureGroup.diffuseColour, textureGroup.specularColour);
           return textureGroup;
         }
 
@@ -256,9 +255,17 @@ namespace ammonite {
         const bool loadedNodes = processNodes(scenePtr, modelData,
                                               rawMeshDataVec, modelLoadInfo);
 
-        //Sync the queued texture loads
+        //Pack small textures into atlases, then sync the queued texture loads
+        if (loadedNodes) {
+          atlasQueuedTextures(&modelData->textureIds, rawMeshDataVec);
+        }
         uploadQueuedTextures();
 
+        //Find the model's bounding box, before the vertex data is uploaded
+        if (loadedNodes) {
+          calcModelBounds(modelData, *rawMeshDataVec);
+        }
+
         return loadedNodes;
       }
     }
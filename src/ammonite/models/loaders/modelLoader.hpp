@@ -25,6 +25,8 @@ namespace AMMONITE_INTERNAL ammonite {
       //Texture loaders
       GLuint queueTextureLoad(const std::string& texturePath, bool flipTexture,
                               bool srgbTexture);
+      void atlasQueuedTextures(std::vector<TextureIdGroup>* textureIdGroups,
+                               std::vector<RawMeshData>* rawMeshDataVec);
       bool uploadQueuedTextures();
     }
   }
@@ -5,7 +5,8 @@
 
 #include "../models.hpp"
 
-#include "../../graphics/textures.hpp"
+#include "../../graphics/materials.hpp"
+#include "../../maths/vector.hpp"
 #include "../../utils/debug.hpp"
 #include "../../utils/logging.hpp"
 #include "../../utils/thread.hpp"
@@ -177,32 +178,35 @@ namespace ammonite {
         }
 
         /*
-         - Load material components, returning a texture ID
+         - Load a material component, as a texture ID or a colour
          - Textures loads will be queued on the thread pool
-         - Colour materials will be uploaded immediately
         */
-        GLuint loadMaterialComponent(const AmmoniteMaterialComponent& component,
-                                     bool isTexture) {
+        void loadMaterialComponent(const AmmoniteMaterialComponent& component,
+                                   bool isTexture, GLuint* textureIdPtr,
+                                   ammonite::Vec<float, 3>& colour) {
           if (isTexture) {
-            return queueTextureLoad(*component.textureInfo.texturePath, false,
-                                    component.textureInfo.isSrgbTexture);
+            *textureIdPtr = queueTextureLoad(*component.textureInfo.texturePath, false,
+                                             component.textureInfo.isSrgbTexture);
+            return;
           }
 
-          return textures::internal::loadSolidTexture(component.colour);
+          ammonite::copy(component.colour, colour);
         }
 
-
         //Load and apply each component of each material to its mesh
         void applyMaterials(ModelData* modelData, const AmmoniteMaterial* materials,
                             unsigned int meshCount) {
           for (unsigned int meshIndex = 0; meshIndex < meshCount; meshIndex++) {
             const AmmoniteMaterial& material = materials[meshIndex];
-            modelData->textureIds.push_back({
-              .diffuseId = loadMaterialComponent(material.diffuse,
-                                                 material.diffuseIsTexture),
-              .specularId = loadMaterialComponent(material.specular,
-                                                  material.specularIsTexture)
-            });
+            TextureIdGroup& textureGroup = modelData->textureIds.emplace_back();
+            loadMaterialComponent(material.diffuse, material.diffuseIsTexture,
+                                  &textureGroup.diffuseId, textureGroup.diffuseColour);
+            loadMaterialComponent(material.specular, material.specularIsTexture,
+                                  &textureGroup.specularId, textureGroup.specularColour);
+
+            textureGroup.materialIndex = graphics::internal::acquireMaterial(
+              textureGroup.diffuseId, textureGroup.specularId,
+              textureGroup.diffuseColour, textureGroup.specularColour);
           }
         }
       }
@@ -355,11 +359,15 @@ namespace ammonite {
             memoryInfo.vertexCounts, memoryInfo.indexCounts, rawMeshDataVec);
         }
 
-        //Sync the queued texture loads
+        //Sync the mesh indexing, atlases need the final texture coordinates
+        syncMeshIndexing(&indexGroup, jobSyncCount);
+
+        //Pack small textures into atlases, then sync the queued texture loads
+        atlasQueuedTextures(&modelData->textureIds, rawMeshDataVec);
         uploadQueuedTextures();
 
-        //Sync the mesh indexing
-        syncMeshIndexing(&indexGroup, jobSyncCount);
+        //Find the model's bounding box from the final vertex data
+        calcModelBounds(modelData, *rawMeshDataVec);
 
         return true;
       }
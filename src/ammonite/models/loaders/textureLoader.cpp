@@ -1,10 +1,18 @@
 #include <iostream>
 #include <list>
+#include <map>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "../models.hpp"
 
+#include "../../graphics/materials.hpp"
+#include "../../graphics/renderer.hpp"
+#include "../../graphics/textureAtlas.hpp"
 #include "../../graphics/textures.hpp"
+#include "../../maths/vector.hpp"
+#include "../../utils/debug.hpp"
 #include "../../utils/logging.hpp"
 #include "../../utils/thread.hpp"
 
@@ -26,6 +34,7 @@ namespace ammonite {
           TextureThreadData threadData;
           GLuint textureId;
           AmmoniteGroup sync{0};
+          bool isAtlased = false;
         };
 
         //Store the outstanding texture loads
@@ -45,6 +54,122 @@ namespace ammonite {
         }
       }
 
+      //Texture atlas helpers
+      namespace {
+        //Queued texture that could be packed, and how many uses an atlas could replace
+        struct AtlasCandidate {
+          TextureLoadData* textureLoadData = nullptr;
+          unsigned int useCount = 0;
+          unsigned int atlasUseCount = 0;
+        };
+
+        //Returns true if every texture coordinate of a mesh stays inside its texture
+        bool hasClampedTexCoords(const RawMeshData& rawMeshData) {
+          for (unsigned int i = 0; i < rawMeshData.vertexCount; i++) {
+            const ammonite::Vec<float, 2>& texturePoint = rawMeshData.vertexData[i].texturePoint;
+            if (texturePoint[0] < 0.0f || texturePoint[0] > 1.0f ||
+                texturePoint[1] < 0.0f || texturePoint[1] > 1.0f) {
+              return false;
+            }
+          }
+
+          return true;
+        }
+
+        //Move a mesh's texture coordinates into its image's region of an atlas
+        void remapTexCoords(RawMeshData* rawMeshData, const textures::internal::AtlasRect& rect,
+                            int atlasWidth, int atlasHeight) {
+          for (unsigned int i = 0; i < rawMeshData->vertexCount; i++) {
+            ammonite::Vec<float, 2>& texturePoint = rawMeshData->vertexData[i].texturePoint;
+            texturePoint[0] = ((float)rect.x + (texturePoint[0] * (float)rect.width)) /
+                              (float)atlasWidth;
+            texturePoint[1] = ((float)rect.y + (texturePoint[1] * (float)rect.height)) /
+                              (float)atlasHeight;
+          }
+        }
+
+        /*
+         - Pack queued textures of the same format into an atlas, then move the meshes
+           using them onto it
+         - Packed textures are released, and skipped by uploadQueuedTextures()
+         - Textures that don't fit are left to upload as usual
+        */
+        void packAtlasGroup(const std::vector<TextureLoadData*>& textureLoads,
+                            std::vector<TextureIdGroup>* textureIdGroups,
+                            std::vector<RawMeshData>* rawMeshDataVec) {
+          std::vector<const textures::internal::TextureData*> images;
+          for (const TextureLoadData* textureLoadData : textureLoads) {
+            images.push_back(&textureLoadData->threadData.textureData);
+          }
+
+          std::vector<textures::internal::AtlasRect> imageRects(images.size());
+          textures::internal::TextureData atlasData;
+          if (!textures::internal::buildTextureAtlas(images.data(), images.size(),
+                                                     imageRects.data(), &atlasData)) {
+            return;
+          }
+
+          //Upload the atlas, its size is kept to remap texture coordinates
+          const int atlasWidth = atlasData.width;
+          const int atlasHeight = atlasData.height;
+          const GLuint atlasId = textures::internal::reserveUncachedTexture();
+          if (atlasId == 0) {
+            delete [] atlasData.data;
+            return;
+          }
+
+          if (!textures::internal::uploadTextureData(atlasId, atlasData)) {
+            textures::internal::deleteTexture(atlasId);
+            return;
+          }
+
+          //Find the region of each packed texture, and free its data
+          std::map<GLuint, textures::internal::AtlasRect> packedRects;
+          for (unsigned int i = 0; i < textureLoads.size(); i++) {
+            if (imageRects[i].width != 0) {
+              TextureLoadData* const textureLoadData = textureLoads[i];
+              packedRects[textureLoadData->textureId] = imageRects[i];
+              textureLoadData->isAtlased = true;
+              delete [] textureLoadData->threadData.textureData.data;
+            }
+          }
+
+          /*
+           - Swap each mesh using a packed texture to the atlas
+           - Materials are replaced before the textures they use are released
+          */
+          bool hasAtlasUser = false;
+          for (unsigned int meshIndex = 0; meshIndex < textureIdGroups->size(); meshIndex++) {
+            TextureIdGroup& textureGroup = (*textureIdGroups)[meshIndex];
+            const auto rectIt = packedRects.find(textureGroup.diffuseId);
+            if (rectIt == packedRects.end()) {
+              continue;
+            }
+
+            remapTexCoords(&(*rawMeshDataVec)[meshIndex], rectIt->second, atlasWidth,
+                           atlasHeight);
+
+            graphics::internal::releaseMaterial(textureGroup.materialIndex);
+            textures::internal::deleteTexture(textureGroup.diffuseId);
+
+            //The atlas starts with a single reference, copy it for any extra users
+            if (hasAtlasUser) {
+              textures::internal::copyTexture(atlasId);
+            }
+            hasAtlasUser = true;
+
+            textureGroup.diffuseId = atlasId;
+            textureGroup.materialIndex = graphics::internal::acquireMaterial(
+              textureGroup.diffuseId, textureGroup.specularId,
+              textureGroup.diffuseColour, textureGroup.specularColour);
+          }
+
+          ammoniteInternalDebug << "Packed " << packedRects.size() << " textures into a " \
+                                << atlasWidth << " x " << atlasHeight << " atlas (ID " \
+                                << atlasId << ")" << std::endl;
+        }
+      }
+
       /*
        - Queue a texture load on the thread pool
        - Must call uploadQueuedTextures() before it can be used
@@ -53,7 +178,7 @@ namespace ammonite {
       GLuint queueTextureLoad(const std::string& texturePath, bool flipTexture,
                               bool srgbTexture) {
         //Calculate the texture's key
-        std::string textureKey;
+        textures::internal::TextureKey textureKey;
         textures::internal::calculateTextureKey(texturePath, flipTexture, srgbTexture, &textureKey);
 
         //Use texture cache, if already loaded / reserved
@@ -62,7 +187,8 @@ namespace ammonite {
         }
 
         //Reserve the texture key before loading
-        const GLuint textureId = textures::internal::reserveTextureKey(textureKey);
+        const GLuint textureId = textures::internal::reserveTextureKey(textureKey,
+                                                                       texturePath);
         if (textureId == 0) {
           ammonite::utils::warning << "Failed to reserve texture" << std::endl;
           return 0;
@@ -95,6 +221,9 @@ namespace ammonite {
         bool success = true;
         for (TextureLoadData& textureLoadData : textureQueue) {
           ammonite::utils::thread::waitGroupComplete(&textureLoadData.sync, 1);
+          if (textureLoadData.isAtlased) {
+            continue;
+          }
 
           //Attempt to upload the texture data if the load was successful
           success &= textureLoadData.threadData.loadedTexture;
@@ -109,6 +238,67 @@ namespace ammonite {
 
         return success;
       }
+
+      /*
+       - Pack small queued textures into atlases, if texture atlasing is enabled
+         - Only diffuse textures of meshes without a specular texture, with texture
+           coordinates inside the texture, are packed
+         - Textures are only packed if every use by the model can be replaced
+       - Remaps the texture coordinates of the meshes using packed textures, and swaps
+         their textures and materials to the atlas
+       - Must be called before uploadQueuedTextures(), with the model's final mesh data
+      */
+      void atlasQueuedTextures(std::vector<TextureIdGroup>* textureIdGroups,
+                               std::vector<RawMeshData>* rawMeshDataVec) {
+        if (!renderer::settings::getTextureAtlasing()) {
+          return;
+        }
+
+        //Wait for the texture loads, and find the textures small enough to pack
+        std::map<GLuint, AtlasCandidate> candidates;
+        for (TextureLoadData& textureLoadData : textureQueue) {
+          ammonite::utils::thread::waitGroupComplete(&textureLoadData.sync, 1);
+          if (textureLoadData.threadData.loadedTexture &&
+              textures::internal::canAtlasTexture(textureLoadData.threadData.textureData)) {
+            candidates[textureLoadData.textureId].textureLoadData = &textureLoadData;
+          }
+        }
+
+        //Count every use of each candidate, and the uses an atlas could replace
+        for (unsigned int meshIndex = 0; meshIndex < textureIdGroups->size(); meshIndex++) {
+          const TextureIdGroup& textureGroup = (*textureIdGroups)[meshIndex];
+          for (const GLuint textureId : {textureGroup.diffuseId, textureGroup.specularId}) {
+            const auto candidateIt = candidates.find(textureId);
+            if (candidateIt != candidates.end()) {
+              candidateIt->second.useCount++;
+            }
+          }
+
+          const auto candidateIt = candidates.find(textureGroup.diffuseId);
+          if (candidateIt != candidates.end() && textureGroup.specularId == 0 &&
+              hasClampedTexCoords((*rawMeshDataVec)[meshIndex])) {
+            candidateIt->second.atlasUseCount++;
+          }
+        }
+
+        //Group the textures that can be fully replaced by their channels and colour space
+        std::map<std::pair<int, bool>, std::vector<TextureLoadData*>> atlasGroups;
+        for (const auto& [textureId, candidate] : candidates) {
+          if (candidate.useCount == candidate.atlasUseCount) {
+            const textures::internal::TextureData& textureData =
+              candidate.textureLoadData->threadData.textureData;
+            atlasGroups[{textureData.numChannels, textureData.srgbTexture}].push_back(
+              candidate.textureLoadData);
+          }
+        }
+
+        //Packing a single texture wouldn't save anything
+        for (const auto& [format, textureLoads] : atlasGroups) {
+          if (textureLoads.size() > 1) {
+            packAtlasGroup(textureLoads, textureIdGroups, rawMeshDataVec);
+          }
+        }
+      }
     }
   }
 }
@@ -0,0 +1,279 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "modelBounds.hpp"
+
+#include "boundingTree.hpp"
+#include "models.hpp"
+#include "../maths/matrix.hpp"
+#include "../maths/vector.hpp"
+#include "../utils/id.hpp"
+
+/*
+ - Calculate bounding volumes for model data and model instances
+ - Model data bounds are found once at load time, instance bounds are
+   transformed from them whenever the model matrix changes
+ - Active models are tracked in a bounding volume tree, for visibility and picking queries
+*/
+
+namespace ammonite {
+  namespace models {
+    namespace {
+      internal::BoundingTree activeModelTree;
+
+      /*
+       - Bounds that models have left or entered, since the last reset
+       - Static changes are the subset that affect shadows of static models only
+      */
+      std::vector<internal::BoundingBox> changedBounds;
+      std::vector<internal::BoundingBox> changedStaticBounds;
+      bool tooManyChangedBounds = false;
+
+      //Models whose matrices changed since the last reset, for per-draw data uploads
+      std::vector<AmmoniteId> movedModelIds;
+      bool tooManyMovedModels = false;
+
+      //Give up tracking individual changes past this, to avoid unbounded growth
+      constexpr unsigned int maxChangedBounds = 4096;
+
+      /*
+       - Active models that have moved recently, and the frames they stay dynamic for
+       - Models are tracked by ID, since changing a model's type moves its ModelInfo
+      */
+      std::vector<AmmoniteId> dynamicModelIds;
+      uintmax_t boundsFrame = 1;
+      constexpr uintmax_t dynamicModelFrames = 60;
+
+      void recordChangedBounds(const internal::BoundingBox& bounds, bool isStaticChange) {
+        if (tooManyChangedBounds) {
+          return;
+        }
+
+        if (changedBounds.size() >= maxChangedBounds) {
+          tooManyChangedBounds = true;
+          changedBounds.clear();
+          changedStaticBounds.clear();
+          return;
+        }
+
+        changedBounds.push_back(bounds);
+        if (isStaticChange) {
+          changedStaticBounds.push_back(bounds);
+        }
+      }
+
+      void recordMovedModel(AmmoniteId modelId) {
+        if (tooManyMovedModels) {
+          return;
+        }
+
+        if (movedModelIds.size() >= maxChangedBounds) {
+          tooManyMovedModels = true;
+          movedModelIds.clear();
+          return;
+        }
+
+        movedModelIds.push_back(modelId);
+      }
+    }
+
+    namespace internal {
+      //Find the bounds of every vertex in the model, before it's uploaded
+      void calcModelBounds(ModelData* modelData,
+                           const std::vector<RawMeshData>& rawMeshDataVec) {
+        BoundingBox& bounds = modelData->bounds;
+        bool foundVertex = false;
+
+        for (const RawMeshData& rawMeshData : rawMeshDataVec) {
+          for (unsigned int i = 0; i < rawMeshData.vertexCount; i++) {
+            const ammonite::Vec<float, 3>& vertex = rawMeshData.vertexData[i].vertex;
+
+            //Initialise the bounds from the first vertex
+            if (!foundVertex) {
+              ammonite::copy(vertex, bounds.minimum);
+              ammonite::copy(vertex, bounds.maximum);
+              foundVertex = true;
+              continue;
+            }
+
+            for (unsigned int axis = 0; axis < 3; axis++) {
+              bounds.minimum[axis] = std::min(bounds.minimum[axis], vertex[axis]);
+              bounds.maximum[axis] = std::max(bounds.maximum[axis], vertex[axis]);
+            }
+          }
+        }
+
+        //Models without vertices get empty bounds at the origin
+        if (!foundVertex) {
+          ammonite::set(bounds.minimum, 0.0f);
+          ammonite::set(bounds.maximum, 0.0f);
+        }
+      }
+
+      /*
+       - Transform the model data's bounds by the model matrix
+       - Uses the absolute values of the matrix to find the transformed extent,
+         giving the tightest box around the transformed box without visiting its corners
+      */
+      void calcWorldBounds(ModelInfo* modelInfo) {
+        recordMovedModel(modelInfo->modelId);
+
+        //Tracked models leave their old bounds, static models also leave cached shadows
+        const bool isTracked = (modelInfo->boundsNodeId != BoundingTree::nullNode);
+        if (isTracked) {
+          recordChangedBounds(modelInfo->worldBounds, !modelInfo->isDynamic);
+
+          //Moving models become dynamic until they settle
+          if (!modelInfo->isDynamic) {
+            modelInfo->isDynamic = true;
+            dynamicModelIds.push_back(modelInfo->modelId);
+          }
+          modelInfo->lastMovedFrame = boundsFrame;
+        }
+
+        const BoundingBox& localBounds = modelInfo->modelData->bounds;
+        const ammonite::Mat<float, 4>& modelMatrix = modelInfo->positionData.modelMatrix;
+
+        //Find the local centre and half-size
+        ammonite::Vec<float, 3> localCentre = {0};
+        ammonite::Vec<float, 3> localExtent = {0};
+        ammonite::add(localBounds.minimum, localBounds.maximum, localCentre);
+        ammonite::scale(localCentre, 0.5f);
+        ammonite::sub(localBounds.maximum, localBounds.minimum, localExtent);
+        ammonite::scale(localExtent, 0.5f);
+
+        for (unsigned int row = 0; row < 3; row++) {
+          //Translation, then the rotated / scaled centre
+          float centre = modelMatrix[3][row];
+          float extent = 0.0f;
+          for (unsigned int col = 0; col < 3; col++) {
+            centre += modelMatrix[col][row] * localCentre[col];
+            extent += std::abs(modelMatrix[col][row]) * localExtent[col];
+          }
+
+          modelInfo->worldBounds.minimum[row] = centre - extent;
+          modelInfo->worldBounds.maximum[row] = centre + extent;
+        }
+
+        //Move the model in the tree, if it's tracked
+        if (isTracked) {
+          recordChangedBounds(modelInfo->worldBounds, false);
+          activeModelTree.update(modelInfo->boundsNodeId, modelInfo->worldBounds);
+        }
+      }
+
+      //Start tracking a model's world bounds as static, if it isn't already tracked
+      void addModelBounds(ModelInfo* modelInfo) {
+        if (modelInfo->boundsNodeId == BoundingTree::nullNode) {
+          modelInfo->boundsNodeId = activeModelTree.insert(modelInfo->worldBounds,
+                                                           modelInfo->modelId);
+          modelInfo->isDynamic = false;
+          recordChangedBounds(modelInfo->worldBounds, true);
+        }
+      }
+
+      void removeModelBounds(ModelInfo* modelInfo) {
+        if (modelInfo->boundsNodeId != BoundingTree::nullNode) {
+          activeModelTree.remove(modelInfo->boundsNodeId);
+          modelInfo->boundsNodeId = BoundingTree::nullNode;
+          recordChangedBounds(modelInfo->worldBounds, !modelInfo->isDynamic);
+
+          //Stop tracking the model's movement
+          if (modelInfo->isDynamic) {
+            modelInfo->isDynamic = false;
+            std::erase(dynamicModelIds, modelInfo->modelId);
+          }
+        }
+      }
+
+      /*
+       - Mark dynamic models that haven't moved for a while as static again
+       - Their bounds are recorded as static changes, so cached shadows pick them up
+       - Should be called once per frame, before changes are queried
+      */
+      void settleDynamicModels() {
+        boundsFrame++;
+        std::erase_if(dynamicModelIds, [](AmmoniteId modelId) {
+          ModelInfo* const modelInfo = getModelPtr(modelId);
+          if (modelInfo == nullptr) {
+            return true;
+          }
+
+          if (boundsFrame - modelInfo->lastMovedFrame <= dynamicModelFrames) {
+            return false;
+          }
+
+          modelInfo->isDynamic = false;
+          recordChangedBounds(modelInfo->worldBounds, true);
+          return true;
+        });
+      }
+
+      /*
+       - Return the bounds active models have entered or left since the last reset
+         - Moving models record both their old and new bounds
+       - Returns nullptr if too much has changed to track, so everything should be
+         treated as changed
+      */
+      const std::vector<BoundingBox>* getChangedBounds() {
+        return tooManyChangedBounds ? nullptr : &changedBounds;
+      }
+
+      /*
+       - Return the changed bounds that involve static models, a subset of getChangedBounds()
+         - Includes models becoming dynamic or static, and models being added or removed
+       - Returns nullptr under the same conditions as getChangedBounds()
+      */
+      const std::vector<BoundingBox>* getChangedStaticBounds() {
+        return tooManyChangedBounds ? nullptr : &changedStaticBounds;
+      }
+
+      void resetChangedBounds() {
+        changedBounds.clear();
+        changedStaticBounds.clear();
+        tooManyChangedBounds = false;
+      }
+
+      /*
+       - Return the IDs of models whose matrices changed since the last reset
+         - Models may appear more than once, and may no longer exist
+       - Returns nullptr if too many models moved to track, so every model should be
+         treated as moved
+      */
+      const std::vector<AmmoniteId>* getMovedModels() {
+        return tooManyMovedModels ? nullptr : &movedModelIds;
+      }
+
+      void resetMovedModels() {
+        movedModelIds.clear();
+        tooManyMovedModels = false;
+      }
+
+      //Append the IDs of active models intersecting a frustum
+      void getModelsInFrustum(const ammonite::Vec<float, 4> planes[6],
+                              std::vector<AmmoniteId>* modelIds) {
+        activeModelTree.queryFrustum(planes, modelIds);
+      }
+
+      //Append the IDs of active models intersecting a sphere
+      void getModelsInSphere(const ammonite::Vec<float, 3>& centre, float radius,
+                             std::vector<AmmoniteId>* modelIds) {
+        activeModelTree.querySphere(centre, radius, modelIds);
+      }
+    }
+
+    /*
+     - Find the closest active model whose bounding box is hit by a ray
+       - ignoredModelId is never returned, use 0 to consider every model
+     - Writes the distance along the ray to distance, in multiples of direction
+     - Returns the model's ID, or 0 if nothing was hit
+    */
+    AmmoniteId pickModel(const ammonite::Vec<float, 3>& origin,
+                         const ammonite::Vec<float, 3>& direction,
+                         AmmoniteId ignoredModelId, float* distance) {
+      return activeModelTree.queryRay(origin, direction, ignoredModelId, distance);
+    }
+  }
+}
@@ -0,0 +1,37 @@
+#ifndef INTERNALMODELBOUNDS
+#define INTERNALMODELBOUNDS
+
+#include <vector>
+
+#include "modelTypes.hpp"
+
+#include "../maths/vector.hpp"
+#include "../utils/id.hpp"
+#include "../visibility.hpp"
+
+namespace AMMONITE_INTERNAL ammonite {
+  namespace models {
+    namespace internal {
+      //Bounding volume calculation
+      void calcModelBounds(ModelData* modelData,
+                           const std::vector<RawMeshData>& rawMeshDataVec);
+      void calcWorldBounds(ModelInfo* modelInfo);
+
+      //Bounding volume tree tracking and queries
+      void addModelBounds(ModelInfo* modelInfo);
+      void removeModelBounds(ModelInfo* modelInfo);
+      void settleDynamicModels();
+      const std::vector<BoundingBox>* getChangedBounds();
+      const std::vector<BoundingBox>* getChangedStaticBounds();
+      void resetChangedBounds();
+      const std::vector<AmmoniteId>* getMovedModels();
+      void resetMovedModels();
+      void getModelsInFrustum(const ammonite::Vec<float, 4> planes[6],
+                              std::vector<AmmoniteId>* modelIds);
+      void getModelsInSphere(const ammonite::Vec<float, 3>& centre, float radius,
+                             std::vector<AmmoniteId>* modelIds);
+    }
+  }
+}
+
+#endif
@@ -9,6 +9,7 @@
 #include "models.hpp"
 
 #include "../graphics/buffers.hpp"
+#include "../graphics/materials.hpp"
 #include "../graphics/textures.hpp"
 #include "../utils/debug.hpp"
 #include "../utils/id.hpp"
@@ -126,8 +127,9 @@ namespace ammonite {
 
         //Delete the model data if this was the last reference
         if (modelData->refCount == 0) {
-          //Reduce reference count on model data textures
+          //Reduce reference count on model data materials, then their textures
           for (const TextureIdGroup& textureIdGroup : modelData->textureIds) {
+            graphics::internal::releaseMaterial(textureIdGroup.materialIndex);
             if (textureIdGroup.diffuseId != 0) {
               textures::internal::deleteTexture(textureIdGroup.diffuseId);
             }
@@ -13,7 +13,9 @@
 namespace ammonite {
   namespace models {
     namespace internal {
-      void calcModelMatrices(PositionData* positionData) {
+      void calcModelMatrices(ModelInfo* modelInfo) {
+        PositionData* const positionData = &modelInfo->positionData;
+
         //Recalculate the model matrix when a component changes
         ammonite::Mat<float, 4> rotationScaleMatrix = {{0}};
         ammonite::multiply(positionData->rotationMatrix, positionData->scaleMatrix,
@@ -25,6 +27,9 @@ namespace ammonite {
         ammonite::Mat<float, 4> inverseModelMatrix = {{0}};
         ammonite::transpose(ammonite::inverse(positionData->modelMatrix, inverseModelMatrix));
         ammonite::copy(inverseModelMatrix, positionData->normalMatrix);
+
+        //Keep the world-space bounds in sync with the model matrix
+        calcWorldBounds(modelInfo);
       }
     }
 
@@ -90,7 +95,7 @@ namespace ammonite {
         }
 
         //Recalculate model and normal matrices
-        calcModelMatrices(&modelInfo->positionData);
+        calcModelMatrices(modelInfo);
       }
 
       void setScale(AmmoniteId modelId, const ammonite::Vec<float, 3>& scale) {
@@ -110,7 +115,7 @@ namespace ammonite {
         }
 
         //Recalculate model and normal matrices
-        calcModelMatrices(&modelInfo->positionData);
+        calcModelMatrices(modelInfo);
       }
 
       void setScale(AmmoniteId modelId, float scaleMultiplier) {
@@ -136,7 +141,7 @@ namespace ammonite {
         }
 
         //Recalculate model and normal matrices
-        calcModelMatrices(&modelInfo->positionData);
+        calcModelMatrices(modelInfo);
       }
     }
 
@@ -157,7 +162,7 @@ namespace ammonite {
         }
 
         //Recalculate model and normal matrices
-        calcModelMatrices(&modelInfo->positionData);
+        calcModelMatrices(modelInfo);
       }
 
       void scaleModel(AmmoniteId modelId, const ammonite::Vec<float, 3>& scale) {
@@ -175,7 +180,7 @@ namespace ammonite {
         }
 
         //Recalculate model and normal matrices
-        calcModelMatrices(&modelInfo->positionData);
+        calcModelMatrices(modelInfo);
       }
 
       void scaleModel(AmmoniteId modelId, float scaleMultiplier) {
@@ -204,7 +209,7 @@ namespace ammonite {
         }
 
         //Recalculate model and normal matrices
-        calcModelMatrices(&modelInfo->positionData);
+        calcModelMatrices(modelInfo);
       }
     }
   }
@@ -8,8 +8,8 @@
 namespace AMMONITE_INTERNAL ammonite {
   namespace models {
     namespace internal {
-      //Calculate matrices from position, scale and rotation
-      void calcModelMatrices(PositionData* positionData);
+      //Calculate matrices and world bounds from position, scale and rotation
+      void calcModelMatrices(ModelInfo* modelInfo);
     }
   }
 }
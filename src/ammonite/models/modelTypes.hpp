@@ -1,6 +1,7 @@
 #ifndef INTERNALMODELTYPES
 #define INTERNALMODELTYPES
 
+#include <cstdint>
 #include <string>
 #include <unordered_set>
 #include <vector>
@@ -11,6 +12,7 @@ extern "C" {
 
 #include "../maths/matrix.hpp"
 #include "../maths/quaternion.hpp"
+#include "../maths/vector.hpp"
 #include "../utils/id.hpp"
 #include "../visibility.hpp"
 
@@ -37,19 +39,36 @@ namespace AMMONITE_INTERNAL ammonite {
         unsigned int indexCount = 0;
       };
 
-      //Store rendering information on an uploaded mesh
+      /*
+       - Store rendering information on an uploaded mesh
+       - Meshes share buffers, so the vertex array identifies the buffer pool
+         and the offsets locate the mesh inside it
+      */
       struct MeshInfoGroup {
         unsigned int vertexCount = 0;
         unsigned int indexCount = 0;
-        GLuint vertexBufferId = 0;
-        GLuint elementBufferId = 0;
+        unsigned int firstIndex = 0;
+        GLint baseVertex = 0;
         GLuint vertexArrayId = 0;
       };
 
-      //Store texture IDs for a single mesh
+      /*
+       - Store the material of a single mesh
+       - Colours are used for components without a texture
+       - The material index identifies the textures and colours on the GPU
+      */
       struct TextureIdGroup {
         GLuint diffuseId = 0;
         GLuint specularId = 0;
+        ammonite::Vec<float, 3> diffuseColour = {1.0f, 1.0f, 1.0f};
+        ammonite::Vec<float, 3> specularColour = {0.0f, 0.0f, 0.0f};
+        unsigned int materialIndex = 0;
+      };
+
+      //Axis-aligned bounding box, used for visibility testing
+      struct BoundingBox {
+        ammonite::Vec<float, 3> minimum = {0};
+        ammonite::Vec<float, 3> maximum = {0};
       };
 
       /*
@@ -62,6 +81,7 @@ namespace AMMONITE_INTERNAL ammonite {
         std::string modelKey;
         std::vector<MeshInfoGroup> meshInfo;
         std::vector<TextureIdGroup> textureIds;
+        BoundingBox bounds;
         std::unordered_set<AmmoniteId> activeModelIds;
         std::unordered_set<AmmoniteId> inactiveModelIds;
       };
@@ -88,6 +108,16 @@ namespace AMMONITE_INTERNAL ammonite {
         PositionData positionData;
         std::vector<TextureIdGroup> textureIds;
 
+        //Bounds of the model data, after the model matrix is applied
+        BoundingBox worldBounds;
+
+        //Leaf in the bounding volume tree, only set while the model is active
+        unsigned int boundsNodeId = -1;
+
+        //Active models that moved recently are dynamic, and kept out of cached shadows
+        bool isDynamic = false;
+        uintmax_t lastMovedFrame = 0;
+
         //Model identification
         AmmoniteId modelId = 0;
 
@@ -1,9 +1,11 @@
 #include <algorithm>
 #include <iostream>
 #include <iterator>
+#include <list>
 #include <map>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 extern "C" {
   #include <epoxy/gl.h>
@@ -11,7 +13,9 @@ extern "C" {
 
 #include "models.hpp"
 
+#include "boundingTree.hpp"
 #include "../enums.hpp"
+#include "../graphics/materials.hpp"
 #include "../graphics/textures.hpp"
 #include "../lighting/lighting.hpp"
 #include "../maths/matrix.hpp"
@@ -146,6 +150,30 @@ namespace ammonite {
       ModelTracker inactiveModelTracker;
     }
 
+    //Asynchronous material tracking
+    namespace {
+      //Material applied by applyMaterialAsync(), waiting for its textures to load
+      struct AsyncMaterialLoad {
+        AmmoniteId modelId;
+        std::vector<GLuint> textureIds;
+        AmmoniteMaterialCallback callback;
+        void* userPtr;
+      };
+
+      std::list<AsyncMaterialLoad> asyncMaterialLoads;
+
+      //Colours drawn for textured components while they load
+      const ammonite::Vec<float, 3> placeholderDiffuse = {0.5f, 0.5f, 0.5f};
+      const ammonite::Vec<float, 3> placeholderSpecular = {0.0f, 0.0f, 0.0f};
+
+      //Stop tracking a model's asynchronous material, without calling its callback
+      void cancelAsyncMaterial(AmmoniteId modelId) {
+        std::erase_if(asyncMaterialLoads, [modelId](const AsyncMaterialLoad& asyncLoad) {
+          return asyncLoad.modelId == modelId;
+        });
+      }
+    }
+
     //Model movement helpers
     namespace {
       void moveModelToActive(AmmoniteId modelId, internal::ModelInfo* modelPtr) {
@@ -154,10 +182,14 @@ namespace ammonite {
         inactiveModelTracker.deleteModelInfo(modelId);
         activeModelTracker.addModelInfo(modelId, modelInfo);
         internal::setModelInfoActive(modelId, true);
+
+        //Track the bounds of active models only
+        internal::addModelBounds(modelIdPtrMap[modelId]);
       }
 
       void moveModelToInactive(AmmoniteId modelId, internal::ModelInfo* modelPtr) {
         //Move from active to inactive tracker, update model pointer map
+        internal::removeModelBounds(modelPtr);
         const internal::ModelInfo modelInfo = *modelPtr;
         activeModelTracker.deleteModelInfo(modelId);
         inactiveModelTracker.addModelInfo(modelId, modelInfo);
@@ -189,6 +221,44 @@ namespace ammonite {
         return &haveModelsMoved;
       }
 
+      /*
+       - Upload textures from applyMaterialAsync() that finished loading, and swap them
+         into their materials
+       - Call the callbacks of materials that finished loading
+       - Called by beginFrame()
+      */
+      void updateAsyncMaterials() {
+        //Refresh the materials of uploaded textures, and rebuild the draws using them
+        std::vector<GLuint> finishedTextureIds;
+        textures::internal::updateAsyncTextures(&finishedTextureIds);
+        for (const GLuint textureId : finishedTextureIds) {
+          graphics::internal::refreshTextureMaterials(textureId);
+          haveModelsMoved = true;
+        }
+
+        //Collect materials with no textures left to load, as callbacks may apply more
+        std::vector<AsyncMaterialLoad> finishedLoads;
+        auto asyncLoadIt = asyncMaterialLoads.begin();
+        while (asyncLoadIt != asyncMaterialLoads.end()) {
+          const bool isFinished = std::ranges::none_of(asyncLoadIt->textureIds,
+                                                       textures::internal::isTexturePending);
+          if (isFinished) {
+            finishedLoads.push_back(*asyncLoadIt);
+            asyncLoadIt = asyncMaterialLoads.erase(asyncLoadIt);
+          } else {
+            asyncLoadIt++;
+          }
+        }
+
+        for (const AsyncMaterialLoad& asyncLoad : finishedLoads) {
+          if (asyncLoad.callback != nullptr) {
+            const bool success = std::ranges::all_of(asyncLoad.textureIds,
+                                                     textures::internal::isTextureLoaded);
+            asyncLoad.callback(asyncLoad.modelId, success, asyncLoad.userPtr);
+          }
+        }
+      }
+
       /*
        - Set the ID of the attached light source
          - This doesn't unlink an existing source first
@@ -237,9 +307,10 @@ namespace ammonite {
           return 0;
         }
 
-        //Apply default texture IDs per mesh
+        //Apply default texture IDs and materials per mesh
         modelInfo.textureIds = modelInfo.modelData->textureIds;
         for (const internal::TextureIdGroup& textureGroup : modelInfo.textureIds) {
+          graphics::internal::copyMaterial(textureGroup.materialIndex);
           if (textureGroup.diffuseId != 0) {
             ammonite::textures::internal::copyTexture(textureGroup.diffuseId);
           }
@@ -255,8 +326,9 @@ namespace ammonite {
         ammonite::identity(modelInfo.positionData.rotationMatrix);
         ammonite::fromEuler(modelInfo.positionData.rotationQuat, 0.0f, 0.0f, 0.0f);
 
-        //Calculate model and normal matrices
-        internal::calcModelMatrices(&modelInfo.positionData);
+        //Calculate model and normal matrices, then track the model's bounds
+        internal::calcModelMatrices(&modelInfo);
+        internal::addModelBounds(&modelInfo);
 
         //Add model to the tracker and return the ID
         activeModelTracker.addModelInfo(modelInfo.modelId, modelInfo);
@@ -356,8 +428,9 @@ namespace ammonite {
         newModelInfo->drawMode = AMMONITE_DRAW_ACTIVE;
       }
 
-      //Increase texture reference counters
+      //Increase texture and material reference counters
       for (const internal::TextureIdGroup& textureGroup : newModelInfo->textureIds) {
+        graphics::internal::copyMaterial(textureGroup.materialIndex);
         if (textureGroup.diffuseId != 0) {
           ammonite::textures::internal::copyTexture(textureGroup.diffuseId);
         }
@@ -371,6 +444,12 @@ namespace ammonite {
       newModelInfo->modelId = newModelId;
       newModelInfo->lightEmitterId = 0;
 
+      //Track the copy's bounds separately, if it's active
+      newModelInfo->boundsNodeId = internal::BoundingTree::nullNode;
+      if (newModelInfo->drawMode != AMMONITE_DRAW_INACTIVE) {
+        internal::addModelBounds(newModelInfo);
+      }
+
       //Return the new ID
       return newModelId;
     }
@@ -378,10 +457,12 @@ namespace ammonite {
     void deleteModel(AmmoniteId modelId) {
       //Check the model actually exists
       if (modelIdPtrMap.contains(modelId)) {
-        const internal::ModelInfo* const modelInfo = modelIdPtrMap[modelId];
+        internal::ModelInfo* const modelInfo = modelIdPtrMap[modelId];
+        cancelAsyncMaterial(modelId);
 
-        //Release textures
+        //Release materials, then their textures
         for (const internal::TextureIdGroup& textureGroup : modelInfo->textureIds) {
+          graphics::internal::releaseMaterial(textureGroup.materialIndex);
           if (textureGroup.diffuseId != 0) {
             ammonite::textures::internal::deleteTexture(textureGroup.diffuseId);
           }
@@ -394,6 +475,9 @@ namespace ammonite {
         //Unlink any attached light source
         ammonite::lighting::internal::unlinkByModel(modelId);
 
+        //Stop tracking the model's bounds
+        internal::removeModelBounds(modelInfo);
+
         /*
          - Remove the model info from the tracker, before the data is deleted
          - Copy the modelKey for future use
@@ -417,35 +501,92 @@ namespace ammonite {
     }
 
     namespace {
-      //Apply one component of a material to a mesh
-      bool applyMaterialComponent(GLuint* textureIdPtr, bool isTexture,
-                                  const AmmoniteMaterialComponent& component) {
+      /*
+       - Apply one component of a material to a mesh, as a texture or a colour
+       - Asynchronous textures are drawn as the placeholder colour until they load
+      */
+      bool applyMaterialComponent(GLuint* textureIdPtr, ammonite::Vec<float, 3>& colour,
+                                  bool isTexture, const AmmoniteMaterialComponent& component,
+                                  const ammonite::Vec<float, 3>* placeholderColour) {
         //Remove any applied texture
         if (*textureIdPtr != 0) {
           ammonite::textures::internal::deleteTexture(*textureIdPtr);
           *textureIdPtr = 0;
         }
 
-        GLuint textureId = 0;
-        if (isTexture) {
-          //Create new texture
-          textureId = ammonite::textures::internal::loadTexture(
-            *component.textureInfo.texturePath, false,
-            component.textureInfo.isSrgbTexture);
+        //Colours are stored in the material, without a texture
+        if (!isTexture) {
+          ammonite::copy(component.colour, colour);
+          return true;
+        }
+
+        //Create new texture and apply it to the mesh
+        const std::string& texturePath = *component.textureInfo.texturePath;
+        const bool srgbTexture = component.textureInfo.isSrgbTexture;
+        if (placeholderColour != nullptr) {
+          ammonite::copy(*placeholderColour, colour);
+          *textureIdPtr = ammonite::textures::internal::loadTextureAsync(texturePath, false,
+                                                                         srgbTexture);
         } else {
-          //Create solid colour texture
-          textureId = textures::internal::loadSolidTexture(component.colour);
+          *textureIdPtr = ammonite::textures::internal::loadTexture(texturePath, false,
+                                                                    srgbTexture);
         }
 
-        //Apply texture to the mesh
-        *textureIdPtr = textureId;
-        return (textureId != 0);
+        return (*textureIdPtr != 0);
+      }
+
+      /*
+       - Apply a material to every mesh of a model, loading textures asynchronously
+         if requested
+       - Any asynchronous material still loading for the model is dropped
+      */
+      bool applyModelMaterial(internal::ModelInfo* modelInfoPtr,
+                              const AmmoniteMaterial& material, bool isAsync) {
+        //Materials are part of the draw state, so the renderer needs to rebuild its draws
+        haveModelsMoved = true;
+        cancelAsyncMaterial(modelInfoPtr->modelId);
+
+        const ammonite::Vec<float, 3>* const diffusePlaceholder =
+          isAsync ? &placeholderDiffuse : nullptr;
+        const ammonite::Vec<float, 3>* const specularPlaceholder =
+          isAsync ? &placeholderSpecular : nullptr;
+
+        //Apply material to every mesh on the model
+        for (internal::TextureIdGroup& textureIdGroup : modelInfoPtr->textureIds) {
+          //Release the old material before its textures
+          graphics::internal::releaseMaterial(textureIdGroup.materialIndex);
+
+          const bool appliedDiffuse = applyMaterialComponent(&textureIdGroup.diffuseId,
+            textureIdGroup.diffuseColour, material.diffuseIsTexture, material.diffuse,
+            diffusePlaceholder);
+          const bool appliedSpecular = applyMaterialComponent(&textureIdGroup.specularId,
+            textureIdGroup.specularColour, material.specularIsTexture, material.specular,
+            specularPlaceholder);
+
+          //Always hold a material, so the mesh can still be drawn and deleted
+          textureIdGroup.materialIndex = graphics::internal::acquireMaterial(
+            textureIdGroup.diffuseId, textureIdGroup.specularId,
+            textureIdGroup.diffuseColour, textureIdGroup.specularColour);
+
+          if (!appliedDiffuse) {
+            ammonite::utils::warning << "Failed to apply diffuse material component" << std::endl;
+            return false;
+          }
+
+          if (!appliedSpecular) {
+            ammonite::utils::warning << "Failed to apply specular material component" << std::endl;
+            return false;
+          }
+        }
+
+        return true;
       }
     }
 
     /*
      - Apply a material to every mesh of a model
-     - Existing textures will have their reference counter reduced
+     - Existing textures and materials will have their reference counter reduced
+     - Blocks until the material's textures are loaded
     */
     bool applyMaterial(AmmoniteId modelId, const AmmoniteMaterial& material) {
       internal::ModelInfo* const modelInfoPtr = modelIdPtrMap[modelId];
@@ -453,24 +594,58 @@ namespace ammonite {
         return false;
       }
 
-      //Apply material to every mesh on the model
-      for (internal::TextureIdGroup& textureIdGroup : modelInfoPtr->textureIds) {
-        if (!applyMaterialComponent(&textureIdGroup.diffuseId,
-                                    material.diffuseIsTexture, material.diffuse)) {
-          ammonite::utils::warning << "Failed to apply diffuse material component" << std::endl;
-          return false;
-        }
+      return applyModelMaterial(modelInfoPtr, material, false);
+    }
+
+    /*
+     - Apply a material to every mesh of a model, returning before its textures load
+       - Textures are decoded on the thread pool, then uploaded and swapped in by
+         beginFrame(), placeholder colours are drawn until then
+       - Once every texture has loaded or failed, callback is called from beginFrame()
+         with the model's ID, whether every texture loaded and userPtr
+         - callback may be nullptr, isMaterialLoading() can be used instead
+     - Existing textures and materials will have their reference counter reduced
+     - Applying another material or deleting the model drops the callback
+     - Returns false if the model doesn't exist or a texture couldn't be reserved
+    */
+    bool applyMaterialAsync(AmmoniteId modelId, const AmmoniteMaterial& material,
+                            AmmoniteMaterialCallback callback, void* userPtr) {
+      internal::ModelInfo* const modelInfoPtr = modelIdPtrMap[modelId];
+      if (modelInfoPtr == nullptr) {
+        return false;
+      }
+
+      if (!applyModelMaterial(modelInfoPtr, material, true)) {
+        return false;
+      }
 
-        if (!applyMaterialComponent(&textureIdGroup.specularId,
-                                    material.specularIsTexture, material.specular)) {
-          ammonite::utils::warning << "Failed to apply specular material component" << std::endl;
-          return false;
+      //Track the model's textures, to report when they've all loaded
+      AsyncMaterialLoad& asyncLoad = asyncMaterialLoads.emplace_back();
+      asyncLoad = {.modelId = modelId, .textureIds = {}, .callback = callback,
+                   .userPtr = userPtr};
+      for (const internal::TextureIdGroup& textureIdGroup : modelInfoPtr->textureIds) {
+        for (const GLuint textureId : {textureIdGroup.diffuseId, textureIdGroup.specularId}) {
+          if (textureId != 0) {
+            asyncLoad.textureIds.push_back(textureId);
+          }
         }
       }
 
       return true;
     }
 
+    bool applyMaterialAsync(AmmoniteId modelId, const AmmoniteMaterial& material) {
+      return applyMaterialAsync(modelId, material, nullptr, nullptr);
+    }
+
+    //Returns true while a material from applyMaterialAsync() is loading for a model
+    bool isMaterialLoading(AmmoniteId modelId) {
+      return std::ranges::any_of(asyncMaterialLoads,
+                                 [modelId](const AsyncMaterialLoad& asyncLoad) {
+        return asyncLoad.modelId == modelId;
+      });
+    }
+
     AmmoniteMaterial createMaterial(const std::string& diffusePath,
                                     const std::string& specularPath) {
       return {
@@ -575,8 +750,9 @@ namespace ammonite {
           moveModelToInactive(modelId, modelPtr);
         }
 
-        //Update draw mode
+        //Update draw mode, and flag the change for draws grouped by mode
         modelIdPtrMap[modelId]->drawMode = drawMode;
+        haveModelsMoved = true;
       }
     }
   }
@@ -3,6 +3,7 @@
 
 //Include other model components
 #include "loaders/modelLoader.hpp" // IWYU pragma: export
+#include "modelBounds.hpp" // IWYU pragma: export
 #include "modelPosition.hpp" // IWYU pragma: export
 #include "modelDataStorage.hpp" // IWYU pragma: export
 #include "modelTypes.hpp" // IWYU pragma: export
@@ -22,6 +23,7 @@ namespace AMMONITE_INTERNAL ammonite {
                      ModelInfo* modelInfoArray[]);
       ModelInfo* getModelPtr(AmmoniteId modelId);
       bool* getModelsMovedPtr();
+      void updateAsyncMaterials();
 
       void setLightEmitterId(AmmoniteId modelId, AmmoniteId lightEmitterId);
       AmmoniteId getLightEmitterId(AmmoniteId modelId);
@@ -6,7 +6,6 @@
 
 extern "C" {
   #include <epoxy/gl.h>
-  #include <stb/stb_image.h>
 }
 
 #include "skybox.hpp"
@@ -1,3 +1,4 @@
+#include <atomic>
 #include <chrono>
 #include <cstddef>
 #include <cstdint>
@@ -9,6 +10,7 @@
 #include <iostream>
 #include <string>
 #include <utility>
+#include <vector>
 
 extern "C" {
   #include <errno.h>
@@ -35,8 +37,22 @@ namespace ammonite {
       }
 
       namespace {
-        std::string getCachedFilePath(std::string* filePaths, unsigned int fileCount) {
-          return dataCachePath + internal::hashStrings(filePaths, fileCount).append(".cache");
+        /*
+         - Generate the cache path for a set of files
+         - Non-empty cache keys are hashed with the paths, so data created from the same
+           files with different settings gets its own cache file
+        */
+        std::string getCachedFilePath(std::string* filePaths, unsigned int fileCount,
+                                      const std::string& cacheKey) {
+          if (cacheKey.empty()) {
+            return dataCachePath +
+              utils::internal::hashStrings(filePaths, fileCount).append(".cache");
+          }
+
+          std::vector<std::string> keyStrings(filePaths, filePaths + fileCount);
+          keyStrings.push_back(cacheKey);
+          return dataCachePath + utils::internal::hashStrings(
+            keyStrings.data(), keyStrings.size()).append(".cache");
         }
 
         /*
@@ -355,94 +371,109 @@ namespace ammonite {
                                    unsigned int fileCount, std::size_t* dataSize,
                                    unsigned char** userData, std::size_t* userDataSize,
                                    AmmoniteCacheEnum* cacheState) {
-        //Generate a cache string
-        *cacheFilePath = getCachedFilePath(filePaths, fileCount);
-
-        //Attempt to load the cache file, try another string on collision
-        unsigned char* cacheData = nullptr;
-        unsigned int attempts = 0;
-        bool collision = true;
-        bool failed = false;
-        while (collision && attempts < MAX_LOAD_ATTEMPTS) {
-          collision = false;
-
-          //Check cache file exists
-          if (!std::filesystem::exists(*cacheFilePath)) {
-            ammoniteInternalDebug << "Couldn't find '" << *cacheFilePath << "'" << std::endl;
-            *cacheState = AMMONITE_CACHE_MISS;
-            return nullptr;
-          }
+        return internal::getCachedFile(cacheFilePath, filePaths, fileCount, "", dataSize,
+                                       userData, userDataSize, cacheState);
+      }
+
+      namespace internal {
+        /*
+         - Attempt to read a cached file, from file paths, checking timestamps and file sizes
+         - Same as getCachedFile(), except cacheKey is used when generating the cache path
+           - Pass the settings used to create the cached data, so each gets its own file
+        */
+        unsigned char* getCachedFile(std::string* cacheFilePath, std::string* filePaths,
+                                     unsigned int fileCount, const std::string& cacheKey,
+                                     std::size_t* dataSize, unsigned char** userData,
+                                     std::size_t* userDataSize, AmmoniteCacheEnum* cacheState) {
+          //Generate a cache string
+          *cacheFilePath = getCachedFilePath(filePaths, fileCount, cacheKey);
+
+          //Attempt to load the cache file, try another string on collision
+          unsigned char* cacheData = nullptr;
+          unsigned int attempts = 0;
+          bool collision = true;
+          bool failed = false;
+          while (collision && attempts < MAX_LOAD_ATTEMPTS) {
+            collision = false;
+
+            //Check cache file exists
+            if (!std::filesystem::exists(*cacheFilePath)) {
+              ammoniteInternalDebug << "Couldn't find '" << *cacheFilePath << "'" << std::endl;
+              *cacheState = AMMONITE_CACHE_MISS;
+              return nullptr;
+            }
 
-          //Attempt to read the cache if it exists, writes to size
-          std::size_t size = 0;
-          std::size_t blockSizes[3];
-          cacheData = loadFile(*cacheFilePath, &size);
-          if (cacheData == nullptr || size < sizeof(blockSizes)) {
-            ammonite::utils::warning << "Failed to read '" << *cacheFilePath << "'" << std::endl;
-            *cacheState = AMMONITE_CACHE_MISS;
-
-            //Cache data may or may not have been returned, due to size check
-            if (cacheData != nullptr) {
-              delete [] cacheData;
-              *cacheState = AMMONITE_CACHE_INVALID;
+            //Attempt to read the cache if it exists, writes to size
+            std::size_t size = 0;
+            std::size_t blockSizes[3];
+            cacheData = loadFile(*cacheFilePath, &size);
+            if (cacheData == nullptr || size < sizeof(blockSizes)) {
+              ammonite::utils::warning << "Failed to read '" << *cacheFilePath << "'" << std::endl;
+              *cacheState = AMMONITE_CACHE_MISS;
+
+              //Cache data may or may not have been returned, due to size check
+              if (cacheData != nullptr) {
+                delete [] cacheData;
+                *cacheState = AMMONITE_CACHE_INVALID;
+              }
+              return nullptr;
             }
-            return nullptr;
-          }
 
-          //Get the sizes and start addresses of the data, user and extra blocks
-          std::memcpy(blockSizes, cacheData + size - sizeof(blockSizes), sizeof(blockSizes));
-          *dataSize = blockSizes[0];
-          *userData = cacheData + blockSizes[0];
-          *userDataSize = blockSizes[1];
-          unsigned char* const extraData = *userData + *userDataSize;
-          const std::size_t extraDataSize = blockSizes[2] - sizeof(blockSizes);
-
-          //Check size of data is as expected, then validate the loaded cache
-          if (blockSizes[0] + blockSizes[1] + blockSizes[2] != size) {
-            ammonite::utils::warning << "Incorrect size information for '" << *cacheFilePath \
-                                     << "'" << std::endl;
-            failed = true;
-          } else {
-            const AmmoniteCacheEnum result = validateInputs(
-              filePaths, fileCount, extraData, extraDataSize);
-            if (result == AMMONITE_CACHE_COLLISION) {
-              //Append the attempt counter to the file path and try again
-              collision = true;
-              cacheFilePath->erase(cacheFilePath->rfind('.'));
-              *cacheFilePath += std::string("-") + std::to_string(attempts) +
-                                std::string(".cache");
-
-            } else if (result != AMMONITE_CACHE_HIT) {
-              ammonite::utils::warning << "Failed to validate '" << *cacheFilePath \
+            //Get the sizes and start addresses of the data, user and extra blocks
+            std::memcpy(blockSizes, cacheData + size - sizeof(blockSizes), sizeof(blockSizes));
+            *dataSize = blockSizes[0];
+            *userData = cacheData + blockSizes[0];
+            *userDataSize = blockSizes[1];
+            unsigned char* const extraData = *userData + *userDataSize;
+            const std::size_t extraDataSize = blockSizes[2] - sizeof(blockSizes);
+
+            //Check size of data is as expected, then validate the loaded cache
+            if (blockSizes[0] + blockSizes[1] + blockSizes[2] != size) {
+              ammonite::utils::warning << "Incorrect size information for '" << *cacheFilePath \
                                        << "'" << std::endl;
               failed = true;
+            } else {
+              const AmmoniteCacheEnum result = validateInputs(
+                filePaths, fileCount, extraData, extraDataSize);
+              if (result == AMMONITE_CACHE_COLLISION) {
+                //Append the attempt counter to the file path and try again
+                collision = true;
+                cacheFilePath->erase(cacheFilePath->rfind('.'));
+                *cacheFilePath += std::string("-") + std::to_string(attempts) +
+                                  std::string(".cache");
+
+              } else if (result != AMMONITE_CACHE_HIT) {
+                ammonite::utils::warning << "Failed to validate '" << *cacheFilePath \
+                                         << "'" << std::endl;
+                failed = true;
+              }
             }
+
+            //Increment attempts, and try again if we had a collision
+            attempts++;
           }
 
-          //Increment attempts, and try again if we had a collision
-          attempts++;
-        }
+          //Handle too many collision resolution attempts
+          if (attempts >= MAX_LOAD_ATTEMPTS && collision) {
+            ammonite::utils::warning << "Maximum number of collision resolution attempts reached" \
+                                     << std::endl;
+            failed = true;
+          }
 
-        //Handle too many collision resolution attempts
-        if (attempts >= MAX_LOAD_ATTEMPTS && collision) {
-          ammonite::utils::warning << "Maximum number of collision resolution attempts reached" \
-                                   << std::endl;
-          failed = true;
-        }
+          //Clean up after a failure
+          if (failed) {
+            if (!deleteCacheFile(*cacheFilePath)) {
+              ammonite::utils::warning << "Failed to clean broken cache '" << cacheFilePath << "'" << std::endl;
+            }
 
-        //Clean up after a failure
-        if (failed) {
-          if (!deleteCacheFile(*cacheFilePath)) {
-            ammonite::utils::warning << "Failed to clean broken cache '" << cacheFilePath << "'" << std::endl;
+            delete [] cacheData;
+            *cacheState = AMMONITE_CACHE_INVALID;
+            return nullptr;
           }
 
-          delete [] cacheData;
-          *cacheState = AMMONITE_CACHE_INVALID;
-          return nullptr;
+          *cacheState = AMMONITE_CACHE_HIT;
+          return cacheData;
         }
-
-        *cacheState = AMMONITE_CACHE_HIT;
-        return cacheData;
       }
 
       /*
@@ -489,18 +520,33 @@ namespace ammonite {
         std::memcpy(fileData + dataSize + userDataSize + extraSize, blockSizes,
                     sizeof(blockSizes));
 
-        //Write the data, user data and cache info to the cache file
-        if (!ammonite::utils::files::writeFile(cacheFilePath, fileData, totalDataSize)) {
+        /*
+         - Write the data, user data and cache info to a temporary file, then move it over
+           the cache file
+         - Readers never see a partial file, and concurrent writers of the same cache
+           replace each other's complete files
+        */
+        static std::atomic<unsigned int> tempFileCounter = 0;
+        const std::string tempFilePath = cacheFilePath + "." + std::to_string(getpid()) +
+          "-" + std::to_string(tempFileCounter++) + ".tmp";
+        bool success = ammonite::utils::files::writeFile(tempFilePath, fileData, totalDataSize);
+        delete [] fileData;
+        if (success && std::rename(tempFilePath.c_str(), cacheFilePath.c_str()) != 0) {
+          ammonite::utils::warning << "Failed to move '" << tempFilePath << "' to '" \
+                                   << cacheFilePath << "' (" << -errno << ")" << std::endl;
+          success = false;
+        }
+
+        if (!success) {
           ammonite::utils::warning << "Failed to cache '" << cacheFilePath << "'" << std::endl;
-          if (!deleteCacheFile(cacheFilePath)) {
-            ammonite::utils::warning << "Failed to clean broken cache '" << cacheFilePath << "'" << std::endl;
+          if (!deleteFile(tempFilePath)) {
+            ammonite::utils::warning << "Failed to clean temporary cache '" << tempFilePath \
+                                     << "'" << std::endl;
           }
 
-          delete [] fileData;
           return false;
         }
 
-        delete [] fileData;
         return true;
       }
     }
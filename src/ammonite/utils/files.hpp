@@ -1,7 +1,25 @@
 #ifndef INTERNALFILES
 #define INTERNALFILES
 
+#include <cstddef>
+#include <string>
+
+#include "../visibility.hpp"
+
 //Include public interface
 #include "../../include/ammonite/utils/files.hpp" // IWYU pragma: export
 
+namespace AMMONITE_INTERNAL ammonite {
+  namespace utils {
+    namespace files {
+      namespace internal {
+        unsigned char* getCachedFile(std::string* cacheFilePath, std::string* filePaths,
+                                     unsigned int fileCount, const std::string& cacheKey,
+                                     std::size_t* dataSize, unsigned char** userData,
+                                     std::size_t* userDataSize, AmmoniteCacheEnum* cacheState);
+      }
+    }
+  }
+}
+
 #endif
@@ -0,0 +1,128 @@
+#ifndef INTERNALFLATHASHMAP
+#define INTERNALFLATHASHMAP
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "hash.hpp"
+
+#include "../visibility.hpp"
+
+namespace AMMONITE_INTERNAL ammonite {
+  namespace utils {
+    namespace internal {
+      /*
+       - Map 128-bit hashes to values, stored in a single array with linear probing
+       - Keys are already well mixed, so their low bits pick the starting slot
+       - Removed entries shift later entries back, so no tombstones are left behind
+       - Pointers to values are invalidated by inserting or erasing
+      */
+      template <typename T>
+      class FlatHashMap {
+      private:
+        struct Slot {
+          Hash128 key;
+          T value;
+          bool isUsed = false;
+        };
+
+        std::vector<Slot> slots;
+        std::size_t entryCount = 0;
+
+        std::size_t getMask() const {
+          return slots.size() - 1;
+        }
+
+        //Return the slot holding key, or the empty slot where it would go
+        std::size_t findSlot(const Hash128& key) const {
+          std::size_t slot = key.low & getMask();
+          while (slots[slot].isUsed && !(slots[slot].key == key)) {
+            slot = (slot + 1) & getMask();
+          }
+
+          return slot;
+        }
+
+        //Double the slot count and re-insert every entry, keeping under 3/4 full
+        void grow() {
+          std::vector<Slot> oldSlots = std::move(slots);
+          slots = std::vector<Slot>(oldSlots.empty() ? 16 : oldSlots.size() * 2);
+          for (Slot& oldSlot : oldSlots) {
+            if (oldSlot.isUsed) {
+              slots[findSlot(oldSlot.key)] = std::move(oldSlot);
+            }
+          }
+        }
+
+      public:
+        //Return a pointer to the value for key, or nullptr if it's missing
+        T* find(const Hash128& key) {
+          if (entryCount == 0) {
+            return nullptr;
+          }
+
+          Slot& slot = slots[findSlot(key)];
+          return slot.isUsed ? &slot.value : nullptr;
+        }
+
+        bool contains(const Hash128& key) const {
+          return entryCount != 0 && slots[findSlot(key)].isUsed;
+        }
+
+        //Return the value for key, inserting a default value if it's missing
+        T& operator[](const Hash128& key) {
+          if ((entryCount + 1) * 4 > slots.size() * 3) {
+            grow();
+          }
+
+          Slot& slot = slots[findSlot(key)];
+          if (!slot.isUsed) {
+            slot = {.key = key, .value = T(), .isUsed = true};
+            entryCount++;
+          }
+
+          return slot.value;
+        }
+
+        //Remove key, returning false if it wasn't present
+        bool erase(const Hash128& key) {
+          if (entryCount == 0) {
+            return false;
+          }
+
+          std::size_t emptySlot = findSlot(key);
+          if (!slots[emptySlot].isUsed) {
+            return false;
+          }
+
+          //Move back later entries of the run that would no longer be reachable
+          std::size_t slot = emptySlot;
+          while (true) {
+            slot = (slot + 1) & getMask();
+            if (!slots[slot].isUsed) {
+              break;
+            }
+
+            //Entries that start between the gap and their slot must stay put
+            const std::size_t homeSlot = slots[slot].key.low & getMask();
+            if (((slot - homeSlot) & getMask()) >= ((slot - emptySlot) & getMask())) {
+              slots[emptySlot] = std::move(slots[slot]);
+              emptySlot = slot;
+            }
+          }
+
+          slots[emptySlot] = {};
+          entryCount--;
+          return true;
+        }
+
+        std::size_t size() const {
+          return entryCount;
+        }
+      };
+    }
+  }
+}
+
+#endif
@@ -1,4 +1,7 @@
+#include <bit>
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <string>
 
 extern "C" {
@@ -11,7 +14,6 @@ extern "C" {
 }
 
 #ifndef USE_VAES_AVX512
-  #include <cstddef>
   #include <functional>
 #endif
 
@@ -104,6 +106,81 @@ namespace ammonite {
         return outputString;
       }
 #endif
+
+      namespace {
+        constexpr std::uint64_t multiplierA = 0x87C37B91114253D5;
+        constexpr std::uint64_t multiplierB = 0x4CF5AD432745937F;
+
+        //Spread every input bit across the whole output
+        std::uint64_t finalMix(std::uint64_t value) {
+          value ^= value >> 33;
+          value *= 0xFF51AFD7ED558CCD;
+          value ^= value >> 33;
+          value *= 0xC4CEB9FE1A85EC53;
+          value ^= value >> 33;
+          return value;
+        }
+
+        std::uint64_t mixLow(std::uint64_t block) {
+          return std::rotl(block * multiplierA, 31) * multiplierB;
+        }
+
+        std::uint64_t mixHigh(std::uint64_t block) {
+          return std::rotl(block * multiplierB, 33) * multiplierA;
+        }
+      }
+
+      /*
+       - Hash size bytes of data into 128 bits, in the style of MurmurHash3
+       - Different seeds give unrelated hashes of the same data
+       - Fast enough for cache keys, but don't use this for security either
+      */
+      Hash128 hashData(const void* data, std::size_t size, std::uint64_t seed) {
+        const unsigned char* bytes = (const unsigned char*)data;
+        std::uint64_t low = seed;
+        std::uint64_t high = seed;
+
+        //Mix in each 16 byte block
+        const std::size_t blockCount = size / 16;
+        for (std::size_t i = 0; i < blockCount; i++) {
+          std::uint64_t blockLow = 0;
+          std::uint64_t blockHigh = 0;
+          std::memcpy(&blockLow, bytes + (i * 16), sizeof(blockLow));
+          std::memcpy(&blockHigh, bytes + (i * 16) + 8, sizeof(blockHigh));
+
+          low ^= mixLow(blockLow);
+          low = (std::rotl(low, 27) + high) * 5 + 0x52DCE729;
+          high ^= mixHigh(blockHigh);
+          high = (std::rotl(high, 31) + low) * 5 + 0x38495AB5;
+        }
+
+        //Mix in the remaining bytes, zero-padded to a block
+        const std::size_t tailSize = size % 16;
+        if (tailSize != 0) {
+          unsigned char tail[16] = {0};
+          std::memcpy(tail, bytes + (blockCount * 16), tailSize);
+
+          std::uint64_t tailLow = 0;
+          std::uint64_t tailHigh = 0;
+          std::memcpy(&tailLow, tail, sizeof(tailLow));
+          std::memcpy(&tailHigh, tail + 8, sizeof(tailHigh));
+          low ^= mixLow(tailLow);
+          high ^= mixHigh(tailHigh);
+        }
+
+        //Include the size, so zero-padding can't collide, then mix the halves together
+        low ^= (std::uint64_t)size;
+        high ^= (std::uint64_t)size;
+        low += high;
+        high += low;
+
+        low = finalMix(low);
+        high = finalMix(high);
+        low += high;
+        high += low;
+
+        return {.low = low, .high = high};
+      }
     }
   }
 }
@@ -1,6 +1,8 @@
 #ifndef INTERNALHASH
 #define INTERNALHASH
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 
 #include "../visibility.hpp"
@@ -9,6 +11,16 @@ namespace AMMONITE_INTERNAL ammonite {
   namespace utils {
     namespace internal {
       std::string hashStrings(const std::string* inputs, unsigned int inputCount);
+
+      //128-bit hash, used to identify data without storing it
+      struct Hash128 {
+        std::uint64_t low = 0;
+        std::uint64_t high = 0;
+
+        bool operator==(const Hash128& other) const = default;
+      };
+
+      Hash128 hashData(const void* data, std::size_t size, std::uint64_t seed);
     }
   }
 }
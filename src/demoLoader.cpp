@@ -199,7 +199,8 @@ namespace {
       frameRate = 1 / frameTime;
     }
 
-    return std::format("{:.2f} fps ({:f}ms)", frameRate, frameTime * 1000);
+    return std::format("{:.2f} fps ({:f}ms), {} state changes", frameRate, frameTime * 1000,
+                       ammonite::renderer::getFrameStateChanges());
   }
 
   //Clean up anything that was created
@@ -199,6 +199,7 @@ namespace {
     RenderFarPlaneKey,
     ShadowFarPlaneKey,
     GammaCorrectionEnabledKey,
+    IndirectDrawingKey,
     AmbientLightKey,
     PlacementColourKey
   };
@@ -219,6 +220,7 @@ namespace {
     {"renderFarPlane", RenderFarPlaneKey},
     {"shadowFarPlane", ShadowFarPlaneKey},
     {"gammaCorrection", GammaCorrectionEnabledKey},
+    {"indirectDrawing", IndirectDrawingKey},
     {"ambientLight", AmbientLightKey},
     {"placementColour", PlacementColourKey}
   };
@@ -265,6 +267,9 @@ namespace {
     case GammaCorrectionEnabledKey:
       result = boolToString(ammonite::renderer::settings::getGammaCorrection());
       break;
+    case IndirectDrawingKey:
+      result = boolToString(ammonite::renderer::settings::getIndirectDrawing());
+      break;
     case AmbientLightKey:
       {
         ammonite::Vec<float, 3> lightVec = {0};
@@ -316,6 +321,7 @@ namespace {
     case FocalDepthEnabledKey:
     case VsyncKey:
     case GammaCorrectionEnabledKey:
+    case IndirectDrawingKey:
       valuePtr = new bool;
       if (!stringToBool(arguments[2], (bool*)valuePtr)) {
         delete (bool*)valuePtr;
@@ -387,6 +393,9 @@ namespace {
     case GammaCorrectionEnabledKey:
       ammonite::renderer::settings::setGammaCorrection(*((bool*)valuePtr));
       break;
+    case IndirectDrawingKey:
+      ammonite::renderer::settings::setIndirectDrawing(*((bool*)valuePtr));
+      break;
     case AmbientLightKey:
       ammonite::lighting::properties::setAmbientLight(*((ammonite::Vec<float, 3>*)valuePtr));
       break;
@@ -400,6 +409,7 @@ namespace {
     case FocalDepthEnabledKey:
     case VsyncKey:
     case GammaCorrectionEnabledKey:
+    case IndirectDrawingKey:
       delete (bool*)valuePtr;
       break;
     case FocalDepthKey:
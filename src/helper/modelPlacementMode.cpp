@@ -173,9 +173,17 @@ namespace placement {
     const double horiz = ammonite::camera::getHorizontal(activeCameraId);
     const double vert = ammonite::camera::getVertical(activeCameraId);
 
+    //Stop at the first model in the way, ignoring the model being placed
+    float placementDistance = modelDistance;
+    float hitDistance = 0.0f;
+    if (ammonite::models::pickModel(cameraPosition, cameraDirection,
+                                    placementModelId, &hitDistance) != 0) {
+      placementDistance = std::min(placementDistance, hitDistance);
+    }
+
     //Calculate position
     ammonite::Vec<float, 3> modelPosition = {0};
-    ammonite::scale(cameraDirection, modelDistance, modelPosition);
+    ammonite::scale(cameraDirection, placementDistance, modelPosition);
     ammonite::add(modelPosition, cameraPosition);
 
     //Place the model
@@ -20,10 +20,12 @@ namespace AMMONITE_EXPOSED ammonite {
         void setFocalDepthEnabled(bool enabled);
         void setFocalDepth(float depth);
         void setBlurStrength(float strength);
+        void setBlurDownscale(unsigned int downscale);
 
         bool getFocalDepthEnabled();
         float getFocalDepth();
         float getBlurStrength();
+        unsigned int getBlurDownscale();
       }
 
       void setVsync(bool enabled);
@@ -34,6 +36,18 @@ namespace AMMONITE_EXPOSED ammonite {
       void setRenderFarPlane(float renderFarPlane);
       void setShadowFarPlane(float shadowFarPlane);
       void setGammaCorrection(bool gammaCorrection);
+      void setIndirectDrawing(bool enabled);
+      void setStaticShadowCaching(bool enabled);
+      void setShadowAtlasEnabled(bool enabled);
+      void setShadowAtlasRes(unsigned int shadowAtlasRes);
+      void setClusteredLighting(bool enabled);
+      void setDepthPrepass(bool enabled);
+      void setDynamicResolution(bool enabled);
+      void setTargetFrameTime(float targetFrameTime);
+      void setTextureCompression(bool enabled);
+      void setTextureStreaming(bool enabled);
+      void setTextureMemoryBudget(unsigned int megabytes);
+      void setTextureAtlasing(bool enabled);
 
       bool getVsync();
       float getFrameLimit();
@@ -43,10 +57,23 @@ namespace AMMONITE_EXPOSED ammonite {
       float getRenderFarPlane();
       float getShadowFarPlane();
       bool getGammaCorrection();
+      bool getIndirectDrawing();
+      bool getStaticShadowCaching();
+      bool getShadowAtlasEnabled();
+      unsigned int getShadowAtlasRes();
+      bool getClusteredLighting();
+      bool getDepthPrepass();
+      bool getDynamicResolution();
+      float getTargetFrameTime();
+      bool getTextureCompression();
+      bool getTextureStreaming();
+      unsigned int getTextureMemoryBudget();
+      bool getTextureAtlasing();
     }
 
     uintmax_t getTotalFrames();
     double getAverageFrameTime();
+    unsigned int getFrameStateChanges();
     void drawFrame();
   }
 }
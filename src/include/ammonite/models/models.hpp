@@ -10,6 +10,12 @@
 
 static constexpr bool ASSUME_FLIP_MODEL_UVS = true;
 
+/*
+ - Called once a material applied with applyMaterialAsync() has finished loading
+ - success is false if any of its textures failed to load
+*/
+using AmmoniteMaterialCallback = void (*)(AmmoniteId modelId, bool success, void* userPtr);
+
 //Model drawing mode enums
 enum AmmoniteDrawEnum : unsigned char {
   AMMONITE_DRAW_INACTIVE,
@@ -100,6 +106,10 @@ namespace AMMONITE_EXPOSED ammonite {
     AmmoniteId copyModel(AmmoniteId modelId, bool preserveDrawMode);
 
     bool applyMaterial(AmmoniteId modelId, const AmmoniteMaterial& material);
+    bool applyMaterialAsync(AmmoniteId modelId, const AmmoniteMaterial& material,
+                            AmmoniteMaterialCallback callback, void* userPtr);
+    bool applyMaterialAsync(AmmoniteId modelId, const AmmoniteMaterial& material);
+    bool isMaterialLoading(AmmoniteId modelId);
     AmmoniteMaterial createMaterial(const std::string& diffusePath,
                                     const std::string& specularPath);
     AmmoniteMaterial createMaterial(const ammonite::Vec<float, 3>& diffuseColour,
@@ -114,6 +124,10 @@ namespace AMMONITE_EXPOSED ammonite {
     unsigned int getVertexCount(AmmoniteId modelId);
     void setDrawMode(AmmoniteId modelId, AmmoniteDrawEnum drawMode);
 
+    AmmoniteId pickModel(const ammonite::Vec<float, 3>& origin,
+                         const ammonite::Vec<float, 3>& direction,
+                         AmmoniteId ignoredModelId, float* distance);
+
     bool dumpModelStorageDebug();
   }
 }
@@ -0,0 +1,1792 @@
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <ammonite/ammonite.hpp>
+
+//Internal structures are built into the test, since the library doesn't export them
+#include "ammonite/graphics/culling.hpp"
+#include "ammonite/graphics/lightClusters.hpp"
+#include "ammonite/graphics/rangeAllocator.hpp"
+#include "ammonite/graphics/renderQueue.hpp"
+#include "ammonite/graphics/shadowAtlas.hpp"
+#include "ammonite/graphics/shadowInstances.hpp"
+#include "ammonite/graphics/textureAtlas.hpp"
+#include "ammonite/graphics/textureCompression.hpp"
+#include "ammonite/models/boundingTree.hpp"
+#include "ammonite/utils/flatHashMap.hpp"
+#include "ammonite/utils/hash.hpp"
+
+/*
+ - Tests for internal data structures that don't need an OpenGL context
+ - Each structure is checked against a brute-force model of the same state
+*/
+
+//Range allocator helpers
+namespace {
+  struct AllocatedRange {
+    unsigned int offset;
+    unsigned int size;
+  };
+
+  /*
+   - Compare an allocator to an occupancy map of every element
+   - Checks the used size, the largest free range and the number of free ranges
+  */
+  bool verifyRangeAllocator(const ammonite::graphics::internal::RangeAllocator& allocator,
+                            const std::vector<bool>& occupied) {
+    unsigned int usedSize = 0;
+    unsigned int largestFreeRange = 0;
+    unsigned int freeRangeCount = 0;
+    unsigned int currentFreeRange = 0;
+    for (const bool isOccupied : occupied) {
+      if (isOccupied) {
+        usedSize++;
+        currentFreeRange = 0;
+      } else {
+        if (currentFreeRange == 0) {
+          freeRangeCount++;
+        }
+
+        currentFreeRange++;
+        largestFreeRange = std::max(largestFreeRange, currentFreeRange);
+      }
+    }
+
+    if (allocator.getUsedSize() != usedSize) {
+      ammonite::utils::error << "Used size was " << allocator.getUsedSize() \
+                             << ", expected " << usedSize << std::endl;
+      return false;
+    }
+
+    if (allocator.getLargestFreeRange() != largestFreeRange) {
+      ammonite::utils::error << "Largest free range was " << allocator.getLargestFreeRange() \
+                             << ", expected " << largestFreeRange << std::endl;
+      return false;
+    }
+
+    //Adjacent free ranges must always be merged
+    if (allocator.getFreeRangeCount() != freeRangeCount) {
+      ammonite::utils::error << "Free range count was " << allocator.getFreeRangeCount() \
+                             << ", expected " << freeRangeCount << std::endl;
+      return false;
+    }
+
+    return true;
+  }
+
+  //Mark a range as occupied or free, failing if any element is already in that state
+  bool markRange(std::vector<bool>& occupied, const AllocatedRange& range, bool isOccupied) {
+    for (unsigned int i = range.offset; i < range.offset + range.size; i++) {
+      if (i >= occupied.size() || occupied[i] == isOccupied) {
+        ammonite::utils::error << "Range (" << range.offset << ", " << range.size \
+                               << ") " << (isOccupied ? "overlaps used" : "overlaps free") \
+                               << " storage at " << i << std::endl;
+        return false;
+      }
+
+      occupied[i] = isOccupied;
+    }
+
+    return true;
+  }
+}
+
+//Range allocator tests
+namespace {
+  //Allocate and free random ranges, comparing against an occupancy map after every step
+  bool testRangeAllocatorRandom(unsigned int capacity, unsigned int operationCount,
+                                unsigned int maxRangeSize) {
+    ammonite::graphics::internal::RangeAllocator allocator(capacity);
+    std::vector<bool> occupied(capacity, false);
+    std::vector<AllocatedRange> allocatedRanges;
+
+    for (unsigned int operation = 0; operation < operationCount; operation++) {
+      const bool shouldFree = !allocatedRanges.empty() &&
+                              ammonite::utils::random<unsigned int>(1) == 0;
+      if (shouldFree) {
+        const unsigned int rangeIndex = ammonite::utils::random<unsigned int>(
+          allocatedRanges.size() - 1);
+        const AllocatedRange range = allocatedRanges[rangeIndex];
+        allocatedRanges[rangeIndex] = allocatedRanges.back();
+        allocatedRanges.pop_back();
+
+        if (!markRange(occupied, range, false)) {
+          return false;
+        }
+        allocator.free(range.offset, range.size);
+      } else {
+        AllocatedRange range = {
+          .offset = 0,
+          .size = ammonite::utils::random<unsigned int>(1, maxRangeSize)
+        };
+
+        if (allocator.allocate(range.size, &range.offset)) {
+          if (!markRange(occupied, range, true)) {
+            return false;
+          }
+          allocatedRanges.push_back(range);
+        } else if (allocator.getLargestFreeRange() >= range.size) {
+          ammonite::utils::error << "Failed to allocate " << range.size \
+                                 << " elements, despite a large enough free range" << std::endl;
+          return false;
+        }
+      }
+
+      if (!verifyRangeAllocator(allocator, occupied)) {
+        return false;
+      }
+    }
+
+    //Free everything, the allocator should return to a single range
+    for (const AllocatedRange& range : allocatedRanges) {
+      markRange(occupied, range, false);
+      allocator.free(range.offset, range.size);
+    }
+
+    if (!allocator.isEmpty() || !verifyRangeAllocator(allocator, occupied)) {
+      ammonite::utils::error << "Allocator didn't return to a single free range" << std::endl;
+      return false;
+    }
+
+    return true;
+  }
+
+  //Fill the allocator exactly, then free alternate ranges and merge them back together
+  bool testRangeAllocatorMerge(unsigned int rangeCount, unsigned int rangeSize) {
+    ammonite::graphics::internal::RangeAllocator allocator(rangeCount * rangeSize);
+    std::vector<bool> occupied(rangeCount * rangeSize, false);
+    std::vector<AllocatedRange> ranges(rangeCount);
+    for (AllocatedRange& range : ranges) {
+      range.size = rangeSize;
+      if (!allocator.allocate(range.size, &range.offset) ||
+          !markRange(occupied, range, true)) {
+        ammonite::utils::error << "Failed to fill the allocator" << std::endl;
+        return false;
+      }
+    }
+
+    //Full allocators have no free ranges left, and reject further allocations
+    unsigned int offset = 0;
+    if (allocator.allocate(1, &offset) || !verifyRangeAllocator(allocator, occupied)) {
+      ammonite::utils::error << "Full allocator accepted an allocation" << std::endl;
+      return false;
+    }
+
+    //Free every other range, none of these should merge
+    for (unsigned int i = 0; i < rangeCount; i += 2) {
+      markRange(occupied, ranges[i], false);
+      allocator.free(ranges[i].offset, ranges[i].size);
+    }
+
+    if (!verifyRangeAllocator(allocator, occupied)) {
+      return false;
+    }
+
+    //Free the rest, each should merge with both neighbours
+    for (unsigned int i = 1; i < rangeCount; i += 2) {
+      markRange(occupied, ranges[i], false);
+      allocator.free(ranges[i].offset, ranges[i].size);
+      if (!verifyRangeAllocator(allocator, occupied)) {
+        return false;
+      }
+    }
+
+    return allocator.isEmpty();
+  }
+
+  //Zero-sized ranges always succeed, and never touch the allocator's state
+  bool testRangeAllocatorEmpty() {
+    ammonite::graphics::internal::RangeAllocator emptyAllocator(0);
+    ammonite::graphics::internal::RangeAllocator allocator(16);
+    unsigned int offset = 1;
+    if (emptyAllocator.allocate(1, &offset) || !emptyAllocator.allocate(0, &offset) ||
+        emptyAllocator.getFreeRangeCount() != 0) {
+      ammonite::utils::error << "Empty allocator didn't reject allocations" << std::endl;
+      return false;
+    }
+
+    if (!allocator.allocate(0, &offset) || allocator.getUsedSize() != 0 ||
+        allocator.getFreeRangeCount() != 1) {
+      ammonite::utils::error << "Zero-sized allocation changed the allocator" << std::endl;
+      return false;
+    }
+
+    allocator.free(offset, 0);
+    return allocator.isEmpty() && allocator.getLargestFreeRange() == 16;
+  }
+}
+
+//Shadow atlas helpers
+namespace {
+  using ammonite::graphics::internal::ShadowTile;
+
+  /*
+   - Track which parts of the atlas are used, in units of the smallest tile
+   - Mark a tile as used or free, failing if any cell is already in that state
+  */
+  bool markTile(std::vector<bool>& occupied, unsigned int cellsPerSide, unsigned int cellSize,
+                const ShadowTile& tile, bool isOccupied) {
+    const unsigned int firstX = tile.x / cellSize;
+    const unsigned int firstY = tile.y / cellSize;
+    const unsigned int tileCells = tile.size / cellSize;
+    for (unsigned int y = firstY; y < firstY + tileCells; y++) {
+      for (unsigned int x = firstX; x < firstX + tileCells; x++) {
+        if (x >= cellsPerSide || y >= cellsPerSide ||
+            occupied[(y * cellsPerSide) + x] == isOccupied) {
+          ammonite::utils::error << "Tile (" << tile.x << ", " << tile.y << ", " << tile.size \
+                                 << ") " << (isOccupied ? "overlaps a used" : "overlaps a free") \
+                                 << " tile" << std::endl;
+          return false;
+        }
+
+        occupied[(y * cellsPerSide) + x] = isOccupied;
+      }
+    }
+
+    return true;
+  }
+
+  //Returns true if any aligned square of tileCells cells is entirely free
+  bool hasFreeSquare(const std::vector<bool>& occupied, unsigned int cellsPerSide,
+                     unsigned int tileCells) {
+    for (unsigned int squareY = 0; squareY < cellsPerSide; squareY += tileCells) {
+      for (unsigned int squareX = 0; squareX < cellsPerSide; squareX += tileCells) {
+        bool isFree = true;
+        for (unsigned int y = squareY; y < squareY + tileCells && isFree; y++) {
+          for (unsigned int x = squareX; x < squareX + tileCells && isFree; x++) {
+            isFree = !occupied[(y * cellsPerSide) + x];
+          }
+        }
+
+        if (isFree) {
+          return true;
+        }
+      }
+    }
+
+    return false;
+  }
+}
+
+//Shadow atlas tests
+namespace {
+  /*
+   - Allocate and free random tiles, comparing against an occupancy map after every step
+   - Allocations may only fail if no aligned square of that size is free, so any
+     unmerged siblings are caught
+  */
+  bool testShadowAtlasRandom(unsigned int atlasSize, unsigned int minTileSize,
+                             unsigned int operationCount) {
+    ammonite::graphics::internal::ShadowAtlasAllocator allocator(atlasSize, minTileSize);
+    const unsigned int cellsPerSide = atlasSize / minTileSize;
+    std::vector<bool> occupied((std::size_t)cellsPerSide * cellsPerSide, false);
+    std::vector<ShadowTile> tiles;
+    unsigned int usedArea = 0;
+
+    for (unsigned int operation = 0; operation < operationCount; operation++) {
+      if (!tiles.empty() && ammonite::utils::random<unsigned int>(1) == 0) {
+        const unsigned int tileIndex = ammonite::utils::random<unsigned int>(tiles.size() - 1);
+        const ShadowTile tile = tiles[tileIndex];
+        tiles[tileIndex] = tiles.back();
+        tiles.pop_back();
+
+        if (!markTile(occupied, cellsPerSide, minTileSize, tile, false)) {
+          return false;
+        }
+        allocator.free(tile);
+        usedArea -= tile.size * tile.size;
+      } else {
+        //Request any size, including sizes that aren't powers of 2
+        ShadowTile tile;
+        const unsigned int requestedSize = ammonite::utils::random<unsigned int>(
+          1, atlasSize / 2);
+        const unsigned int expectedSize = std::clamp(std::bit_floor(requestedSize),
+                                                     minTileSize, atlasSize);
+        if (allocator.allocate(requestedSize, &tile)) {
+          if (tile.size != expectedSize || tile.x % tile.size != 0 ||
+              tile.y % tile.size != 0) {
+            ammonite::utils::error << "Tile (" << tile.x << ", " << tile.y << ", " \
+                                   << tile.size << ") is misaligned" << std::endl;
+            return false;
+          }
+
+          if (!markTile(occupied, cellsPerSide, minTileSize, tile, true)) {
+            return false;
+          }
+          tiles.push_back(tile);
+          usedArea += tile.size * tile.size;
+        } else if (hasFreeSquare(occupied, cellsPerSide, expectedSize / minTileSize)) {
+          ammonite::utils::error << "Failed to allocate a " << expectedSize \
+                                 << " tile, despite a free space" << std::endl;
+          return false;
+        }
+      }
+
+      if (allocator.getUsedArea() != usedArea) {
+        ammonite::utils::error << "Used area was " << allocator.getUsedArea() \
+                               << ", expected " << usedArea << std::endl;
+        return false;
+      }
+    }
+
+    //Free everything, the whole atlas should merge back into a single tile
+    for (const ShadowTile& tile : tiles) {
+      allocator.free(tile);
+    }
+
+    ShadowTile tile;
+    if (allocator.getUsedArea() != 0 || !allocator.allocate(atlasSize, &tile) ||
+        tile.size != atlasSize) {
+      ammonite::utils::error << "Freed tiles didn't merge into the whole atlas" << std::endl;
+      return false;
+    }
+
+    return true;
+  }
+
+  //Sizes are rounded down to powers of 2, and empty atlases reject every tile
+  bool testShadowAtlasLimits() {
+    ShadowTile tile;
+    ammonite::graphics::internal::ShadowAtlasAllocator allocator(1000, 100);
+    ammonite::graphics::internal::ShadowAtlasAllocator emptyAllocator(0, 16);
+    if (allocator.getAtlasSize() != 512 || allocator.getMinTileSize() != 64 ||
+        emptyAllocator.allocate(16, &tile)) {
+      ammonite::utils::error << "Shadow atlas has invalid limits" << std::endl;
+      return false;
+    }
+
+    //Oversized tiles are clamped to the atlas, and fill it
+    return allocator.allocate(4096, &tile) && tile.size == 512 &&
+           !allocator.allocate(1, &tile);
+  }
+}
+
+//Render queue tests
+namespace {
+  using ammonite::graphics::internal::RenderItem;
+
+  /*
+   - Sort random render items, and compare them to a stable sort of the same items
+   - Keys are picked from a small set, so many items share a key, and most digits
+     are shared by every key
+  */
+  bool testRenderQueueSort(unsigned int itemCount, unsigned int distinctKeys) {
+    std::vector<std::uint64_t> keys(distinctKeys);
+    for (std::uint64_t& key : keys) {
+      key = ammonite::utils::random<std::uint64_t>();
+    }
+
+    //Items remember their original position, to check the sort is stable
+    std::vector<RenderItem> renderItems(itemCount);
+    for (unsigned int i = 0; i < itemCount; i++) {
+      renderItems[i] = {
+        .sortKey = keys[ammonite::utils::random<unsigned int>(distinctKeys - 1)],
+        .modelIndex = i,
+        .meshIndex = 0
+      };
+    }
+
+    std::vector<RenderItem> expectedItems = renderItems;
+    std::stable_sort(expectedItems.begin(), expectedItems.end(),
+                     [](const RenderItem& left, const RenderItem& right) {
+      return left.sortKey < right.sortKey;
+    });
+
+    ammonite::graphics::internal::sortRenderItems(&renderItems);
+    for (unsigned int i = 0; i < itemCount; i++) {
+      if (renderItems[i].sortKey != expectedItems[i].sortKey ||
+          renderItems[i].modelIndex != expectedItems[i].modelIndex) {
+        ammonite::utils::error << "Sorted render items differ at index " << i << std::endl;
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  //Higher fields must always outweigh lower fields, and nearer draws sort first
+  bool testSortKeyOrder() {
+    using ammonite::graphics::internal::createSortKey;
+    const unsigned int maxField = ~0u;
+    const std::uint64_t firstPassKey = createSortKey({
+      .pass = 0, .drawMode = maxField, .shader = maxField, .vertexArrayId = maxField,
+      .diffuseId = maxField, .specularId = maxField, .depth = 1.0f
+    });
+    const std::uint64_t secondPassKey = createSortKey({
+      .pass = 1, .drawMode = 0, .shader = 0, .vertexArrayId = 0,
+      .diffuseId = 0, .specularId = 0, .depth = 0.0f
+    });
+    const std::uint64_t nearKey = createSortKey({
+      .pass = 1, .drawMode = 0, .shader = 0, .vertexArrayId = 0,
+      .diffuseId = 0, .specularId = 0, .depth = 0.25f
+    });
+    const std::uint64_t farKey = createSortKey({
+      .pass = 1, .drawMode = 0, .shader = 0, .vertexArrayId = 0,
+      .diffuseId = 0, .specularId = 0, .depth = 0.75f
+    });
+
+    if (firstPassKey >= secondPassKey || nearKey >= farKey || secondPassKey >= nearKey) {
+      ammonite::utils::error << "Sort keys are incorrectly ordered" << std::endl;
+      return false;
+    }
+
+    return true;
+  }
+}
+
+//Light cluster tests
+namespace {
+  using ammonite::graphics::internal::ClusterLight;
+  using ammonite::graphics::internal::LightCluster;
+
+  //Check every cluster's run of the light index list is valid, and uses valid lights
+  bool verifyClusterLists(unsigned int lightCount) {
+    const std::vector<LightCluster>& clusters = ammonite::graphics::internal::getLightClusters();
+    const std::vector<unsigned int>& lightIndices =
+      ammonite::graphics::internal::getClusterLightIndices();
+    if (clusters.size() != ammonite::graphics::internal::clusterCount) {
+      ammonite::utils::error << "Found " << clusters.size() << " clusters, expected " \
+                             << ammonite::graphics::internal::clusterCount << std::endl;
+      return false;
+    }
+
+    for (const LightCluster& cluster : clusters) {
+      if (cluster.firstLight + cluster.lightCount > lightIndices.size()) {
+        ammonite::utils::error << "Cluster's lights leave the index list" << std::endl;
+        return false;
+      }
+
+      for (unsigned int i = 0; i < cluster.lightCount; i++) {
+        if (lightIndices[cluster.firstLight + i] >= lightCount) {
+          ammonite::utils::error << "Cluster uses an invalid light" << std::endl;
+          return false;
+        }
+      }
+    }
+
+    return true;
+  }
+
+  /*
+   - Sort random lights into clusters for a random camera, then check random visible
+     points against every light
+   - Each light reaching a point must be listed by the point's cluster, found the same
+     way as the shaders
+  */
+  bool testLightClusters(unsigned int lightCount, unsigned int pointCount) {
+    using namespace ammonite::graphics::internal;
+
+    //Create a random camera
+    ammonite::Vec<float, 3> cameraPosition = {0};
+    ammonite::Vec<float, 3> cameraTarget = {0};
+    const ammonite::Vec<float, 3> up = {0.0f, 1.0f, 0.0f};
+    ammonite::utils::random<float>(cameraPosition, -20.0f, 20.0f);
+    ammonite::utils::random<float>(cameraTarget, -20.0f, 20.0f);
+
+    const float fov = ammonite::utils::random<float>(0.5f, 2.0f);
+    const float aspectRatio = ammonite::utils::random<float>(0.5f, 2.5f);
+    const float nearPlane = ammonite::utils::random<float>(0.05f, 1.0f);
+    const float farPlane = ammonite::utils::random<float>(50.0f, 200.0f);
+    ammonite::Mat<float, 4> viewMatrix = {{0}};
+    ammonite::Mat<float, 4> projectionMatrix = {{0}};
+    ammonite::lookAt(cameraPosition, cameraTarget, up, viewMatrix);
+    ammonite::perspective(fov, aspectRatio, nearPlane, farPlane, projectionMatrix);
+
+    //Scatter lights around the camera, including behind it and past the far plane
+    std::vector<ClusterLight> lights(lightCount);
+    std::vector<ammonite::Vec<float, 3>> viewLightPositions(lightCount);
+    for (unsigned int i = 0; i < lightCount; i++) {
+      ammonite::utils::random<float>(lights[i].position, -farPlane, farPlane);
+      lights[i].range = ammonite::utils::random<float>(0.5f, 20.0f);
+
+      ammonite::Vec<float, 4> worldPosition = {0};
+      ammonite::Vec<float, 4> viewPosition = {0};
+      ammonite::set(worldPosition, lights[i].position, 1.0f);
+      ammonite::multiply(viewMatrix, worldPosition, viewPosition);
+      ammonite::copy(viewPosition, viewLightPositions[i]);
+    }
+
+    buildLightClusters(viewMatrix, projectionMatrix, lights);
+    if (!verifyClusterLists(lightCount)) {
+      return false;
+    }
+
+    float depthScale = 0.0f;
+    float depthBias = 0.0f;
+    getClusterDepthFactors(&depthScale, &depthBias);
+    const std::vector<LightCluster>& clusters = getLightClusters();
+    const std::vector<unsigned int>& lightIndices = getClusterLightIndices();
+
+    for (unsigned int point = 0; point < pointCount; point++) {
+      //Pick a visible point in view space, from its screen position and depth
+      const float screenX = ammonite::utils::random<float>(-1.0f, 1.0f);
+      const float screenY = ammonite::utils::random<float>(-1.0f, 1.0f);
+      const float depth = ammonite::utils::random<float>(nearPlane, farPlane);
+      const ammonite::Vec<float, 3> viewPoint = {
+        screenX * depth / projectionMatrix[0][0],
+        screenY * depth / projectionMatrix[1][1],
+        -depth
+      };
+
+      //Find the point's cluster
+      const unsigned int tileX = std::min((unsigned int)((screenX * 0.5f + 0.5f) *
+        clusterGridX), clusterGridX - 1);
+      const unsigned int tileY = std::min((unsigned int)((screenY * 0.5f + 0.5f) *
+        clusterGridY), clusterGridY - 1);
+      const float slice = (std::log(depth) * depthScale) + depthBias;
+      const unsigned int sliceIndex = (unsigned int)std::clamp(slice, 0.0f,
+                                                               (float)(clusterGridZ - 1));
+      const LightCluster& cluster = clusters[(((sliceIndex * clusterGridY) + tileY) *
+                                             clusterGridX) + tileX];
+      const unsigned int* const firstLight = lightIndices.data() + cluster.firstLight;
+      const unsigned int* const lastLight = firstLight + cluster.lightCount;
+
+      //Skip lights within rounding distance of the point
+      for (unsigned int i = 0; i < lightCount; i++) {
+        if (ammonite::distance(viewPoint, viewLightPositions[i]) > lights[i].range * 0.999f) {
+          continue;
+        }
+
+        if (std::find(firstLight, lastLight, i) == lastLight) {
+          ammonite::utils::error << "Light " << i << " reaches a point, but is missing " \
+                                 << "from its cluster" << std::endl;
+          return false;
+        }
+      }
+    }
+
+    return true;
+  }
+}
+
+//Bounding tree helpers
+namespace {
+  using ammonite::models::internal::BoundingBox;
+
+  struct TrackedBounds {
+    unsigned int nodeIndex;
+    BoundingBox bounds;
+  };
+
+  //Extent of the scene, and the largest half-size of a box
+  constexpr float sceneSize = 100.0f;
+  constexpr float maxBoxSize = 4.0f;
+
+  //Distance from the edge of a query that rounding may move models across
+  constexpr float queryEpsilon = 1e-3f;
+
+  BoundingBox randomBounds() {
+    BoundingBox bounds;
+    for (unsigned int axis = 0; axis < 3; axis++) {
+      const float centre = ammonite::utils::random<float>(-sceneSize, sceneSize);
+      const float extent = ammonite::utils::random<float>(0.01f, maxBoxSize);
+      bounds.minimum[axis] = centre - extent;
+      bounds.maximum[axis] = centre + extent;
+    }
+
+    return bounds;
+  }
+
+  //Move bounds by up to distance along each axis
+  void moveBounds(BoundingBox& bounds, float distance) {
+    for (unsigned int axis = 0; axis < 3; axis++) {
+      const float offset = ammonite::utils::random<float>(-distance, distance);
+      bounds.minimum[axis] += offset;
+      bounds.maximum[axis] += offset;
+    }
+  }
+
+  //Returns true if a box isn't fully behind any of the planes, moved forwards by slack
+  bool isInsideFrustum(const BoundingBox& bounds, const ammonite::Vec<float, 4> planes[6],
+                       float slack) {
+    for (unsigned int i = 0; i < 6; i++) {
+      //Test the corner furthest along the plane's normal
+      float distance = planes[i][3] + slack;
+      for (unsigned int axis = 0; axis < 3; axis++) {
+        distance += planes[i][axis] * ((planes[i][axis] >= 0.0f) ?
+          bounds.maximum[axis] : bounds.minimum[axis]);
+      }
+
+      if (distance < 0.0f) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  //Returns true if a box is within radius of a point
+  bool isInsideSphere(const BoundingBox& bounds, const ammonite::Vec<float, 3>& centre,
+                      float radius) {
+    float distanceSquared = 0.0f;
+    for (unsigned int axis = 0; axis < 3; axis++) {
+      const float closest = std::clamp(centre[axis], bounds.minimum[axis],
+                                       bounds.maximum[axis]);
+      distanceSquared += (closest - centre[axis]) * (closest - centre[axis]);
+    }
+
+    return distanceSquared <= radius * radius;
+  }
+
+  //Returns the distance a ray enters a box at, or infinity if it's missed
+  float findRayDistance(const BoundingBox& bounds, const ammonite::Vec<float, 3>& origin,
+                        const ammonite::Vec<float, 3>& direction) {
+    float nearDistance = 0.0f;
+    float farDistance = std::numeric_limits<float>::infinity();
+    for (unsigned int axis = 0; axis < 3; axis++) {
+      float nearSlab = (bounds.minimum[axis] - origin[axis]) / direction[axis];
+      float farSlab = (bounds.maximum[axis] - origin[axis]) / direction[axis];
+      if (nearSlab > farSlab) {
+        std::swap(nearSlab, farSlab);
+      }
+
+      nearDistance = std::max(nearDistance, nearSlab);
+      farDistance = std::min(farDistance, farSlab);
+    }
+
+    return (nearDistance <= farDistance) ? nearDistance :
+      std::numeric_limits<float>::infinity();
+  }
+
+  /*
+   - Compare the IDs returned by a query to the IDs expected, ignoring order
+   - Results must contain every required ID, and only allowed IDs
+     - Models within rounding distance of the query's edge are allowed, but not required
+  */
+  bool compareQueryResults(std::vector<AmmoniteId>& modelIds,
+                           const std::vector<AmmoniteId>& requiredIds,
+                           const std::vector<AmmoniteId>& allowedIds, const char* queryName) {
+    std::sort(modelIds.begin(), modelIds.end());
+    if (std::adjacent_find(modelIds.begin(), modelIds.end()) != modelIds.end()) {
+      ammonite::utils::error << queryName << " query returned a model twice" << std::endl;
+      return false;
+    }
+
+    //Models are stored in order, so the expected IDs are already sorted
+    if (!std::includes(modelIds.begin(), modelIds.end(),
+                       requiredIds.begin(), requiredIds.end()) ||
+        !std::includes(allowedIds.begin(), allowedIds.end(),
+                       modelIds.begin(), modelIds.end())) {
+      ammonite::utils::error << queryName << " query found " << modelIds.size() \
+                             << " models, expected " << requiredIds.size() << std::endl;
+      return false;
+    }
+
+    return true;
+  }
+
+  //Find the closest model hit by a ray, ignoring ignoredModelId
+  AmmoniteId findClosestModel(const std::map<AmmoniteId, TrackedBounds>& models,
+                              const ammonite::Vec<float, 3>& origin,
+                              const ammonite::Vec<float, 3>& direction,
+                              AmmoniteId ignoredModelId, float* distance) {
+    float closestDistance = std::numeric_limits<float>::infinity();
+    AmmoniteId closestModelId = 0;
+    for (const auto& model : models) {
+      const float modelDistance = findRayDistance(model.second.bounds, origin, direction);
+      if (model.first != ignoredModelId && modelDistance < closestDistance) {
+        closestDistance = modelDistance;
+        closestModelId = model.first;
+      }
+    }
+
+    if (distance != nullptr) {
+      *distance = closestDistance;
+    }
+
+    return closestModelId;
+  }
+
+  //Compare a ray query to the closest model, models hit at the same distance may be swapped
+  bool verifyRayQuery(ammonite::models::internal::BoundingTree& tree,
+                      const std::map<AmmoniteId, TrackedBounds>& models,
+                      const ammonite::Vec<float, 3>& origin,
+                      const ammonite::Vec<float, 3>& direction, AmmoniteId ignoredModelId) {
+    float expectedDistance = 0.0f;
+    const AmmoniteId expectedModelId = findClosestModel(models, origin, direction,
+                                                        ignoredModelId, &expectedDistance);
+
+    //Allow for rounding, relative to the distance
+    float distance = 0.0f;
+    const AmmoniteId modelId = tree.queryRay(origin, direction, ignoredModelId, &distance);
+    const float tolerance = 1e-4f * std::max(1.0f, expectedDistance);
+    if ((modelId == 0) != (expectedModelId == 0) || (modelId != 0 &&
+        (modelId == ignoredModelId || std::abs(distance - expectedDistance) > tolerance))) {
+      ammonite::utils::error << "Ray query hit model " << modelId << " at " << distance \
+                             << ", expected model " << expectedModelId << " at " \
+                             << expectedDistance << std::endl;
+      return false;
+    }
+
+    return true;
+  }
+
+  //Run a random frustum, sphere and ray query, and compare them to every model
+  bool verifyBoundingTreeQueries(ammonite::models::internal::BoundingTree& tree,
+                                 const std::map<AmmoniteId, TrackedBounds>& models) {
+    //Create a random frustum, from randomly oriented planes around a point
+    ammonite::Vec<float, 3> point = {0};
+    ammonite::Vec<float, 4> planes[6];
+    ammonite::utils::random<float>(point, -sceneSize, sceneSize);
+    for (ammonite::Vec<float, 4>& plane : planes) {
+      ammonite::Vec<float, 3> normal = {0};
+      ammonite::utils::random<float>(normal, -1.0f, 1.0f);
+      ammonite::normalise(normal);
+
+      //Push each plane back from the point, so the frustum has some volume
+      const float offset = ammonite::utils::random<float>(5.0f, sceneSize);
+      plane[0] = normal[0];
+      plane[1] = normal[1];
+      plane[2] = normal[2];
+      plane[3] = offset - ammonite::dot(normal, point);
+    }
+
+    std::vector<AmmoniteId> modelIds;
+    std::vector<AmmoniteId> requiredIds;
+    std::vector<AmmoniteId> allowedIds;
+    tree.queryFrustum(planes, &modelIds);
+    for (const auto& model : models) {
+      if (isInsideFrustum(model.second.bounds, planes, -queryEpsilon)) {
+        requiredIds.push_back(model.first);
+      }
+
+      if (isInsideFrustum(model.second.bounds, planes, queryEpsilon)) {
+        allowedIds.push_back(model.first);
+      }
+    }
+
+    if (!compareQueryResults(modelIds, requiredIds, allowedIds, "Frustum")) {
+      return false;
+    }
+
+    //Check a random sphere
+    const float radius = ammonite::utils::random<float>(0.0f, sceneSize / 4.0f);
+    const float requiredRadius = std::max(radius - queryEpsilon, 0.0f);
+    ammonite::utils::random<float>(point, -sceneSize, sceneSize);
+    modelIds.clear();
+    requiredIds.clear();
+    allowedIds.clear();
+    tree.querySphere(point, radius, &modelIds);
+    for (const auto& model : models) {
+      if (isInsideSphere(model.second.bounds, point, requiredRadius)) {
+        requiredIds.push_back(model.first);
+      }
+
+      if (isInsideSphere(model.second.bounds, point, radius + queryEpsilon)) {
+        allowedIds.push_back(model.first);
+      }
+    }
+
+    if (!compareQueryResults(modelIds, requiredIds, allowedIds, "Sphere")) {
+      return false;
+    }
+
+    //Cast a random ray, then cast it again ignoring the closest model
+    ammonite::Vec<float, 3> direction = {0};
+    ammonite::utils::random<float>(point, -sceneSize, sceneSize);
+    ammonite::utils::random<float>(direction, -1.0f, 1.0f);
+    const AmmoniteId closestModelId = findClosestModel(models, point, direction, 0, nullptr);
+    return verifyRayQuery(tree, models, point, direction, 0) &&
+           verifyRayQuery(tree, models, point, direction, closestModelId);
+  }
+}
+
+//Bounding tree tests
+namespace {
+  /*
+   - Randomly insert, move and remove models, checking queries against every model
+   - Moves are mostly small, so most stay inside their enlarged bounds
+  */
+  bool testBoundingTreeChurn(unsigned int operationCount, unsigned int queryInterval) {
+    ammonite::models::internal::BoundingTree tree;
+    std::map<AmmoniteId, TrackedBounds> models;
+    AmmoniteId nextModelId = 1;
+
+    for (unsigned int operation = 0; operation < operationCount; operation++) {
+      const unsigned int choice = ammonite::utils::random<unsigned int>(9);
+      if (choice < 4 || models.empty()) {
+        const BoundingBox bounds = randomBounds();
+        models[nextModelId] = {.nodeIndex = tree.insert(bounds, nextModelId), .bounds = bounds};
+        nextModelId++;
+      } else {
+        auto modelIt = models.begin();
+        std::advance(modelIt, ammonite::utils::random<std::size_t>(models.size() - 1));
+        if (choice < 6) {
+          tree.remove(modelIt->second.nodeIndex);
+          models.erase(modelIt);
+        } else {
+          const bool isLargeMove = (choice == 9);
+          moveBounds(modelIt->second.bounds, isLargeMove ? sceneSize / 4.0f : 0.2f);
+          tree.update(modelIt->second.nodeIndex, modelIt->second.bounds);
+        }
+      }
+
+      if (tree.getLeafCount() != models.size()) {
+        ammonite::utils::error << "Tree has " << tree.getLeafCount() << " leaves, expected " \
+                               << models.size() << std::endl;
+        return false;
+      }
+
+      if (operation % queryInterval == 0 && !verifyBoundingTreeQueries(tree, models)) {
+        return false;
+      }
+    }
+
+    //Balanced trees stay within a small multiple of the optimal height
+    const int maxHeight = 2 * (int)std::ceil(std::log2((double)models.size() + 1.0)) + 1;
+    if (tree.getHeight() > maxHeight) {
+      ammonite::utils::error << "Tree height was " << tree.getHeight() << " for " \
+                             << models.size() << " leaves" << std::endl;
+      return false;
+    }
+
+    //Empty the tree, queries should find nothing
+    for (const auto& model : models) {
+      tree.remove(model.second.nodeIndex);
+    }
+    models.clear();
+
+    if (tree.getLeafCount() != 0 || tree.getHeight() != -1 ||
+        !verifyBoundingTreeQueries(tree, models)) {
+      ammonite::utils::error << "Tree wasn't empty after removing every model" << std::endl;
+      return false;
+    }
+
+    return true;
+  }
+}
+
+//Cubemap face culling tests
+namespace {
+  //Returns true if a point relative to a cubemap's origin is well inside a face's view
+  bool isInsideFace(const ammonite::Vec<float, 3>& point, unsigned int face) {
+    const unsigned int axis = face / 2;
+    const float sign = ((face % 2) == 0) ? 1.0f : -1.0f;
+    const float depth = sign * point[axis];
+    const float margin = 1e-4f * std::max(1.0f, depth);
+    return depth > std::abs(point[(axis + 1) % 3]) + margin &&
+           depth > std::abs(point[(axis + 2) % 3]) + margin;
+  }
+
+  /*
+   - Sample points in random boxes around random origins, every point inside a face's
+     view must have that face set in the box's mask
+   - Boxes are sometimes shrunk to a single point, which must only be on its own face
+  */
+  bool testCalculateFaceMask(unsigned int boxCount, unsigned int pointsPerBox) {
+    for (unsigned int i = 0; i < boxCount; i++) {
+      ammonite::Vec<float, 3> origin = {0};
+      ammonite::utils::random<float>(origin, -sceneSize, sceneSize);
+
+      //Mix boxes around the origin with boxes away from it
+      BoundingBox bounds = randomBounds();
+      if (ammonite::utils::random<unsigned int>(3) == 0) {
+        for (unsigned int axis = 0; axis < 3; axis++) {
+          const float offset = origin[axis] -
+            ((bounds.minimum[axis] + bounds.maximum[axis]) * 0.5f);
+          bounds.minimum[axis] += offset + ammonite::utils::random<float>(-1.0f, 1.0f);
+          bounds.maximum[axis] += offset + ammonite::utils::random<float>(-1.0f, 1.0f);
+          if (bounds.minimum[axis] > bounds.maximum[axis]) {
+            std::swap(bounds.minimum[axis], bounds.maximum[axis]);
+          }
+        }
+      }
+
+      const bool isPoint = (ammonite::utils::random<unsigned int>(7) == 0);
+      if (isPoint) {
+        ammonite::copy(bounds.minimum, bounds.maximum);
+      }
+
+      const unsigned char faceMask = ammonite::graphics::internal::calculateFaceMask(
+        bounds, origin);
+
+      //Check the corners, then random points inside the box
+      for (unsigned int j = 0; j < pointsPerBox + 8; j++) {
+        ammonite::Vec<float, 3> point = {0};
+        for (unsigned int axis = 0; axis < 3; axis++) {
+          if (j < 8) {
+            point[axis] = (((j >> axis) & 1) != 0) ? bounds.maximum[axis] :
+                                                     bounds.minimum[axis];
+          } else {
+            point[axis] = ammonite::utils::random<float>(bounds.minimum[axis],
+                                                         bounds.maximum[axis]);
+          }
+          point[axis] -= origin[axis];
+        }
+
+        unsigned char requiredMask = 0;
+        for (unsigned int face = 0; face < 6; face++) {
+          if (isInsideFace(point, face)) {
+            requiredMask |= (1u << face);
+          }
+        }
+
+        if ((requiredMask & ~faceMask) != 0) {
+          ammonite::utils::error << "Faces " << (int)requiredMask << " were needed for a " \
+                                 << "point of the box, but the mask was " \
+                                 << (int)faceMask << std::endl;
+          return false;
+        }
+
+        //A single point well inside a face can't be kept for any other face
+        if (isPoint && requiredMask != 0 && faceMask != requiredMask) {
+          ammonite::utils::error << "Point on faces " << (int)requiredMask \
+                                 << " was given the mask " << (int)faceMask << std::endl;
+          return false;
+        }
+      }
+    }
+
+    return true;
+  }
+}
+
+//Shadow instance tests
+namespace {
+  /*
+   - Add instances for random face masks of random lights, then check each model's run
+     holds exactly its (light, face) pairs, in the order they were added
+   - Runs must cover the instances without gaps, in model order
+  */
+  bool testShadowInstances(unsigned int trialCount, unsigned int modelCount,
+                           unsigned int maxLights) {
+    for (unsigned int trial = 0; trial < trialCount; trial++) {
+      ammonite::graphics::internal::resetShadowInstances(modelCount);
+      std::vector<std::vector<unsigned int>> expectedLayers(modelCount);
+
+      //Lights are added in any order, and sometimes skip models entirely
+      const unsigned int lightCount = ammonite::utils::random<unsigned int>(maxLights);
+      for (unsigned int i = 0; i < lightCount; i++) {
+        const unsigned int lightIndex = ammonite::utils::random<unsigned int>(maxLights * 4);
+        for (unsigned int modelIndex = 0; modelIndex < modelCount; modelIndex++) {
+          unsigned int faceMask = ammonite::utils::random<unsigned int>(63);
+          if (ammonite::utils::random<unsigned int>(2) == 0) {
+            faceMask = 0;
+          }
+
+          ammonite::graphics::internal::addShadowInstances(modelIndex, lightIndex, faceMask);
+          for (unsigned int face = 0; face < 6; face++) {
+            if ((faceMask & (1u << face)) != 0) {
+              expectedLayers[modelIndex].push_back((lightIndex * 6) + face);
+            }
+          }
+        }
+      }
+
+      ammonite::graphics::internal::groupShadowInstances();
+      const std::vector<ammonite::graphics::internal::ShadowInstanceRun>& instanceRuns =
+        ammonite::graphics::internal::getShadowInstanceRuns();
+      const std::vector<unsigned int>& instanceLayers =
+        ammonite::graphics::internal::getShadowInstanceLayers();
+      if (instanceRuns.size() != modelCount) {
+        ammonite::utils::error << "Expected " << modelCount << " instance runs, found " \
+                               << instanceRuns.size() << std::endl;
+        return false;
+      }
+
+      unsigned int nextInstance = 0;
+      for (unsigned int modelIndex = 0; modelIndex < modelCount; modelIndex++) {
+        const ammonite::graphics::internal::ShadowInstanceRun& instanceRun =
+          instanceRuns[modelIndex];
+        const std::vector<unsigned int>& expected = expectedLayers[modelIndex];
+        if (instanceRun.firstInstance != nextInstance ||
+            instanceRun.instanceCount != expected.size()) {
+          ammonite::utils::error << "Model " << modelIndex << " has instances " \
+                                 << instanceRun.firstInstance << " + " \
+                                 << instanceRun.instanceCount << ", expected " \
+                                 << nextInstance << " + " << expected.size() << std::endl;
+          return false;
+        }
+
+        if (!std::equal(expected.begin(), expected.end(),
+                        instanceLayers.begin() + instanceRun.firstInstance)) {
+          ammonite::utils::error << "Model " << modelIndex << " has the wrong layers" \
+                                 << std::endl;
+          return false;
+        }
+
+        nextInstance += instanceRun.instanceCount;
+      }
+
+      if (nextInstance != instanceLayers.size()) {
+        ammonite::utils::error << "Expected " << nextInstance << " instances, found " \
+                               << instanceLayers.size() << std::endl;
+        return false;
+      }
+    }
+
+    return true;
+  }
+}
+
+//Texture compression helpers
+namespace {
+  //Decoded RGBA texels of a 4x4 block, in row order
+  using DecodedBlock = int[16][4];
+
+  std::uint64_t readLittleEndian(const unsigned char* input, unsigned int bytes) {
+    std::uint64_t value = 0;
+    for (unsigned int i = 0; i < bytes; i++) {
+      value |= (std::uint64_t)input[i] << (i * 8);
+    }
+
+    return value;
+  }
+
+  void unpackColour565(unsigned int packed, int colour[3]) {
+    const int red = (int)((packed >> 11) & 0x1F);
+    const int green = (int)((packed >> 5) & 0x3F);
+    const int blue = (int)(packed & 0x1F);
+    colour[0] = (red << 3) | (red >> 2);
+    colour[1] = (green << 2) | (green >> 4);
+    colour[2] = (blue << 3) | (blue >> 2);
+  }
+
+  /*
+   - Decode a BC1 colour block into the RGBA texels
+   - BC3's colour blocks always use 4 colours, BC1 uses 3 colours and black when
+     the first colour isn't larger
+  */
+  void decodeColourBlock(const unsigned char* input, bool isAlwaysFourColour,
+                         DecodedBlock texels) {
+    const unsigned int colour0 = (unsigned int)readLittleEndian(input, 2);
+    const unsigned int colour1 = (unsigned int)readLittleEndian(input + 2, 2);
+    int palette[4][4] = {{0}};
+    unpackColour565(colour0, palette[0]);
+    unpackColour565(colour1, palette[1]);
+    palette[0][3] = 255;
+    palette[1][3] = 255;
+
+    const bool isFourColour = isAlwaysFourColour || colour0 > colour1;
+    for (unsigned int c = 0; c < 3; c++) {
+      if (isFourColour) {
+        palette[2][c] = ((2 * palette[0][c]) + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + (2 * palette[1][c])) / 3;
+      } else {
+        palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+        palette[3][c] = 0;
+      }
+    }
+    palette[2][3] = 255;
+    palette[3][3] = isFourColour ? 255 : 0;
+
+    const std::uint64_t indices = readLittleEndian(input + 4, 4);
+    for (unsigned int i = 0; i < 16; i++) {
+      std::memcpy(texels[i], palette[(indices >> (i * 2)) & 0x3], sizeof(texels[i]));
+    }
+  }
+
+  //Decode a BC4 block into one component of the texels
+  void decodeChannelBlock(const unsigned char* input, unsigned int component,
+                          DecodedBlock texels) {
+    const int value0 = input[0];
+    const int value1 = input[1];
+    int palette[8] = {value0, value1, 0, 0, 0, 0, 0, 255};
+    if (value0 > value1) {
+      for (int index = 2; index < 8; index++) {
+        palette[index] = (((8 - index) * value0) + ((index - 1) * value1)) / 7;
+      }
+    } else {
+      for (int index = 2; index < 6; index++) {
+        palette[index] = (((6 - index) * value0) + ((index - 1) * value1)) / 5;
+      }
+    }
+
+    const std::uint64_t indices = readLittleEndian(input + 2, 6);
+    for (unsigned int i = 0; i < 16; i++) {
+      texels[i][component] = palette[(indices >> (i * 3)) & 0x7];
+    }
+  }
+
+  //Read bits of a 16 byte block, starting from the lowest bit
+  struct BlockReader {
+    const unsigned char* input;
+    unsigned int bitOffset = 0;
+
+    unsigned int read(unsigned int bits) {
+      unsigned int value = 0;
+      for (unsigned int i = 0; i < bits; i++) {
+        value |= ((this->input[this->bitOffset / 8] >> (this->bitOffset % 8)) & 1u) << i;
+        this->bitOffset++;
+      }
+
+      return value;
+    }
+  };
+
+  //Decode a BC7 block, returns false for modes other than 6, since nothing else is written
+  bool decodeBptcBlock(const unsigned char* input, DecodedBlock texels) {
+    BlockReader reader = {.input = input};
+    if (reader.read(7) != (1u << 6)) {
+      return false;
+    }
+
+    int endpoints[2][4];
+    for (unsigned int c = 0; c < 4; c++) {
+      endpoints[0][c] = (int)reader.read(7) << 1;
+      endpoints[1][c] = (int)reader.read(7) << 1;
+    }
+
+    for (auto& endpoint : endpoints) {
+      const int pBit = (int)reader.read(1);
+      for (int& value : endpoint) {
+        value |= pBit;
+      }
+    }
+
+    constexpr int weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+    for (unsigned int i = 0; i < 16; i++) {
+      const int weight = weights[reader.read((i == 0) ? 3 : 4)];
+      for (unsigned int c = 0; c < 4; c++) {
+        texels[i][c] = (((64 - weight) * endpoints[0][c]) + (weight * endpoints[1][c]) +
+                        32) >> 6;
+      }
+    }
+
+    return true;
+  }
+
+  //Decode a compressed image into RGBA texels, returns false if a block couldn't be decoded
+  bool decodeCompressedImage(GLenum format, const unsigned char* input, int width,
+                             int height, std::vector<int>* texels) {
+    const int blocksX = (width + 3) / 4;
+    const int blocksY = (height + 3) / 4;
+    const bool isBc1 = (format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT);
+    texels->assign((std::size_t)width * height * 4, 0);
+    for (int blockY = 0; blockY < blocksY; blockY++) {
+      for (int blockX = 0; blockX < blocksX; blockX++) {
+        DecodedBlock block = {{0}};
+        switch (format) {
+        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+          decodeColourBlock(input, false, block);
+          break;
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+          decodeColourBlock(input + 8, true, block);
+          decodeChannelBlock(input, 3, block);
+          break;
+        case GL_COMPRESSED_RG_RGTC2:
+          decodeChannelBlock(input, 0, block);
+          decodeChannelBlock(input + 8, 1, block);
+          break;
+        default:
+          if (!decodeBptcBlock(input, block)) {
+            ammonite::utils::error << "Found a BC7 block that doesn't use mode 6" \
+                                   << std::endl;
+            return false;
+          }
+          break;
+        }
+        input += isBc1 ? 8 : 16;
+
+        //Skip the texels past the edges of the image
+        for (int y = 0; y < 4 && (blockY * 4) + y < height; y++) {
+          for (int x = 0; x < 4 && (blockX * 4) + x < width; x++) {
+            const std::size_t texel = ((std::size_t)((blockY * 4) + y) * width) +
+                                      (std::size_t)((blockX * 4) + x);
+            std::memcpy(&(*texels)[texel * 4], block[(y * 4) + x], sizeof(block[0]));
+          }
+        }
+      }
+    }
+
+    return true;
+  }
+
+  /*
+   - Create an image of a random gradient with a little noise, or of 4x4 blocks that
+     each pick every pixel from a random pair of colours
+   - Both can be stored without much loss, while mistakes in the encoder are large
+   - Endpoints are inset by 1/16 of their range, so pairs of colours aren't stored exactly
+  */
+  std::vector<unsigned char> createCompressionImage(int width, int height, int channels,
+                                                    bool useColourPairs) {
+    float base[4] = {0.0f};
+    float gradient[2][4] = {{0.0f}};
+    for (int c = 0; c < channels; c++) {
+      base[c] = ammonite::utils::random<float>(0.0f, 255.0f);
+      gradient[0][c] = ammonite::utils::random<float>(-6.0f, 6.0f);
+      gradient[1][c] = ammonite::utils::random<float>(-6.0f, 6.0f);
+    }
+
+    std::vector<unsigned char> image((std::size_t)width * height * channels);
+    std::vector<unsigned char> blockColours((std::size_t)(width + 3) / 4 * 2 * channels);
+    for (int y = 0; y < height; y++) {
+      for (int x = 0; x < width; x++) {
+        unsigned char* const pixel = &image[(((std::size_t)y * width) + x) * channels];
+        if (!useColourPairs) {
+          for (int c = 0; c < channels; c++) {
+            const float value = base[c] + (gradient[0][c] * (float)(x % 16)) +
+              (gradient[1][c] * (float)(y % 16)) + ammonite::utils::random<float>(-3.0f, 3.0f);
+            pixel[c] = (unsigned char)std::clamp(std::lround(value), 0l, 255l);
+          }
+
+          continue;
+        }
+
+        //Pick new colours at the start of each row of blocks
+        unsigned char* const colours = &blockColours[(std::size_t)(x / 4) * 2 * channels];
+        if (y % 4 == 0 && x % 4 == 0) {
+          for (int c = 0; c < channels * 2; c++) {
+            colours[c] = (unsigned char)ammonite::utils::random<unsigned int>(255);
+          }
+        }
+
+        const int colour = (int)ammonite::utils::random<unsigned int>(1);
+        std::memcpy(pixel, colours + (colour * channels), channels);
+      }
+    }
+
+    return image;
+  }
+
+  /*
+   - Compress random images, decode them and compare them against the originals
+   - The largest difference of any component, and the root mean square difference,
+     must be within the limits
+   - Only the components stored by the format are compared, missing alpha counts as opaque
+  */
+  bool testCompressionRoundTrip(GLenum format, int channels, unsigned int components,
+                                bool useColourPairs, unsigned int imageCount, int maxError,
+                                float maxRmsError) {
+    for (unsigned int i = 0; i < imageCount; i++) {
+      const int width = ammonite::utils::random<int>(1, 37);
+      const int height = ammonite::utils::random<int>(1, 37);
+      const std::vector<unsigned char> image = createCompressionImage(width, height,
+                                                                      channels, useColourPairs);
+
+      //Fill the output with a marker, to catch the encoder writing too little
+      const std::size_t compressedSize =
+        ammonite::textures::internal::calculateCompressedSize(format, width, height);
+      std::vector<unsigned char> compressed(compressedSize + 16, 0xA5);
+      if (!ammonite::textures::internal::compressImage(format, image.data(), width, height,
+                                                       channels, compressed.data())) {
+        ammonite::utils::error << "Failed to compress a " << width << " x " << height \
+                               << " image" << std::endl;
+        return false;
+      }
+
+      if (std::any_of(compressed.begin() + (long)compressedSize, compressed.end(),
+                      [](unsigned char value) { return value != 0xA5; })) {
+        ammonite::utils::error << "Compression wrote past the end of its output" << std::endl;
+        return false;
+      }
+
+      std::vector<int> texels;
+      if (!decodeCompressedImage(format, compressed.data(), width, height, &texels)) {
+        return false;
+      }
+
+      int largestError = 0;
+      double errorSum = 0.0;
+      for (std::size_t texel = 0; texel < (std::size_t)width * height; texel++) {
+        for (unsigned int c = 0; c < components; c++) {
+          const int expected = (c < (unsigned int)channels) ?
+            image[(texel * channels) + c] : 255;
+          const int error = std::abs(texels[(texel * 4) + c] - expected);
+          largestError = std::max(largestError, error);
+          errorSum += (double)error * error;
+        }
+      }
+
+      const double rmsError = std::sqrt(errorSum /
+        ((double)width * height * components));
+      if (largestError > maxError || rmsError > maxRmsError) {
+        ammonite::utils::error << "Compressing a " << width << " x " << height \
+                               << " image had a largest error of " << largestError \
+                               << " and an RMS error of " << rmsError << ", expected at most " \
+                               << maxError << " and " << maxRmsError << std::endl;
+        return false;
+      }
+    }
+
+    return true;
+  }
+}
+
+//Texture atlas helpers
+namespace {
+  using ammonite::textures::internal::AtlasRect;
+  using ammonite::textures::internal::TextureData;
+
+  //Gutter each atlas image must be surrounded by
+  constexpr int atlasGutter = 8;
+
+  //Create an image of random texels, small enough to be atlased
+  TextureData createRandomImage(int maxSize, int channels) {
+    TextureData image = {
+      .width = ammonite::utils::random<int>(1, maxSize),
+      .height = ammonite::utils::random<int>(1, maxSize),
+      .numChannels = channels,
+      .srgbTexture = true,
+      .hasTransparency = false,
+      .data = nullptr,
+      .compressedFormat = GL_NONE,
+      .levels = 1
+    };
+
+    const std::size_t size = (std::size_t)image.width * image.height * channels;
+    image.data = new unsigned char[size];
+    for (std::size_t i = 0; i < size; i++) {
+      image.data[i] = (unsigned char)ammonite::utils::random<unsigned int>(255);
+    }
+
+    return image;
+  }
+
+  /*
+   - Check an atlased image's texels, and its gutter of repeated edge texels
+   - Random texels make it unlikely for an overlapping image to match
+  */
+  bool verifyAtlasImage(const TextureData& atlas, const TextureData& image,
+                        const AtlasRect& rect) {
+    if (rect.x % atlasGutter != 0 || rect.y % atlasGutter != 0 ||
+        (int)rect.width != image.width || (int)rect.height != image.height) {
+      ammonite::utils::error << "Image region (" << rect.x << ", " << rect.y << ", " \
+                             << rect.width << ", " << rect.height << ") is misaligned" \
+                             << std::endl;
+      return false;
+    }
+
+    const int channels = image.numChannels;
+    for (int y = -atlasGutter; y < image.height + atlasGutter; y++) {
+      for (int x = -atlasGutter; x < image.width + atlasGutter; x++) {
+        const int atlasX = (int)rect.x + x;
+        const int atlasY = (int)rect.y + y;
+        if (atlasX < 0 || atlasY < 0 || atlasX >= atlas.width || atlasY >= atlas.height) {
+          ammonite::utils::error << "Image gutter leaves the atlas" << std::endl;
+          return false;
+        }
+
+        const int sourceX = std::clamp(x, 0, image.width - 1);
+        const int sourceY = std::clamp(y, 0, image.height - 1);
+        const unsigned char* const atlasTexel = atlas.data +
+          (((std::size_t)atlasY * atlas.width) + atlasX) * channels;
+        const unsigned char* const imageTexel = image.data +
+          (((std::size_t)sourceY * image.width) + sourceX) * channels;
+        if (std::memcmp(atlasTexel, imageTexel, channels) != 0) {
+          ammonite::utils::error << "Atlas texel (" << atlasX << ", " << atlasY \
+                                 << ") doesn't match its image" << std::endl;
+          return false;
+        }
+      }
+    }
+
+    return true;
+  }
+}
+
+//Texture atlas tests
+namespace {
+  //Pack random rectangles, checking bounds and overlaps with an occupancy map
+  bool testSkylinePacker(unsigned int trialCount, unsigned int rectCount) {
+    for (unsigned int trial = 0; trial < trialCount; trial++) {
+      const unsigned int width = ammonite::utils::random<unsigned int>(64, 512);
+      const unsigned int height = ammonite::utils::random<unsigned int>(64, 512);
+      ammonite::textures::internal::SkylinePacker packer(width, height);
+      std::vector<bool> occupied((std::size_t)width * height, false);
+
+      unsigned int usedWidth = 0;
+      unsigned int usedHeight = 0;
+      for (unsigned int i = 0; i < rectCount; i++) {
+        AtlasRect rect;
+        const unsigned int rectWidth = ammonite::utils::random<unsigned int>(1, 64);
+        const unsigned int rectHeight = ammonite::utils::random<unsigned int>(1, 64);
+        if (!packer.pack(rectWidth, rectHeight, &rect)) {
+          continue;
+        }
+
+        if (rect.width != rectWidth || rect.height != rectHeight ||
+            rect.x + rect.width > width || rect.y + rect.height > height) {
+          ammonite::utils::error << "Packed rectangle (" << rect.x << ", " << rect.y << ", " \
+                                 << rect.width << ", " << rect.height \
+                                 << ") doesn't fit the area" << std::endl;
+          return false;
+        }
+
+        for (unsigned int y = rect.y; y < rect.y + rect.height; y++) {
+          for (unsigned int x = rect.x; x < rect.x + rect.width; x++) {
+            if (occupied[((std::size_t)y * width) + x]) {
+              ammonite::utils::error << "Packed rectangles overlap at (" << x << ", " \
+                                     << y << ")" << std::endl;
+              return false;
+            }
+
+            occupied[((std::size_t)y * width) + x] = true;
+          }
+        }
+
+        usedWidth = std::max(usedWidth, rect.x + rect.width);
+        usedHeight = std::max(usedHeight, rect.y + rect.height);
+      }
+
+      if (packer.getUsedWidth() != usedWidth || packer.getUsedHeight() != usedHeight) {
+        ammonite::utils::error << "Packer used " << packer.getUsedWidth() << "x" \
+                               << packer.getUsedHeight() << ", expected " << usedWidth \
+                               << "x" << usedHeight << std::endl;
+        return false;
+      }
+    }
+
+    //Empty rectangles and areas can't be packed
+    AtlasRect rect;
+    ammonite::textures::internal::SkylinePacker packer(64, 64);
+    ammonite::textures::internal::SkylinePacker emptyPacker(0, 0);
+    return !packer.pack(0, 1, &rect) && !packer.pack(65, 1, &rect) &&
+           !emptyPacker.pack(1, 1, &rect);
+  }
+
+  /*
+   - Build an atlas from random images, then check every packed image and its gutter
+   - Images that don't fit must be given an empty region
+  */
+  bool testTextureAtlas(unsigned int imageCount, int maxImageSize, int channels) {
+    std::vector<TextureData> images(imageCount);
+    std::vector<const TextureData*> imagePtrs(imageCount);
+    std::vector<AtlasRect> imageRects(imageCount);
+    for (unsigned int i = 0; i < imageCount; i++) {
+      images[i] = createRandomImage(maxImageSize, channels);
+      imagePtrs[i] = &images[i];
+    }
+
+    //Mark a single image as transparent, the atlas should inherit it
+    images[0].hasTransparency = true;
+
+    bool passed = true;
+    TextureData atlas = {};
+    if (!ammonite::textures::internal::buildTextureAtlas(imagePtrs.data(), imageCount,
+                                                         imageRects.data(), &atlas)) {
+      ammonite::utils::error << "Failed to build texture atlas" << std::endl;
+      passed = false;
+    } else {
+      if (atlas.width % atlasGutter != 0 || atlas.height % atlasGutter != 0 ||
+          atlas.levels <= 1 || atlas.numChannels != channels) {
+        ammonite::utils::error << "Atlas has an invalid layout" << std::endl;
+        passed = false;
+      }
+
+      unsigned int packedCount = 0;
+      for (unsigned int i = 0; i < imageCount && passed; i++) {
+        if (imageRects[i].width != 0) {
+          passed &= verifyAtlasImage(atlas, images[i], imageRects[i]);
+          packedCount++;
+        } else if (imageRects[i].height != 0) {
+          ammonite::utils::error << "Unpacked image was given a region" << std::endl;
+          passed = false;
+        }
+      }
+
+      if (packedCount == 0 || atlas.hasTransparency != (imageRects[0].width != 0)) {
+        ammonite::utils::error << "Atlas has invalid image data" << std::endl;
+        passed = false;
+      }
+
+      delete [] atlas.data;
+    }
+
+    for (const TextureData& image : images) {
+      delete [] image.data;
+    }
+
+    return passed;
+  }
+
+  //Only small, uncompressed images can be atlased
+  bool testCanAtlasTexture() {
+    TextureData image = {
+      .width = 128,
+      .height = 128,
+      .numChannels = 4,
+      .srgbTexture = false,
+      .hasTransparency = false,
+      .data = nullptr,
+      .compressedFormat = GL_NONE,
+      .levels = 1
+    };
+
+    bool passed = ammonite::textures::internal::canAtlasTexture(image);
+    image.height = 129;
+    passed &= !ammonite::textures::internal::canAtlasTexture(image);
+    image.height = 128;
+    image.compressedFormat = GL_COMPRESSED_RGBA_BPTC_UNORM;
+    passed &= !ammonite::textures::internal::canAtlasTexture(image);
+
+    return passed;
+  }
+}
+
+//Flat hash map helpers
+namespace {
+  using ammonite::utils::internal::Hash128;
+
+  struct ReferenceHasher {
+    std::size_t operator()(const Hash128& key) const {
+      return (std::size_t)(key.low ^ std::rotl(key.high, 32));
+    }
+  };
+
+  using ReferenceMap = std::unordered_map<Hash128, unsigned int, ReferenceHasher>;
+
+  /*
+   - Create keys that are hard on the map, in equal numbers:
+     - Keys from hashData(), hashing inputs of every length up to 40 bytes
+     - Keys sharing their low 20 bits, so they collide at any size used
+     - Keys only differing in their high bits
+     - Keys starting in the last 4 slots, so their runs wrap past the end of the table
+   - Returns false if hashData() gave different inputs the same key
+  */
+  bool createTestKeys(unsigned int keyCount, std::vector<Hash128>* keys) {
+    const std::uint64_t seed = ammonite::utils::random<std::uint64_t>();
+    const std::uint64_t sharedLow = ammonite::utils::random<std::uint64_t>();
+
+    keys->clear();
+    ReferenceMap seenKeys;
+    for (unsigned int i = 0; i < keyCount; i++) {
+      unsigned char input[40] = {0};
+      std::memcpy(input, &i, sizeof(i));
+      const Hash128 hash = ammonite::utils::internal::hashData(input, 4 + (i % 37), seed);
+
+      Hash128 key = hash;
+      switch (i % 4) {
+      case 1:
+        key.low = (hash.low & ~0xFFFFFull) | (sharedLow & 0xFFFFFull);
+        break;
+      case 2:
+        key.low = sharedLow;
+        break;
+      case 3:
+        key.low = (hash.low | 0xFFFFFull) - (i % 16 / 4);
+        break;
+      default:
+        break;
+      }
+
+      if (seenKeys.contains(hash) || seenKeys.contains(key)) {
+        ammonite::utils::error << "hashData() gave a repeated key for input " << i \
+                               << std::endl;
+        return false;
+      }
+
+      seenKeys[hash] = i;
+      seenKeys[key] = i;
+      keys->push_back(key);
+    }
+
+    return true;
+  }
+
+  //Check the map holds exactly the entries of the reference
+  bool checkFlatHashMap(ammonite::utils::internal::FlatHashMap<unsigned int>* map,
+                        const ReferenceMap& reference, const std::vector<Hash128>& keys) {
+    if (map->size() != reference.size()) {
+      ammonite::utils::error << "Map holds " << map->size() << " entries, expected " \
+                             << reference.size() << std::endl;
+      return false;
+    }
+
+    for (std::size_t i = 0; i < keys.size(); i++) {
+      const auto referenceIt = reference.find(keys[i]);
+      const unsigned int* const value = map->find(keys[i]);
+      const bool isExpected = (referenceIt != reference.end());
+      if ((value != nullptr) != isExpected || map->contains(keys[i]) != isExpected) {
+        ammonite::utils::error << "Key " << i << " should " << (isExpected ? "" : "not ") \
+                               << "be in the map" << std::endl;
+        return false;
+      }
+
+      if (isExpected && *value != referenceIt->second) {
+        ammonite::utils::error << "Key " << i << " has value " << *value << ", expected " \
+                               << referenceIt->second << std::endl;
+        return false;
+      }
+    }
+
+    return true;
+  }
+}
+
+//Flat hash map tests
+namespace {
+  /*
+   - Insert, erase and find random keys, comparing against std::unordered_map
+   - Phases alternate between mostly inserting and mostly erasing, so erases happen
+     between every growth of the table, and emptied tables are filled again
+   - Every lookup is checked, and the whole map 4 times per phase
+  */
+  bool testFlatHashMap(unsigned int keyCount, unsigned int operationCount,
+                       unsigned int phaseLength) {
+    std::vector<Hash128> keys;
+    if (!createTestKeys(keyCount, &keys)) {
+      return false;
+    }
+
+    ammonite::utils::internal::FlatHashMap<unsigned int> map;
+    ReferenceMap reference;
+    for (unsigned int operation = 0; operation < operationCount; operation++) {
+      const bool isGrowing = ((operation / phaseLength) % 2 == 0);
+      const unsigned int keyIndex = ammonite::utils::random<unsigned int>(keyCount - 1);
+      const Hash128& key = keys[keyIndex];
+      const unsigned int choice = ammonite::utils::random<unsigned int>(99);
+      if (choice < (isGrowing ? 60u : 25u)) {
+        //Existing values must be returned, new ones default constructed
+        const auto referenceIt = reference.find(key);
+        const unsigned int expected = (referenceIt != reference.end()) ?
+          referenceIt->second : 0;
+        unsigned int& value = map[key];
+        if (value != expected) {
+          ammonite::utils::error << "Inserting key " << keyIndex << " found value " \
+                                 << value << ", expected " << expected << std::endl;
+          return false;
+        }
+
+        value = ammonite::utils::random<unsigned int>(1, 1000000);
+        reference[key] = value;
+      } else if (choice < 90) {
+        const bool expected = (reference.erase(key) != 0);
+        if (map.erase(key) != expected) {
+          ammonite::utils::error << "Erasing key " << keyIndex << " should " \
+                                 << (expected ? "" : "not ") << "succeed" << std::endl;
+          return false;
+        }
+      } else {
+        const unsigned int* const value = map.find(key);
+        if ((value != nullptr) != reference.contains(key)) {
+          ammonite::utils::error << "Finding key " << keyIndex << " should " \
+                                 << (reference.contains(key) ? "" : "not ") \
+                                 << "succeed" << std::endl;
+          return false;
+        }
+      }
+
+      if (map.size() != reference.size()) {
+        ammonite::utils::error << "Map holds " << map.size() << " entries, expected " \
+                               << reference.size() << std::endl;
+        return false;
+      }
+
+      if (operation % (phaseLength / 4) == 0 && !checkFlatHashMap(&map, reference, keys)) {
+        return false;
+      }
+    }
+
+    return checkFlatHashMap(&map, reference, keys);
+  }
+}
+
+int main() {
+  bool failed = false;
+
+  ammonite::utils::normal << "Testing range allocator, random allocations" << std::endl;
+  failed |= !testRangeAllocatorRandom(4096, 50000, 64);
+
+  ammonite::utils::normal << "Testing range allocator, random large allocations" << std::endl;
+  failed |= !testRangeAllocatorRandom(1024, 20000, 512);
+
+  ammonite::utils::normal << "Testing range allocator, merging" << std::endl;
+  failed |= !testRangeAllocatorMerge(256, 7);
+
+  ammonite::utils::normal << "Testing range allocator, empty ranges" << std::endl;
+  failed |= !testRangeAllocatorEmpty();
+
+  ammonite::utils::normal << "Testing shadow atlas, random tiles" << std::endl;
+  failed |= !testShadowAtlasRandom(2048, 32, 20000);
+
+  ammonite::utils::normal << "Testing shadow atlas limits" << std::endl;
+  failed |= !testShadowAtlasLimits();
+
+  //Large queues and light counts use the thread pool, force several threads to split them
+  if (!ammonite::utils::thread::createThreadPool(4)) {
+    ammonite::utils::error << "Failed to create thread pool, exiting" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  ammonite::utils::normal << "Testing render queue sort, small queues" << std::endl;
+  failed |= !testRenderQueueSort(0, 1);
+  failed |= !testRenderQueueSort(1, 1);
+  failed |= !testRenderQueueSort(1000, 16);
+
+  ammonite::utils::normal << "Testing render queue sort, threaded" << std::endl;
+  failed |= !testRenderQueueSort(300000, 64);
+  failed |= !testRenderQueueSort(300000, 300000);
+
+  ammonite::utils::normal << "Testing sort key order" << std::endl;
+  failed |= !testSortKeyOrder();
+
+  ammonite::utils::normal << "Testing light clusters" << std::endl;
+  failed |= !testLightClusters(8, 20000);
+
+  ammonite::utils::normal << "Testing light clusters, threaded" << std::endl;
+  failed |= !testLightClusters(300, 20000);
+
+  ammonite::utils::thread::destroyThreadPool();
+
+  ammonite::utils::normal << "Testing bounding tree, random churn" << std::endl;
+  failed |= !testBoundingTreeChurn(20000, 50);
+
+  ammonite::utils::normal << "Testing bounding tree, dense churn" << std::endl;
+  failed |= !testBoundingTreeChurn(5000, 1);
+
+  ammonite::utils::normal << "Testing cubemap face culling" << std::endl;
+  failed |= !testCalculateFaceMask(20000, 64);
+
+  ammonite::utils::normal << "Testing shadow instances" << std::endl;
+  failed |= !testShadowInstances(500, 200, 16);
+
+  ammonite::utils::normal << "Testing texture compression, BC1" << std::endl;
+  failed |= !testCompressionRoundTrip(GL_COMPRESSED_RGB_S3TC_DXT1_EXT,
+                                      3, 3, false, 200, 28, 7.0f);
+  failed |= !testCompressionRoundTrip(GL_COMPRESSED_RGB_S3TC_DXT1_EXT,
+                                      3, 3, true, 200, 20, 14.0f);
+
+  ammonite::utils::normal << "Testing texture compression, BC3" << std::endl;
+  failed |= !testCompressionRoundTrip(GL_COMPRESSED_RGBA_S3TC_DXT5_EXT,
+                                      4, 4, false, 200, 28, 7.0f);
+  failed |= !testCompressionRoundTrip(GL_COMPRESSED_RGBA_S3TC_DXT5_EXT,
+                                      4, 4, true, 200, 20, 14.0f);
+
+  ammonite::utils::normal << "Testing texture compression, BC5" << std::endl;
+  failed |= !testCompressionRoundTrip(GL_COMPRESSED_RG_RGTC2,
+                                      2, 2, false, 200, 6, 2.0f);
+  failed |= !testCompressionRoundTrip(GL_COMPRESSED_RG_RGTC2,
+                                      2, 2, true, 200, 0, 0.0f);
+
+  ammonite::utils::normal << "Testing texture compression, BC7" << std::endl;
+  failed |= !testCompressionRoundTrip(GL_COMPRESSED_RGBA_BPTC_UNORM,
+                                      4, 4, false, 200, 26, 6.5f);
+  failed |= !testCompressionRoundTrip(GL_COMPRESSED_RGBA_BPTC_UNORM,
+                                      4, 4, true, 200, 17, 12.0f);
+  failed |= !testCompressionRoundTrip(GL_COMPRESSED_RGBA_BPTC_UNORM,
+                                      3, 4, false, 200, 26, 6.5f);
+
+  ammonite::utils::normal << "Testing skyline packer" << std::endl;
+  failed |= !testSkylinePacker(200, 300);
+
+  ammonite::utils::normal << "Testing texture atlas" << std::endl;
+  failed |= !testTextureAtlas(40, 128, 4);
+
+  ammonite::utils::normal << "Testing texture atlas, single channel" << std::endl;
+  failed |= !testTextureAtlas(100, 32, 1);
+
+  ammonite::utils::normal << "Testing texture atlas, overfull" << std::endl;
+  failed |= !testTextureAtlas(800, 128, 3);
+
+  ammonite::utils::normal << "Testing texture atlas limits" << std::endl;
+  failed |= !testCanAtlasTexture();
+
+  ammonite::utils::normal << "Testing flat hash map" << std::endl;
+  failed |= !testFlatHashMap(2000, 100000, 4000);
+
+  ammonite::utils::normal << "Testing flat hash map, small tables" << std::endl;
+  failed |= !testFlatHashMap(24, 100000, 100);
+
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}